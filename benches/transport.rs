@@ -0,0 +1,421 @@
+//! Side-by-side benchmark of the two Atem ↔ Astation transports: the RTM
+//! shim (stub broker, or the real SDK with `--features real_rtm`) and the
+//! Astation WebSocket client against a local stand-in that relays every
+//! frame back. Both carry the same `AstationMessage` mix and are measured
+//! the same way: a fixed window of messages in flight, latency from send to
+//! the matching receive, process CPU time and Rust heap allocations.
+//!
+//! cargo bench --bench transport
+//!
+//! `cargo test --benches` runs only a short check of both transports. The
+//! bench is a target of its own so that its counting allocator does not
+//! slow down, or count the allocations of, the unit tests.
+//!
+//! With `real_rtm`, ATEM_BENCH_RTM_APP_ID and ATEM_BENCH_RTM_TOKEN (a token
+//! valid for both bench users, or empty for an app without certificate)
+//! select the project. CPU includes the in-process stand-ins (the stub
+//! broker, the echo server); allocations made by the native shim or the
+//! SDK are not counted.
+
+// The binary crate has no library; build the modules the bench needs from
+// their sources. Most of what they offer goes unused here.
+#![allow(dead_code)]
+
+#[path = "../src/agent_client.rs"]
+mod agent_client;
+#[path = "../src/agora_api.rs"]
+mod agora_api;
+#[path = "../src/auth.rs"]
+mod auth;
+#[path = "../src/config.rs"]
+mod config;
+#[path = "../src/credentials.rs"]
+mod credentials;
+#[path = "../src/rtm_client.rs"]
+mod rtm_client;
+#[path = "../src/websocket_client.rs"]
+mod websocket_client;
+
+use crate::rtm_client::{RtmClient, RtmConfig, RtmEvent};
+use crate::websocket_client::{AstationClient, AstationMessage};
+use anyhow::{Result, anyhow};
+use futures_util::{SinkExt, StreamExt};
+use std::alloc::{GlobalAlloc, Layout, System};
+use std::collections::HashMap;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::time::{Duration, Instant};
+use tokio_tungstenite::tungstenite::Message;
+
+const CHANNEL: &str = "atem_bench";
+const SENDER: &str = "atem-bench-tx";
+const RECEIVER: &str = "atem-bench-rx";
+/// Messages sent but not yet received before the sender waits.
+const WINDOW: usize = 32;
+const LARGE_RESULT_BYTES: usize = 12 * 1024;
+/// A run that stops making progress for this long fails.
+const STALL_TIMEOUT: Duration = Duration::from_secs(30);
+
+/// Counts Rust heap allocations (and reallocations) in the bench binary.
+struct CountingAlloc;
+
+static ALLOCATIONS: AtomicU64 = AtomicU64::new(0);
+
+unsafe impl GlobalAlloc for CountingAlloc {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+        unsafe { System.alloc(layout) }
+    }
+
+    unsafe fn alloc_zeroed(&self, layout: Layout) -> *mut u8 {
+        ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+        unsafe { System.alloc_zeroed(layout) }
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+        unsafe { System.realloc(ptr, layout, new_size) }
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        unsafe { System.dealloc(ptr, layout) }
+    }
+}
+
+#[global_allocator]
+static GLOBAL: CountingAlloc = CountingAlloc;
+
+fn process_cpu() -> Duration {
+    let mut ts = libc::timespec {
+        tv_sec: 0,
+        tv_nsec: 0,
+    };
+    unsafe { libc::clock_gettime(libc::CLOCK_PROCESS_CPUTIME_ID, &mut ts) };
+    Duration::new(ts.tv_sec as u64, ts.tv_nsec as u32)
+}
+
+/// The `index`-th message of the mix, in twenty-message rounds: ten
+/// partial and two final transcriptions, four heartbeats, three status
+/// updates and one large command result.
+pub fn mix_message(index: usize) -> AstationMessage {
+    match index % 20 {
+        0..=9 => AstationMessage::VoiceCommand {
+            text: format!("refactor the parser so that error {index} reports the line"),
+            is_final: false,
+        },
+        10 | 11 => AstationMessage::VoiceCommand {
+            text: format!("refactor the parser so that error {index} reports the line and column"),
+            is_final: true,
+        },
+        12..=15 => AstationMessage::Heartbeat {
+            timestamp: index.to_string(),
+        },
+        16..=18 => AstationMessage::StatusUpdate {
+            status: "working".to_string(),
+            data: HashMap::from([
+                ("client_type".to_string(), "Atem".to_string()),
+                ("agent".to_string(), "claude".to_string()),
+                ("seq".to_string(), index.to_string()),
+            ]),
+        },
+        _ => AstationMessage::CommandResponse {
+            output: "x".repeat(LARGE_RESULT_BYTES),
+            success: true,
+            timestamp: index.to_string(),
+        },
+    }
+}
+
+/// One transport's numbers for a run.
+#[derive(Debug)]
+pub struct TransportReport {
+    pub transport: &'static str,
+    pub messages: usize,
+    pub elapsed: Duration,
+    pub cpu: Duration,
+    pub allocations: u64,
+    /// Send-to-receive latency per message, sorted.
+    pub latencies_us: Vec<u64>,
+}
+
+impl TransportReport {
+    pub fn per_second(&self) -> f64 {
+        self.messages as f64 / self.elapsed.as_secs_f64().max(f64::EPSILON)
+    }
+
+    pub fn percentile_us(&self, p: f64) -> u64 {
+        if self.latencies_us.is_empty() {
+            return 0;
+        }
+        let rank = ((p / 100.0) * self.latencies_us.len() as f64).ceil() as usize;
+        self.latencies_us[rank.clamp(1, self.latencies_us.len()) - 1]
+    }
+
+    pub fn cpu_us_per_message(&self) -> f64 {
+        self.cpu.as_micros() as f64 / self.messages.max(1) as f64
+    }
+
+    pub fn allocations_per_message(&self) -> f64 {
+        self.allocations as f64 / self.messages.max(1) as f64
+    }
+}
+
+/// Snapshot taken when the timed part of a run starts.
+struct Probe {
+    started: Instant,
+    cpu: Duration,
+    allocations: u64,
+    sent_at: Vec<Instant>,
+    latencies_us: Vec<u64>,
+}
+
+impl Probe {
+    fn start(messages: usize) -> Self {
+        Self {
+            started: Instant::now(),
+            cpu: process_cpu(),
+            allocations: ALLOCATIONS.load(Ordering::Relaxed),
+            sent_at: Vec::with_capacity(messages),
+            latencies_us: Vec::with_capacity(messages),
+        }
+    }
+
+    fn in_flight(&self) -> usize {
+        self.sent_at.len() - self.latencies_us.len()
+    }
+
+    fn sent(&mut self) {
+        self.sent_at.push(Instant::now());
+    }
+
+    /// Both transports deliver in order, so the n-th receive matches the
+    /// n-th send.
+    fn received(&mut self) {
+        let sent_at = self.sent_at[self.latencies_us.len()];
+        self.latencies_us.push(sent_at.elapsed().as_micros() as u64);
+    }
+
+    fn finish(mut self, transport: &'static str) -> TransportReport {
+        let elapsed = self.started.elapsed();
+        let cpu = process_cpu().saturating_sub(self.cpu);
+        let allocations = ALLOCATIONS.load(Ordering::Relaxed) - self.allocations;
+        self.latencies_us.sort_unstable();
+        TransportReport {
+            transport,
+            messages: self.latencies_us.len(),
+            elapsed,
+            cpu,
+            allocations,
+            latencies_us: self.latencies_us,
+        }
+    }
+}
+
+fn rtm_credentials() -> (String, String) {
+    if cfg!(feature = "real_rtm") {
+        (
+            std::env::var("ATEM_BENCH_RTM_APP_ID").unwrap_or_default(),
+            std::env::var("ATEM_BENCH_RTM_TOKEN").unwrap_or_default(),
+        )
+    } else {
+        // Stub: a project of its own, so concurrent tests do not interfere.
+        (
+            format!("atem-bench-{}", uuid::Uuid::new_v4()),
+            String::new(),
+        )
+    }
+}
+
+/// Publishes the mix from one RTM client to another on a channel. Each
+/// message is serialized on send and parsed on receipt, as the WebSocket
+/// client's writer and reader tasks do.
+pub async fn run_rtm(messages: usize) -> Result<TransportReport> {
+    let (app_id, token) = rtm_credentials();
+    let client = |client_id: &str| {
+        RtmClient::new(RtmConfig {
+            app_id: app_id.clone(),
+            token: token.clone(),
+            channel: CHANNEL.into(),
+            client_id: client_id.into(),
+            ..Default::default()
+        })
+    };
+    let sender = client(SENDER)?;
+    let receiver = client(RECEIVER)?;
+    sender.login_and_join(&token, SENDER, CHANNEL).await?;
+    receiver.login_and_join(&token, RECEIVER, CHANNEL).await?;
+    receiver.drain_events().await;
+
+    let mut probe = Probe::start(messages);
+    let mut last_progress = Instant::now();
+    while probe.latencies_us.len() < messages {
+        while probe.sent_at.len() < messages && probe.in_flight() < WINDOW {
+            let json = serde_json::to_string(&mix_message(probe.sent_at.len()))?;
+            probe.sent();
+            sender.publish_channel(&json).await?;
+        }
+        receiver.tick().await?;
+        let before = probe.latencies_us.len();
+        for event in receiver.drain_events().await {
+            if let RtmEvent::Message { from, payload, .. } = event {
+                if from != SENDER {
+                    continue;
+                }
+                let _: AstationMessage = serde_json::from_str(&payload)?;
+                probe.received();
+            }
+        }
+        if probe.latencies_us.len() > before {
+            last_progress = Instant::now();
+        } else if last_progress.elapsed() > STALL_TIMEOUT {
+            return Err(anyhow!(
+                "rtm: stalled after {} of {messages} messages",
+                probe.latencies_us.len()
+            ));
+        } else {
+            // The real SDK delivers on its own threads.
+            tokio::time::sleep(Duration::from_micros(50)).await;
+        }
+    }
+    let label = if cfg!(feature = "real_rtm") {
+        "rtm (sdk)"
+    } else {
+        "rtm (stub)"
+    };
+    let report = probe.finish(label);
+    sender.shutdown(Duration::from_millis(500)).await?;
+    receiver.shutdown(Duration::from_millis(500)).await?;
+    Ok(report)
+}
+
+/// Sends the mix through `AstationClient` to a local stand-in for
+/// Astation that relays every text frame straight back.
+pub async fn run_websocket(messages: usize) -> Result<TransportReport> {
+    let listener = tokio::net::TcpListener::bind("127.0.0.1:0").await?;
+    let address = listener.local_addr()?;
+    let server = tokio::spawn(async move {
+        let Ok((stream, _)) = listener.accept().await else {
+            return;
+        };
+        let Ok(mut socket) = tokio_tungstenite::accept_async(stream).await else {
+            return;
+        };
+        while let Some(Ok(frame)) = socket.next().await {
+            match frame {
+                Message::Text(_) => {
+                    if socket.send(frame).await.is_err() {
+                        break;
+                    }
+                }
+                Message::Close(_) => break,
+                _ => {}
+            }
+        }
+    });
+
+    let mut client = AstationClient::new();
+    client.connect_raw(&format!("ws://{address}")).await?;
+
+    let mut probe = Probe::start(messages);
+    while probe.latencies_us.len() < messages {
+        while probe.sent_at.len() < messages && probe.in_flight() < WINDOW {
+            let message = mix_message(probe.sent_at.len());
+            probe.sent();
+            client.send_message(message).await?;
+        }
+        match tokio::time::timeout(STALL_TIMEOUT, client.recv_message_async()).await {
+            Ok(Some(_)) => probe.received(),
+            Ok(None) => return Err(anyhow!("websocket: stand-in closed the connection")),
+            Err(_) => {
+                return Err(anyhow!(
+                    "websocket: stalled after {} of {messages} messages",
+                    probe.latencies_us.len()
+                ));
+            }
+        }
+    }
+    let report = probe.finish("websocket");
+    drop(client);
+    server.abort();
+    Ok(report)
+}
+
+pub fn format_reports(reports: &[TransportReport]) -> String {
+    let mut out = format!(
+        "{:<12} {:>8} {:>10} {:>8} {:>8} {:>8} {:>8} {:>11} {:>11}\n",
+        "transport",
+        "msgs",
+        "msgs/s",
+        "p50 µs",
+        "p90 µs",
+        "p99 µs",
+        "max µs",
+        "cpu µs/msg",
+        "allocs/msg"
+    );
+    for report in reports {
+        out.push_str(&format!(
+            "{:<12} {:>8} {:>10.0} {:>8} {:>8} {:>8} {:>8} {:>11.1} {:>11.1}\n",
+            report.transport,
+            report.messages,
+            report.per_second(),
+            report.percentile_us(50.0),
+            report.percentile_us(90.0),
+            report.percentile_us(99.0),
+            report.percentile_us(100.0),
+            report.cpu_us_per_message(),
+            report.allocations_per_message(),
+        ));
+    }
+    out
+}
+
+/// The mix covers every message kind, the large result included.
+fn check_mix() {
+    let kinds: Vec<String> = (0..20)
+        .map(|index| {
+            let json = serde_json::to_value(mix_message(index)).unwrap();
+            json["type"].as_str().unwrap().to_string()
+        })
+        .collect();
+    for kind in [
+        "voiceCommand",
+        "heartbeat",
+        "statusUpdate",
+        "commandResponse",
+    ] {
+        assert!(kinds.iter().any(|k| k == kind), "missing {kind}");
+    }
+    let large = serde_json::to_string(&mix_message(19)).unwrap();
+    assert!(large.len() > LARGE_RESULT_BYTES);
+}
+
+/// Both transports deliver a short run of the mix.
+async fn check_transports() {
+    let rtm = run_rtm(60).await.unwrap();
+    let websocket = run_websocket(60).await.unwrap();
+    for report in [&rtm, &websocket] {
+        assert_eq!(report.messages, 60);
+        assert!(report.percentile_us(50.0) <= report.percentile_us(99.0));
+        assert!(report.allocations > 0);
+    }
+}
+
+fn main() {
+    const MESSAGES: usize = 20_000;
+    // `cargo bench` passes --bench; `cargo test --benches` does not.
+    let full = std::env::args().any(|arg| arg == "--bench");
+    let runtime = tokio::runtime::Builder::new_multi_thread()
+        .enable_all()
+        .build()
+        .expect("tokio runtime");
+    check_mix();
+    runtime.block_on(async {
+        check_transports().await;
+        if full {
+            // Runs both transports on the same mix and prints them side by side.
+            let rtm = run_rtm(MESSAGES).await.unwrap();
+            let websocket = run_websocket(MESSAGES).await.unwrap();
+            println!("{}", format_reports(&[rtm, websocket]));
+        }
+    });
+}
@@ -1,7 +1,32 @@
+// SDK-independent pieces of the shim, compiled into both the stub and the
+// real client.
+const SHARED_SOURCES: &[&str] = &[
+    "native/src/atem_rtm_buffer_pool.cpp",
+    "native/src/atem_rtm_cpu.cpp",
+    "native/src/atem_rtm_credit.cpp",
+    "native/src/atem_rtm_dispatcher.cpp",
+    "native/src/atem_rtm_events.cpp",
+    "native/src/atem_rtm_fair.cpp",
+    "native/src/atem_rtm_fleet.cpp",
+    "native/src/atem_rtm_history.cpp",
+    "native/src/atem_rtm_hold_queue.cpp",
+    "native/src/atem_rtm_inflight.cpp",
+    "native/src/atem_rtm_location.cpp",
+    "native/src/atem_rtm_lock_wait.cpp",
+    "native/src/atem_rtm_metadata.cpp",
+    "native/src/atem_rtm_outbound.cpp",
+    "native/src/atem_rtm_prefetch.cpp",
+    "native/src/atem_rtm_presence.cpp",
+    "native/src/atem_rtm_reorder.cpp",
+    "native/src/atem_rtm_series.cpp",
+    "native/src/atem_rtm_single_flight.cpp",
+    "native/src/atem_rtm_timers.cpp",
+];
+
 fn main() {
-    println!("cargo:rerun-if-changed=native/src/atem_rtm.cpp");
-    println!("cargo:rerun-if-changed=native/src/atem_rtm_real.cpp");
+    println!("cargo:rerun-if-changed=native/src");
     println!("cargo:rerun-if-changed=native/include/atem_rtm.h");
+    println!("cargo:rerun-if-changed=native/include/atem_rtm_stub.h");
 
     let use_real_rtm = std::env::var("CARGO_FEATURE_REAL_RTM").is_ok();
 
@@ -13,6 +38,7 @@ fn main() {
         .flag_if_supported("-Wall")
         .flag_if_supported("-Wextra")
         .flag_if_supported("-Wpedantic");
+    build.files(SHARED_SOURCES);
 
     if use_real_rtm {
         build
@@ -35,7 +61,9 @@ fn main() {
         );
         println!("cargo:rustc-link-arg=-Wl,-rpath,$ORIGIN/../native/third_party/agora/rtm_linux/rtm/sdk");
     } else {
-        build.file("native/src/atem_rtm.cpp");
+        build
+            .file("native/src/atem_rtm.cpp")
+            .file("native/src/atem_rtm_broker.cpp");
         build.compile("atem_rtm_stub");
     }
 }
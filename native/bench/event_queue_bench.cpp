@@ -0,0 +1,60 @@
+// Microbenchmark of the native event queue alone: one producer pushing
+// message events and polling them back in batches of 32, as
+// atem_rtm_poll_events does. Run it through scripts/bench-event-queue.sh.
+//
+// It times the ring only. The Rust side, the reorder buffer and the fair
+// scheduler still build a String per event, so end-to-end gains are much
+// smaller (see the ignored event_stream_throughput test). Cache misses
+// are not measured here; run the binary under `perf stat -e cache-misses`
+// where perf counters are available.
+//
+// Usage: event_queue_bench [payload bytes (300)] [record|message (message)]
+//   record   pushes a built EventRecord, the path every event took before
+//            push_message existed
+//   message  pushes straight from the inbound strings
+
+#include "atem_rtm_events.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+int main(int argc, char** argv) {
+    const size_t size = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 300;
+    const bool record = argc > 2 && std::strcmp(argv[2], "record") == 0;
+    const std::string channel = "atem-room-main";
+    const std::string user = "atem-host-12345";
+    const std::string payload(size, 'x');
+
+    atem_rtm::EventQueue queue(1024);
+    AtemRtmEvent out[64];
+    constexpr size_t kEvents = 2000000;
+    constexpr size_t kBatch = 32;
+    volatile size_t sink = 0;
+
+    const auto started = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kEvents; i += kBatch) {
+        for (size_t j = 0; j < kBatch; ++j) {
+            if (record) {
+                atem_rtm::EventRecord event;
+                event.kind = ATEM_RTM_EVENT_MESSAGE;
+                event.timestamp = i;
+                event.channel = channel;
+                event.with_user(user).with_payload(payload);
+                queue.push(event);
+            } else {
+                queue.push_message(i, ATEM_RTM_MESSAGE_LIVE, channel, user, payload);
+            }
+        }
+        const size_t polled = queue.poll(out, 64);
+        for (size_t k = 0; k < polled; ++k) sink = sink + out[k].payload_len;
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - started;
+
+    printf("%s payload=%zu spilled=%llu: %.1f ns/event\n", record ? "record" : "message", size,
+           (unsigned long long)queue.counters().spilled,
+           std::chrono::duration<double, std::nano>(elapsed).count() / kEvents);
+    return 0;
+}
@@ -1,25 +1,465 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 typedef struct AtemRtmClient AtemRtmClient;
+typedef struct AtemRtmFleet AtemRtmFleet;
+
+/* Return codes shared by the int-returning calls below. */
+#define ATEM_RTM_OK 0
+#define ATEM_RTM_ERROR (-1)
+/* atem_rtm_send_peer: the target is offline; the message is held until
+ * the peer's presence REMOTE_JOIN arrives or the hold TTL runs out. Held
+ * messages take no credit; once released they are paced and wait for
+ * credit like any other send. */
+#define ATEM_RTM_QUEUED 1
+/* Sends after atem_rtm_shutdown has started are rejected with this. */
+#define ATEM_RTM_ERR_CLOSED (-2)
+/* atem_rtm_buffer_acquire: every outbound buffer is in use. */
+#define ATEM_RTM_ERR_NO_BUFFER (-3)
+/* Sends: flow control already holds credit_hold_max messages and this one
+ * would have to wait too; nothing was sent (a buffer stays the caller's). */
+#define ATEM_RTM_ERR_BUSY (-4)
 
 typedef struct {
     const char* app_id;
     const char* token;
     const char* channel;
     const char* client_id;
+    /* Peer messages held per offline peer before the oldest is dropped (0 = 64). */
+    size_t peer_hold_capacity;
+    /* How long a held peer message stays deliverable (0 = 30000 ms). */
+    uint32_t peer_hold_ttl_ms;
+    /* Longest a message waits in the per-publisher reorder buffer for an
+     * earlier one to arrive (0 = 50 ms). */
+    uint32_t reorder_window_ms;
+    /* Idle mode: inbound messages are delivered in batches at most this
+     * often (0 = 250 ms) and presence changes are applied at this interval
+     * (0 = 5000 ms). */
+    uint32_t idle_batch_window_ms;
+    uint32_t idle_presence_interval_ms;
+    /* Metadata updates staged within this window are coalesced into one
+     * storage write per channel/user (0 = 200 ms). */
+    uint32_t metadata_window_ms;
+    /* Registered outbound buffers (0 = 32) and their size (0 = 4096 bytes). */
+    uint32_t outbound_buffer_count;
+    uint32_t outbound_buffer_size;
+    /* Undelivered records kept for atem_rtm_poll_events before the oldest
+     * is dropped (0 = 1024). */
+    uint32_t event_queue_capacity;
+    /* How long a remote atem_rtm_where_now answer is trusted (0 = 30000). */
+    uint32_t location_ttl_ms;
+    /* Identical concurrent reads always share one request; these keep a
+     * successful / failed result for reuse afterwards (0 = don't). */
+    uint32_t read_cache_ms;
+    uint32_t read_error_cache_ms;
+    /* Event thread (0 = off: callbacks are processed on the SDK's threads).
+     * When set, SDK callbacks only copy and queue their events; filtering,
+     * the event stream and user callbacks run on one shim thread, which
+     * also does the atem_rtm_tick work (atem_rtm_tick then returns at
+     * once). It has no fixed tick: it sleeps until the next event or the
+     * next deadline (reorder window, hold expiry, idle batch, metadata
+     * window, pacing, credit). Deadlines less than this many ms apart may
+     * share one wakeup (1 = exact). The name defaults to "atem-rtm-disp"; the
+     * mask pins it to CPUs (bit n = CPU n, 0 = any); priority 1-99 asks for
+     * SCHED_FIFO (0 = normal). Settings the OS refuses are logged and
+     * skipped. */
+    uint32_t dispatcher_tick_ms;
+    const char* dispatcher_name;
+    uint64_t dispatcher_cpu_mask;
+    uint32_t dispatcher_priority;
+    /* Messages fetched from channel history in parallel with the subscribe
+     * of atem_rtm_join_channel and atem_rtm_bring_up (0 = none, at most
+     * 100). Live messages on the channel wait up to 2 s for the history,
+     * which is delivered first as ATEM_RTM_MESSAGE_REPLAYED events, oldest
+     * first and without messages also received live. Replayed messages
+     * are not passed to the message callback. */
+    uint32_t join_history_count;
+    /* Schedules message events across publishers by deficit round-robin
+     * instead of arrival order: each publisher with messages waiting may
+     * hand out this many payload bytes per round (0 = arrival order; a few
+     * KB is typical). Each publisher keeps its own order, and one that
+     * exceeds fair_publisher_max_bytes of waiting messages
+     * (0 = 262144) loses its own oldest ones. Other event kinds are not
+     * scheduled and may overtake waiting messages. */
+    uint32_t fair_quantum_bytes;
+    uint32_t fair_publisher_max_bytes;
+    /* Paces publishes and peer sends to `outbound_rate_per_s` with bursts
+     * of up to `outbound_burst` (0 = no pacing / 0 = 10). Messages over the
+     * rate wait and leave in priority order (atem_rtm_set_priority); a
+     * waiting message gains one class per `outbound_aging_ms` (0 = 250),
+     * so bulk traffic is delayed but never starved. Drained by
+     * atem_rtm_tick (or the dispatcher) and by atem_rtm_shutdown. */
+    uint32_t outbound_rate_per_s;
+    uint32_t outbound_burst;
+    uint32_t outbound_aging_ms;
+    /* Flow control: each publisher we receive from may have
+     * `credit_window` messages that the application has not polled yet
+     * (0 = no limit). Credit is granted back to the publisher as events are
+     * polled, and repeated every `credit_refresh_ms` (0 = 1000) in case a
+     * grant is lost. Grants go out from atem_rtm_tick (or the dispatcher).
+     * Sending always honours the grants received: a publish or peer send
+     * beyond them is held, a held ".partial" message being replaced by the
+     * next one of its class, until more credit arrives. Messages the event
+     * queue drops unpolled count as polled. */
+    uint32_t credit_window;
+    uint32_t credit_refresh_ms;
+    /* Most messages held for credit at once (0 = 1024). A send that would
+     * be held beyond it fails with ATEM_RTM_ERR_BUSY; a paced one that
+     * meets the limit when its turn comes is dropped (credit_refused). */
+    uint32_t credit_hold_max;
 } AtemRtmConfig;
 
+/* An outbound buffer owned by the caller until it is submitted with
+ * atem_rtm_publish_buffer/atem_rtm_send_peer_buffer or released. */
+typedef struct {
+    uint32_t id;
+    char* data;
+    size_t capacity;
+} AtemRtmBuffer;
+
+typedef enum {
+    ATEM_RTM_METADATA_CHANNEL = 0,
+    ATEM_RTM_METADATA_USER = 1,
+} AtemRtmMetadataScope;
+
+typedef enum {
+    ATEM_RTM_HISTORY_SKIP = 0,
+    ATEM_RTM_HISTORY_STORE = 1,
+} AtemRtmHistoryPolicy;
+
+typedef enum {
+    ATEM_RTM_PRIORITY_CONTROL = 0,
+    ATEM_RTM_PRIORITY_NORMAL = 1,
+    ATEM_RTM_PRIORITY_BULK = 2,
+} AtemRtmPriority;
+
+typedef struct {
+    uint64_t peer_messages_held;
+    uint64_t peer_messages_flushed;
+    uint64_t peer_messages_expired;
+    uint64_t peer_messages_dropped;
+    uint64_t peer_hold_depth;
+    uint64_t reorder_depth;
+    uint64_t reorder_max_depth;
+    uint64_t reorder_held;
+    uint64_t reorder_hold_ms_total;
+    uint64_t reorder_hold_ms_max;
+    uint64_t reorder_gaps_skipped;
+    uint64_t reorder_duplicates;
+    uint64_t reorder_late;
+    uint64_t publishes_sent;
+    uint64_t publishes_acked;
+    uint64_t publishes_failed;
+    uint64_t publishes_in_flight;
+    uint64_t idle_mode;
+    uint64_t idle_batched_messages;
+    uint64_t metadata_staged;
+    uint64_t metadata_coalesced;
+    uint64_t metadata_writes;
+    uint64_t metadata_written;
+    uint64_t metadata_conflicts;
+    uint64_t metadata_retries;
+    uint64_t metadata_superseded;
+    uint64_t metadata_failed;
+    uint64_t metadata_pending;
+    uint64_t metadata_in_flight;
+    uint64_t lock_waits;
+    uint64_t lock_acquires;
+    uint64_t lock_acquired;
+    uint64_t lock_contended;
+    uint64_t lock_failed;
+    uint64_t lock_waiters;
+    uint64_t lock_handoff_ms_total;
+    uint64_t lock_handoff_ms_max;
+    uint64_t history_stored;
+    uint64_t history_skipped;
+    uint64_t buffers_in_use;
+    uint64_t buffer_publishes;
+    uint64_t buffers_exhausted;
+    uint64_t events_queued;
+    uint64_t events_dropped;
+    uint64_t location_hits;
+    uint64_t location_misses;
+    uint64_t location_queries;
+    uint64_t location_collapsed;
+    uint64_t location_entries;
+    uint64_t reads_requested;
+    uint64_t reads_issued;
+    uint64_t reads_collapsed;
+    uint64_t reads_cache_hits;
+    /* Thread CPU time spent in SDK callbacks, in microseconds: the total,
+     * the longest single callback and the number of callbacks, then the
+     * split by the event kind each callback reports. cpu_dispatch_us is
+     * the shim's own work in atem_rtm_tick or on the dispatcher thread,
+     * where callback time continued there is added to its event kind. */
+    uint64_t cpu_callbacks;
+    uint64_t cpu_callback_us;
+    uint64_t cpu_callback_max_us;
+    uint64_t cpu_message_us;
+    uint64_t cpu_presence_us;
+    uint64_t cpu_topic_us;
+    uint64_t cpu_lock_us;
+    uint64_t cpu_storage_us;
+    uint64_t cpu_link_state_us;
+    uint64_t cpu_result_us;
+    uint64_t cpu_token_us;
+    uint64_t cpu_dispatch_us;
+    /* Dispatcher thread: tasks run, most queued at once and the longest a
+     * task waited (all 0 without one). */
+    uint64_t dispatcher_tasks;
+    uint64_t dispatcher_max_depth;
+    uint64_t dispatcher_lag_ms_max;
+    /* Events too large for a queue slot's inline space (about 512 bytes of
+     * payload plus names), kept in a pooled buffer instead. */
+    uint64_t events_spilled;
+    /* Join-time history fetches, the messages they replayed, history
+     * messages dropped as duplicates of live ones, and fetches that failed
+     * or arrived after the hold. */
+    uint64_t prefetch_fetches;
+    uint64_t prefetch_replayed;
+    uint64_t prefetch_duplicates;
+    uint64_t prefetch_late;
+    /* Fair scheduling: messages dropped to keep a publisher within its
+     * share, and the most publishers with messages waiting at once. */
+    uint64_t fair_shed;
+    uint64_t fair_publishers_max;
+    /* Outbound pacing: messages waiting now, messages that had to wait,
+     * messages sent ahead of a more urgent class because of their age,
+     * and the longest wait per priority class. */
+    uint64_t outbound_queued;
+    uint64_t outbound_deferred;
+    uint64_t outbound_aged;
+    uint64_t outbound_wait_ms_max_control;
+    uint64_t outbound_wait_ms_max_normal;
+    uint64_t outbound_wait_ms_max_bulk;
+    /* Flow control: grants sent to publishers and received from
+     * receivers, messages that had to wait for credit (and wait now), and
+     * held partials replaced by a newer one. */
+    uint64_t credit_grants_sent;
+    uint64_t credit_grants_received;
+    uint64_t credit_held;
+    uint64_t credit_waiting;
+    uint64_t credit_coalesced;
+    /* Timer wheel: timers armed now and run so far (with a dispatcher, its
+     * ticks count too), and how often the dispatcher thread woke up; it
+     * sleeps until the next event or timer. */
+    uint64_t timers_pending;
+    uint64_t timers_fired;
+    uint64_t dispatcher_wakeups;
+    /* Flow control: sends refused or dropped because credit_hold_max
+     * messages were already held. */
+    uint64_t credit_refused;
+} AtemRtmStats;
+
+/* Seconds of traffic kept by atem_rtm_get_stats_series. */
+#define ATEM_RTM_STATS_SERIES_SECONDS 600
+
+/* One second of traffic. Inbound counts live messages queued for polling,
+ * outbound counts publishes and peer sends handed to the service. The
+ * latency is from the server timestamp to atem_rtm_poll_events, over the
+ * messages polled in that second (0 when none were). Errors are failed
+ * publishes plus events the queue dropped or shed. */
+typedef struct {
+    uint64_t unix_second;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint32_t messages_in;
+    uint32_t messages_out;
+    uint32_t latency_p99_ms;
+    uint32_t latency_samples;
+    uint32_t queue_depth_max;
+    uint32_t errors;
+} AtemRtmStatsSample;
+
+/* AtemRtmHealth::link_state; same values as the SDK's RTM_LINK_STATE. */
+#define ATEM_RTM_LINK_IDLE 0
+#define ATEM_RTM_LINK_CONNECTING 1
+#define ATEM_RTM_LINK_CONNECTED 2
+#define ATEM_RTM_LINK_DISCONNECTED 3
+#define ATEM_RTM_LINK_SUSPENDED 4
+#define ATEM_RTM_LINK_FAILED 5
+
+/* Age reported for something that has not happened yet. */
+#define ATEM_RTM_AGE_NEVER UINT64_MAX
+
+typedef struct {
+    int32_t link_state;
+    uint64_t last_inbound_age_ms;
+    uint64_t last_outbound_age_ms;
+    /* Inbound messages not yet delivered (reorder window, idle batch) and
+     * how long the queue has been non-empty. */
+    uint64_t inbound_queued;
+    uint64_t queue_lag_ms;
+    /* Publishes and storage writes awaiting their result. */
+    uint64_t requests_in_flight;
+    /* Since the last successful login or token renewal. */
+    uint64_t token_age_ms;
+} AtemRtmHealth;
+
+/* Event stream. Every SDK event kind is flattened into fixed-layout
+ * records (one per user, lock, topic or metadata item) and queued for
+ * atem_rtm_poll_events. */
+typedef enum {
+    ATEM_RTM_EVENT_MESSAGE = 1,
+    ATEM_RTM_EVENT_PRESENCE = 2,
+    ATEM_RTM_EVENT_TOPIC = 3,
+    ATEM_RTM_EVENT_LOCK = 4,
+    ATEM_RTM_EVENT_STORAGE = 5,
+    ATEM_RTM_EVENT_LINK_STATE = 6,
+    ATEM_RTM_EVENT_RESULT = 7,
+    ATEM_RTM_EVENT_TOKEN_WILL_EXPIRE = 8,
+} AtemRtmEventKind;
+
+/* AtemRtmEvent::subtype for ATEM_RTM_EVENT_MESSAGE: replayed messages
+ * come from the history fetched on join (AtemRtmConfig::join_history_count). */
+#define ATEM_RTM_MESSAGE_LIVE 0
+#define ATEM_RTM_MESSAGE_REPLAYED 1
+
+/* AtemRtmEvent::subtype for ATEM_RTM_EVENT_PRESENCE. */
+#define ATEM_RTM_PRESENCE_SNAPSHOT 1
+#define ATEM_RTM_PRESENCE_JOIN 2
+#define ATEM_RTM_PRESENCE_LEAVE 3
+
+/* AtemRtmEvent::subtype for ATEM_RTM_EVENT_RESULT. */
+typedef enum {
+    ATEM_RTM_OP_LOGIN = 1,
+    ATEM_RTM_OP_LOGOUT = 2,
+    ATEM_RTM_OP_SUBSCRIBE = 3,
+    ATEM_RTM_OP_PUBLISH = 4,
+    ATEM_RTM_OP_RENEW_TOKEN = 5,
+    ATEM_RTM_OP_ACQUIRE_LOCK = 6,
+    ATEM_RTM_OP_RELEASE_LOCK = 7,
+    ATEM_RTM_OP_SET_METADATA = 8,
+    ATEM_RTM_OP_GET_METADATA = 9,
+    ATEM_RTM_OP_WHERE_NOW = 10,
+    ATEM_RTM_OP_GET_STATE = 11,
+    ATEM_RTM_OP_WHO_NOW = 12,
+    ATEM_RTM_OP_GET_HISTORY = 13,
+} AtemRtmResultOp;
+
+/* One event. Strings may be NULL; they point into memory owned by the
+ * client and stay valid until the next atem_rtm_poll_events call.
+ *
+ * kind         subtype                      fields used
+ * MESSAGE      ATEM_RTM_MESSAGE_*           channel, user (publisher), payload, timestamp
+ * PRESENCE     ATEM_RTM_PRESENCE_*          channel, user; aux = snapshot size
+ * TOPIC        SDK RTM_TOPIC_EVENT_TYPE     channel, name (topic), user (publisher)
+ * LOCK         SDK RTM_LOCK_EVENT_TYPE      channel, name (lock), user (owner); aux = ttl
+ * STORAGE      SDK RTM_STORAGE_EVENT_TYPE   channel (target), name (key), payload (value),
+ *                                           user (author); aux = AtemRtmMetadataScope
+ * LINK_STATE   ATEM_RTM_LINK_*              code = SDK reason code
+ * RESULT       AtemRtmResultOp              request_id, code = SDK error code, channel, name
+ * TOKEN_WILL_EXPIRE 0                       channel */
+typedef struct {
+    uint32_t kind;
+    uint32_t subtype;
+    int32_t code;
+    uint32_t aux;
+    uint64_t request_id;
+    uint64_t timestamp;
+    const char* channel;
+    const char* user;
+    const char* name;
+    const char* payload;
+    size_t payload_len;
+} AtemRtmEvent;
+
+typedef void (*AtemRtmEventNotify)(void* user_data);
+
+typedef struct {
+    /* Outstanding publishes acknowledged before the deadline. */
+    uint32_t flushed;
+    /* Outstanding publishes acknowledged with an error. */
+    uint32_t failed;
+    /* Still unacknowledged at the deadline, or held for offline peers. */
+    uint32_t abandoned;
+    uint32_t elapsed_ms;
+} AtemRtmShutdownReport;
+
 typedef void (*AtemRtmMessageCallback)(
     const char* from_client_id,
     const char* payload,
     void* user_data);
 
+/* Completes an atem_rtm_acquire_lock wait: ATEM_RTM_OK once the lock is
+ * ours, ATEM_RTM_ERROR if the acquire failed, ATEM_RTM_ERR_CLOSED if the
+ * client shut down first. */
+typedef void (*AtemRtmLockCallback)(
+    const char* channel,
+    const char* lock_name,
+    int result,
+    void* user_data);
+
+/* Completes an atem_rtm_where_now lookup. `channels` is only valid during
+ * the call; `result` is ATEM_RTM_OK, ATEM_RTM_ERROR or ATEM_RTM_ERR_CLOSED. */
+typedef void (*AtemRtmWhereNowCallback)(
+    const char* user_id,
+    int result,
+    const char* const* channels,
+    size_t channel_count,
+    void* user_data);
+
+/* One item of a read result: a state or metadata key/value, a user id
+ * (value NULL) for atem_rtm_who_now, or publisher/message for
+ * atem_rtm_get_history. */
+typedef struct {
+    const char* key;
+    const char* value;
+    size_t value_len;
+    uint64_t timestamp;
+} AtemRtmItem;
+
+/* Completes a read. `result` is the SDK error code (0 on success) or
+ * ATEM_RTM_ERR_CLOSED; `items` is only valid during the call. */
+typedef void (*AtemRtmReadCallback)(
+    int result,
+    const AtemRtmItem* items,
+    size_t count,
+    void* user_data);
+
+/* Completes atem_rtm_bring_up: ATEM_RTM_OK once logged in and subscribed,
+ * otherwise the SDK error code of the step that failed. */
+typedef void (*AtemRtmReadyCallback)(
+    AtemRtmClient* client,
+    int result,
+    void* user_data);
+
+/* AtemRtmFleetConfig.jitter_ms value for evenly spaced starts. */
+#define ATEM_RTM_FLEET_NO_JITTER UINT32_MAX
+
+/* Bulk bring-up of many clients (see atem_rtm_fleet_create). */
+typedef struct {
+    /* Clients logging in at the same time (0 = 4). */
+    uint32_t max_parallel;
+    /* Gap between two starts, plus up to `jitter_ms` at random
+     * (0 = 100 / 0 = stagger_ms, ATEM_RTM_FLEET_NO_JITTER = none). */
+    uint32_t stagger_ms;
+    uint32_t jitter_ms;
+    /* A client not ready after this long counts as failed (0 = 15000).
+     * It keeps its parallel slot until its bring-up completes. */
+    uint32_t ready_timeout_ms;
+} AtemRtmFleetConfig;
+
+/* Time-to-ready is measured from a client's start to its subscribe
+ * result. */
+typedef struct {
+    uint32_t sessions;
+    uint32_t ready;
+    uint32_t failed;
+    uint32_t pending;
+    uint32_t ready_ms_p50;
+    uint32_t ready_ms_p90;
+    uint32_t ready_ms_p99;
+    uint32_t ready_ms_max;
+    uint32_t elapsed_ms;
+} AtemRtmFleetReport;
+
 AtemRtmClient* atem_rtm_create(
     const AtemRtmConfig* config,
     AtemRtmMessageCallback callback,
@@ -30,6 +470,14 @@ void atem_rtm_destroy(AtemRtmClient* client);
 int atem_rtm_connect(AtemRtmClient* client);
 int atem_rtm_disconnect(AtemRtmClient* client);
 
+/* Graceful exit: rejects new sends, waits up to `deadline_ms` for
+ * outstanding publishes to be acknowledged, then logs out. `report` may be
+ * NULL. Call atem_rtm_destroy afterwards. */
+int atem_rtm_shutdown(
+    AtemRtmClient* client,
+    uint32_t deadline_ms,
+    AtemRtmShutdownReport* report);
+
 int atem_rtm_login(
     AtemRtmClient* client,
     const char* token,
@@ -39,6 +487,8 @@ int atem_rtm_join_channel(
     AtemRtmClient* client,
     const char* channel_id);
 
+/* ATEM_RTM_ERROR when the SDK refuses the message outright; a buffer
+ * submitted that way stays the caller's. */
 int atem_rtm_publish_channel(
     AtemRtmClient* client,
     const char* payload);
@@ -48,6 +498,50 @@ int atem_rtm_send_peer(
     const char* target_client_id,
     const char* payload);
 
+/* Allocation-free publishing: take a registered buffer, write the payload
+ * into `data` (no terminator needed), then submit it by id and length. The
+ * SDK reads from the buffer directly and it returns to the pool when the
+ * publish result arrives. A buffer that will not be sent must be released,
+ * and so must one whose submit failed with a negative code. */
+int atem_rtm_buffer_acquire(
+    AtemRtmClient* client,
+    AtemRtmBuffer* out);
+
+int atem_rtm_buffer_release(
+    AtemRtmClient* client,
+    uint32_t buffer_id);
+
+int atem_rtm_publish_buffer(
+    AtemRtmClient* client,
+    uint32_t buffer_id,
+    size_t length);
+
+/* Like atem_rtm_send_peer, including ATEM_RTM_QUEUED for offline peers
+ * (the buffer is recycled right away in that case). */
+int atem_rtm_send_peer_buffer(
+    AtemRtmClient* client,
+    const char* target_client_id,
+    uint32_t buffer_id,
+    size_t length);
+
+/* Whether channel publishes of `message_class` are stored in RTM history.
+ * The class of a JSON payload is its top-level "type", suffixed with
+ * ".partial" when it has `"is_final": false` (a partial falls back to its
+ * base class if it has no policy of its own). NULL or "*" sets the default
+ * for everything else, which starts out as ATEM_RTM_HISTORY_SKIP. */
+int atem_rtm_set_history_policy(
+    AtemRtmClient* client,
+    const char* message_class,
+    AtemRtmHistoryPolicy policy);
+
+/* Priority class of outbound `message_class` (same classes and ".partial"
+ * fallback as atem_rtm_set_history_policy) when pacing is on. NULL or "*"
+ * sets the default, which starts out as ATEM_RTM_PRIORITY_NORMAL. */
+int atem_rtm_set_priority(
+    AtemRtmClient* client,
+    const char* message_class,
+    AtemRtmPriority priority);
+
 int atem_rtm_set_token(
     AtemRtmClient* client,
     const char* token);
@@ -57,6 +551,162 @@ int atem_rtm_subscribe_topic(
     const char* channel,
     const char* topic);
 
+/* Low-power mode for background Atems (e.g. terminal unfocused): batches
+ * inbound delivery and presence, pauses topic subscriptions outside the
+ * joined channels. Leaving idle delivers everything batched right away. */
+int atem_rtm_set_idle(AtemRtmClient* client, int idle);
+
+/* Stages a metadata key/value for the channel or user `target`. Updates
+ * are coalesced per target and written in one batch when the metadata
+ * window is up (on atem_rtm_tick), carrying the last revision seen so a
+ * concurrent remote change is detected and resolved last-writer-wins. */
+int atem_rtm_stage_metadata(
+    AtemRtmClient* client,
+    AtemRtmMetadataScope scope,
+    const char* target,
+    const char* key,
+    const char* value);
+
+/* Writes all staged metadata now, ignoring the coalescing window. */
+int atem_rtm_flush_metadata(AtemRtmClient* client);
+
+/* Waits for an RTM lock in `channel` (it must already exist, see
+ * IRtmLock::setLock) and calls `callback` once. Waiters queue locally: a
+ * lock held by another client is only re-acquired when its release or
+ * expiry LockEvent arrives, so waiting costs no requests. */
+int atem_rtm_acquire_lock(
+    AtemRtmClient* client,
+    const char* channel,
+    const char* lock_name,
+    AtemRtmLockCallback callback,
+    void* user_data);
+
+/* Releases a lock acquired above. With local waiters the lock is handed to
+ * the next one instead: it is not released to the service and no
+ * ATEM_RTM_OP_RELEASE_LOCK result follows. */
+int atem_rtm_release_lock(
+    AtemRtmClient* client,
+    const char* channel,
+    const char* lock_name);
+
+/* Which channels `user_id` is in. A fresh cached answer (kept current by
+ * presence events on subscribed channels) runs `callback` before this
+ * returns ATEM_RTM_OK. Otherwise one getUserChannels query is shared by
+ * every concurrent lookup for the user and ATEM_RTM_QUEUED is returned. */
+int atem_rtm_where_now(
+    AtemRtmClient* client,
+    const char* user_id,
+    AtemRtmWhereNowCallback callback,
+    void* user_data);
+
+/* Presence and storage reads. Identical reads in flight share one SDK
+ * request and every caller gets the result; with read_cache_ms set, a
+ * result is also reused until an event shows the data changed. Each
+ * returns ATEM_RTM_OK if `callback` already ran (cache hit) and
+ * ATEM_RTM_QUEUED otherwise. */
+int atem_rtm_get_state(
+    AtemRtmClient* client,
+    const char* channel,
+    const char* user_id,
+    AtemRtmReadCallback callback,
+    void* user_data);
+
+int atem_rtm_get_channel_metadata(
+    AtemRtmClient* client,
+    const char* channel,
+    AtemRtmReadCallback callback,
+    void* user_data);
+
+int atem_rtm_who_now(
+    AtemRtmClient* client,
+    const char* channel,
+    AtemRtmReadCallback callback,
+    void* user_data);
+
+/* The newest `count` (0 = 100) stored messages of `channel`. */
+int atem_rtm_get_history(
+    AtemRtmClient* client,
+    const char* channel,
+    uint32_t count,
+    AtemRtmReadCallback callback,
+    void* user_data);
+
+/* Moves up to `max` queued events into `out`, oldest first, and stores
+ * how many in `*count`. Messages are queued after reordering and idle
+ * batching, exactly when the message callback (if any) sees them. */
+int atem_rtm_poll_events(
+    AtemRtmClient* client,
+    AtemRtmEvent* out,
+    size_t max,
+    size_t* count);
+
+/* `notify` runs (on an SDK thread) whenever the event queue goes from
+ * empty to non-empty; a wake-up hint, not a delivery. */
+int atem_rtm_set_event_notify(
+    AtemRtmClient* client,
+    AtemRtmEventNotify notify,
+    void* user_data);
+
+/* Logs in and subscribes `channel` without a round trip through the
+ * caller: the subscribe goes out as soon as the login result arrives.
+ * `callback` runs exactly once, on an SDK thread, or with
+ * ATEM_RTM_ERR_CLOSED from atem_rtm_shutdown / atem_rtm_destroy. One
+ * bring-up per client at a time. */
+int atem_rtm_bring_up(
+    AtemRtmClient* client,
+    const char* token,
+    const char* channel,
+    AtemRtmReadyCallback callback,
+    void* user_data);
+
+/* Session manager for hosts running many clients. Clients added to a
+ * fleet are brought up (atem_rtm_bring_up) at most `max_parallel` at a
+ * time, with jittered gaps between starts so a restart does not hit RTM
+ * all at once. The fleet does not own the clients. */
+AtemRtmFleet* atem_rtm_fleet_create(const AtemRtmFleetConfig* config);
+
+int atem_rtm_fleet_add(
+    AtemRtmFleet* fleet,
+    AtemRtmClient* client,
+    const char* token,
+    const char* channel);
+
+/* Starts whatever is due and fills `report` (may be NULL). Returns
+ * ATEM_RTM_QUEUED while clients are pending and ATEM_RTM_OK once every
+ * client is ready or failed. Call it every few milliseconds. */
+int atem_rtm_fleet_tick(
+    AtemRtmFleet* fleet,
+    AtemRtmFleetReport* report);
+
+/* Bring-ups still in progress finish unobserved. */
+void atem_rtm_fleet_destroy(AtemRtmFleet* fleet);
+
+/* Drives time-based work (reorder window, hold queue expiry). Call it
+ * periodically, e.g. from the UI tick. Also flushes idle-mode batches and
+ * due metadata writes, and runs the shim's timers that are due. */
+int atem_rtm_tick(AtemRtmClient* client);
+
+int atem_rtm_get_stats(
+    AtemRtmClient* client,
+    AtemRtmStats* out);
+
+/* Copies the per-second samples of the last ATEM_RTM_STATS_SERIES_SECONDS
+ * completed seconds into `out`, oldest first, and sets `count`. With a
+ * smaller `max` the newest `max` are copied. Seconds without traffic are
+ * included as empty samples, so sample i covers unix_second of the first
+ * plus i. */
+int atem_rtm_get_stats_series(
+    AtemRtmClient* client,
+    AtemRtmStatsSample* out,
+    size_t max,
+    size_t* count);
+
+/* Health snapshot for supervisors. Reads atomics only and never blocks,
+ * so it is cheap enough to call every frame from any thread. */
+int atem_rtm_health(
+    AtemRtmClient* client,
+    AtemRtmHealth* out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,369 @@
+#pragma once
+
+// Header-only C++17 layer over atem_rtm.h for native consumers: owning
+// handles for clients and outbound buffers, string_view event accessors
+// and a handler table that picks the handler for each event kind at
+// compile time. Nothing here allocates or copies strings; event views
+// point into the client's queue and stay valid until its next poll().
+// Errors are the C API's int return codes.
+
+#include "atem_rtm.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace atem_rtm {
+
+// A NUL-terminated string argument, taken without a copy.
+class CStr {
+public:
+    CStr(const char* value) : value_(value) {}
+    CStr(const std::string& value) : value_(value.c_str()) {}
+
+    const char* c_str() const { return value_; }
+
+private:
+    const char* value_;
+};
+
+namespace detail {
+
+inline std::string_view view(const char* value) {
+    return value ? std::string_view(value) : std::string_view();
+}
+
+inline std::string_view view(const char* value, size_t length) {
+    return value ? std::string_view(value, length) : std::string_view();
+}
+
+} // namespace detail
+
+// Typed views of AtemRtmEvent, one per kind (see the table in atem_rtm.h).
+
+struct MessageEvent {
+    static constexpr uint32_t kKind = ATEM_RTM_EVENT_MESSAGE;
+    std::string_view channel;
+    std::string_view publisher;
+    std::string_view payload;
+    uint64_t timestamp;
+    bool replayed;
+
+    static MessageEvent from(const AtemRtmEvent& e) {
+        return {detail::view(e.channel), detail::view(e.user),
+                detail::view(e.payload, e.payload_len), e.timestamp,
+                e.subtype == ATEM_RTM_MESSAGE_REPLAYED};
+    }
+};
+
+struct PresenceEvent {
+    static constexpr uint32_t kKind = ATEM_RTM_EVENT_PRESENCE;
+    uint32_t change;  // ATEM_RTM_PRESENCE_*
+    std::string_view channel;
+    std::string_view user;  // empty for an empty snapshot
+    uint32_t snapshot_size;
+    uint64_t timestamp;
+
+    static PresenceEvent from(const AtemRtmEvent& e) {
+        return {e.subtype, detail::view(e.channel), detail::view(e.user), e.aux, e.timestamp};
+    }
+};
+
+struct TopicEvent {
+    static constexpr uint32_t kKind = ATEM_RTM_EVENT_TOPIC;
+    uint32_t type;  // SDK RTM_TOPIC_EVENT_TYPE
+    std::string_view channel;
+    std::string_view topic;
+    std::string_view publisher;
+    uint64_t timestamp;
+
+    static TopicEvent from(const AtemRtmEvent& e) {
+        return {e.subtype, detail::view(e.channel), detail::view(e.name), detail::view(e.user),
+                e.timestamp};
+    }
+};
+
+struct LockEvent {
+    static constexpr uint32_t kKind = ATEM_RTM_EVENT_LOCK;
+    uint32_t type;  // SDK RTM_LOCK_EVENT_TYPE
+    std::string_view channel;
+    std::string_view lock;
+    std::string_view owner;
+    uint32_t ttl_seconds;
+    uint64_t timestamp;
+
+    static LockEvent from(const AtemRtmEvent& e) {
+        return {e.subtype, detail::view(e.channel), detail::view(e.name), detail::view(e.user),
+                e.aux, e.timestamp};
+    }
+};
+
+struct StorageEvent {
+    static constexpr uint32_t kKind = ATEM_RTM_EVENT_STORAGE;
+    uint32_t type;  // SDK RTM_STORAGE_EVENT_TYPE
+    AtemRtmMetadataScope scope;
+    std::string_view target;
+    std::string_view key;
+    std::string_view value;
+    std::string_view author;
+    uint64_t timestamp;
+
+    static StorageEvent from(const AtemRtmEvent& e) {
+        return {e.subtype, static_cast<AtemRtmMetadataScope>(e.aux), detail::view(e.channel),
+                detail::view(e.name), detail::view(e.payload, e.payload_len),
+                detail::view(e.user), e.timestamp};
+    }
+};
+
+struct LinkStateEvent {
+    static constexpr uint32_t kKind = ATEM_RTM_EVENT_LINK_STATE;
+    uint32_t state;  // ATEM_RTM_LINK_*
+    int32_t reason;  // SDK reason code
+    uint64_t timestamp;
+
+    static LinkStateEvent from(const AtemRtmEvent& e) {
+        return {e.subtype, e.code, e.timestamp};
+    }
+};
+
+struct ResultEvent {
+    static constexpr uint32_t kKind = ATEM_RTM_EVENT_RESULT;
+    AtemRtmResultOp op;
+    uint64_t request_id;
+    int32_t code;  // SDK error code, 0 on success
+    std::string_view channel;
+    std::string_view name;
+    uint64_t timestamp;
+
+    static ResultEvent from(const AtemRtmEvent& e) {
+        return {static_cast<AtemRtmResultOp>(e.subtype), e.request_id, e.code,
+                detail::view(e.channel), detail::view(e.name), e.timestamp};
+    }
+};
+
+struct TokenWillExpireEvent {
+    static constexpr uint32_t kKind = ATEM_RTM_EVENT_TOKEN_WILL_EXPIRE;
+    std::string_view channel;
+    uint64_t timestamp;
+
+    static TokenWillExpireEvent from(const AtemRtmEvent& e) {
+        return {detail::view(e.channel), e.timestamp};
+    }
+};
+
+// A set of callables, one per event kind of interest, e.g.
+//
+//     auto handlers = atem_rtm::make_handlers(
+//         [&](const atem_rtm::MessageEvent& m) { ... },
+//         [&](const atem_rtm::ResultEvent& r) { ... });
+//     client.poll(handlers);
+//
+// Which kinds are handled is decided by overload resolution when the table
+// is instantiated: there is no virtual call, and kinds without a handler
+// compile to nothing. A callable taking `const AtemRtmEvent&` receives the
+// events no typed handler matched.
+template <typename... Fs>
+class Handlers {
+public:
+    explicit Handlers(Fs... fs) : set_{std::move(fs)...} {}
+
+    void operator()(const AtemRtmEvent& e) {
+        switch (e.kind) {
+        case MessageEvent::kKind: return call<MessageEvent>(e);
+        case PresenceEvent::kKind: return call<PresenceEvent>(e);
+        case TopicEvent::kKind: return call<TopicEvent>(e);
+        case LockEvent::kKind: return call<LockEvent>(e);
+        case StorageEvent::kKind: return call<StorageEvent>(e);
+        case LinkStateEvent::kKind: return call<LinkStateEvent>(e);
+        case ResultEvent::kKind: return call<ResultEvent>(e);
+        case TokenWillExpireEvent::kKind: return call<TokenWillExpireEvent>(e);
+        default: return call<AtemRtmEvent>(e);
+        }
+    }
+
+private:
+    struct Set : Fs... {
+        using Fs::operator()...;
+    };
+
+    template <typename View>
+    void call(const AtemRtmEvent& e) {
+        if constexpr (std::is_same_v<View, AtemRtmEvent>) {
+            if constexpr (std::is_invocable_v<Set&, const AtemRtmEvent&>) set_(e);
+        } else if constexpr (std::is_invocable_v<Set&, const View&>) {
+            set_(View::from(e));
+        } else {
+            call<AtemRtmEvent>(e);
+        }
+    }
+
+    Set set_;
+};
+
+template <typename... Fs>
+Handlers<std::decay_t<Fs>...> make_handlers(Fs&&... fs) {
+    return Handlers<std::decay_t<Fs>...>(std::forward<Fs>(fs)...);
+}
+
+// An outbound buffer from atem_rtm_buffer_acquire, released on
+// destruction unless it was submitted.
+class Buffer {
+public:
+    Buffer() = default;
+    Buffer(Buffer&& other) noexcept
+        : client_(std::exchange(other.client_, nullptr)), buffer_(other.buffer_) {}
+    Buffer& operator=(Buffer&& other) noexcept {
+        if (this != &other) {
+            reset();
+            client_ = std::exchange(other.client_, nullptr);
+            buffer_ = other.buffer_;
+        }
+        return *this;
+    }
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+    ~Buffer() { reset(); }
+
+    explicit operator bool() const { return client_ != nullptr; }
+    char* data() const { return client_ ? buffer_.data : nullptr; }
+    size_t capacity() const { return client_ ? buffer_.capacity : 0; }
+
+    // Submits the first `length` bytes; the buffer is given up either way.
+    // A refused submit leaves it with the caller, so it is released here.
+    int publish(size_t length) {
+        if (!client_) return ATEM_RTM_ERROR;
+        AtemRtmClient* client = std::exchange(client_, nullptr);
+        return settle(client, atem_rtm_publish_buffer(client, buffer_.id, length));
+    }
+    int send_peer(CStr target, size_t length) {
+        if (!client_) return ATEM_RTM_ERROR;
+        AtemRtmClient* client = std::exchange(client_, nullptr);
+        return settle(client,
+                      atem_rtm_send_peer_buffer(client, target.c_str(), buffer_.id, length));
+    }
+
+    void reset() {
+        if (client_) atem_rtm_buffer_release(std::exchange(client_, nullptr), buffer_.id);
+    }
+
+private:
+    friend class Client;
+    Buffer(AtemRtmClient* client, const AtemRtmBuffer& buffer)
+        : client_(client), buffer_(buffer) {}
+
+    // ATEM_RTM_QUEUED is not a refusal: the hold queue took a copy and
+    // already recycled the buffer.
+    int settle(AtemRtmClient* client, int rc) {
+        if (rc < 0) atem_rtm_buffer_release(client, buffer_.id);
+        return rc;
+    }
+
+    AtemRtmClient* client_{nullptr};
+    AtemRtmBuffer buffer_{};
+};
+
+// Owns an AtemRtmClient; destroyed with it. Events are consumed with
+// poll() rather than the legacy message callback. Move-only.
+class Client {
+public:
+    Client() = default;
+    explicit Client(const AtemRtmConfig& config)
+        : client_(atem_rtm_create(&config, nullptr, nullptr)) {}
+    Client(Client&& other) noexcept : client_(std::exchange(other.client_, nullptr)) {}
+    Client& operator=(Client&& other) noexcept {
+        if (this != &other) {
+            reset();
+            client_ = std::exchange(other.client_, nullptr);
+        }
+        return *this;
+    }
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+    ~Client() { reset(); }
+
+    // False if creation failed.
+    explicit operator bool() const { return client_ != nullptr; }
+    AtemRtmClient* native() const { return client_; }
+
+    void reset() {
+        if (client_) atem_rtm_destroy(std::exchange(client_, nullptr));
+    }
+
+    int connect() { return atem_rtm_connect(client_); }
+    int disconnect() { return atem_rtm_disconnect(client_); }
+    int shutdown(uint32_t deadline_ms, AtemRtmShutdownReport* report = nullptr) {
+        return atem_rtm_shutdown(client_, deadline_ms, report);
+    }
+    int login(CStr token, CStr user_id) {
+        return atem_rtm_login(client_, token.c_str(), user_id.c_str());
+    }
+    int join_channel(CStr channel) { return atem_rtm_join_channel(client_, channel.c_str()); }
+    int set_token(CStr token) { return atem_rtm_set_token(client_, token.c_str()); }
+    int subscribe_topic(CStr channel, CStr topic) {
+        return atem_rtm_subscribe_topic(client_, channel.c_str(), topic.c_str());
+    }
+    int set_idle(bool idle) { return atem_rtm_set_idle(client_, idle ? 1 : 0); }
+    int set_history_policy(const char* message_class, AtemRtmHistoryPolicy policy) {
+        return atem_rtm_set_history_policy(client_, message_class, policy);
+    }
+    int set_priority(const char* message_class, AtemRtmPriority priority) {
+        return atem_rtm_set_priority(client_, message_class, priority);
+    }
+
+    int publish(CStr payload) { return atem_rtm_publish_channel(client_, payload.c_str()); }
+    // ATEM_RTM_QUEUED when the peer is offline and the message is held.
+    int send_peer(CStr target, CStr payload) {
+        return atem_rtm_send_peer(client_, target.c_str(), payload.c_str());
+    }
+    // Empty when every buffer is in use (or the client is closed).
+    Buffer acquire_buffer() {
+        AtemRtmBuffer buffer{};
+        if (atem_rtm_buffer_acquire(client_, &buffer) != ATEM_RTM_OK) return Buffer();
+        return Buffer(client_, buffer);
+    }
+
+    int stage_metadata(AtemRtmMetadataScope scope, CStr target, CStr key, CStr value) {
+        return atem_rtm_stage_metadata(client_, scope, target.c_str(), key.c_str(),
+                                       value.c_str());
+    }
+    int flush_metadata() { return atem_rtm_flush_metadata(client_); }
+    int release_lock(CStr channel, CStr lock_name) {
+        return atem_rtm_release_lock(client_, channel.c_str(), lock_name.c_str());
+    }
+
+    int set_event_notify(AtemRtmEventNotify notify, void* user_data) {
+        return atem_rtm_set_event_notify(client_, notify, user_data);
+    }
+
+    // Hands every queued event to `handlers`, `Batch` at a time; returns
+    // how many were handled, or -1. The views passed to a handler are only
+    // valid during the call.
+    template <size_t Batch = 64, typename H>
+    long poll(H& handlers) {
+        AtemRtmEvent events[Batch];
+        long handled = 0;
+        for (;;) {
+            size_t count = 0;
+            if (atem_rtm_poll_events(client_, events, Batch, &count) != ATEM_RTM_OK) return -1;
+            for (size_t i = 0; i < count; ++i) handlers(events[i]);
+            handled += static_cast<long>(count);
+            if (count < Batch) return handled;
+        }
+    }
+
+    int tick() { return atem_rtm_tick(client_); }
+    int stats(AtemRtmStats& out) { return atem_rtm_get_stats(client_, &out); }
+    // Oldest first; `count` is set to the samples copied.
+    int stats_series(AtemRtmStatsSample* out, size_t max, size_t& count) {
+        return atem_rtm_get_stats_series(client_, out, max, &count);
+    }
+    int health(AtemRtmHealth& out) { return atem_rtm_health(client_, &out); }
+
+private:
+    AtemRtmClient* client_{nullptr};
+};
+
+} // namespace atem_rtm
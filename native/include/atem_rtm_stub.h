@@ -0,0 +1,59 @@
+#pragma once
+
+/* Control surface of the in-process broker behind the stub client (the
+ * default build without the `real_rtm` feature). Stub clients created with
+ * the same app_id share one emulated project: messages, presence, locks,
+ * metadata and history behave as on the RTM service. None of this exists
+ * in the real client. */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Delay of every broker round trip and fan-out delivery, drawn per
+ * delivery from [min_ms, max_ms] (0/0 = immediate). Due deliveries run on
+ * the client's next call into the shim, atem_rtm_tick at the latest; the
+ * event notify hook fires when something is queued. */
+int atem_rtm_stub_set_latency(
+    const char* app_id,
+    uint32_t min_ms,
+    uint32_t max_ms);
+
+/* Moves the project's clock forward: delayed deliveries, lock TTLs,
+ * presence intervals and history timestamps all see the new time. */
+int atem_rtm_stub_advance_clock(
+    const char* app_id,
+    uint32_t ms);
+
+/* Channels with more than `announce_max` members report joins and leaves
+ * in batches every `interval_ms` instead of one by one
+ * (0 = 50 / 0 = 5000, the service defaults). */
+int atem_rtm_stub_set_presence_interval(
+    const char* app_id,
+    uint32_t announce_max,
+    uint32_t interval_ms);
+
+/* Takes a lock away from its owner, as revokeLock from another app would.
+ * Returns ATEM_RTM_ERROR if the lock is not held. */
+int atem_rtm_stub_revoke_lock(
+    const char* app_id,
+    const char* channel,
+    const char* lock_name);
+
+/* Delivers a channel message to every subscriber as if `publisher` had
+ * sent it with PublishOptions::customType `custom_type` (NULL = none) and
+ * the service had stamped it `timestamp` (0 = now). Lets tests replay
+ * traffic out of order, duplicated or from an earlier sender epoch. */
+int atem_rtm_stub_inject_message(
+    const char* app_id,
+    const char* channel,
+    const char* publisher,
+    const char* payload,
+    const char* custom_type,
+    uint64_t timestamp);
+
+#ifdef __cplusplus
+}
+#endif
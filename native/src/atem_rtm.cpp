@@ -1,21 +1,129 @@
 #include "atem_rtm.h"
+#include "atem_rtm_broker.h"
+#include "atem_rtm_buffer_pool.h"
+#include "atem_rtm_clock.h"
+#include "atem_rtm_cpu.h"
+#include "atem_rtm_credit.h"
+#include "atem_rtm_events.h"
+#include "atem_rtm_history.h"
+#include "atem_rtm_hold_queue.h"
+#include "atem_rtm_location.h"
+#include "atem_rtm_lock_wait.h"
+#include "atem_rtm_metadata.h"
+#include "atem_rtm_outbound.h"
+#include "atem_rtm_prefetch.h"
+#include "atem_rtm_presence.h"
+#include "atem_rtm_reorder.h"
+#include "atem_rtm_series.h"
+#include "atem_rtm_single_flight.h"
+#include "atem_rtm_timers.h"
 
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <chrono>
+#include <memory>
 #include <mutex>
+#include <random>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
-struct AtemRtmClient {
+struct AtemRtmClient : public atem_rtm::StubMember {
     AtemRtmConfig config{};
     AtemRtmMessageCallback callback{nullptr};
     void* user_data{nullptr};
     bool connected{false};
     bool logged_in{false};
     bool channel_joined{false};
+    bool idle{false};
+    bool closing{false};
+    // Health probe timestamps (0 = never).
+    uint64_t last_inbound_ms{0};
+    uint64_t last_outbound_ms{0};
+    uint64_t token_renewed_ms{0};
+    std::string client_id;
     std::string user_id;
     std::string channel_id;
     std::string token;
+    // The emulated service, shared with every stub client of this app id.
+    // Its results and events are run by drain() on our own thread.
+    std::shared_ptr<atem_rtm::StubBroker> broker;
+    atem_rtm::StubBroker::Id member{0};
+    // Timers on the broker's virtual clock, run by atem_rtm_tick.
+    atem_rtm::TimerWheel timers{0};
+    // Staged metadata; batches are written to the broker on tick.
+    atem_rtm::MetadataWriteBehind metadata{atem_rtm::kDefaultMetadataWindowMs};
+    uint64_t next_request_id{1};
+    // Outbound buffers; "publishing" echoes and recycles them at once.
+    atem_rtm::BufferPool buffers{atem_rtm::kDefaultOutboundBufferCount,
+                                 atem_rtm::kDefaultOutboundBufferSize};
+    // Applied to channel publishes; stored messages go to broker history.
+    atem_rtm::HistoryPolicy history;
+    // Paced sending, as in the real client; drained on tick.
+    atem_rtm::OutboundScheduler outbound{0, 0, 0};
+    // Sender stamps and flow control, as in the real client: credit
+    // granted to publishers as their messages are polled, and the sends
+    // held for the credit granted to us.
+    uint32_t stamp_epoch{0};
+    std::unordered_map<std::string, uint64_t> next_seq;
+    atem_rtm::CreditGranter granter{0, 0};
+    atem_rtm::CreditGate credit_gate{0, 0};
+    // Lock wait lists, arbitrated by the broker as by the service.
+    struct LockWaiter {
+        AtemRtmLockCallback callback;
+        void* user_data;
+    };
+    atem_rtm::LockWaitList locks;
+    std::unordered_map<uint64_t, LockWaiter> lock_waiters;
+    // Re-check timer per lock (channel '\x1f' name).
+    std::unordered_map<std::string, atem_rtm::TimerId> lock_rechecks;
+    // whereNow cache and the lookups waiting on a broker query.
+    struct LocationWaiter {
+        AtemRtmWhereNowCallback callback;
+        void* user_data;
+    };
+    atem_rtm::LocationCache location{atem_rtm::kDefaultLocationTtlMs};
+    std::unordered_map<uint64_t, LocationWaiter> location_waiters;
+    // Who the broker reports online, and the peer messages parked for the
+    // users it reports offline, as in the real client.
+    atem_rtm::PresenceCache presence;
+    atem_rtm::PeerHoldQueue hold_queue{atem_rtm::kDefaultPeerHoldCapacity,
+                                       atem_rtm::kDefaultPeerHoldTtlMs};
+    // Collapsed reads and their callbacks, as in the real client.
+    struct ReadWaiter {
+        AtemRtmReadCallback callback;
+        void* user_data;
+        std::string prefetch_channel;  // set for the join-time history fetch
+    };
+    atem_rtm::SingleFlight reads{0, 0};
+    std::unordered_map<uint64_t, ReadWaiter> read_waiters;
+    // Join-time history merged with the channel's first live messages.
+    atem_rtm::HistoryPrefetch prefetch;
+    // Per-publisher ordering of live traffic, as in the real client; held
+    // messages are released on tick.
+    atem_rtm::ReorderBuffer reorder{atem_rtm::kDefaultReorderWindowMs};
+    // Event stream; the stub reports its echoes and synthetic results here.
+    atem_rtm::EventQueue events{atem_rtm::kDefaultEventQueueCapacity};
+    AtemRtmEventNotify event_notify{nullptr};
+    void* event_notify_data{nullptr};
+    // Per-second traffic, and the queue drops it has counted as errors.
+    atem_rtm::StatsSeries series;
+    uint64_t series_dropped{0};
+    // Thread CPU time of the broker's event deliveries, the stub's stand-in
+    // for SDK callbacks.
+    atem_rtm::CpuMeter cpu;
+
+    void wake() override;
+    void on_message(const std::string& channel, const std::string& publisher,
+                    const std::string& payload, const std::string& custom_type,
+                    uint64_t timestamp) override;
+    void on_presence(const atem_rtm::PresenceDelta& delta, uint64_t timestamp) override;
+    void on_lock_event(uint32_t type, const std::string& channel, const std::string& lock,
+                       const std::string& owner, uint32_t ttl, uint64_t timestamp) override;
 };
 
 namespace {
@@ -24,8 +132,630 @@ inline std::string copy_or_empty(const char* value) {
     return value ? std::string(value) : std::string();
 }
 
+std::string read_prefix(const char* op, const std::string& channel) {
+    return atem_rtm::SingleFlight::key(op, channel) + '\x1f';
+}
+
+void notify_if(AtemRtmClient* client, bool woke) {
+    if (woke && client->event_notify) client->event_notify(client->event_notify_data);
+}
+
+void sample_queue(AtemRtmClient* client, uint64_t now) {
+    const uint64_t dropped =
+        client->events.counters().dropped + client->events.fair().counters().shed;
+    client->series.errors(dropped - client->series_dropped, now);
+    client->series_dropped = dropped;
+    client->series.depth(client->events.depth(), now);
+}
+
+void emit(AtemRtmClient* client, atem_rtm::EventRecord record) {
+    if (record.timestamp == 0) record.timestamp = client->broker->wall_ms();
+    const bool woke = client->events.push(record);
+    sample_queue(client, client->broker->now_ms());
+    notify_if(client, woke);
+}
+
+void emit_message(AtemRtmClient* client, uint64_t timestamp, std::string_view channel,
+                  std::string_view publisher, std::string_view payload,
+                  uint32_t subtype = ATEM_RTM_MESSAGE_LIVE) {
+    const bool woke = client->events.push_message(timestamp ? timestamp : client->broker->wall_ms(),
+                                                  subtype, channel, publisher, payload);
+    const uint64_t now = client->broker->now_ms();
+    if (subtype == ATEM_RTM_MESSAGE_LIVE) client->series.inbound(payload.size(), now);
+    sample_queue(client, now);
+    notify_if(client, woke);
+}
+
+// Messages released by the history prefetch.
+void deliver(AtemRtmClient* client, const std::vector<atem_rtm::InboundMessage>& ready) {
+    for (const auto& msg : ready) {
+        if (!msg.replayed) {
+            client->granter.delivered(msg.publisher, msg.channel, client->user_id, msg.stamp,
+                                      client->broker->now_ms());
+        }
+        emit_message(client, msg.server_ts, msg.channel, msg.publisher, msg.payload,
+                     msg.replayed ? ATEM_RTM_MESSAGE_REPLAYED : ATEM_RTM_MESSAGE_LIVE);
+        // The legacy callback only ever sees live traffic.
+        if (client->callback && !msg.replayed) {
+            client->callback(msg.publisher.c_str(), msg.payload.c_str(), client->user_data);
+        }
+    }
+}
+
+// Live traffic out of the reorder buffer; the join-time history merge may
+// still hold some of it.
+void deliver_live(AtemRtmClient* client, std::vector<atem_rtm::InboundMessage>& ready) {
+    if (!client->prefetch.idle()) {
+        ready.erase(std::remove_if(ready.begin(), ready.end(),
+                                   [client](atem_rtm::InboundMessage& msg) {
+                                       return client->prefetch.hold(msg);
+                                   }),
+                    ready.end());
+    }
+    deliver(client, ready);
+}
+
+void emit_result(AtemRtmClient* client, uint32_t op, const std::string& channel,
+                 int32_t code = 0, uint64_t request_id = 0, const std::string& name = {}) {
+    atem_rtm::EventRecord record;
+    record.kind = ATEM_RTM_EVENT_RESULT;
+    record.subtype = op;
+    record.code = code;
+    record.request_id = request_id ? request_id : client->next_request_id++;
+    record.channel = channel;
+    if (!name.empty()) record.with_name(name);
+    emit(client, std::move(record));
+}
+
+// Runs whatever the broker has delivered to us by now.
+void drain(AtemRtmClient* client) {
+    client->broker->drain(client->member);
+}
+
+// Stub: the echo of an outbound message, as callback and event.
+void echo(AtemRtmClient* client, const std::string& channel, const char* from,
+          const char* payload) {
+    client->last_inbound_ms = client->last_outbound_ms;
+    emit_message(client, 0, channel, from, payload);
+    if (client->callback) {
+        client->callback(from, payload, client->user_data);
+    }
+    emit_result(client, ATEM_RTM_OP_PUBLISH, channel);
+}
+
+void refresh_metadata(AtemRtmClient* client,
+                      const std::vector<atem_rtm::MetadataWriteBehind::Refresh>& refresh) {
+    for (const auto& target : refresh) {
+        const auto scope = target.scope;
+        const std::string name = target.target;
+        client->broker->get_metadata(
+            client->member, scope, name,
+            [client, scope, name](int32_t code, std::vector<atem_rtm::StubItem> items) {
+                emit_result(client, ATEM_RTM_OP_GET_METADATA, name, code);
+                for (const auto& item : items) {
+                    client->metadata.observe(scope, name, item.key, item.revision,
+                                             item.timestamp);
+                }
+                client->metadata.refreshed(scope, name, code == 0, client->broker->now_ms());
+            });
+    }
+}
+
+std::string next_stamp(AtemRtmClient* client, const std::string& destination) {
+    char stamp[atem_rtm::kSenderStampMax];
+    atem_rtm::format_sender_stamp(stamp, client->stamp_epoch, client->next_seq[destination]++);
+    return stamp;
+}
+
+// A publish through the broker, echoed as the SDK round trip would be.
+void send_channel(AtemRtmClient* client, const char* payload) {
+    const bool store =
+        client->history.should_store(atem_rtm::message_class(payload, strlen(payload)));
+    if (store) {
+        client->reads.invalidate_prefix(read_prefix("hist", client->channel_id));
+    }
+    client->last_outbound_ms = client->broker->now_ms();
+    client->series.outbound(strlen(payload), client->last_outbound_ms);
+    client->broker->publish(client->member, client->channel_id, payload,
+                            next_stamp(client, client->channel_id), store);
+    echo(client, client->channel_id,
+         client->client_id.empty() ? "self" : client->client_id.c_str(), payload);
+}
+
+void send_peer_to(AtemRtmClient* client, const char* target_client_id, const char* payload) {
+    client->last_outbound_ms = client->broker->now_ms();
+    client->series.outbound(strlen(payload), client->last_outbound_ms);
+    if (client->broker->send_peer(client->member, target_client_id, payload,
+                                  next_stamp(client, target_client_id))) {
+        emit_result(client, ATEM_RTM_OP_PUBLISH, target_client_id);
+    } else {
+        // Nobody is logged in as the target: echo back, as the stub always has.
+        echo(client, target_client_id, target_client_id, payload);
+    }
+}
+
+// Publishing to an offline user would fail; parks the message until
+// presence reports the peer back and returns ATEM_RTM_QUEUED. Otherwise
+// sends it and returns 0.
+int send_peer_now(AtemRtmClient* client, const char* target_client_id, const char* payload) {
+    if (client->presence.lookup(target_client_id) == atem_rtm::PeerPresence::Offline) {
+        client->hold_queue.hold(target_client_id, payload, client->broker->now_ms());
+        return ATEM_RTM_QUEUED;
+    }
+    send_peer_to(client, target_client_id, payload);
+    return 0;
+}
+
+// True when the message went out, false when it was held for an offline
+// peer.
+bool send_out(AtemRtmClient* client, const atem_rtm::OutboundMessage& msg) {
+    if (msg.target.empty()) {
+        send_channel(client, msg.payload.c_str());
+        return true;
+    }
+    return send_peer_now(client, msg.target.c_str(), msg.payload.c_str()) == 0;
+}
+
+const std::string& destination_of(AtemRtmClient* client, const atem_rtm::OutboundMessage& msg) {
+    return msg.target.empty() ? client->channel_id : msg.target;
+}
+
+// Sends what the pacer lets out now, or everything when `all`. What the
+// credit does not cover yet is held. Returns how many went out.
+size_t flush_outbound(AtemRtmClient* client, bool all) {
+    if (client->outbound.depth() == 0) {
+        return 0;
+    }
+    std::vector<atem_rtm::OutboundMessage> due;
+    if (all) {
+        client->outbound.take_all(client->broker->now_ms(), due);
+    } else {
+        client->outbound.take_due(client->broker->now_ms(), due);
+    }
+    size_t sent = 0;
+    for (auto& msg : due) {
+        const std::string destination = destination_of(client, msg);
+        if (client->credit_gate.allows(destination, client->next_seq[destination],
+                                       client->broker->now_ms())) {
+            if (send_out(client, msg)) ++sent;
+        } else {
+            // Dropped when flow control is full (counted as refused).
+            const std::string message_class =
+                atem_rtm::message_class(msg.payload.data(), msg.payload.size());
+            client->credit_gate.hold(destination, std::move(msg), message_class);
+        }
+    }
+    return sent;
+}
+
+// Sends the held messages new credit covers, or all of them when `all`.
+// Returns how many went out.
+size_t flush_credit(AtemRtmClient* client, bool all) {
+    if (client->credit_gate.depth() == 0) {
+        return 0;
+    }
+    std::vector<atem_rtm::OutboundMessage> ready;
+    if (all) {
+        client->credit_gate.take_all(ready);
+    } else {
+        for (const auto& destination : client->credit_gate.waiting()) {
+            client->credit_gate.take_ready(destination, client->next_seq[destination],
+                                           client->broker->now_ms(), ready);
+        }
+    }
+    size_t sent = 0;
+    for (const auto& msg : ready) {
+        if (send_out(client, msg)) ++sent;
+    }
+    return sent;
+}
+
+// Live messages the event queue dropped or shed will never be polled;
+// they free their publishers' credit all the same.
+void release_discarded(AtemRtmClient* client) {
+    std::vector<atem_rtm::DiscardedMessage> discarded;
+    client->events.take_discarded(discarded);
+    for (const auto& msg : discarded) {
+        client->granter.consumed(msg.publisher, msg.channel);
+    }
+}
+
+// Grants the credit polled messages have freed, and repeats standing
+// grants, as peer messages outside the stamps, pacing and credit.
+void send_grants(AtemRtmClient* client) {
+    if (!client->granter.enabled() || !client->logged_in) {
+        return;
+    }
+    release_discarded(client);
+    std::vector<atem_rtm::CreditGranter::Grant> grants;
+    client->granter.take_grants(client->broker->now_ms(), grants);
+    for (const auto& grant : grants) {
+        char custom_type[atem_rtm::kSenderStampMax];
+        atem_rtm::format_credit_grant(custom_type, grant.epoch, grant.limit);
+        client->broker->send_peer(client->member, grant.publisher, grant.destination,
+                                  custom_type);
+    }
+}
+
+// With pacing on, queues the message and sends whatever is due, this one
+// included if it may go now. Without pacing, holds it if the credit does
+// not cover it. Returns 0 when it may be sent now, 1 when it was queued,
+// and ATEM_RTM_ERR_BUSY when flow control is full and it would have to
+// wait.
+int pace(AtemRtmClient* client, const char* target_client_id, const char* payload) {
+    const std::string destination = target_client_id ? target_client_id : client->channel_id;
+    const uint64_t now = client->broker->now_ms();
+    if (!client->outbound.paced()) {
+        if (client->credit_gate.allows(destination, client->next_seq[destination], now)) {
+            return 0;
+        }
+        atem_rtm::OutboundMessage msg;
+        if (target_client_id) msg.target = target_client_id;
+        msg.payload = payload;
+        if (!client->credit_gate.hold(destination, std::move(msg),
+                                      atem_rtm::message_class(payload, strlen(payload)))) {
+            return ATEM_RTM_ERR_BUSY;
+        }
+        return 1;
+    }
+    if (client->credit_gate.refuses(destination, client->next_seq[destination], now)) {
+        client->credit_gate.count_refused();
+        return ATEM_RTM_ERR_BUSY;
+    }
+    atem_rtm::OutboundMessage msg;
+    if (target_client_id) msg.target = target_client_id;
+    msg.payload = payload;
+    msg.priority = client->outbound.priority_of(atem_rtm::message_class(payload, strlen(payload)));
+    client->outbound.push(std::move(msg), now);
+    flush_outbound(client, false);
+    return 1;
+}
+
+// Sends whatever was held for peers that just came online, through the
+// pacer like any other send. Nothing more goes out once shutdown began.
+void flush_held(AtemRtmClient* client, const std::vector<std::string>& peers) {
+    for (const auto& peer : peers) {
+        if (client->closing) return;
+        for (const auto& payload : client->hold_queue.release(peer, client->broker->now_ms())) {
+            // Credit is only taken now; a full credit hold refuses it.
+            if (pace(client, peer.c_str(), payload.c_str()) == 0) {
+                send_peer_now(client, peer.c_str(), payload.c_str());
+            }
+        }
+    }
+}
+
+// Hands the due batches to the broker; results arrive through drain().
+void flush_metadata(AtemRtmClient* client, bool force) {
+    uint64_t now = client->broker->now_ms();
+    for (auto& write : client->metadata.take_due(now, force)) {
+        std::vector<atem_rtm::StubItem> items;
+        for (const auto& item : write.items) {
+            atem_rtm::StubItem stub_item;
+            stub_item.key = item.key;
+            stub_item.value = item.value;
+            stub_item.revision = item.revision;
+            items.push_back(std::move(stub_item));
+        }
+        const uint64_t request_id = client->next_request_id++;
+        const auto scope = write.scope;
+        const std::string target = write.target;
+        client->broker->update_metadata(
+            client->member, scope, target, std::move(items),
+            [client, request_id, scope, target](int32_t code) {
+                emit_result(client, ATEM_RTM_OP_SET_METADATA, target, code, request_id);
+                if (scope == atem_rtm::MetadataScope::Channel) {
+                    client->reads.invalidate(atem_rtm::SingleFlight::key("meta", target));
+                }
+                atem_rtm::MetadataWriteBehind::Result result;
+                result.ok = code == 0;
+                result.conflict = code == atem_rtm::kStubErrorOutdatedRevision;
+                std::vector<atem_rtm::MetadataWriteBehind::Refresh> refresh;
+                client->metadata.completed(request_id, result, client->broker->now_ms(), refresh);
+                refresh_metadata(client, refresh);
+            });
+        std::vector<atem_rtm::MetadataWriteBehind::Refresh> refresh;
+        client->metadata.issued(request_id, std::move(write), now, refresh);
+        refresh_metadata(client, refresh);
+    }
+}
+
+atem_rtm::ReadResult to_read_result(int32_t code, const std::vector<atem_rtm::StubItem>& items,
+                                    bool with_values) {
+    atem_rtm::ReadResult result;
+    result.code = code;
+    for (const auto& item : items) {
+        result.items.push_back(
+            atem_rtm::ReadItem{item.key, item.value, with_values, item.timestamp});
+    }
+    return result;
+}
+
+void answer_read(const atem_rtm::ReadResult& result, AtemRtmReadCallback callback,
+                 void* user_data) {
+    if (!callback) return;
+    std::vector<AtemRtmItem> items;
+    for (const auto& item : result.items) {
+        items.push_back(AtemRtmItem{item.key.c_str(),
+                                    item.has_value ? item.value.data() : nullptr,
+                                    item.value.size(), item.timestamp});
+    }
+    callback(result.code, items.data(), items.size(), user_data);
+}
+
+void prefetch_done(AtemRtmClient* client, const std::string& channel,
+                   const atem_rtm::ReadResult& result) {
+    std::vector<atem_rtm::InboundMessage> history;
+    for (const auto& item : result.items) {
+        atem_rtm::InboundMessage msg;
+        msg.publisher = item.key;
+        msg.payload = item.value;
+        msg.server_ts = item.timestamp;
+        history.push_back(std::move(msg));
+    }
+    std::vector<atem_rtm::InboundMessage> ready;
+    client->prefetch.completed(channel, result.code == 0, std::move(history), ready);
+    deliver(client, ready);
+}
+
+void answer(AtemRtmClient* client, const AtemRtmClient::ReadWaiter& waiter,
+            const atem_rtm::ReadResult& result) {
+    if (waiter.prefetch_channel.empty()) {
+        answer_read(result, waiter.callback, waiter.user_data);
+    } else {
+        prefetch_done(client, waiter.prefetch_channel, result);
+    }
+}
+
+void complete_reads(AtemRtmClient* client,
+                    const std::vector<atem_rtm::SingleFlight::Delivery>& done) {
+    for (const auto& delivery : done) {
+        auto it = client->read_waiters.find(delivery.waiter);
+        if (it == client->read_waiters.end()) continue;
+        AtemRtmClient::ReadWaiter waiter = it->second;
+        client->read_waiters.erase(it);
+        answer(client, waiter, *delivery.result);
+    }
+}
+
+void read_result(AtemRtmClient* client, uint64_t request_id, atem_rtm::ReadResult result) {
+    std::vector<atem_rtm::SingleFlight::Delivery> done;
+    client->reads.completed(request_id, std::move(result), client->broker->now_ms(), done);
+    complete_reads(client, done);
+}
+
+// Joins or starts the read `key`; `issue` sends the broker request whose
+// completion feeds read_result() with the given request id.
+template <typename Issue>
+int stub_read(AtemRtmClient* client, const std::string& key, AtemRtmClient::ReadWaiter reader,
+              Issue issue) {
+    if (client->closing) {
+        return ATEM_RTM_ERR_CLOSED;
+    }
+    const uint64_t now = client->broker->now_ms();
+    const uint64_t waiter = client->next_request_id++;
+    std::shared_ptr<const atem_rtm::ReadResult> cached;
+    const auto start = client->reads.begin(key, waiter, now, cached);
+    if (start == atem_rtm::SingleFlight::Start::Cached) {
+        answer(client, reader, *cached);
+        return ATEM_RTM_OK;
+    }
+    client->read_waiters[waiter] = reader;
+    if (start == atem_rtm::SingleFlight::Start::Issue) {
+        const uint64_t request_id = client->next_request_id++;
+        issue(request_id);
+        std::vector<atem_rtm::SingleFlight::Delivery> done;
+        client->reads.issued(waiter, request_id, now, done);
+        complete_reads(client, done);
+    }
+    drain(client);
+    return ATEM_RTM_QUEUED;
+}
+
+int read_history(AtemRtmClient* client, const std::string& channel, uint32_t limit,
+                 AtemRtmClient::ReadWaiter reader) {
+    return stub_read(
+        client, atem_rtm::SingleFlight::key("hist", channel, std::to_string(limit)), reader,
+        [client, channel, limit](uint64_t request_id) {
+            client->broker->get_history(
+                client->member, channel, limit, 0,
+                [client, request_id](int32_t code, std::vector<atem_rtm::StubItem> items,
+                                     uint64_t) {
+                    emit_result(client, ATEM_RTM_OP_GET_HISTORY, std::string(), code,
+                                request_id);
+                    read_result(client, request_id, to_read_result(code, items, true));
+                });
+        });
+}
+
+void complete_location_waiters(AtemRtmClient* client,
+                               const std::vector<atem_rtm::LocationCache::Answer>& done) {
+    for (const auto& answer : done) {
+        auto it = client->location_waiters.find(answer.waiter);
+        if (it == client->location_waiters.end()) continue;
+        AtemRtmClient::LocationWaiter waiter = it->second;
+        client->location_waiters.erase(it);
+        if (!waiter.callback) continue;
+        std::vector<const char*> names;
+        for (const auto& channel : answer.channels) names.push_back(channel.c_str());
+        waiter.callback(answer.user.c_str(),
+                        answer.ok ? ATEM_RTM_OK
+                                  : (client->closing ? ATEM_RTM_ERR_CLOSED : ATEM_RTM_ERROR),
+                        names.data(), names.size(), waiter.user_data);
+    }
+}
+
+void lock_result(AtemRtmClient* client, uint64_t request_id, const atem_rtm::LockKey& key,
+                 int32_t code);
+void run_lock_step(AtemRtmClient* client, atem_rtm::LockWaitList::Step step);
+
+// Replaces the lock's pending re-check with one `delay_ms` from now on the
+// broker's clock.
+void arm_lock_recheck(AtemRtmClient* client, const atem_rtm::LockWaitList::Recheck& recheck) {
+    std::string id = recheck.lock.channel;
+    id.push_back('\x1f');
+    id.append(recheck.lock.name);
+    atem_rtm::TimerId& timer = client->lock_rechecks[id];
+    client->timers.cancel(timer);
+    timer = client->timers.schedule(
+        client->broker->now_ms() + recheck.delay_ms, [client, key = recheck.lock] {
+            if (!client->channel_joined) return;
+            atem_rtm::LockWaitList::Step step;
+            client->locks.recheck(key.channel, key.name, client->broker->now_ms(), step);
+            run_lock_step(client, std::move(step));
+        });
+}
+
+// Carries out what the wait list asked for; results come back through the
+// broker, so issued() always precedes them. Lock timing uses the broker's
+// clock, so advancing it drives the re-checks.
+void run_lock_step(AtemRtmClient* client, atem_rtm::LockWaitList::Step step) {
+    while (!step.empty()) {
+        atem_rtm::LockWaitList::Step next;
+        uint64_t now = client->broker->now_ms();
+        for (const auto& recheck : step.recheck) {
+            arm_lock_recheck(client, recheck);
+        }
+        for (const auto& key : step.release) {
+            client->broker->release_lock(client->member, key.channel, key.name,
+                                         [client, key](int32_t code) {
+                                             emit_result(client, ATEM_RTM_OP_RELEASE_LOCK,
+                                                         key.channel, code, 0, key.name);
+                                         });
+        }
+        for (const auto& key : step.acquire) {
+            const uint64_t request_id = client->next_request_id++;
+            client->broker->acquire_lock(client->member, key.channel, key.name,
+                                         [client, request_id, key](int32_t code) {
+                                             lock_result(client, request_id, key, code);
+                                         });
+            client->locks.issued(key.channel, key.name, request_id, now, next);
+        }
+        for (const auto& completion : step.done) {
+            auto it = client->lock_waiters.find(completion.waiter);
+            if (it == client->lock_waiters.end()) {
+                continue;
+            }
+            AtemRtmClient::LockWaiter waiter = it->second;
+            client->lock_waiters.erase(it);
+            if (waiter.callback) {
+                int result = completion.outcome == atem_rtm::LockOutcome::Acquired ? ATEM_RTM_OK
+                             : completion.outcome == atem_rtm::LockOutcome::Closed
+                                 ? ATEM_RTM_ERR_CLOSED
+                                 : ATEM_RTM_ERROR;
+                waiter.callback(completion.lock.channel.c_str(), completion.lock.name.c_str(),
+                                result, waiter.user_data);
+            }
+        }
+        step = std::move(next);
+    }
+}
+
+void lock_result(AtemRtmClient* client, uint64_t request_id, const atem_rtm::LockKey& key,
+                 int32_t code) {
+    emit_result(client, ATEM_RTM_OP_ACQUIRE_LOCK, key.channel, code, request_id, key.name);
+    atem_rtm::LockWaitList::Result result;
+    result.ok = code == 0;
+    result.contended = code == atem_rtm::kStubErrorLockAcquireFailed;
+    atem_rtm::LockWaitList::Step step;
+    client->locks.acquire_result(request_id, result, client->broker->now_ms(), step);
+    run_lock_step(client, std::move(step));
+}
+
+uint32_t to_presence_subtype(atem_rtm::PresenceDelta::Kind kind) {
+    switch (kind) {
+    case atem_rtm::PresenceDelta::Kind::Snapshot:
+        return ATEM_RTM_PRESENCE_SNAPSHOT;
+    case atem_rtm::PresenceDelta::Kind::Join:
+        return ATEM_RTM_PRESENCE_JOIN;
+    default:
+        return ATEM_RTM_PRESENCE_LEAVE;
+    }
+}
+
 } // namespace
 
+// Runs under the broker lock: only signal, the poll drains.
+void AtemRtmClient::wake() {
+    if (event_notify) event_notify(event_notify_data);
+}
+
+void AtemRtmClient::on_message(const std::string& channel, const std::string& publisher,
+                               const std::string& payload, const std::string& custom_type,
+                               uint64_t timestamp) {
+    atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Message);
+    last_inbound_ms = broker->now_ms();
+    // Credit granted to us: never delivered; held sends go on tick.
+    const atem_rtm::CreditGrant grant = atem_rtm::parse_credit_grant(custom_type.c_str());
+    if (grant.valid) {
+        credit_gate.grant(publisher, payload, grant, broker->now_ms());
+        return;
+    }
+    reads.invalidate_prefix(read_prefix("hist", channel));
+    atem_rtm::InboundMessage msg;
+    msg.channel = channel;
+    msg.publisher = publisher;
+    msg.payload = payload;
+    msg.server_ts = timestamp;
+    msg.stamp = atem_rtm::parse_sender_stamp(custom_type.c_str());
+    std::vector<atem_rtm::InboundMessage> ready;
+    reorder.push(std::move(msg), broker->now_ms(), ready);
+    deliver_live(this, ready);
+}
+
+void AtemRtmClient::on_presence(const atem_rtm::PresenceDelta& delta, uint64_t timestamp) {
+    atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Presence);
+    atem_rtm::EventRecord record;
+    record.kind = ATEM_RTM_EVENT_PRESENCE;
+    record.subtype = to_presence_subtype(delta.kind);
+    record.timestamp = timestamp;
+    record.channel = delta.channel;
+    if (delta.kind == atem_rtm::PresenceDelta::Kind::Snapshot) {
+        record.aux = static_cast<uint32_t>(delta.users.size());
+        if (delta.users.empty()) emit(this, record);
+    }
+    for (const auto& user : delta.users) {
+        atem_rtm::EventRecord per_user = record;
+        emit(this, std::move(per_user.with_user(user)));
+    }
+    location.apply(delta);
+    reads.invalidate(atem_rtm::SingleFlight::key("who", delta.channel));
+    reads.invalidate_prefix(read_prefix("state", delta.channel));
+    std::vector<std::string> came_online;
+    presence.apply(delta, came_online);
+    hold_queue.expire(broker->now_ms());
+    flush_held(this, came_online);
+}
+
+void AtemRtmClient::on_lock_event(uint32_t type, const std::string& channel,
+                                  const std::string& lock, const std::string& owner,
+                                  uint32_t ttl, uint64_t timestamp) {
+    atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Lock);
+    atem_rtm::EventRecord record;
+    record.kind = ATEM_RTM_EVENT_LOCK;
+    record.subtype = type;
+    record.aux = ttl;
+    record.timestamp = timestamp;
+    record.channel = channel;
+    record.with_name(lock);
+    if (!owner.empty()) record.with_user(owner);
+    emit(this, std::move(record));
+
+    atem_rtm::LockWaitList::Step step;
+    const uint64_t now = broker->now_ms();
+    if (type == atem_rtm::kStubLockAcquired ||
+        (type == atem_rtm::kStubLockSnapshot && !owner.empty() && owner != user_id)) {
+        locks.on_held(channel, lock, now, step);
+    } else if (type == atem_rtm::kStubLockReleased) {
+        locks.on_free(channel, lock, now, step);
+    } else if (type == atem_rtm::kStubLockExpired ||
+               (type == atem_rtm::kStubLockSnapshot && owner.empty())) {
+        // A snapshot showing it free means any hold of ours is gone.
+        locks.on_expired(channel, lock, now, step);
+    }
+    run_lock_step(this, std::move(step));
+}
+
 extern "C" {
 
 AtemRtmClient* atem_rtm_create(
@@ -37,9 +767,60 @@ AtemRtmClient* atem_rtm_create(
     }
     auto* client = new AtemRtmClient();
     client->config = *config;
+    // `config` strings are the caller's; keep what bring-up needs.
+    client->client_id = config->client_id ? config->client_id : "";
     client->callback = callback;
     client->user_data = user_data;
     client->connected = false;
+    if (config->outbound_buffer_count || config->outbound_buffer_size) {
+        client->buffers = atem_rtm::BufferPool(
+            config->outbound_buffer_count ? config->outbound_buffer_count
+                                          : atem_rtm::kDefaultOutboundBufferCount,
+            config->outbound_buffer_size ? config->outbound_buffer_size
+                                         : atem_rtm::kDefaultOutboundBufferSize);
+    }
+    if (config->metadata_window_ms) {
+        client->metadata = atem_rtm::MetadataWriteBehind(config->metadata_window_ms);
+    }
+    if (config->reorder_window_ms) {
+        client->reorder = atem_rtm::ReorderBuffer(config->reorder_window_ms);
+    }
+    if (config->location_ttl_ms) {
+        client->location = atem_rtm::LocationCache(config->location_ttl_ms);
+    }
+    if (config->peer_hold_capacity || config->peer_hold_ttl_ms) {
+        client->hold_queue = atem_rtm::PeerHoldQueue(
+            config->peer_hold_capacity ? config->peer_hold_capacity
+                                       : atem_rtm::kDefaultPeerHoldCapacity,
+            config->peer_hold_ttl_ms ? config->peer_hold_ttl_ms
+                                     : atem_rtm::kDefaultPeerHoldTtlMs);
+    }
+    if (config->read_cache_ms || config->read_error_cache_ms) {
+        client->reads = atem_rtm::SingleFlight(config->read_cache_ms, config->read_error_cache_ms);
+    }
+    if (config->event_queue_capacity || config->fair_quantum_bytes) {
+        client->events = atem_rtm::EventQueue(
+            config->event_queue_capacity ? config->event_queue_capacity
+                                         : atem_rtm::kDefaultEventQueueCapacity,
+            config->fair_quantum_bytes, config->fair_publisher_max_bytes);
+    }
+    if (config->outbound_rate_per_s) {
+        client->outbound = atem_rtm::OutboundScheduler(
+            config->outbound_rate_per_s, config->outbound_burst, config->outbound_aging_ms);
+    }
+    client->events.track_discards(config->credit_window > 0);
+    client->stamp_epoch = std::random_device{}();
+    if (config->credit_window) {
+        client->granter = atem_rtm::CreditGranter(config->credit_window, config->credit_refresh_ms);
+    }
+    client->credit_gate =
+        atem_rtm::CreditGate(config->credit_refresh_ms, config->credit_hold_max);
+    client->credit_gate.set_epoch(client->stamp_epoch);
+    // Stub: the dispatcher_* settings are ignored; broker deliveries
+    // already run on the caller's thread.
+    client->broker = atem_rtm::StubBroker::project(copy_or_empty(config->app_id));
+    client->member = client->broker->attach(client);
+    client->timers = atem_rtm::TimerWheel(client->broker->now_ms());
     return client;
 }
 
@@ -47,6 +828,7 @@ void atem_rtm_destroy(AtemRtmClient* client) {
     if (!client) {
         return;
     }
+    client->broker->detach(client->member);
     delete client;
 }
 
@@ -64,9 +846,69 @@ int atem_rtm_disconnect(AtemRtmClient* client) {
     if (!client) {
         return -1;
     }
+    client->broker->logout(client->member);
+    client->location.invalidate();
+    // A fresh snapshot follows the next subscribe.
+    client->presence.invalidate();
+    client->connected = false;
+    client->logged_in = false;
+    client->channel_joined = false;
+    return 0;
+}
+
+int atem_rtm_shutdown(
+    AtemRtmClient* client,
+    uint32_t deadline_ms,
+    AtemRtmShutdownReport* report) {
+    if (!client) {
+        return -1;
+    }
+    if (client->closing) {
+        return ATEM_RTM_ERR_CLOSED;
+    }
+    // Paced and credit-held sends go out at once, as the stub acknowledges
+    // them on the spot. Staged metadata follows; its results arrive with
+    // the broker latency, which the deadline bounds.
+    const uint64_t started = client->broker->now_ms();
+    const uint64_t written_before = client->metadata.counters().written;
+    const uint64_t failed_before = client->metadata.counters().failed;
+    const uint64_t deadline = started + deadline_ms;
+    size_t sent = flush_outbound(client, true);
+    sent += flush_credit(client, true);
+    flush_metadata(client, true);
+    drain(client);
+    while (client->metadata.in_flight() > 0 && client->broker->now_ms() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        drain(client);
+        flush_metadata(client, true);
+    }
+    atem_rtm::LockWaitList::Step step;
+    client->locks.close(step);
+    run_lock_step(client, std::move(step));
+    drain(client);
+    client->closing = true;
+    std::vector<atem_rtm::SingleFlight::Delivery> reads_done;
+    client->reads.close(ATEM_RTM_ERR_CLOSED, reads_done);
+    complete_reads(client, reads_done);
+    std::vector<atem_rtm::LocationCache::Answer> location_done;
+    client->location.close(location_done);
+    complete_location_waiters(client, location_done);
+    client->broker->logout(client->member);
     client->connected = false;
     client->logged_in = false;
     client->channel_joined = false;
+    if (report) {
+        *report = AtemRtmShutdownReport{};
+        const auto& meta = client->metadata.counters();
+        report->flushed = static_cast<uint32_t>(sent + meta.written - written_before);
+        report->failed = static_cast<uint32_t>(meta.failed - failed_before);
+        // Held messages target peers that are still offline; metadata
+        // unanswered at the deadline, or restaged after it, never lands.
+        report->abandoned =
+            static_cast<uint32_t>(client->hold_queue.clear() + client->metadata.in_flight() +
+                                  client->metadata.pending_items());
+        report->elapsed_ms = static_cast<uint32_t>(client->broker->now_ms() - started);
+    }
     return 0;
 }
 
@@ -80,6 +922,14 @@ int atem_rtm_login(
     client->token = token ? token : "";
     client->user_id = user_id;
     client->logged_in = true;
+    client->token_renewed_ms = client->broker->now_ms();
+    client->broker->login(client->member, client->user_id);
+    atem_rtm::EventRecord link;
+    link.kind = ATEM_RTM_EVENT_LINK_STATE;
+    link.subtype = ATEM_RTM_LINK_CONNECTED;
+    emit(client, std::move(link));
+    emit_result(client, ATEM_RTM_OP_LOGIN, std::string());
+    drain(client);
     return 0;
 }
 
@@ -91,18 +941,61 @@ int atem_rtm_join_channel(
     }
     client->channel_id = channel_id;
     client->channel_joined = true;
+    emit_result(client, ATEM_RTM_OP_SUBSCRIBE, client->channel_id);
+    // Before the subscribe, so no live message slips past the merge.
+    const uint32_t history_count =
+        std::min(client->config.join_history_count, atem_rtm::kMaxPrefetchCount);
+    const bool fetch_history =
+        history_count && client->prefetch.begin(client->channel_id, client->broker->now_ms());
+    // The presence and lock snapshots follow the subscribe result.
+    client->broker->subscribe(client->member, client->channel_id);
+    if (fetch_history) {
+        read_history(client, client->channel_id, history_count,
+                     {nullptr, nullptr, client->channel_id});
+    }
+    drain(client);
+    return 0;
+}
+
+int atem_rtm_bring_up(
+    AtemRtmClient* client,
+    const char* token,
+    const char* channel_id,
+    AtemRtmReadyCallback callback,
+    void* user_data) {
+    if (client && client->closing) {
+        return ATEM_RTM_ERR_CLOSED;
+    }
+    if (!client || !channel_id || !channel_id[0]) {
+        return -1;
+    }
+    // No round trips here: log in, join and report ready at once.
+    int rc = atem_rtm_login(client, token, client->client_id.c_str());
+    if (rc == 0) rc = atem_rtm_join_channel(client, channel_id);
+    if (rc != 0) {
+        return rc;
+    }
+    if (callback) callback(client, ATEM_RTM_OK, user_data);
     return 0;
 }
 
 int atem_rtm_publish_channel(
     AtemRtmClient* client,
     const char* payload) {
+    if (client && client->closing) {
+        return ATEM_RTM_ERR_CLOSED;
+    }
     if (!client || !client->connected || !client->channel_joined || !payload) {
         return -1;
     }
-    if (client->callback) {
-        client->callback(client->config.client_id ? client->config.client_id : "self", payload, client->user_data);
+    const int paced = pace(client, nullptr, payload);
+    if (paced < 0) {
+        return paced;
     }
+    if (paced == 0) {
+        send_channel(client, payload);
+    }
+    drain(client);
     return 0;
 }
 
@@ -110,12 +1003,116 @@ int atem_rtm_send_peer(
     AtemRtmClient* client,
     const char* target_client_id,
     const char* payload) {
+    if (client && client->closing) {
+        return ATEM_RTM_ERR_CLOSED;
+    }
     if (!client || !client->connected || !target_client_id || !payload) {
         return -1;
     }
-    if (client->callback) {
-        // Stub: immediately echo back to simulate delivery.
-        client->callback(target_client_id, payload, client->user_data);
+    const int paced = pace(client, target_client_id, payload);
+    if (paced < 0) {
+        return paced;
+    }
+    const int rc = paced == 0 ? send_peer_now(client, target_client_id, payload) : 0;
+    drain(client);
+    return rc;
+}
+
+int atem_rtm_buffer_acquire(
+    AtemRtmClient* client,
+    AtemRtmBuffer* out) {
+    if (client && client->closing) {
+        return ATEM_RTM_ERR_CLOSED;
+    }
+    if (!client || !out) {
+        return -1;
+    }
+    uint32_t id = 0;
+    if (!client->buffers.acquire(&id)) {
+        return ATEM_RTM_ERR_NO_BUFFER;
+    }
+    out->id = id;
+    out->data = client->buffers.data(id);
+    out->capacity = client->buffers.size();
+    return 0;
+}
+
+int atem_rtm_buffer_release(
+    AtemRtmClient* client,
+    uint32_t buffer_id) {
+    if (!client) {
+        return -1;
+    }
+    return client->buffers.release(buffer_id) ? 0 : -1;
+}
+
+int atem_rtm_publish_buffer(
+    AtemRtmClient* client,
+    uint32_t buffer_id,
+    size_t length) {
+    if (!client || !client->buffers.owned(buffer_id) || length > client->buffers.size()) {
+        return -1;
+    }
+    // Stub: the echo needs a terminated copy; the buffer is done right away.
+    std::string payload(client->buffers.data(buffer_id), length);
+    int rc = atem_rtm_publish_channel(client, payload.c_str());
+    if (rc != 0) {
+        return rc;
+    }
+    uint64_t request_id = client->next_request_id++;
+    client->buffers.sending(buffer_id);
+    client->buffers.submitted(buffer_id, request_id);
+    client->buffers.completed(request_id);
+    return 0;
+}
+
+int atem_rtm_send_peer_buffer(
+    AtemRtmClient* client,
+    const char* target_client_id,
+    uint32_t buffer_id,
+    size_t length) {
+    if (!client || !client->buffers.owned(buffer_id) || length > client->buffers.size()) {
+        return -1;
+    }
+    std::string payload(client->buffers.data(buffer_id), length);
+    int rc = atem_rtm_send_peer(client, target_client_id, payload.c_str());
+    if (rc < 0) {
+        return rc;
+    }
+    uint64_t request_id = client->next_request_id++;
+    client->buffers.sending(buffer_id);
+    client->buffers.submitted(buffer_id, request_id);
+    client->buffers.completed(request_id);
+    return rc;
+}
+
+int atem_rtm_set_history_policy(
+    AtemRtmClient* client,
+    const char* message_class,
+    AtemRtmHistoryPolicy policy) {
+    if (!client) {
+        return -1;
+    }
+    const bool store = policy == ATEM_RTM_HISTORY_STORE;
+    if (!message_class || strcmp(message_class, "*") == 0) {
+        client->history.set_default(store);
+    } else {
+        client->history.set(message_class, store);
+    }
+    return 0;
+}
+
+int atem_rtm_set_priority(
+    AtemRtmClient* client,
+    const char* message_class,
+    AtemRtmPriority priority) {
+    if (!client) {
+        return -1;
+    }
+    if (!message_class || strcmp(message_class, "*") == 0) {
+        client->outbound.set_default(priority);
+    } else {
+        client->outbound.set_class(message_class, priority);
     }
     return 0;
 }
@@ -127,6 +1124,7 @@ int atem_rtm_set_token(
         return -1;
     }
     client->token = token;
+    client->token_renewed_ms = client->broker->now_ms();
     return 0;
 }
 
@@ -141,4 +1139,402 @@ int atem_rtm_subscribe_topic(
     return 0;
 }
 
+int atem_rtm_set_idle(AtemRtmClient* client, int idle) {
+    if (!client) {
+        return -1;
+    }
+    // Stub: nothing to pause or batch; remember the mode for stats.
+    client->idle = idle != 0;
+    return 0;
+}
+
+int atem_rtm_tick(AtemRtmClient* client) {
+    if (!client) {
+        return -1;
+    }
+    drain(client);
+    std::vector<atem_rtm::InboundMessage> reordered;
+    client->reorder.poll(client->broker->now_ms(), reordered);
+    deliver_live(client, reordered);
+    std::vector<atem_rtm::InboundMessage> unheld;
+    client->prefetch.expire(client->broker->now_ms(), unheld);
+    deliver(client, unheld);
+    client->hold_queue.expire(client->broker->now_ms());
+    flush_metadata(client, false);
+    flush_outbound(client, false);
+    flush_credit(client, false);
+    send_grants(client);
+    std::vector<atem_rtm::TimerWheel::Task> due;
+    client->timers.advance(client->broker->now_ms(), due);
+    for (auto& task : due) task();
+    drain(client);
+    return 0;
+}
+
+int atem_rtm_stage_metadata(
+    AtemRtmClient* client,
+    AtemRtmMetadataScope scope,
+    const char* target,
+    const char* key,
+    const char* value) {
+    if (client && client->closing) {
+        return ATEM_RTM_ERR_CLOSED;
+    }
+    if (!client || !target || !key || !value) {
+        return -1;
+    }
+    client->metadata.stage(
+        scope == ATEM_RTM_METADATA_USER ? atem_rtm::MetadataScope::User
+                                        : atem_rtm::MetadataScope::Channel,
+        target, key, value, client->broker->now_ms(), client->broker->wall_ms());
+    return 0;
+}
+
+int atem_rtm_flush_metadata(AtemRtmClient* client) {
+    if (!client) {
+        return -1;
+    }
+    flush_metadata(client, true);
+    drain(client);
+    return 0;
+}
+
+int atem_rtm_acquire_lock(
+    AtemRtmClient* client,
+    const char* channel,
+    const char* lock_name,
+    AtemRtmLockCallback callback,
+    void* user_data) {
+    if (client && client->closing) {
+        return ATEM_RTM_ERR_CLOSED;
+    }
+    if (!client || !channel || !lock_name) {
+        return -1;
+    }
+    uint64_t waiter = client->next_request_id++;
+    client->lock_waiters[waiter] = AtemRtmClient::LockWaiter{callback, user_data};
+    atem_rtm::LockWaitList::Step step;
+    client->locks.wait(channel, lock_name, waiter, client->broker->now_ms(), step);
+    run_lock_step(client, std::move(step));
+    drain(client);
+    return 0;
+}
+
+int atem_rtm_release_lock(
+    AtemRtmClient* client,
+    const char* channel,
+    const char* lock_name) {
+    if (!client || !channel || !lock_name) {
+        return -1;
+    }
+    atem_rtm::LockWaitList::Step step;
+    client->locks.released(channel, lock_name, client->broker->now_ms(), step);
+    run_lock_step(client, std::move(step));
+    drain(client);
+    return 0;
+}
+
+int atem_rtm_health(
+    AtemRtmClient* client,
+    AtemRtmHealth* out) {
+    if (!client || !out) {
+        return -1;
+    }
+    const uint64_t now = client->broker->now_ms();
+    auto age = [now](uint64_t at) -> uint64_t {
+        return at == 0 ? ATEM_RTM_AGE_NEVER : now - at;
+    };
+    *out = AtemRtmHealth{};
+    out->link_state = client->logged_in ? ATEM_RTM_LINK_CONNECTED : ATEM_RTM_LINK_IDLE;
+    out->last_inbound_age_ms = age(client->last_inbound_ms);
+    out->last_outbound_age_ms = age(client->last_outbound_ms);
+    out->token_age_ms = age(client->token_renewed_ms);
+    return 0;
+}
+
+int atem_rtm_where_now(
+    AtemRtmClient* client,
+    const char* user_id,
+    AtemRtmWhereNowCallback callback,
+    void* user_data) {
+    if (client && client->closing) {
+        return ATEM_RTM_ERR_CLOSED;
+    }
+    if (!client || !user_id) {
+        return -1;
+    }
+    const uint64_t now = client->broker->now_ms();
+    std::vector<std::string> channels;
+    if (client->location.lookup(user_id, now, channels)) {
+        if (callback) {
+            std::vector<const char*> names;
+            for (const auto& channel : channels) names.push_back(channel.c_str());
+            callback(user_id, ATEM_RTM_OK, names.data(), names.size(), user_data);
+        }
+        return ATEM_RTM_OK;
+    }
+    const uint64_t waiter = client->next_request_id++;
+    client->location_waiters[waiter] = AtemRtmClient::LocationWaiter{callback, user_data};
+    if (client->location.wait(user_id, waiter)) {
+        const uint64_t request_id = client->next_request_id++;
+        client->broker->where_now(
+            client->member, user_id,
+            [client, request_id](int32_t code, std::vector<atem_rtm::StubItem> items) {
+                emit_result(client, ATEM_RTM_OP_WHERE_NOW, std::string(), code, request_id);
+                std::vector<std::string> found;
+                for (auto& item : items) found.push_back(std::move(item.key));
+                std::vector<atem_rtm::LocationCache::Answer> done;
+                client->location.result(request_id, code == 0, std::move(found),
+                                        client->broker->now_ms(), done);
+                complete_location_waiters(client, done);
+            });
+        std::vector<atem_rtm::LocationCache::Answer> done;
+        client->location.issued(user_id, request_id, now, done);
+        complete_location_waiters(client, done);
+    }
+    drain(client);
+    return ATEM_RTM_QUEUED;
+}
+
+int atem_rtm_get_state(
+    AtemRtmClient* client,
+    const char* channel,
+    const char* user_id,
+    AtemRtmReadCallback callback,
+    void* user_data) {
+    if (!client || !channel || !user_id) {
+        return -1;
+    }
+    return stub_read(
+        client, atem_rtm::SingleFlight::key("state", channel, user_id), {callback, user_data, {}},
+        [client, target = std::string(channel), user = std::string(user_id)](uint64_t request_id) {
+            client->broker->get_state(
+                client->member, target, user,
+                [client, request_id](int32_t code, std::vector<atem_rtm::StubItem> items) {
+                    emit_result(client, ATEM_RTM_OP_GET_STATE, std::string(), code, request_id);
+                    read_result(client, request_id, to_read_result(code, items, true));
+                });
+        });
+}
+
+int atem_rtm_get_channel_metadata(
+    AtemRtmClient* client,
+    const char* channel,
+    AtemRtmReadCallback callback,
+    void* user_data) {
+    if (!client || !channel) {
+        return -1;
+    }
+    return stub_read(
+        client, atem_rtm::SingleFlight::key("meta", channel), {callback, user_data, {}},
+        [client, target = std::string(channel)](uint64_t request_id) {
+            client->broker->get_metadata(
+                client->member, atem_rtm::MetadataScope::Channel, target,
+                [client, request_id, target](int32_t code,
+                                             std::vector<atem_rtm::StubItem> items) {
+                    emit_result(client, ATEM_RTM_OP_GET_METADATA, target, code, request_id);
+                    for (const auto& item : items) {
+                        client->metadata.observe(atem_rtm::MetadataScope::Channel, target,
+                                                 item.key, item.revision, item.timestamp);
+                    }
+                    read_result(client, request_id, to_read_result(code, items, true));
+                });
+        });
+}
+
+int atem_rtm_who_now(
+    AtemRtmClient* client,
+    const char* channel,
+    AtemRtmReadCallback callback,
+    void* user_data) {
+    if (!client || !channel) {
+        return -1;
+    }
+    return stub_read(
+        client, atem_rtm::SingleFlight::key("who", channel), {callback, user_data, {}},
+        [client, target = std::string(channel)](uint64_t request_id) {
+            client->broker->who_now(
+                client->member, target,
+                [client, request_id](int32_t code, std::vector<atem_rtm::StubItem> items) {
+                    emit_result(client, ATEM_RTM_OP_WHO_NOW, std::string(), code, request_id);
+                    read_result(client, request_id, to_read_result(code, items, false));
+                });
+        });
+}
+
+int atem_rtm_get_history(
+    AtemRtmClient* client,
+    const char* channel,
+    uint32_t count,
+    AtemRtmReadCallback callback,
+    void* user_data) {
+    if (!client || !channel) {
+        return -1;
+    }
+    const uint32_t limit = count ? count : atem_rtm::kStubHistoryPageMax;
+    return read_history(client, channel, limit, {callback, user_data, {}});
+}
+
+int atem_rtm_poll_events(
+    AtemRtmClient* client,
+    AtemRtmEvent* out,
+    size_t max,
+    size_t* count) {
+    if (!client || !count || (!out && max)) {
+        return -1;
+    }
+    *count = client->events.poll(out, max);
+    const uint64_t now = client->broker->now_ms();
+    const uint64_t wall = client->broker->wall_ms();
+    for (size_t i = 0; i < *count; ++i) {
+        const AtemRtmEvent& event = out[i];
+        if (event.kind == ATEM_RTM_EVENT_MESSAGE && event.subtype == ATEM_RTM_MESSAGE_LIVE &&
+            event.timestamp != 0) {
+            client->series.latency(wall > event.timestamp ? wall - event.timestamp : 0, now);
+        }
+    }
+    // Polled messages free their publishers' credit.
+    if (client->granter.enabled()) {
+        release_discarded(client);
+    }
+    for (size_t i = 0; client->granter.enabled() && i < *count; ++i) {
+        const AtemRtmEvent& event = out[i];
+        if (event.kind != ATEM_RTM_EVENT_MESSAGE || event.subtype != ATEM_RTM_MESSAGE_LIVE ||
+            !event.user || !event.channel) {
+            continue;
+        }
+        client->granter.consumed(event.user, event.channel);
+    }
+    return 0;
+}
+
+int atem_rtm_get_stats_series(
+    AtemRtmClient* client,
+    AtemRtmStatsSample* out,
+    size_t max,
+    size_t* count) {
+    if (!client || !count || (!out && max)) {
+        return -1;
+    }
+    *count = client->series.copy(client->broker->now_ms(), out, max);
+    return 0;
+}
+
+int atem_rtm_set_event_notify(
+    AtemRtmClient* client,
+    AtemRtmEventNotify notify,
+    void* user_data) {
+    if (!client) {
+        return -1;
+    }
+    client->event_notify = notify;
+    client->event_notify_data = user_data;
+    return 0;
+}
+
+int atem_rtm_get_stats(
+    AtemRtmClient* client,
+    AtemRtmStats* out) {
+    if (!client || !out) {
+        return -1;
+    }
+    client->hold_queue.expire(client->broker->now_ms());
+    const auto& held = client->hold_queue.counters();
+    *out = AtemRtmStats{};
+    out->peer_messages_held = held.held;
+    out->peer_messages_flushed = held.flushed;
+    out->peer_messages_expired = held.expired;
+    out->peer_messages_dropped = held.dropped;
+    out->peer_hold_depth = client->hold_queue.depth();
+    out->idle_mode = client->idle ? 1 : 0;
+    const auto& reorder = client->reorder.counters();
+    out->reorder_depth = client->reorder.depth();
+    out->reorder_max_depth = reorder.max_depth;
+    out->reorder_held = reorder.held;
+    out->reorder_hold_ms_total = reorder.hold_ms_total;
+    out->reorder_hold_ms_max = reorder.hold_ms_max;
+    out->reorder_gaps_skipped = reorder.gaps_skipped;
+    out->reorder_duplicates = reorder.duplicates;
+    out->reorder_late = reorder.late;
+    const auto& meta = client->metadata.counters();
+    out->metadata_staged = meta.staged;
+    out->metadata_coalesced = meta.coalesced;
+    out->metadata_writes = meta.writes;
+    out->metadata_written = meta.written;
+    out->metadata_conflicts = meta.conflicts;
+    out->metadata_retries = meta.retries;
+    out->metadata_superseded = meta.superseded;
+    out->metadata_failed = meta.failed;
+    out->metadata_pending = client->metadata.pending_items();
+    out->metadata_in_flight = client->metadata.in_flight();
+    const auto& locks = client->locks.counters();
+    out->lock_waits = locks.waits;
+    out->lock_acquires = locks.acquires;
+    out->lock_acquired = locks.acquired;
+    out->lock_contended = locks.contended;
+    out->lock_failed = locks.failed;
+    out->lock_waiters = client->locks.waiters();
+    out->lock_handoff_ms_total = locks.handoff_ms_total;
+    out->lock_handoff_ms_max = locks.handoff_ms_max;
+    out->history_stored = client->history.counters().stored;
+    out->history_skipped = client->history.counters().skipped;
+    out->buffers_in_use = client->buffers.in_use();
+    out->buffer_publishes = client->buffers.counters().submitted;
+    out->buffers_exhausted = client->buffers.counters().exhausted;
+    const auto& location = client->location.counters();
+    out->location_hits = location.hits;
+    out->location_misses = location.misses;
+    out->location_queries = location.queries;
+    out->location_collapsed = location.collapsed;
+    out->location_entries = client->location.entries();
+    const auto& reads = client->reads.counters();
+    out->reads_requested = reads.requests;
+    out->reads_issued = reads.issued;
+    out->reads_collapsed = reads.collapsed;
+    out->reads_cache_hits = reads.cache_hits;
+    const auto callbacks = client->cpu.callbacks();
+    const auto cpu_us = [client](atem_rtm::CpuSlot slot) {
+        return client->cpu.slot(slot).ns_total / 1000;
+    };
+    out->cpu_callbacks = callbacks.calls;
+    out->cpu_callback_us = callbacks.ns_total / 1000;
+    out->cpu_callback_max_us = callbacks.ns_max / 1000;
+    out->cpu_message_us = cpu_us(atem_rtm::CpuSlot::Message);
+    out->cpu_presence_us = cpu_us(atem_rtm::CpuSlot::Presence);
+    out->cpu_topic_us = cpu_us(atem_rtm::CpuSlot::Topic);
+    out->cpu_lock_us = cpu_us(atem_rtm::CpuSlot::Lock);
+    out->cpu_storage_us = cpu_us(atem_rtm::CpuSlot::Storage);
+    out->cpu_link_state_us = cpu_us(atem_rtm::CpuSlot::LinkState);
+    out->cpu_result_us = cpu_us(atem_rtm::CpuSlot::Result);
+    out->cpu_token_us = cpu_us(atem_rtm::CpuSlot::TokenWillExpire);
+    out->cpu_dispatch_us = cpu_us(atem_rtm::CpuSlot::Dispatch);
+    out->events_queued = client->events.depth();
+    out->events_dropped = client->events.counters().dropped;
+    out->events_spilled = client->events.counters().spilled;
+    const auto& prefetch = client->prefetch.counters();
+    out->prefetch_fetches = prefetch.fetches;
+    out->prefetch_replayed = prefetch.replayed;
+    out->prefetch_duplicates = prefetch.duplicates;
+    out->prefetch_late = prefetch.late;
+    out->fair_shed = client->events.fair().counters().shed;
+    out->fair_publishers_max = client->events.fair().counters().max_publishers;
+    const auto& outbound = client->outbound.counters();
+    out->outbound_queued = client->outbound.depth();
+    out->outbound_deferred = outbound.deferred;
+    out->outbound_aged = outbound.aged;
+    out->outbound_wait_ms_max_control = outbound.wait_ms_max[atem_rtm::kOutboundControl];
+    out->outbound_wait_ms_max_normal = outbound.wait_ms_max[atem_rtm::kOutboundNormal];
+    out->outbound_wait_ms_max_bulk = outbound.wait_ms_max[atem_rtm::kOutboundBulk];
+    const auto& credit = client->credit_gate.counters();
+    out->credit_grants_sent = client->granter.counters().grants;
+    out->credit_grants_received = credit.grants;
+    out->credit_held = credit.held;
+    out->credit_waiting = client->credit_gate.depth();
+    out->credit_coalesced = credit.coalesced;
+    out->credit_refused = credit.refused;
+    out->timers_pending = client->timers.size();
+    out->timers_fired = client->timers.counters().fired;
+    return 0;
+}
+
 } // extern "C"
@@ -0,0 +1,552 @@
+#include "atem_rtm_broker.h"
+
+#include "atem_rtm.h"
+#include "atem_rtm_clock.h"
+#include "atem_rtm_stub.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace atem_rtm {
+
+std::shared_ptr<StubBroker> StubBroker::project(const std::string& app_id) {
+    // Projects outlive their clients, like the service keeps its state.
+    static std::mutex registry_mtx;
+    static std::unordered_map<std::string, std::shared_ptr<StubBroker>> registry;
+    std::lock_guard<std::mutex> lock(registry_mtx);
+    auto& broker = registry[app_id];
+    if (!broker) broker = std::make_shared<StubBroker>();
+    return broker;
+}
+
+void StubBroker::set_latency(uint32_t min_ms, uint32_t max_ms) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    latency_min_ms_ = min_ms;
+    latency_max_ms_ = std::max(min_ms, max_ms);
+}
+
+void StubBroker::set_presence_interval(uint32_t announce_max, uint32_t interval_ms) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    announce_max_ = announce_max ? announce_max : kStubPresenceAnnounceMax;
+    interval_ms_ = interval_ms ? interval_ms : kStubPresenceIntervalMs;
+}
+
+void StubBroker::advance(uint64_t ms) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    offset_ms_ += ms;
+    const uint64_t now = now_locked();
+    pump(now);
+    // Whatever just became due has to be picked up by its client.
+    for (auto& entry : members_) {
+        Member& member = entry.second;
+        if (!member.inbox.empty() && member.inbox.front().due_ms <= now && member.handler) {
+            member.handler->wake();
+        }
+    }
+}
+
+uint64_t StubBroker::now_ms() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return now_locked();
+}
+
+uint64_t StubBroker::wall_ms() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return wall_locked();
+}
+
+bool StubBroker::revoke_lock(const std::string& channel, const std::string& name) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto found = channels_.find(channel);
+    if (found == channels_.end()) return false;
+    auto held = found->second.locks.find(name);
+    if (held == found->second.locks.end() || held->second.owner.empty()) return false;
+    std::string owner = std::move(held->second.owner);
+    held->second.owner.clear();
+    held->second.expires_ms = 0;
+    lock_event(found->second, kStubLockReleased, channel, name, held->second, owner, 0);
+    return true;
+}
+
+StubBroker::Id StubBroker::attach(StubMember* member) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    Id id = next_id_++;
+    members_[id].handler = member;
+    return id;
+}
+
+void StubBroker::detach(Id id) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = members_.find(id);
+    if (it == members_.end()) return;
+    it->second.logged_in = false;
+    leave_all(id, it->second);
+    members_.erase(id);
+}
+
+size_t StubBroker::drain(Id id) {
+    size_t ran = 0;
+    for (;;) {
+        std::function<void()> run;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            const uint64_t now = now_locked();
+            pump(now);
+            auto it = members_.find(id);
+            if (it == members_.end()) break;
+            auto& inbox = it->second.inbox;
+            if (inbox.empty() || inbox.front().due_ms > now) break;
+            run = std::move(inbox.front().run);
+            inbox.pop_front();
+        }
+        // One at a time: a delivery may queue more for this member.
+        run();
+        ++ran;
+    }
+    return ran;
+}
+
+void StubBroker::login(Id id, const std::string& user) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = members_.find(id);
+    if (it == members_.end()) return;
+    if (it->second.logged_in && it->second.user != user) leave_all(id, it->second);
+    it->second.user = user;
+    it->second.logged_in = true;
+    // Back within the TTL: the locks are still ours.
+    for (auto& channel : channels_) {
+        for (auto& entry : channel.second.locks) {
+            if (entry.second.owner == user) entry.second.expires_ms = 0;
+        }
+    }
+}
+
+void StubBroker::logout(Id id) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = members_.find(id);
+    if (it == members_.end() || !it->second.logged_in) return;
+    it->second.logged_in = false;
+    leave_all(id, it->second);
+}
+
+void StubBroker::inject(const std::string& channel_name, const std::string& publisher,
+                        const std::string& payload, const std::string& custom_type,
+                        uint64_t timestamp) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto found = channels_.find(channel_name);
+    if (found == channels_.end()) return;
+    const uint64_t ts = timestamp ? timestamp : wall_locked();
+    for (Id subscriber : found->second.subscribers) {
+        StubMember* handler = members_[subscriber].handler;
+        post(subscriber, [handler, channel_name, publisher, payload, custom_type, ts] {
+            handler->on_message(channel_name, publisher, payload, custom_type, ts);
+        });
+    }
+}
+
+void StubBroker::subscribe(Id id, const std::string& channel_name) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = members_.find(id);
+    if (it == members_.end() || !it->second.logged_in) return;
+    Member& member = it->second;
+    if (std::find(member.channels.begin(), member.channels.end(), channel_name) !=
+        member.channels.end()) {
+        return;
+    }
+    Channel& channel = channels_[channel_name];
+    member.channels.push_back(channel_name);
+    channel.subscribers.push_back(id);
+    if (channel.users[member.user]++ == 0) {
+        announce(channel, channel_name, PresenceDelta::Kind::Join, member.user, id);
+    }
+
+    // The subscriber itself gets the roster and the lock states.
+    const uint64_t ts = wall_locked();
+    PresenceDelta snapshot{PresenceDelta::Kind::Snapshot, channel_name, {}};
+    for (const auto& entry : channel.users) snapshot.users.push_back(entry.first);
+    StubMember* handler = member.handler;
+    post(id, [handler, snapshot, ts] { handler->on_presence(snapshot, ts); });
+    for (const auto& entry : channel.locks) {
+        const std::string name = entry.first;
+        const std::string owner = entry.second.owner;
+        const uint32_t ttl = entry.second.ttl_seconds;
+        post(id, [handler, channel_name, name, owner, ttl, ts] {
+            handler->on_lock_event(kStubLockSnapshot, channel_name, name, owner, ttl, ts);
+        });
+    }
+}
+
+void StubBroker::publish(Id id, const std::string& channel_name, const std::string& payload,
+                         const std::string& custom_type, bool store) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = members_.find(id);
+    if (it == members_.end() || !it->second.logged_in) return;
+    const std::string publisher = it->second.user;
+    uint64_t ts = wall_locked();
+    if (store) {
+        // Distinct timestamps keep history pages from splitting a millisecond.
+        ts = std::max(ts, last_history_ts_ + 1);
+        last_history_ts_ = ts;
+        auto& history = channels_[channel_name].history;
+        history.push_back(StubItem{publisher, payload, -1, ts, publisher});
+        if (history.size() > kStubHistoryCapacity) history.pop_front();
+    }
+    auto found = channels_.find(channel_name);
+    if (found == channels_.end()) return;
+    // The publisher sees its own message through the stub's echo.
+    for (Id subscriber : found->second.subscribers) {
+        if (subscriber == id) continue;
+        StubMember* handler = members_[subscriber].handler;
+        post(subscriber, [handler, channel_name, publisher, payload, custom_type, ts] {
+            handler->on_message(channel_name, publisher, payload, custom_type, ts);
+        });
+    }
+}
+
+bool StubBroker::send_peer(Id id, const std::string& user, const std::string& payload,
+                           const std::string& custom_type) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = members_.find(id);
+    if (it == members_.end() || !it->second.logged_in) return false;
+    const std::string publisher = it->second.user;
+    const uint64_t ts = wall_locked();
+    bool delivered = false;
+    for (auto& entry : members_) {
+        if (!entry.second.logged_in || entry.second.user != user) continue;
+        StubMember* handler = entry.second.handler;
+        // User-channel messages arrive on the publisher's name.
+        post(entry.first, [handler, publisher, payload, custom_type, ts] {
+            handler->on_message(publisher, publisher, payload, custom_type, ts);
+        });
+        delivered = true;
+    }
+    return delivered;
+}
+
+void StubBroker::acquire_lock(Id id, const std::string& channel_name, const std::string& name,
+                              StubDone done) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = members_.find(id);
+    if (it == members_.end()) return;
+    int32_t code = 0;
+    if (!it->second.logged_in) {
+        code = kStubErrorNotLogin;
+    } else {
+        Channel& channel = channels_[channel_name];
+        Lock& target = channel.locks[name];
+        if (target.owner.empty()) {
+            target.owner = it->second.user;
+            target.expires_ms = 0;
+            lock_event(channel, kStubLockAcquired, channel_name, name, target, target.owner, id);
+        } else if (target.owner != it->second.user) {
+            code = kStubErrorLockAcquireFailed;
+        }
+    }
+    post(id, [done, code] { done(code); });
+}
+
+void StubBroker::release_lock(Id id, const std::string& channel_name, const std::string& name,
+                              StubDone done) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = members_.find(id);
+    if (it == members_.end()) return;
+    int32_t code = 0;
+    auto found = channels_.find(channel_name);
+    if (!it->second.logged_in) {
+        code = kStubErrorNotLogin;
+    } else if (found == channels_.end() || !found->second.locks.count(name)) {
+        code = kStubErrorLockNotExist;
+    } else {
+        Lock& target = found->second.locks[name];
+        if (target.owner != it->second.user) {
+            code = kStubErrorLockNotAcquired;
+        } else {
+            target.owner.clear();
+            lock_event(found->second, kStubLockReleased, channel_name, name, target,
+                       it->second.user, id);
+        }
+    }
+    post(id, [done, code] { done(code); });
+}
+
+void StubBroker::update_metadata(Id id, MetadataScope scope, const std::string& target,
+                                 std::vector<StubItem> items, StubDone done) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = members_.find(id);
+    if (it == members_.end()) return;
+    int32_t code = 0;
+    auto& stored = storage_[storage_key(scope, target)];
+    if (!it->second.logged_in) {
+        code = kStubErrorNotLogin;
+    } else {
+        // All or nothing: one stale revision rejects the whole update.
+        for (const auto& item : items) {
+            if (item.revision < 0) continue;
+            auto current = stored.find(item.key);
+            int64_t revision = current == stored.end() ? 0 : current->second.revision;
+            if (revision != item.revision) code = kStubErrorOutdatedRevision;
+        }
+    }
+    if (code == 0) {
+        const uint64_t ts = wall_locked();
+        for (auto& item : items) {
+            StubItem& slot = stored[item.key];
+            slot.key = std::move(item.key);
+            slot.value = std::move(item.value);
+            slot.revision = next_revision_++;
+            slot.timestamp = ts;
+            slot.author = it->second.user;
+        }
+    }
+    post(id, [done, code] { done(code); });
+}
+
+void StubBroker::get_metadata(Id id, MetadataScope scope, const std::string& target,
+                              StubItemsDone done) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::vector<StubItem> items;
+    auto found = storage_.find(storage_key(scope, target));
+    if (found != storage_.end()) {
+        for (const auto& entry : found->second) items.push_back(entry.second);
+    }
+    post(id, [done, items] { done(0, items); });
+}
+
+void StubBroker::get_state(Id id, const std::string& channel_name, const std::string& user,
+                           StubItemsDone done) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto found = channels_.find(channel_name);
+    // Nobody sets presence state through the shim, so present users have none.
+    const bool present = found != channels_.end() && found->second.users.count(user);
+    const int32_t code = present ? 0 : kStubErrorUserNotExist;
+    post(id, [done, code] { done(code, {}); });
+}
+
+void StubBroker::who_now(Id id, const std::string& channel_name, StubItemsDone done) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::vector<StubItem> items;
+    auto found = channels_.find(channel_name);
+    if (found != channels_.end()) {
+        for (const auto& entry : found->second.users) {
+            items.emplace_back();
+            items.back().key = entry.first;
+        }
+    }
+    post(id, [done, items] { done(0, items); });
+}
+
+void StubBroker::where_now(Id id, const std::string& user, StubItemsDone done) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::vector<StubItem> items;
+    for (const auto& entry : channels_) {
+        if (!entry.second.users.count(user)) continue;
+        items.emplace_back();
+        items.back().key = entry.first;
+    }
+    post(id, [done, items] { done(0, items); });
+}
+
+void StubBroker::get_history(Id id, const std::string& channel_name, uint32_t count,
+                             uint64_t start, StubHistoryDone done) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    count = count ? std::min(count, kStubHistoryPageMax) : kStubHistoryPageMax;
+    std::vector<StubItem> items;
+    uint64_t next_start = 0;
+    auto found = channels_.find(channel_name);
+    if (found != channels_.end()) {
+        const auto& history = found->second.history;
+        auto end = start == 0 ? history.end()
+                              : std::lower_bound(history.begin(), history.end(), start,
+                                                 [](const StubItem& item, uint64_t ts) {
+                                                     return item.timestamp < ts;
+                                                 });
+        auto begin = end - std::min<std::ptrdiff_t>(count, end - history.begin());
+        items.assign(begin, end);
+        if (begin != history.begin()) next_start = begin->timestamp;
+    }
+    post(id, [done, items, next_start] { done(0, items, next_start); });
+}
+
+uint64_t StubBroker::now_locked() const {
+    return atem_rtm::now_ms() + offset_ms_;
+}
+
+uint64_t StubBroker::wall_locked() const {
+    return atem_rtm::wall_ms() + offset_ms_;
+}
+
+void StubBroker::post(Id id, std::function<void()> run) {
+    auto it = members_.find(id);
+    if (it == members_.end()) return;
+    Member& member = it->second;
+    uint64_t delay = latency_min_ms_;
+    if (latency_max_ms_ > latency_min_ms_) {
+        delay = std::uniform_int_distribution<uint32_t>(latency_min_ms_, latency_max_ms_)(rng_);
+    }
+    uint64_t due = now_locked() + delay;
+    // One connection per client: deliveries never overtake each other.
+    if (!member.inbox.empty()) due = std::max(due, member.inbox.back().due_ms);
+    member.inbox.push_back(Task{due, std::move(run)});
+    if (member.handler) member.handler->wake();
+}
+
+void StubBroker::pump(uint64_t now) {
+    for (auto& entry : channels_) {
+        const std::string& name = entry.first;
+        Channel& channel = entry.second;
+        for (auto& held : channel.locks) {
+            Lock& lock = held.second;
+            if (lock.expires_ms == 0 || now < lock.expires_ms) continue;
+            std::string owner = std::move(lock.owner);
+            lock.owner.clear();
+            lock.expires_ms = 0;
+            lock_event(channel, kStubLockExpired, name, held.first, lock, owner, 0);
+        }
+        if (channel.interval_due_ms == 0 || now < channel.interval_due_ms) continue;
+        channel.interval_due_ms = 0;
+        const uint64_t ts = wall_locked();
+        PresenceDelta joined{PresenceDelta::Kind::Join, name, std::move(channel.joined)};
+        PresenceDelta left{PresenceDelta::Kind::Leave, name, std::move(channel.left)};
+        channel.joined.clear();
+        channel.left.clear();
+        for (Id subscriber : channel.subscribers) {
+            StubMember* handler = members_[subscriber].handler;
+            post(subscriber, [handler, joined, left, ts] {
+                if (!joined.users.empty()) handler->on_presence(joined, ts);
+                if (!left.users.empty()) handler->on_presence(left, ts);
+            });
+        }
+    }
+}
+
+void StubBroker::announce(Channel& channel, const std::string& name, PresenceDelta::Kind kind,
+                          const std::string& user, Id except) {
+    if (channel.users.size() > announce_max_) {
+        (kind == PresenceDelta::Kind::Join ? channel.joined : channel.left).push_back(user);
+        if (channel.interval_due_ms == 0) channel.interval_due_ms = now_locked() + interval_ms_;
+        return;
+    }
+    const PresenceDelta delta{kind, name, {user}};
+    const uint64_t ts = wall_locked();
+    for (Id subscriber : channel.subscribers) {
+        if (subscriber == except) continue;
+        StubMember* handler = members_[subscriber].handler;
+        post(subscriber, [handler, delta, ts] { handler->on_presence(delta, ts); });
+    }
+}
+
+void StubBroker::lock_event(const Channel& channel, uint32_t type,
+                            const std::string& channel_name, const std::string& lock_name,
+                            const Lock& lock, const std::string& owner, Id except) {
+    const uint64_t ts = wall_locked();
+    const uint32_t ttl = lock.ttl_seconds;
+    for (Id subscriber : channel.subscribers) {
+        if (subscriber == except) continue;
+        StubMember* handler = members_[subscriber].handler;
+        post(subscriber, [handler, type, channel_name, lock_name, owner, ttl, ts] {
+            handler->on_lock_event(type, channel_name, lock_name, owner, ttl, ts);
+        });
+    }
+}
+
+void StubBroker::leave_all(Id id, Member& member) {
+    for (const auto& name : member.channels) {
+        Channel& channel = channels_[name];
+        channel.subscribers.erase(
+            std::remove(channel.subscribers.begin(), channel.subscribers.end(), id),
+            channel.subscribers.end());
+        auto user = channel.users.find(member.user);
+        if (user != channel.users.end() && --user->second == 0) {
+            channel.users.erase(user);
+            announce(channel, name, PresenceDelta::Kind::Leave, member.user, id);
+        }
+    }
+    member.channels.clear();
+    if (member.user.empty() || user_online(member.user)) return;
+    // Locks outlive their owner's session by the TTL.
+    const uint64_t now = now_locked();
+    for (auto& channel : channels_) {
+        for (auto& entry : channel.second.locks) {
+            Lock& lock = entry.second;
+            if (lock.owner == member.user && lock.expires_ms == 0) {
+                lock.expires_ms = now + uint64_t(lock.ttl_seconds) * 1000;
+            }
+        }
+    }
+}
+
+bool StubBroker::user_online(const std::string& user) const {
+    for (const auto& entry : members_) {
+        if (entry.second.logged_in && entry.second.user == user) return true;
+    }
+    return false;
+}
+
+std::string StubBroker::storage_key(MetadataScope scope, const std::string& target) {
+    return (scope == MetadataScope::Channel ? "c:" : "u:") + target;
+}
+
+} // namespace atem_rtm
+
+extern "C" {
+
+int atem_rtm_stub_set_latency(
+    const char* app_id,
+    uint32_t min_ms,
+    uint32_t max_ms) {
+    if (!app_id || max_ms < min_ms) {
+        return -1;
+    }
+    atem_rtm::StubBroker::project(app_id)->set_latency(min_ms, max_ms);
+    return 0;
+}
+
+int atem_rtm_stub_advance_clock(
+    const char* app_id,
+    uint32_t ms) {
+    if (!app_id) {
+        return -1;
+    }
+    atem_rtm::StubBroker::project(app_id)->advance(ms);
+    return 0;
+}
+
+int atem_rtm_stub_set_presence_interval(
+    const char* app_id,
+    uint32_t announce_max,
+    uint32_t interval_ms) {
+    if (!app_id) {
+        return -1;
+    }
+    atem_rtm::StubBroker::project(app_id)->set_presence_interval(announce_max, interval_ms);
+    return 0;
+}
+
+int atem_rtm_stub_revoke_lock(
+    const char* app_id,
+    const char* channel,
+    const char* lock_name) {
+    if (!app_id || !channel || !lock_name) {
+        return -1;
+    }
+    return atem_rtm::StubBroker::project(app_id)->revoke_lock(channel, lock_name)
+               ? ATEM_RTM_OK
+               : ATEM_RTM_ERROR;
+}
+
+int atem_rtm_stub_inject_message(
+    const char* app_id,
+    const char* channel,
+    const char* publisher,
+    const char* payload,
+    const char* custom_type,
+    uint64_t timestamp) {
+    if (!app_id || !channel || !publisher || !payload) {
+        return -1;
+    }
+    atem_rtm::StubBroker::project(app_id)->inject(channel, publisher, payload,
+                                                  custom_type ? custom_type : "", timestamp);
+    return 0;
+}
+
+} // extern "C"
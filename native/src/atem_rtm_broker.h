@@ -0,0 +1,199 @@
+#pragma once
+
+#include "atem_rtm_metadata.h"
+#include "atem_rtm_presence.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace atem_rtm {
+
+// Service defaults the broker emulates.
+constexpr uint32_t kStubLockTtlSeconds = 10;
+constexpr uint32_t kStubPresenceAnnounceMax = 50;
+constexpr uint32_t kStubPresenceIntervalMs = 5000;
+constexpr size_t kStubHistoryCapacity = 1000;
+constexpr uint32_t kStubHistoryPageMax = 100;
+
+// SDK numbering (RTM_LOCK_EVENT_TYPE, RTM_ERROR_CODE), so stub records and
+// result codes match what the real client reports.
+constexpr uint32_t kStubLockSnapshot = 1;
+constexpr uint32_t kStubLockAcquired = 4;
+constexpr uint32_t kStubLockReleased = 5;
+constexpr uint32_t kStubLockExpired = 6;
+constexpr int32_t kStubErrorNotLogin = -10002;
+constexpr int32_t kStubErrorOutdatedRevision = -12014;
+constexpr int32_t kStubErrorUserNotExist = -13011;
+constexpr int32_t kStubErrorLockNotAcquired = -14006;
+constexpr int32_t kStubErrorLockAcquireFailed = -14007;
+constexpr int32_t kStubErrorLockNotExist = -14008;
+
+// A metadata item, a user or channel name (whoNow/whereNow), or a stored
+// message (key = publisher, value = payload).
+struct StubItem {
+    std::string key;
+    std::string value;
+    int64_t revision{-1};  // metadata only; -1 writes unconditionally
+    uint64_t timestamp{0};
+    std::string author;
+};
+
+using StubDone = std::function<void(int32_t code)>;
+using StubItemsDone = std::function<void(int32_t code, std::vector<StubItem> items)>;
+// `next_start` continues with older messages; 0 when there are none.
+using StubHistoryDone =
+    std::function<void(int32_t code, std::vector<StubItem> items, uint64_t next_start)>;
+
+// What a stub client receives from the broker, in the shape of the SDK's
+// event handler. Called from StubBroker::drain on the client's own thread.
+class StubMember {
+public:
+    virtual ~StubMember() = default;
+
+    // Something was queued for this member. Runs under the broker lock, so
+    // it may only signal (e.g. the event notify hook).
+    virtual void wake() = 0;
+
+    // `custom_type` is the publisher's PublishOptions::customType.
+    virtual void on_message(const std::string& channel, const std::string& publisher,
+                            const std::string& payload, const std::string& custom_type,
+                            uint64_t timestamp) = 0;
+    virtual void on_presence(const PresenceDelta& delta, uint64_t timestamp) = 0;
+    virtual void on_lock_event(uint32_t type, const std::string& channel,
+                               const std::string& lock, const std::string& owner,
+                               uint32_t ttl, uint64_t timestamp) = 0;
+};
+
+// In-process stand-in for one RTM project (app id), shared by the stub
+// clients created with it. Requests take effect when they are made; their
+// results and the events they cause are queued per member with the
+// injected latency and run by drain(), keeping each member's deliveries in
+// order. Emulated: channel and peer messages, presence snapshots, joins
+// and leaves with interval batching on crowded channels, locks with
+// owner TTL after logout and revoke, metadata revisions, and paged message
+// history. Clients subscribe without metadata events, as the real client
+// does, so storage changes are only seen by reading.
+// Thread-safe.
+class StubBroker {
+public:
+    using Id = uint64_t;
+
+    static std::shared_ptr<StubBroker> project(const std::string& app_id);
+
+    void set_latency(uint32_t min_ms, uint32_t max_ms);
+    void set_presence_interval(uint32_t announce_max, uint32_t interval_ms);
+    // Virtual clock: monotonic and wall time plus everything advanced.
+    void advance(uint64_t ms);
+    uint64_t now_ms();
+    uint64_t wall_ms();
+    bool revoke_lock(const std::string& channel, const std::string& name);
+    // Fans a message out to the channel's subscribers as from `publisher`.
+    void inject(const std::string& channel, const std::string& publisher,
+                const std::string& payload, const std::string& custom_type,
+                uint64_t timestamp);
+
+    Id attach(StubMember* member);
+    // Logs the member out and drops whatever is still queued for it.
+    void detach(Id id);
+    // Runs the member's due deliveries on the calling thread.
+    size_t drain(Id id);
+
+    void login(Id id, const std::string& user);
+    void logout(Id id);
+    void subscribe(Id id, const std::string& channel);
+
+    void publish(Id id, const std::string& channel, const std::string& payload,
+                 const std::string& custom_type, bool store);
+    // False when no client is logged in as `user`.
+    bool send_peer(Id id, const std::string& user, const std::string& payload,
+                   const std::string& custom_type);
+
+    // Locks are set with kStubLockTtlSeconds on first acquire.
+    void acquire_lock(Id id, const std::string& channel, const std::string& name,
+                      StubDone done);
+    void release_lock(Id id, const std::string& channel, const std::string& name,
+                      StubDone done);
+
+    void update_metadata(Id id, MetadataScope scope, const std::string& target,
+                         std::vector<StubItem> items, StubDone done);
+    void get_metadata(Id id, MetadataScope scope, const std::string& target,
+                      StubItemsDone done);
+
+    void get_state(Id id, const std::string& channel, const std::string& user,
+                   StubItemsDone done);
+    void who_now(Id id, const std::string& channel, StubItemsDone done);
+    void where_now(Id id, const std::string& user, StubItemsDone done);
+    // Up to `count` (at most kStubHistoryPageMax) messages sent before
+    // `start` (0 = now), oldest first.
+    void get_history(Id id, const std::string& channel, uint32_t count, uint64_t start,
+                     StubHistoryDone done);
+
+private:
+    struct Task {
+        uint64_t due_ms;
+        std::function<void()> run;
+    };
+
+    struct Member {
+        StubMember* handler{nullptr};
+        std::string user;
+        bool logged_in{false};
+        std::vector<std::string> channels;
+        std::deque<Task> inbox;
+    };
+
+    struct Lock {
+        std::string owner;
+        uint32_t ttl_seconds{kStubLockTtlSeconds};
+        uint64_t expires_ms{0};  // set while the owner is logged out
+    };
+
+    struct Channel {
+        std::map<std::string, size_t> users;  // user -> members logged in as it
+        std::vector<Id> subscribers;
+        std::map<std::string, Lock> locks;
+        std::deque<StubItem> history;
+        // Interval mode: changes collected until `interval_due_ms`.
+        std::vector<std::string> joined;
+        std::vector<std::string> left;
+        uint64_t interval_due_ms{0};
+    };
+
+    uint64_t now_locked() const;
+    uint64_t wall_locked() const;
+    void post(Id id, std::function<void()> run);
+    void pump(uint64_t now);
+    void announce(Channel& channel, const std::string& name, PresenceDelta::Kind kind,
+                  const std::string& user, Id except);
+    void lock_event(const Channel& channel, uint32_t type, const std::string& channel_name,
+                    const std::string& lock_name, const Lock& lock, const std::string& owner,
+                    Id except);
+    void leave_all(Id id, Member& member);
+    bool user_online(const std::string& user) const;
+    static std::string storage_key(MetadataScope scope, const std::string& target);
+
+    std::mutex mtx_;
+    std::mt19937 rng_{std::random_device{}()};
+    uint32_t latency_min_ms_{0};
+    uint32_t latency_max_ms_{0};
+    uint32_t announce_max_{kStubPresenceAnnounceMax};
+    uint32_t interval_ms_{kStubPresenceIntervalMs};
+    uint64_t offset_ms_{0};
+    Id next_id_{1};
+    int64_t next_revision_{1};
+    uint64_t last_history_ts_{0};
+    std::unordered_map<Id, Member> members_;
+    std::map<std::string, Channel> channels_;
+    std::unordered_map<std::string, std::map<std::string, StubItem>> storage_;
+};
+
+} // namespace atem_rtm
@@ -0,0 +1,116 @@
+#include "atem_rtm_buffer_pool.h"
+
+namespace atem_rtm {
+
+namespace {
+
+constexpr size_t kMaxEarlyResults = 64;
+
+} // namespace
+
+BufferPool::BufferPool(uint32_t count, uint32_t size)
+    : count_(count),
+      size_(size),
+      storage_(new char[static_cast<size_t>(count) * size]),
+      state_(count, State::Free) {
+    free_.reserve(count);
+    // Hand out low ids first; purely cosmetic, but keeps logs readable.
+    for (uint32_t id = count; id > 0; --id) free_.push_back(id - 1);
+    submitted_.reserve(count);
+    spare_.reserve(count);
+}
+
+bool BufferPool::acquire(uint32_t* id) {
+    if (free_.empty()) {
+        ++counters_.exhausted;
+        return false;
+    }
+    *id = free_.back();
+    free_.pop_back();
+    state_[*id] = State::Owned;
+    ++counters_.acquired;
+    return true;
+}
+
+bool BufferPool::release(uint32_t id) {
+    if (!owned(id)) return false;
+    recycle(id);
+    return true;
+}
+
+bool BufferPool::owned(uint32_t id) const {
+    return id < count_ && state_[id] == State::Owned;
+}
+
+void BufferPool::queued(uint32_t id) {
+    if (owned(id)) state_[id] = State::Queued;
+}
+
+void BufferPool::sending(uint32_t id) {
+    if (id >= count_ || (state_[id] != State::Owned && state_[id] != State::Queued)) return;
+    state_[id] = State::Sending;
+    // Results remembered for an earlier send can no longer be claimed.
+    if (sending_++ == 0) early_.clear();
+}
+
+void BufferPool::submitted(uint32_t id, uint64_t request_id) {
+    if (id >= count_ || state_[id] != State::Sending) return;
+    --sending_;
+    ++counters_.submitted;
+    auto early = early_.find(request_id);
+    if (early != early_.end()) {
+        early_.erase(early);
+        recycle(id);
+        ++counters_.recycled;
+        return;
+    }
+    state_[id] = State::Submitted;
+    if (spare_.empty()) {
+        submitted_[request_id] = id;
+        return;
+    }
+    Submitted::node_type node = std::move(spare_.back());
+    spare_.pop_back();
+    node.key() = request_id;
+    node.mapped() = id;
+    submitted_.insert(std::move(node));
+}
+
+void BufferPool::completed(uint64_t request_id) {
+    auto it = submitted_.find(request_id);
+    if (it == submitted_.end()) {
+        // Not a buffer publish, or one that raced ahead of submitted().
+        // Only the latter need remembering, and only while a buffer is
+        // between the SDK and submitted().
+        if (sending_ == 0) return;
+        if (early_.size() >= kMaxEarlyResults) early_.clear();
+        early_[request_id] = true;
+        return;
+    }
+    recycle(it->second);
+    spare_.push_back(submitted_.extract(it));
+    ++counters_.recycled;
+}
+
+void BufferPool::discard(uint32_t id) {
+    if (id >= count_) return;
+    if (state_[id] == State::Sending) {
+        --sending_;
+    } else if (state_[id] != State::Queued) {
+        return;
+    }
+    recycle(id);
+}
+
+void BufferPool::unsent(uint32_t id) {
+    if (id >= count_ || state_[id] != State::Sending) return;
+    --sending_;
+    state_[id] = State::Owned;
+}
+
+void BufferPool::recycle(uint32_t id) {
+    state_[id] = State::Free;
+    free_.push_back(id);
+}
+
+} // namespace atem_rtm
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace atem_rtm {
+
+constexpr uint32_t kDefaultOutboundBufferCount = 32;
+constexpr uint32_t kDefaultOutboundBufferSize = 4096;
+
+// Fixed set of outbound payload buffers carved out of one allocation at
+// creation. The application fills a buffer in place and submits it by id;
+// the buffer stays reserved until the SDK reports the publish result and
+// is then recycled, so steady-state publishing allocates nothing. Between
+// submit and the SDK a buffer may wait in the pacer or for credit; it is
+// the client's then, not the application's.
+// Not thread-safe; the owning client serialises access.
+class BufferPool {
+public:
+    struct Counters {
+        uint64_t acquired{0};
+        uint64_t submitted{0};
+        uint64_t recycled{0};
+        uint64_t exhausted{0};  // acquire calls that found no free buffer
+    };
+
+    BufferPool(uint32_t count, uint32_t size);
+
+    // Hands a free buffer to the application. False when all are in use.
+    bool acquire(uint32_t* id);
+
+    // Application gives an unsubmitted buffer back.
+    bool release(uint32_t id);
+
+    // True if `id` is currently held by the application (not free, queued
+    // or submitted); only such buffers may be submitted or released.
+    bool owned(uint32_t id) const;
+
+    // The application submitted `id` and the client holds it for a later
+    // send (pacing or credit).
+    void queued(uint32_t id);
+    // `id` is about to go to the SDK; submitted() follows once the request
+    // id is known. Results seen meanwhile may be this buffer's.
+    void sending(uint32_t id);
+    // The buffer went to the SDK under `request_id`; it is recycled by
+    // completed(). A result that raced ahead of this call recycles it now.
+    void submitted(uint32_t id, uint64_t request_id);
+    void completed(uint64_t request_id);
+    // The client dropped a queued or sending buffer, or copied it out.
+    void discard(uint32_t id);
+    // The SDK refused a sending buffer; the application owns it again.
+    void unsent(uint32_t id);
+
+    char* data(uint32_t id) { return storage_.get() + static_cast<size_t>(id) * size_; }
+    uint32_t size() const { return size_; }
+    size_t in_use() const { return count_ - free_.size(); }
+    const Counters& counters() const { return counters_; }
+
+private:
+    enum class State : uint8_t { Free, Owned, Queued, Sending, Submitted };
+    using Submitted = std::unordered_map<uint64_t, uint32_t>;
+
+    void recycle(uint32_t id);
+
+    uint32_t count_;
+    uint32_t size_;
+    std::unique_ptr<char[]> storage_;
+    std::vector<State> state_;
+    std::vector<uint32_t> free_;
+    Submitted submitted_;
+    std::vector<Submitted::node_type> spare_;  // reused map nodes
+    size_t sending_{0};
+    std::unordered_map<uint64_t, bool> early_;
+    Counters counters_;
+};
+
+} // namespace atem_rtm
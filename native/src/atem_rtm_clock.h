@@ -0,0 +1,23 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace atem_rtm {
+
+// Monotonic milliseconds used for every TTL / window computation in the shim.
+inline uint64_t now_ms() {
+    using namespace std::chrono;
+    return static_cast<uint64_t>(
+        duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+// Wall-clock milliseconds since the Unix epoch, comparable with RTM server
+// timestamps (e.g. MetadataItem::updateTs).
+inline uint64_t wall_ms() {
+    using namespace std::chrono;
+    return static_cast<uint64_t>(
+        duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count());
+}
+
+} // namespace atem_rtm
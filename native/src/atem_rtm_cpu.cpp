@@ -0,0 +1,49 @@
+#include "atem_rtm_cpu.h"
+
+#include <time.h>
+
+namespace atem_rtm {
+
+uint64_t thread_cpu_ns() {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+        return 0;
+    }
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+#else
+    return 0;
+#endif
+}
+
+void CpuMeter::record(CpuSlot slot, uint64_t ns, uint64_t calls) {
+    Totals& totals = slots_[static_cast<size_t>(slot)];
+    totals.calls.fetch_add(calls, std::memory_order_relaxed);
+    totals.ns_total.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t max = totals.ns_max.load(std::memory_order_relaxed);
+    while (ns > max &&
+           !totals.ns_max.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+}
+
+CpuMeter::Slot CpuMeter::slot(CpuSlot slot) const {
+    const Totals& totals = slots_[static_cast<size_t>(slot)];
+    Slot out;
+    out.calls = totals.calls.load(std::memory_order_relaxed);
+    out.ns_total = totals.ns_total.load(std::memory_order_relaxed);
+    out.ns_max = totals.ns_max.load(std::memory_order_relaxed);
+    return out;
+}
+
+CpuMeter::Slot CpuMeter::callbacks() const {
+    Slot out;
+    for (size_t i = static_cast<size_t>(CpuSlot::Message); i < kCpuSlotCount; ++i) {
+        Slot one = slot(static_cast<CpuSlot>(i));
+        out.calls += one.calls;
+        out.ns_total += one.ns_total;
+        if (one.ns_max > out.ns_max) out.ns_max = one.ns_max;
+    }
+    return out;
+}
+
+} // namespace atem_rtm
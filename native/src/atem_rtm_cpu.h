@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace atem_rtm {
+
+// CPU time consumed by the calling thread so far, in nanoseconds
+// (CLOCK_THREAD_CPUTIME_ID; 0 where the platform lacks it).
+uint64_t thread_cpu_ns();
+
+// What a span of thread CPU time is attributed to. Callback slots share
+// their numbering with AtemRtmEventKind, by the event kind the callback
+// reports; slot 0 is the shim's own dispatch work (tick).
+enum class CpuSlot : size_t {
+    Dispatch = 0,
+    Message = 1,
+    Presence = 2,
+    Topic = 3,
+    Lock = 4,
+    Storage = 5,
+    LinkState = 6,
+    Result = 7,
+    TokenWillExpire = 8,
+};
+
+constexpr size_t kCpuSlotCount = 9;
+
+// Running per-slot totals of thread CPU time. SDK callbacks record from
+// the SDK's threads while stats are read from the application's, so every
+// counter is atomic.
+// Thread-safe.
+class CpuMeter {
+public:
+    struct Slot {
+        uint64_t calls{0};
+        uint64_t ns_total{0};
+        uint64_t ns_max{0};  // longest single span
+    };
+
+    // `calls` is 0 for work continued elsewhere (e.g. on the dispatcher)
+    // that an earlier record already counted.
+    void record(CpuSlot slot, uint64_t ns, uint64_t calls = 1);
+    Slot slot(CpuSlot slot) const;
+    // Every callback slot together (all but Dispatch).
+    Slot callbacks() const;
+
+private:
+    struct Totals {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> ns_total{0};
+        std::atomic<uint64_t> ns_max{0};
+    };
+
+    std::array<Totals, kCpuSlotCount> slots_;
+};
+
+// Charges the thread CPU time between construction and destruction to
+// `slot`; put one at the top of a callback.
+class CpuScope {
+public:
+    CpuScope(CpuMeter& meter, CpuSlot slot, uint64_t calls = 1)
+        : meter_(meter), slot_(slot), calls_(calls), start_ns_(thread_cpu_ns()) {}
+    ~CpuScope() {
+        const uint64_t end_ns = thread_cpu_ns();
+        meter_.record(slot_, end_ns > start_ns_ ? end_ns - start_ns_ : 0, calls_);
+    }
+
+    CpuScope(const CpuScope&) = delete;
+    CpuScope& operator=(const CpuScope&) = delete;
+
+private:
+    CpuMeter& meter_;
+    CpuSlot slot_;
+    uint64_t calls_;
+    uint64_t start_ns_;
+};
+
+} // namespace atem_rtm
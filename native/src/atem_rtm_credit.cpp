@@ -0,0 +1,226 @@
+#include "atem_rtm_credit.h"
+
+#include "atem_rtm_history.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace atem_rtm {
+
+namespace {
+
+// Unpolled stamps remembered per stream. The event queue drops its oldest
+// entries when full, so past this the oldest count as consumed.
+constexpr size_t kPendingWindows = 4;
+
+std::string stream_key(const std::string& publisher, const std::string& channel) {
+    std::string key = publisher;
+    key += '\x1f';
+    key += channel;
+    return key;
+}
+
+} // namespace
+
+void format_credit_grant(char* buf, uint32_t epoch, uint64_t limit) {
+    snprintf(buf, kSenderStampMax, "cr:%08x:%llx", epoch, (unsigned long long)limit);
+}
+
+CreditGrant parse_credit_grant(const char* custom_type) {
+    CreditGrant grant;
+    if (!custom_type || strncmp(custom_type, "cr:", 3) != 0) {
+        return grant;
+    }
+    char* end = nullptr;
+    unsigned long epoch = strtoul(custom_type + 3, &end, 16);
+    if (!end || *end != ':') {
+        return grant;
+    }
+    const char* limit_start = end + 1;
+    unsigned long long limit = strtoull(limit_start, &end, 16);
+    if (end == limit_start || *end != '\0') {
+        return grant;
+    }
+    grant.valid = true;
+    grant.epoch = static_cast<uint32_t>(epoch);
+    grant.limit = limit;
+    return grant;
+}
+
+CreditGranter::CreditGranter(uint32_t window, uint32_t refresh_ms)
+    : window_(window), refresh_ms_(refresh_ms ? refresh_ms : kDefaultCreditRefreshMs) {}
+
+void CreditGranter::delivered(const std::string& publisher, const std::string& channel,
+                              const std::string& self, const SenderStamp& stamp,
+                              uint64_t now_ms) {
+    if (!enabled() || !stamp.valid) return;
+    Stream& stream = streams_[stream_key(publisher, channel)];
+    if (stream.publisher.empty() || stream.epoch != stamp.epoch) {
+        // First sight, or the publisher restarted.
+        stream = Stream{};
+        stream.publisher = publisher;
+        stream.destination = channel == publisher ? self : channel;
+        stream.epoch = stamp.epoch;
+        stream.next_unconsumed = stamp.seq;
+    }
+    stream.pending.push_back(stamp.seq);
+    stream.active_ms = now_ms;
+    if (stream.pending.size() > kPendingWindows * window_) {
+        stream.next_unconsumed = std::max(stream.next_unconsumed, stream.pending.front() + 1);
+        stream.pending.pop_front();
+    }
+}
+
+void CreditGranter::consumed(const std::string& publisher, const std::string& channel) {
+    auto found = streams_.find(stream_key(publisher, channel));
+    if (found == streams_.end() || found->second.pending.empty()) return;
+    Stream& stream = found->second;
+    stream.next_unconsumed = std::max(stream.next_unconsumed, stream.pending.front() + 1);
+    stream.pending.pop_front();
+}
+
+void CreditGranter::take_grants(uint64_t now_ms, std::vector<Grant>& out) {
+    const uint64_t step = std::max<uint64_t>(window_ / 2, 1);
+    for (auto it = streams_.begin(); it != streams_.end();) {
+        Stream& stream = it->second;
+        if (stream.pending.empty() &&
+            now_ms - stream.active_ms >= refresh_ms_ * kCreditExpiryRefreshes) {
+            it = streams_.erase(it);
+            continue;
+        }
+        const uint64_t limit = stream.next_unconsumed + window_;
+        const bool moved = stream.granted == 0 || limit >= stream.granted + step;
+        if (moved || now_ms - stream.granted_ms >= refresh_ms_) {
+            stream.granted = limit;
+            stream.granted_ms = now_ms;
+            out.push_back(Grant{stream.publisher, stream.destination, stream.epoch, limit});
+            ++counters_.grants;
+        }
+        ++it;
+    }
+}
+
+uint64_t CreditGranter::next_due() const {
+    const uint64_t step = std::max<uint64_t>(window_ / 2, 1);
+    uint64_t next = UINT64_MAX;
+    for (const auto& entry : streams_) {
+        const Stream& stream = entry.second;
+        const uint64_t limit = stream.next_unconsumed + window_;
+        if (stream.granted == 0 || limit >= stream.granted + step) return 0;
+        next = std::min(next, stream.granted_ms + refresh_ms_);
+        if (stream.pending.empty()) {
+            next = std::min(next, stream.active_ms + refresh_ms_ * kCreditExpiryRefreshes);
+        }
+    }
+    return next;
+}
+
+CreditGate::CreditGate(uint32_t refresh_ms, uint32_t hold_max)
+    : expiry_ms_(static_cast<uint64_t>(refresh_ms ? refresh_ms : kDefaultCreditRefreshMs) *
+                 kCreditExpiryRefreshes),
+      hold_max_(hold_max ? hold_max : kDefaultCreditHoldMax) {}
+
+void CreditGate::grant(const std::string& granter, const std::string& destination,
+                       const CreditGrant& grant, uint64_t now_ms) {
+    // Grants for an earlier incarnation of this client are meaningless.
+    if (!grant.valid || grant.epoch != epoch_) return;
+    Limit& limit = limits_[destination][granter];
+    limit.limit = std::max(limit.limit, grant.limit);
+    limit.updated_ms = now_ms;
+    ++counters_.grants;
+}
+
+bool CreditGate::allows(const std::string& destination, uint64_t seq, uint64_t now_ms) {
+    if (held_.count(destination)) return false;
+    return covered(destination, seq, now_ms);
+}
+
+bool CreditGate::hold(const std::string& destination, OutboundMessage&& msg,
+                      const std::string& message_class) {
+    auto found = held_.find(destination);
+    const bool coalescable = msg.buffer_id == kNoOutboundBuffer &&
+                             !partial_base(message_class).empty();
+    if (coalescable && found != held_.end() &&
+        found->second.back().message_class == message_class &&
+        found->second.back().msg.buffer_id == kNoOutboundBuffer) {
+        found->second.back().msg.payload = std::move(msg.payload);
+        ++counters_.coalesced;
+        return true;
+    }
+    if (depth_ >= hold_max_) {
+        ++counters_.refused;
+        return false;
+    }
+    held_[destination].push_back(Held{std::move(msg), message_class});
+    ++depth_;
+    ++counters_.held;
+    return true;
+}
+
+bool CreditGate::refuses(const std::string& destination, uint64_t seq, uint64_t now_ms) {
+    return depth_ >= hold_max_ && !allows(destination, seq, now_ms);
+}
+
+void CreditGate::take_ready(const std::string& destination, uint64_t next_seq, uint64_t now_ms,
+                            std::vector<OutboundMessage>& out) {
+    auto found = held_.find(destination);
+    if (found == held_.end()) return;
+    auto& queue = found->second;
+    while (!queue.empty() && covered(destination, next_seq, now_ms)) {
+        out.push_back(std::move(queue.front().msg));
+        queue.pop_front();
+        --depth_;
+        ++next_seq;
+    }
+    if (queue.empty()) held_.erase(found);
+}
+
+std::vector<std::string> CreditGate::waiting() const {
+    std::vector<std::string> destinations;
+    destinations.reserve(held_.size());
+    for (const auto& entry : held_) destinations.push_back(entry.first);
+    return destinations;
+}
+
+void CreditGate::take_all(std::vector<OutboundMessage>& out) {
+    for (auto& entry : held_) {
+        for (auto& held : entry.second) out.push_back(std::move(held.msg));
+    }
+    held_.clear();
+    depth_ = 0;
+}
+
+uint64_t CreditGate::next_expiry() const {
+    uint64_t next = UINT64_MAX;
+    for (const auto& held : held_) {
+        auto found = limits_.find(held.first);
+        if (found == limits_.end()) continue;
+        for (const auto& granter : found->second) {
+            next = std::min(next, granter.second.updated_ms + expiry_ms_);
+        }
+    }
+    return next;
+}
+
+bool CreditGate::covered(const std::string& destination, uint64_t seq, uint64_t now_ms) {
+    auto found = limits_.find(destination);
+    if (found == limits_.end()) return true;
+    auto& granters = found->second;
+    bool ok = true;
+    for (auto it = granters.begin(); it != granters.end();) {
+        if (now_ms - it->second.updated_ms >= expiry_ms_) {
+            it = granters.erase(it);
+            continue;
+        }
+        if (seq >= it->second.limit) ok = false;
+        ++it;
+    }
+    if (granters.empty()) limits_.erase(found);
+    return ok;
+}
+
+} // namespace atem_rtm
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "atem_rtm_outbound.h"
+#include "atem_rtm_reorder.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace atem_rtm {
+
+constexpr uint32_t kDefaultCreditRefreshMs = 1000;
+constexpr uint32_t kDefaultCreditHoldMax = 1024;
+// A grant not refreshed for this many refresh periods stops limiting the
+// sender (the receiver is gone); a stream idle that long is forgotten.
+constexpr uint32_t kCreditExpiryRefreshes = 5;
+
+// Credit grant carried in PublishOptions::customType of a peer message
+// from a receiver to a publisher: "cr:<epoch hex>:<limit hex>". The payload
+// is the destination the grant covers (the channel, or the receiver's own
+// user id for peer messages). The publisher may send stamps of that epoch
+// below `limit` there. Grants are cumulative, so a lost or repeated one
+// does no harm. Fits kSenderStampMax.
+struct CreditGrant {
+    bool valid{false};
+    uint32_t epoch{0};
+    uint64_t limit{0};
+};
+
+void format_credit_grant(char* buf, uint32_t epoch, uint64_t limit);
+CreditGrant parse_credit_grant(const char* custom_type);
+
+// Receiver side: turns what the application has polled from each stamped
+// publisher into grants of `window` messages beyond it. A grant goes out
+// when the limit has moved by half a window, and is repeated every
+// `refresh_ms` while the publisher is active or has messages unpolled.
+// Not thread-safe; the owning client serialises access.
+class CreditGranter {
+public:
+    struct Grant {
+        std::string publisher;
+        std::string destination;
+        uint32_t epoch;
+        uint64_t limit;
+    };
+
+    struct Counters {
+        uint64_t grants{0};
+    };
+
+    // window 0 grants nothing; refresh_ms 0 picks the default.
+    CreditGranter(uint32_t window, uint32_t refresh_ms);
+
+    bool enabled() const { return window_ > 0; }
+
+    // A live message was queued for the application. Peer messages arrive
+    // on the publisher's name and are granted for `self`.
+    void delivered(const std::string& publisher, const std::string& channel,
+                   const std::string& self, const SenderStamp& stamp, uint64_t now_ms);
+    // The application polled the oldest message queued from `publisher`
+    // on `channel`, or the event queue dropped it.
+    void consumed(const std::string& publisher, const std::string& channel);
+
+    void take_grants(uint64_t now_ms, std::vector<Grant>& out);
+    // When take_grants() next has a grant to send or a stream to forget;
+    // UINT64_MAX when there are no streams.
+    uint64_t next_due() const;
+
+    const Counters& counters() const { return counters_; }
+
+private:
+    struct Stream {
+        std::string publisher;
+        std::string destination;
+        uint32_t epoch{0};
+        uint64_t next_unconsumed{0};
+        std::deque<uint64_t> pending;  // stamps queued, oldest first
+        uint64_t granted{0};           // 0 = nothing granted this epoch
+        uint64_t granted_ms{0};
+        uint64_t active_ms{0};
+    };
+
+    uint64_t window_;
+    uint64_t refresh_ms_;
+    std::unordered_map<std::string, Stream> streams_;
+    Counters counters_;
+};
+
+// Sender side: the grants remote receivers sent us and the messages held
+// for lack of credit. A destination nobody has granted is not limited. A
+// held ".partial" message is replaced by the next one of its class when
+// nothing was queued behind it, so a stalled receiver gets the latest
+// partial instead of every one. At most `hold_max` messages are held in
+// all; past that hold() refuses.
+// Not thread-safe; the owning client serialises access.
+class CreditGate {
+public:
+    struct Counters {
+        uint64_t grants{0};      // grants received
+        uint64_t held{0};        // messages that had to wait for credit
+        uint64_t coalesced{0};   // held partials replaced by a newer one
+        uint64_t refused{0};     // not held because hold_max were held
+    };
+
+    // refresh_ms 0 picks the default; grants expire after
+    // kCreditExpiryRefreshes of it. hold_max 0 picks kDefaultCreditHoldMax.
+    CreditGate(uint32_t refresh_ms, uint32_t hold_max);
+
+    void set_epoch(uint32_t epoch) { epoch_ = epoch; }
+
+    void grant(const std::string& granter, const std::string& destination,
+               const CreditGrant& grant, uint64_t now_ms);
+
+    // Whether a message stamped `seq` may go to `destination` now, given
+    // what is held for it already.
+    bool allows(const std::string& destination, uint64_t seq, uint64_t now_ms);
+
+    // False, leaving `msg` alone, when full and it could not replace a
+    // held partial.
+    bool hold(const std::string& destination, OutboundMessage&& msg,
+              const std::string& message_class);
+    // Whether a send to `destination` now would have to be held and
+    // cannot be: the caller should push back instead of queueing it.
+    bool refuses(const std::string& destination, uint64_t seq, uint64_t now_ms);
+
+    // Held messages the credit now covers, in order; `next_seq` is the
+    // stamp the first of them will get.
+    void take_ready(const std::string& destination, uint64_t next_seq, uint64_t now_ms,
+                    std::vector<OutboundMessage>& out);
+    // Every destination with messages held.
+    std::vector<std::string> waiting() const;
+    // Everything, regardless of credit (shutdown).
+    void take_all(std::vector<OutboundMessage>& out);
+    // When a grant limiting a held destination expires, which lets its
+    // messages go; UINT64_MAX when nothing is held.
+    uint64_t next_expiry() const;
+
+    size_t depth() const { return depth_; }
+    const Counters& counters() const { return counters_; }
+    void count_refused() { ++counters_.refused; }
+
+private:
+    struct Limit {
+        uint64_t limit{0};
+        uint64_t updated_ms{0};
+    };
+
+    struct Held {
+        OutboundMessage msg;
+        std::string message_class;
+    };
+
+    bool covered(const std::string& destination, uint64_t seq, uint64_t now_ms);
+
+    uint64_t expiry_ms_;
+    size_t hold_max_;
+    uint32_t epoch_{0};
+    // destination -> granter -> limit
+    std::unordered_map<std::string, std::map<std::string, Limit>> limits_;
+    std::map<std::string, std::deque<Held>> held_;
+    size_t depth_{0};
+    Counters counters_;
+};
+
+} // namespace atem_rtm
@@ -0,0 +1,158 @@
+#include "atem_rtm_dispatcher.h"
+
+#include "atem_rtm_clock.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace atem_rtm {
+
+Dispatcher::Dispatcher(Options options) : options_(std::move(options)), timers_(now_ms()) {
+    thread_ = std::thread([this] { run(); });
+}
+
+Dispatcher::~Dispatcher() {
+    stop();
+}
+
+bool Dispatcher::post(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (stopping_) {
+            return false;
+        }
+        queue_.push_back(Queued{now_ms(), std::move(task)});
+        counters_.max_depth = std::max<uint64_t>(counters_.max_depth, queue_.size());
+    }
+    cv_.notify_one();
+    return true;
+}
+
+TimerId Dispatcher::schedule(uint64_t delay_ms, Task task, uint32_t slack_ms) {
+    TimerId id;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (stopping_) {
+            return kNoTimer;
+        }
+        id = timers_.schedule(now_ms() + delay_ms, std::move(task), slack_ms);
+    }
+    // The thread may be asleep until a later deadline.
+    cv_.notify_one();
+    return id;
+}
+
+bool Dispatcher::cancel(TimerId id) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return timers_.cancel(id);
+}
+
+void Dispatcher::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stopping_ = true;
+        queue_.clear();
+    }
+    cv_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+Dispatcher::Counters Dispatcher::counters() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    Counters counters = counters_;
+    counters.timers = timers_.counters().fired;
+    counters.timers_pending = timers_.size();
+    return counters;
+}
+
+void Dispatcher::run() {
+    configure_thread();
+    std::vector<Task> due;
+    for (;;) {
+        Queued next{0, nullptr};
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            uint64_t now = now_ms();
+            for (;;) {
+                if (stopping_) {
+                    return;
+                }
+                if (!queue_.empty()) break;
+                const uint64_t wakeup = timers_.next_wakeup();
+                if (wakeup <= now) break;
+                if (wakeup == UINT64_MAX) {
+                    cv_.wait(lock);
+                } else {
+                    cv_.wait_for(lock, std::chrono::milliseconds(wakeup - now));
+                }
+                ++counters_.wakeups;
+                now = now_ms();
+            }
+            if (!queue_.empty()) {
+                next = std::move(queue_.front());
+                queue_.pop_front();
+                ++counters_.tasks;
+                counters_.lag_ms_max =
+                    std::max(counters_.lag_ms_max, now > next.posted_ms ? now - next.posted_ms : 0);
+            }
+            timers_.advance(now, due);
+        }
+        if (next.task) {
+            next.task();
+        }
+        for (auto& task : due) {
+            task();
+        }
+        due.clear();
+    }
+}
+
+void Dispatcher::configure_thread() {
+    const std::string name = options_.name.empty() ? kDefaultDispatcherName
+                                                   : options_.name.substr(0, 15);
+#if defined(__APPLE__)
+    pthread_setname_np(name.c_str());
+#elif defined(__linux__)
+    pthread_setname_np(pthread_self(), name.c_str());
+#endif
+
+#if defined(__linux__)
+    if (options_.cpu_mask) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu = 0; cpu < 64; ++cpu) {
+            if (options_.cpu_mask & (uint64_t(1) << cpu)) CPU_SET(cpu, &set);
+        }
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (rc != 0) {
+            fprintf(stderr, "[atem_rtm] dispatcher: cannot pin to mask 0x%llx: %s\n",
+                    (unsigned long long)options_.cpu_mask, strerror(rc));
+        }
+    }
+#else
+    if (options_.cpu_mask) {
+        fprintf(stderr, "[atem_rtm] dispatcher: CPU pinning is not supported here\n");
+    }
+#endif
+
+    if (options_.priority) {
+        sched_param param{};
+        param.sched_priority = static_cast<int>(options_.priority);
+        int rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (rc != 0) {
+            fprintf(stderr, "[atem_rtm] dispatcher: cannot set SCHED_FIFO priority %u: %s\n",
+                    options_.priority, strerror(rc));
+        }
+    }
+}
+
+} // namespace atem_rtm
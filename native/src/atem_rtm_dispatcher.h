@@ -0,0 +1,86 @@
+#pragma once
+
+#include "atem_rtm_timers.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace atem_rtm {
+
+constexpr const char* kDefaultDispatcherName = "atem-rtm-disp";
+
+// One shim-owned thread that runs posted tasks in order, and timers from a
+// TimerWheel in between. There is no periodic tick: the thread sleeps
+// until the next task or timer, never polling. SDK callbacks post
+// their events here so filtering and the user callbacks they lead to stay
+// off the SDK's networking threads.
+// The thread is named, and optionally pinned and given SCHED_FIFO
+// priority; settings the OS refuses are logged and skipped.
+// Thread-safe.
+class Dispatcher {
+public:
+    using Task = std::function<void()>;
+
+    struct Options {
+        std::string name{kDefaultDispatcherName};  // at most 15 chars are kept
+        uint64_t cpu_mask{0};                      // bit n = CPU n; 0 = any
+        uint32_t priority{0};                      // SCHED_FIFO 1-99; 0 = normal
+    };
+
+    struct Counters {
+        uint64_t tasks{0};        // run so far
+        uint64_t max_depth{0};    // most tasks waiting at once
+        uint64_t lag_ms_max{0};   // longest a task waited to run
+        uint64_t timers{0};       // timers run so far
+        uint64_t timers_pending{0};
+        uint64_t wakeups{0};      // times the thread woke up
+    };
+
+    explicit Dispatcher(Options options);
+    ~Dispatcher();
+
+    Dispatcher(const Dispatcher&) = delete;
+    Dispatcher& operator=(const Dispatcher&) = delete;
+
+    // False once stopped; the task is dropped.
+    bool post(Task task);
+
+    // Runs `task` on the thread after `delay_ms` (up to `slack_ms` later,
+    // to share a wakeup). kNoTimer once stopped.
+    TimerId schedule(uint64_t delay_ms, Task task, uint32_t slack_ms = 0);
+    // False when the timer already ran or was cancelled.
+    bool cancel(TimerId id);
+
+    // Joins the thread; tasks still queued are dropped. Must not be called
+    // from a task.
+    void stop();
+
+    bool on_thread() const { return std::this_thread::get_id() == thread_.get_id(); }
+    Counters counters() const;
+
+private:
+    struct Queued {
+        uint64_t posted_ms;
+        Task task;
+    };
+
+    void run();
+    void configure_thread();
+
+    const Options options_;
+    mutable std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<Queued> queue_;
+    TimerWheel timers_;
+    bool stopping_{false};
+    Counters counters_;
+    std::thread thread_;
+};
+
+} // namespace atem_rtm
@@ -0,0 +1,197 @@
+#include "atem_rtm_events.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace atem_rtm {
+
+namespace {
+
+constexpr uint32_t kHasUser = 1u << 0;
+constexpr uint32_t kHasName = 1u << 1;
+constexpr uint32_t kHasPayload = 1u << 2;
+
+size_t packed_size(const EventSlotHeader& head) {
+    return size_t{head.channel_len} + 1 + head.user_len + 1 + head.name_len + 1 +
+           head.payload_len;
+}
+
+char* pack(char* out, std::string_view value, bool terminate) {
+    if (!value.empty()) std::memcpy(out, value.data(), value.size());
+    out += value.size();
+    if (terminate) *out++ = '\0';
+    return out;
+}
+
+} // namespace
+
+EventQueue::EventQueue(size_t capacity, uint32_t fair_quantum_bytes,
+                       uint32_t fair_publisher_max_bytes)
+    : capacity_(capacity ? capacity : 1),
+      chunks_((capacity_ + kEventSlotsPerChunk - 1) / kEventSlotsPerChunk),
+      fair_(fair_quantum_bytes, fair_publisher_max_bytes, capacity_) {}
+
+bool EventQueue::push(const EventRecord& record) {
+    EventSlotHeader head;
+    head.kind = record.kind;
+    head.subtype = record.subtype;
+    head.code = record.code;
+    head.aux = record.aux;
+    head.request_id = record.request_id;
+    head.timestamp = record.timestamp;
+    head.flags = (record.has_user ? kHasUser : 0) | (record.has_name ? kHasName : 0) |
+                 (record.has_payload ? kHasPayload : 0);
+    ++counters_.queued;
+    return store(head, record.channel, record.user, record.name, record.payload);
+}
+
+bool EventQueue::push_message(uint64_t timestamp, uint32_t subtype, std::string_view channel,
+                              std::string_view publisher, std::string_view payload) {
+    ++counters_.queued;
+    if (fair_.enabled()) {
+        const bool was_empty = depth() == 0;
+        fair_.push(timestamp, subtype, channel, publisher, payload);
+        return was_empty;
+    }
+    EventSlotHeader head;
+    head.kind = ATEM_RTM_EVENT_MESSAGE;
+    head.subtype = subtype;
+    head.timestamp = timestamp;
+    head.flags = kHasUser | kHasPayload;
+    return store(head, channel, publisher, {}, payload);
+}
+
+bool EventQueue::store(const EventSlotHeader& head, std::string_view channel,
+                       std::string_view user, std::string_view name, std::string_view payload) {
+    const bool was_empty = depth() == 0;
+    if (count_ >= capacity_) {
+        const EventSlot& oldest = at(head_);
+        if (track_discards_ && oldest.head.kind == ATEM_RTM_EVENT_MESSAGE &&
+            oldest.head.subtype == ATEM_RTM_MESSAGE_LIVE) {
+            const char* channel = bytes(oldest);
+            const char* user = channel + oldest.head.channel_len + 1;
+            discarded_.push_back(DiscardedMessage{std::string(user, oldest.head.user_len),
+                                                  std::string(channel, oldest.head.channel_len)});
+        }
+        release(at(head_));
+        head_ = (head_ + 1) % capacity_;
+        --count_;
+        ++counters_.dropped;
+    }
+
+    EventSlot& slot = at((head_ + count_) % capacity_);
+    slot.head = head;
+    slot.head.channel_len = static_cast<uint32_t>(channel.size());
+    slot.head.user_len = static_cast<uint32_t>(user.size());
+    slot.head.name_len = static_cast<uint32_t>(name.size());
+    slot.head.payload_len = static_cast<uint32_t>(payload.size());
+    slot.head.spill = kNoSpill;
+
+    const size_t size = packed_size(slot.head);
+    char* out = slot.data;
+    if (size > sizeof(slot.data)) {
+        if (spill_free_.empty()) {
+            spill_.emplace_back();
+            slot.head.spill = static_cast<uint32_t>(spill_.size() - 1);
+        } else {
+            slot.head.spill = spill_free_.back();
+            spill_free_.pop_back();
+        }
+        std::string& buffer = spill_[slot.head.spill];
+        buffer.resize(size);
+        out = &buffer[0];
+        ++counters_.spilled;
+    }
+    out = pack(out, channel, true);
+    out = pack(out, user, true);
+    out = pack(out, name, true);
+    pack(out, payload, false);
+
+    ++count_;
+    return was_empty;
+}
+
+size_t EventQueue::poll(AtemRtmEvent* out, size_t max) {
+    for (size_t i = 0; i < polled_count_; ++i) release(polled_[i]);
+    if (!fair_.empty()) schedule(max);
+    polled_count_ = std::min(max, count_);
+    if (polled_.size() < polled_count_) polled_.resize(polled_count_);
+    for (size_t i = 0; i < polled_count_; ++i) {
+        EventSlot& slot = at(head_);
+        EventSlot& copy = polled_[i];
+        copy.head = slot.head;
+        // Only the bytes in use; spilled slots keep their buffer.
+        if (slot.head.spill == kNoSpill) std::memcpy(copy.data, slot.data, packed_size(slot.head));
+        head_ = (head_ + 1) % capacity_;
+        --count_;
+    }
+    // Pointers are taken only after polled_ has stopped growing.
+    for (size_t i = 0; i < polled_count_; ++i) {
+        const EventSlotHeader& head = polled_[i].head;
+        const char* channel = bytes(polled_[i]);
+        const char* user = channel + head.channel_len + 1;
+        const char* name = user + head.user_len + 1;
+        const char* payload = name + head.name_len + 1;
+        AtemRtmEvent& event = out[i];
+        event.kind = head.kind;
+        event.subtype = head.subtype;
+        event.code = head.code;
+        event.aux = head.aux;
+        event.request_id = head.request_id;
+        event.timestamp = head.timestamp;
+        event.channel = channel;
+        event.user = head.flags & kHasUser ? user : nullptr;
+        event.name = head.flags & kHasName ? name : nullptr;
+        event.payload = head.flags & kHasPayload ? payload : nullptr;
+        event.payload_len = head.flags & kHasPayload ? head.payload_len : 0;
+    }
+    counters_.polled += polled_count_;
+    return polled_count_;
+}
+
+void EventQueue::track_discards(bool on) {
+    track_discards_ = on;
+    fair_.track_discards(on);
+}
+
+void EventQueue::take_discarded(std::vector<DiscardedMessage>& out) {
+    fair_.take_discarded(out);
+    for (auto& msg : discarded_) out.push_back(std::move(msg));
+    discarded_.clear();
+}
+
+// Tops the ring up to `max` from the fair scheduler, never past capacity
+// (which would drop the oldest).
+void EventQueue::schedule(size_t max) {
+    const size_t room = std::min(max, capacity_);
+    while (count_ < room && fair_.next(scheduled_)) {
+        EventSlotHeader head;
+        head.kind = ATEM_RTM_EVENT_MESSAGE;
+        head.subtype = scheduled_.subtype;
+        head.timestamp = scheduled_.timestamp;
+        head.flags = kHasUser | kHasPayload;
+        store(head, scheduled_.channel, scheduled_.publisher, {}, scheduled_.payload);
+    }
+}
+
+EventSlot& EventQueue::at(size_t position) {
+    auto& chunk = chunks_[position / kEventSlotsPerChunk];
+    // Left uninitialised: store() writes every field it later reads.
+    if (!chunk) chunk.reset(new EventSlot[kEventSlotsPerChunk]);
+    return chunk[position % kEventSlotsPerChunk];
+}
+
+const char* EventQueue::bytes(const EventSlot& slot) const {
+    return slot.head.spill == kNoSpill ? slot.data : spill_[slot.head.spill].data();
+}
+
+void EventQueue::release(EventSlot& slot) {
+    if (slot.head.spill == kNoSpill) return;
+    std::string& buffer = spill_[slot.head.spill];
+    if (buffer.capacity() > kEventSpillKeepBytes) std::string().swap(buffer);
+    spill_free_.push_back(slot.head.spill);
+    slot.head.spill = kNoSpill;
+}
+
+} // namespace atem_rtm
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "atem_rtm.h"
+#include "atem_rtm_fair.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace atem_rtm {
+
+constexpr size_t kDefaultEventQueueCapacity = 1024;
+
+// Owned form of an AtemRtmEvent while it waits in the queue.
+struct EventRecord {
+    uint32_t kind{0};
+    uint32_t subtype{0};
+    int32_t code{0};
+    uint32_t aux{0};
+    uint64_t request_id{0};
+    uint64_t timestamp{0};
+    std::string channel;
+    std::string user;
+    std::string name;
+    std::string payload;
+    // Which of the optional strings are set (NULL in the C record otherwise).
+    bool has_user{false};
+    bool has_name{false};
+    bool has_payload{false};
+
+    EventRecord& with_user(std::string value) {
+        user = std::move(value);
+        has_user = true;
+        return *this;
+    }
+    EventRecord& with_name(std::string value) {
+        name = std::move(value);
+        has_name = true;
+        return *this;
+    }
+    EventRecord& with_payload(std::string value) {
+        payload = std::move(value);
+        has_payload = true;
+        return *this;
+    }
+};
+
+constexpr size_t kCacheLineSize = 64;
+// Ten cache lines: the header plus room for a ~512-byte payload with its
+// channel and publisher names.
+constexpr size_t kEventSlotSize = 640;
+constexpr size_t kEventSlotsPerChunk = 16;
+// Spill buffers larger than this are freed instead of pooled.
+constexpr size_t kEventSpillKeepBytes = 8192;
+
+struct EventSlotHeader {
+    uint32_t kind{0};
+    uint32_t subtype{0};
+    int32_t code{0};
+    uint32_t aux{0};
+    uint64_t request_id{0};
+    uint64_t timestamp{0};
+    uint32_t channel_len{0};
+    uint32_t user_len{0};
+    uint32_t name_len{0};
+    uint32_t payload_len{0};
+    uint32_t spill{0};  // spill buffer index, kNoSpill when packed inline
+    uint32_t flags{0};  // which optional strings are set
+};
+
+// One queued event in a fixed, cache-line-aligned slot. Channel, user and
+// name (each NUL-terminated) and then the payload are packed into `data`
+// when they fit, else into a pooled spill buffer.
+struct alignas(kCacheLineSize) EventSlot {
+    EventSlotHeader head;
+    char data[kEventSlotSize - sizeof(EventSlotHeader)];
+};
+
+static_assert(sizeof(EventSlot) == kEventSlotSize, "event slots are whole cache lines");
+
+// Bounded FIFO behind atem_rtm_poll_events. When full, the oldest event
+// is dropped. Events live in a ring of EventSlots allocated in chunks as
+// the queue first reaches them, so small events cost no allocation once
+// warm. Polled events are kept until the next poll so the string pointers
+// handed out stay valid. With fair scheduling on, message events wait in a
+// FairScheduler instead and enter the ring as they are polled, so other
+// event kinds may overtake them.
+// Not thread-safe; the owning client serialises access.
+class EventQueue {
+public:
+    struct Counters {
+        uint64_t queued{0};
+        uint64_t polled{0};
+        uint64_t dropped{0};
+        uint64_t spilled{0};  // too large for a slot's inline space
+    };
+
+    // fair_quantum_bytes 0 keeps messages in plain arrival order.
+    explicit EventQueue(size_t capacity, uint32_t fair_quantum_bytes = 0,
+                        uint32_t fair_publisher_max_bytes = 0);
+
+    // Returns true if the queue was empty before, i.e. a consumer waiting
+    // for events should be woken.
+    bool push(const EventRecord& record);
+    // The message path, straight from the inbound strings; `subtype` is
+    // ATEM_RTM_MESSAGE_LIVE or ATEM_RTM_MESSAGE_REPLAYED.
+    bool push_message(uint64_t timestamp, uint32_t subtype, std::string_view channel,
+                      std::string_view publisher, std::string_view payload);
+
+    size_t poll(AtemRtmEvent* out, size_t max);
+
+    // Remember live messages dropped or shed unpolled, for flow control.
+    void track_discards(bool on);
+    // Appends them and forgets them.
+    void take_discarded(std::vector<DiscardedMessage>& out);
+
+    // Includes messages still waiting in the fair scheduler.
+    size_t depth() const { return count_ + fair_.size(); }
+    const Counters& counters() const { return counters_; }
+    const FairScheduler& fair() const { return fair_; }
+
+private:
+    static constexpr uint32_t kNoSpill = UINT32_MAX;
+
+    bool store(const EventSlotHeader& head, std::string_view channel, std::string_view user,
+               std::string_view name, std::string_view payload);
+    EventSlot& at(size_t position);
+    const char* bytes(const EventSlot& slot) const;
+    void release(EventSlot& slot);
+    void schedule(size_t max);
+
+    size_t capacity_;
+    std::vector<std::unique_ptr<EventSlot[]>> chunks_;
+    size_t head_{0};
+    size_t count_{0};
+    // Copies of the last poll's slots; their spill buffers are returned to
+    // the pool on the next poll.
+    std::vector<EventSlot> polled_;
+    size_t polled_count_{0};
+    std::deque<std::string> spill_;  // deque: buffers never move
+    std::vector<uint32_t> spill_free_;
+    FairScheduler fair_;
+    FairScheduler::Message scheduled_;  // reused by schedule()
+    bool track_discards_{false};
+    std::vector<DiscardedMessage> discarded_;
+    Counters counters_;
+};
+
+} // namespace atem_rtm
@@ -0,0 +1,102 @@
+#include "atem_rtm_fair.h"
+
+#include "atem_rtm.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace atem_rtm {
+
+FairScheduler::FairScheduler(uint32_t quantum_bytes, uint32_t publisher_max_bytes,
+                             size_t capacity)
+    : quantum_(quantum_bytes),
+      publisher_max_bytes_(publisher_max_bytes ? publisher_max_bytes
+                                               : kDefaultFairPublisherMaxBytes),
+      capacity_(capacity ? capacity : 1) {}
+
+void FairScheduler::push(uint64_t timestamp, uint32_t subtype, std::string_view channel,
+                         std::string_view publisher, std::string_view payload) {
+    auto found = flows_.find(std::string(publisher));
+    if (found == flows_.end()) {
+        found = flows_.emplace(std::string(publisher), Flow{}).first;
+        rotation_.push_back(found->first);
+        counters_.max_publishers =
+            std::max<uint64_t>(counters_.max_publishers, rotation_.size());
+    }
+    Flow& flow = found->second;
+    Message msg;
+    msg.timestamp = timestamp;
+    msg.subtype = subtype;
+    msg.channel.assign(channel);
+    msg.publisher.assign(publisher);
+    msg.payload.assign(payload);
+    flow.bytes += cost(msg);
+    flow.queue.push_back(std::move(msg));
+    ++size_;
+
+    // Always keep the newest message, even if it alone is over the limit.
+    while (flow.bytes > publisher_max_bytes_ && flow.queue.size() > 1) shed(flow);
+    if (size_ > capacity_) {
+        auto largest = std::max_element(
+            flows_.begin(), flows_.end(),
+            [](const auto& a, const auto& b) { return a.second.bytes < b.second.bytes; });
+        shed(largest->second);
+    }
+}
+
+bool FairScheduler::next(Message& out) {
+    while (!rotation_.empty()) {
+        auto found = flows_.find(rotation_.front());
+        Flow& flow = found->second;
+        if (flow.queue.empty()) {
+            // Emptied by shedding; drop out of the rotation.
+            rotation_.pop_front();
+            flows_.erase(found);
+            continue;
+        }
+        if (!flow.in_turn) {
+            flow.deficit += quantum_;
+            flow.in_turn = true;
+        }
+        const size_t head = cost(flow.queue.front());
+        if (head > flow.deficit) {
+            // Turn over; the credit carries to the next round.
+            flow.in_turn = false;
+            rotation_.push_back(std::move(rotation_.front()));
+            rotation_.pop_front();
+            continue;
+        }
+        flow.deficit -= head;
+        flow.bytes -= head;
+        out = std::move(flow.queue.front());
+        flow.queue.pop_front();
+        --size_;
+        if (flow.queue.empty()) {
+            // An idle publisher keeps no credit.
+            rotation_.pop_front();
+            flows_.erase(found);
+        }
+        return true;
+    }
+    return false;
+}
+
+void FairScheduler::take_discarded(std::vector<DiscardedMessage>& out) {
+    for (auto& msg : discarded_) out.push_back(std::move(msg));
+    discarded_.clear();
+}
+
+void FairScheduler::shed(Flow& flow) {
+    if (flow.queue.empty()) return;
+    Message& oldest = flow.queue.front();
+    if (track_discards_ && oldest.subtype == ATEM_RTM_MESSAGE_LIVE) {
+        discarded_.push_back(
+            DiscardedMessage{std::move(oldest.publisher), std::move(oldest.channel)});
+    }
+    flow.bytes -= cost(oldest);
+    flow.queue.pop_front();
+    --size_;
+    ++counters_.shed;
+}
+
+} // namespace atem_rtm
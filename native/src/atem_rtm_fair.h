@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace atem_rtm {
+
+constexpr uint32_t kDefaultFairPublisherMaxBytes = 256 * 1024;
+// Charged per message on top of its payload, so empty messages still cost
+// something.
+constexpr size_t kFairMessageOverhead = 64;
+
+// A live message thrown away before the application polled it; flow
+// control counts it as consumed.
+struct DiscardedMessage {
+    std::string publisher;
+    std::string channel;
+};
+
+// Deficit round-robin across publishers for message events waiting to be
+// polled. Each backlogged publisher gets `quantum_bytes` of credit per
+// round and is served in order while its next message fits the credit,
+// so one publisher flooding a channel cannot push the others' messages
+// behind its own backlog. A publisher over `publisher_max_bytes` loses
+// its own oldest messages; past `capacity` messages in total the largest
+// backlog does.
+// Not thread-safe; the owning queue serialises access.
+class FairScheduler {
+public:
+    struct Counters {
+        uint64_t shed{0};            // dropped to keep a publisher within its share
+        uint64_t max_publishers{0};  // most publishers backlogged at once
+    };
+
+    struct Message {
+        uint64_t timestamp{0};
+        uint32_t subtype{0};
+        std::string channel;
+        std::string publisher;
+        std::string payload;
+    };
+
+    // quantum_bytes 0 disables the scheduler; publisher_max_bytes 0 means
+    // kDefaultFairPublisherMaxBytes.
+    FairScheduler(uint32_t quantum_bytes, uint32_t publisher_max_bytes, size_t capacity);
+
+    bool enabled() const { return quantum_ > 0; }
+
+    void push(uint64_t timestamp, uint32_t subtype, std::string_view channel,
+              std::string_view publisher, std::string_view payload);
+
+    // Moves the next message in schedule order into `out`; false when
+    // nothing is waiting.
+    bool next(Message& out);
+
+    // Remember shed live messages for take_discarded().
+    void track_discards(bool on) { track_discards_ = on; }
+    void take_discarded(std::vector<DiscardedMessage>& out);
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+    size_t publishers() const { return rotation_.size(); }
+    const Counters& counters() const { return counters_; }
+
+private:
+    struct Flow {
+        std::deque<Message> queue;
+        size_t bytes{0};
+        uint64_t deficit{0};
+        bool in_turn{false};  // credited for the current round
+    };
+
+    static size_t cost(const Message& msg) { return msg.payload.size() + kFairMessageOverhead; }
+    void shed(Flow& flow);
+
+    uint64_t quantum_;
+    size_t publisher_max_bytes_;
+    size_t capacity_;
+    size_t size_{0};
+    bool track_discards_{false};
+    std::vector<DiscardedMessage> discarded_;
+    Counters counters_;
+    std::unordered_map<std::string, Flow> flows_;
+    std::deque<std::string> rotation_;  // backlogged publishers, front is served
+};
+
+} // namespace atem_rtm
@@ -0,0 +1,209 @@
+// Bulk bring-up of many clients, built on the public C API so it serves
+// both the real and the stub backend.
+
+#include "atem_rtm.h"
+#include "atem_rtm_clock.h"
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t kDefaultFleetParallel = 4;
+constexpr uint32_t kDefaultFleetStaggerMs = 100;
+constexpr uint32_t kDefaultFleetReadyTimeoutMs = 15000;
+
+struct FleetSession {
+    // TimedOut counts as failed but still holds a parallel slot: its
+    // login and subscribe are still running.
+    enum class State { Waiting, Starting, TimedOut, Ready, Failed };
+
+    AtemRtmClient* client{nullptr};
+    std::string token;
+    std::string channel;
+    State state{State::Waiting};
+    uint64_t started_ms{0};
+    uint64_t ready_ms{0};
+};
+
+// Shared with in-flight bring-ups, which may complete after the fleet
+// handle is gone.
+struct FleetState {
+    std::mutex mtx;
+    std::deque<FleetSession> sessions;
+};
+
+struct ReadyTicket {
+    std::weak_ptr<FleetState> state;
+    size_t index;
+};
+
+void on_ready(AtemRtmClient* client, int result, void* user_data) {
+    (void)client;
+    std::unique_ptr<ReadyTicket> ticket(static_cast<ReadyTicket*>(user_data));
+    std::shared_ptr<FleetState> state = ticket->state.lock();
+    if (!state) return;
+    std::lock_guard<std::mutex> lock(state->mtx);
+    FleetSession& session = state->sessions[ticket->index];
+    if (session.state == FleetSession::State::TimedOut) {
+        session.state = FleetSession::State::Failed;  // frees the slot
+        return;
+    }
+    if (session.state != FleetSession::State::Starting) return;
+    if (result == ATEM_RTM_OK) {
+        session.state = FleetSession::State::Ready;
+        session.ready_ms = atem_rtm::now_ms() - session.started_ms;
+    } else {
+        session.state = FleetSession::State::Failed;
+    }
+}
+
+// Nearest-rank percentile of an ascending list.
+uint32_t percentile(const std::vector<uint64_t>& sorted, uint32_t pct) {
+    if (sorted.empty()) return 0;
+    size_t rank = (sorted.size() * pct + 99) / 100;
+    return static_cast<uint32_t>(sorted[rank ? rank - 1 : 0]);
+}
+
+} // namespace
+
+struct AtemRtmFleet {
+    AtemRtmFleetConfig config{};
+    std::shared_ptr<FleetState> state{std::make_shared<FleetState>()};
+    std::mt19937 rng{std::random_device{}()};
+    uint64_t began_ms{0};
+    uint64_t next_start_ms{0};
+};
+
+extern "C" {
+
+AtemRtmFleet* atem_rtm_fleet_create(const AtemRtmFleetConfig* config) {
+    auto* fleet = new AtemRtmFleet();
+    if (config) fleet->config = *config;
+    AtemRtmFleetConfig& cfg = fleet->config;
+    if (!cfg.max_parallel) cfg.max_parallel = kDefaultFleetParallel;
+    if (!cfg.stagger_ms) cfg.stagger_ms = kDefaultFleetStaggerMs;
+    if (!cfg.jitter_ms) {
+        cfg.jitter_ms = cfg.stagger_ms;
+    } else if (cfg.jitter_ms == ATEM_RTM_FLEET_NO_JITTER) {
+        cfg.jitter_ms = 0;
+    }
+    if (!cfg.ready_timeout_ms) cfg.ready_timeout_ms = kDefaultFleetReadyTimeoutMs;
+    return fleet;
+}
+
+int atem_rtm_fleet_add(
+    AtemRtmFleet* fleet,
+    AtemRtmClient* client,
+    const char* token,
+    const char* channel) {
+    if (!fleet || !client || !channel) return -1;
+    FleetSession session;
+    session.client = client;
+    session.token = token ? token : "";
+    session.channel = channel;
+    std::lock_guard<std::mutex> lock(fleet->state->mtx);
+    fleet->state->sessions.push_back(std::move(session));
+    return 0;
+}
+
+int atem_rtm_fleet_tick(
+    AtemRtmFleet* fleet,
+    AtemRtmFleetReport* report) {
+    if (!fleet) return -1;
+    using State = FleetSession::State;
+    const uint64_t now = atem_rtm::now_ms();
+    FleetState& state = *fleet->state;
+    if (fleet->began_ms == 0) {
+        fleet->began_ms = now;
+        fleet->next_start_ms = now;
+    }
+
+    struct Start {
+        size_t index;
+        AtemRtmClient* client;
+        std::string token;
+        std::string channel;
+    };
+    std::vector<Start> starts;
+    {
+        std::lock_guard<std::mutex> lock(state.mtx);
+        uint32_t starting = 0;
+        for (auto& session : state.sessions) {
+            if (session.state == State::Starting &&
+                now - session.started_ms >= fleet->config.ready_timeout_ms) {
+                session.state = State::TimedOut;
+            }
+            if (session.state == State::Starting || session.state == State::TimedOut) {
+                ++starting;
+            }
+        }
+        // One start per tick at most, so the gaps hold however often we
+        // are called.
+        for (size_t i = 0; i < state.sessions.size(); ++i) {
+            FleetSession& session = state.sessions[i];
+            if (session.state != State::Waiting) continue;
+            if (starting >= fleet->config.max_parallel || now < fleet->next_start_ms) break;
+            session.state = State::Starting;
+            session.started_ms = now;
+            ++starting;
+            std::uniform_int_distribution<uint32_t> jitter(0, fleet->config.jitter_ms);
+            fleet->next_start_ms = now + fleet->config.stagger_ms + jitter(fleet->rng);
+            starts.push_back(Start{i, session.client, session.token, session.channel});
+            break;
+        }
+    }
+
+    // Outside the lock: the stub completes bring-ups synchronously.
+    for (const auto& start : starts) {
+        auto* ticket = new ReadyTicket{fleet->state, start.index};
+        int rc = atem_rtm_bring_up(start.client, start.token.c_str(), start.channel.c_str(),
+                                   on_ready, ticket);
+        if (rc != 0) {
+            delete ticket;
+            std::lock_guard<std::mutex> lock(state.mtx);
+            state.sessions[start.index].state = State::Failed;
+        }
+    }
+
+    AtemRtmFleetReport out{};
+    std::vector<uint64_t> ready_ms;
+    {
+        std::lock_guard<std::mutex> lock(state.mtx);
+        out.sessions = static_cast<uint32_t>(state.sessions.size());
+        for (const auto& session : state.sessions) {
+            switch (session.state) {
+            case State::Ready:
+                ++out.ready;
+                ready_ms.push_back(session.ready_ms);
+                break;
+            case State::TimedOut:
+            case State::Failed:
+                ++out.failed;
+                break;
+            default:
+                ++out.pending;
+                break;
+            }
+        }
+    }
+    std::sort(ready_ms.begin(), ready_ms.end());
+    out.ready_ms_p50 = percentile(ready_ms, 50);
+    out.ready_ms_p90 = percentile(ready_ms, 90);
+    out.ready_ms_p99 = percentile(ready_ms, 99);
+    out.ready_ms_max = ready_ms.empty() ? 0 : static_cast<uint32_t>(ready_ms.back());
+    out.elapsed_ms = static_cast<uint32_t>(atem_rtm::now_ms() - fleet->began_ms);
+    if (report) *report = out;
+    return out.pending ? ATEM_RTM_QUEUED : ATEM_RTM_OK;
+}
+
+void atem_rtm_fleet_destroy(AtemRtmFleet* fleet) {
+    delete fleet;
+}
+
+} // extern "C"
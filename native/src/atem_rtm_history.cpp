@@ -0,0 +1,152 @@
+#include "atem_rtm_history.h"
+
+#include <cstring>
+
+namespace atem_rtm {
+
+namespace {
+
+constexpr const char kPartialSuffix[] = ".partial";
+
+// Minimal scanner over one JSON object: only what message_class() needs.
+struct Scanner {
+    const char* p;
+    const char* end;
+
+    void skip_ws() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) ++p;
+    }
+
+    // Reads a string starting at the opening quote, pointing `start` and
+    // `size` at its contents without copying; escapes are kept as is,
+    // which is fine for comparing against plain ASCII keys and type names.
+    bool read_string(const char** start = nullptr, size_t* size = nullptr) {
+        if (p >= end || *p != '"') return false;
+        const char* first = ++p;
+        while (p < end && *p != '"') {
+            if (*p == '\\') ++p;
+            ++p;
+        }
+        if (p >= end) return false;
+        if (start) *start = first;
+        if (size) *size = static_cast<size_t>(p - first);
+        ++p;
+        return true;
+    }
+
+    // Skips any value, including nested objects and arrays.
+    bool skip_value() {
+        skip_ws();
+        if (p >= end) return false;
+        if (*p == '"') return read_string();
+        if (*p == '{' || *p == '[') {
+            int depth = 0;
+            while (p < end) {
+                if (*p == '"') {
+                    if (!read_string()) return false;
+                    continue;
+                }
+                if (*p == '{' || *p == '[') ++depth;
+                if (*p == '}' || *p == ']') {
+                    ++p;
+                    if (--depth == 0) return true;
+                    continue;
+                }
+                ++p;
+            }
+            return false;
+        }
+        while (p < end && *p != ',' && *p != '}' && *p != ']') ++p;
+        return true;
+    }
+};
+
+bool key_is(const char* key, size_t size, const char* name) {
+    return size == strlen(name) && memcmp(key, name, size) == 0;
+}
+
+} // namespace
+
+std::string message_class(const char* payload, size_t length) {
+    std::string out;
+    message_class(payload, length, &out);
+    return out;
+}
+
+void message_class(const char* payload, size_t length, std::string* out) {
+    out->clear();
+    if (!payload) return;
+    Scanner scan{payload, payload + length};
+    scan.skip_ws();
+    if (scan.p >= scan.end || *scan.p != '{') return;
+    ++scan.p;
+
+    const char* type = nullptr;
+    size_t type_size = 0;
+    bool partial = false;
+    while (true) {
+        const char* key = nullptr;
+        size_t key_size = 0;
+        scan.skip_ws();
+        if (!scan.read_string(&key, &key_size)) break;
+        scan.skip_ws();
+        if (scan.p >= scan.end || *scan.p != ':') break;
+        ++scan.p;
+        scan.skip_ws();
+        if (key_is(key, key_size, "type") && scan.p < scan.end && *scan.p == '"') {
+            if (!scan.read_string(&type, &type_size)) break;
+        } else if (key_is(key, key_size, "is_final") && scan.end - scan.p >= 5 &&
+                   strncmp(scan.p, "false", 5) == 0) {
+            partial = true;
+            scan.p += 5;
+        } else if (!scan.skip_value()) {
+            break;
+        }
+        scan.skip_ws();
+        if (scan.p >= scan.end || *scan.p != ',') break;
+        ++scan.p;
+    }
+    if (type_size == 0) return;
+    out->assign(type, type_size);
+    if (partial) out->append(kPartialSuffix);
+}
+
+std::string partial_base(const std::string& message_class) {
+    const size_t suffix_len = sizeof(kPartialSuffix) - 1;
+    if (message_class.size() > suffix_len &&
+        message_class.compare(message_class.size() - suffix_len, suffix_len, kPartialSuffix) == 0) {
+        return message_class.substr(0, message_class.size() - suffix_len);
+    }
+    return std::string();
+}
+
+void HistoryPolicy::set(const std::string& message_class, bool store) {
+    classes_[message_class] = store;
+}
+
+bool HistoryPolicy::should_store(const std::string& message_class) {
+    bool store = lookup(message_class);
+    if (store) {
+        ++counters_.stored;
+    } else {
+        ++counters_.skipped;
+    }
+    return store;
+}
+
+bool HistoryPolicy::lookup(const std::string& message_class) const {
+    if (message_class.empty()) return default_store_;
+    auto it = classes_.find(message_class);
+    if (it != classes_.end()) return it->second;
+
+    const size_t suffix_len = sizeof(kPartialSuffix) - 1;
+    if (message_class.size() > suffix_len &&
+        message_class.compare(message_class.size() - suffix_len, suffix_len, kPartialSuffix) == 0) {
+        base_.assign(message_class, 0, message_class.size() - suffix_len);
+        it = classes_.find(base_);
+        if (it != classes_.end()) return it->second;
+    }
+    return default_store_;
+}
+
+} // namespace atem_rtm
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace atem_rtm {
+
+// Message class of a JSON payload: its top-level "type", with ".partial"
+// appended when it also carries a top-level `"is_final": false`. Empty for
+// payloads that are not JSON objects or have no type.
+std::string message_class(const char* payload, size_t length);
+// Same, into `out`; reusing one string keeps the publish path from
+// allocating once it has grown to the longest class.
+void message_class(const char* payload, size_t length, std::string* out);
+
+// The class a ".partial" class falls back to when it has no setting of its
+// own; empty for other classes.
+std::string partial_base(const std::string& message_class);
+
+// Which channel publishes are kept in RTM history (storeInHistory), per
+// message class. A ".partial" class without its own policy falls back to
+// its base class, then to the default. The default stores nothing, which
+// is what the shim did before policies existed.
+// Not thread-safe; the owning client serialises access.
+class HistoryPolicy {
+public:
+    struct Counters {
+        uint64_t stored{0};
+        uint64_t skipped{0};
+    };
+
+    void set(const std::string& message_class, bool store);
+    void set_default(bool store) { default_store_ = store; }
+
+    // Decides for one publish and counts the decision.
+    bool should_store(const std::string& message_class);
+
+    const Counters& counters() const { return counters_; }
+
+private:
+    bool lookup(const std::string& message_class) const;
+
+    bool default_store_{false};
+    std::unordered_map<std::string, bool> classes_;
+    mutable std::string base_;  // lookup() scratch for the ".partial" fallback
+    Counters counters_;
+};
+
+} // namespace atem_rtm
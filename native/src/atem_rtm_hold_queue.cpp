@@ -0,0 +1,83 @@
+#include "atem_rtm_hold_queue.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace atem_rtm {
+
+PeerHoldQueue::PeerHoldQueue(size_t per_peer_capacity, uint64_t ttl_ms)
+    : capacity_(per_peer_capacity ? per_peer_capacity : 1), ttl_ms_(ttl_ms) {}
+
+void PeerHoldQueue::hold(const std::string& peer, std::string payload, uint64_t now_ms) {
+    auto& queue = peers_[peer];
+    depth_ -= expire_peer(queue, now_ms);
+    if (queue.size() >= capacity_) {
+        queue.pop_front();
+        --depth_;
+        ++counters_.dropped;
+    }
+    queue.push_back(Entry{std::move(payload), now_ms});
+    ++depth_;
+    ++counters_.held;
+}
+
+std::vector<std::string> PeerHoldQueue::release(const std::string& peer, uint64_t now_ms) {
+    std::vector<std::string> out;
+    auto it = peers_.find(peer);
+    if (it == peers_.end()) {
+        return out;
+    }
+    depth_ -= expire_peer(it->second, now_ms);
+    out.reserve(it->second.size());
+    for (auto& entry : it->second) {
+        out.push_back(std::move(entry.payload));
+    }
+    depth_ -= out.size();
+    counters_.flushed += out.size();
+    peers_.erase(it);
+    return out;
+}
+
+size_t PeerHoldQueue::expire(uint64_t now_ms) {
+    size_t removed = 0;
+    for (auto it = peers_.begin(); it != peers_.end();) {
+        removed += expire_peer(it->second, now_ms);
+        if (it->second.empty()) {
+            it = peers_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    depth_ -= removed;
+    return removed;
+}
+
+uint64_t PeerHoldQueue::next_expiry() const {
+    uint64_t next = UINT64_MAX;
+    for (const auto& entry : peers_) {
+        if (!entry.second.empty()) {
+            next = std::min(next, entry.second.front().held_at_ms + ttl_ms_);
+        }
+    }
+    return next;
+}
+
+size_t PeerHoldQueue::clear() {
+    size_t removed = depth_;
+    counters_.expired += removed;
+    peers_.clear();
+    depth_ = 0;
+    return removed;
+}
+
+size_t PeerHoldQueue::expire_peer(std::deque<Entry>& queue, uint64_t now_ms) {
+    size_t removed = 0;
+    while (!queue.empty() && now_ms - queue.front().held_at_ms >= ttl_ms_) {
+        queue.pop_front();
+        ++removed;
+    }
+    counters_.expired += removed;
+    return removed;
+}
+
+} // namespace atem_rtm
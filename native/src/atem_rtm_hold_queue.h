@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace atem_rtm {
+
+constexpr size_t kDefaultPeerHoldCapacity = 64;
+constexpr uint32_t kDefaultPeerHoldTtlMs = 30000;
+
+// Parks peer messages addressed to users the presence cache reports as
+// offline. Each peer gets a bounded FIFO (oldest entry is dropped on
+// overflow) and entries older than the TTL are discarded instead of sent.
+// Not thread-safe; the owning client serialises access.
+class PeerHoldQueue {
+public:
+    struct Counters {
+        uint64_t held{0};
+        uint64_t flushed{0};
+        uint64_t expired{0};
+        uint64_t dropped{0};
+    };
+
+    PeerHoldQueue(size_t per_peer_capacity, uint64_t ttl_ms);
+
+    void hold(const std::string& peer, std::string payload, uint64_t now_ms);
+
+    // Removes and returns everything still live for `peer`, oldest first.
+    std::vector<std::string> release(const std::string& peer, uint64_t now_ms);
+
+    // Drops expired entries across all peers; returns how many were dropped.
+    size_t expire(uint64_t now_ms);
+    // When the oldest entry expires; UINT64_MAX when nothing is held.
+    uint64_t next_expiry() const;
+
+    // Removes everything, counting it as expired. Returns how many were dropped.
+    size_t clear();
+
+    size_t depth() const { return depth_; }
+    const Counters& counters() const { return counters_; }
+
+private:
+    struct Entry {
+        std::string payload;
+        uint64_t held_at_ms;
+    };
+
+    size_t expire_peer(std::deque<Entry>& queue, uint64_t now_ms);
+
+    size_t capacity_;
+    uint64_t ttl_ms_;
+    size_t depth_{0};
+    Counters counters_;
+    std::unordered_map<std::string, std::deque<Entry>> peers_;
+};
+
+} // namespace atem_rtm
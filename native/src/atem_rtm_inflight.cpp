@@ -0,0 +1,54 @@
+#include "atem_rtm_inflight.h"
+
+namespace atem_rtm {
+
+namespace {
+
+// Early results are only legitimate for a handful of racing publishes;
+// anything beyond that is a result for a request we never tracked.
+constexpr size_t kMaxEarlyResults = 64;
+
+} // namespace
+
+void InflightTracker::sent(uint64_t request_id, uint64_t now_ms) {
+    ++counters_.sent;
+    auto early = early_.find(request_id);
+    if (early != early_.end()) {
+        count(early->second);
+        early_.erase(early);
+        return;
+    }
+    if (spare_.empty()) {
+        pending_[request_id] = Entry{now_ms};
+        return;
+    }
+    Pending::node_type node = std::move(spare_.back());
+    spare_.pop_back();
+    node.key() = request_id;
+    node.mapped() = Entry{now_ms};
+    pending_.insert(std::move(node));
+}
+
+bool InflightTracker::completed(uint64_t request_id, bool ok) {
+    auto it = pending_.find(request_id);
+    if (it == pending_.end()) {
+        if (early_.size() >= kMaxEarlyResults) {
+            early_.clear();
+        }
+        early_[request_id] = ok;
+        return false;
+    }
+    spare_.push_back(pending_.extract(it));
+    count(ok);
+    return true;
+}
+
+void InflightTracker::count(bool ok) {
+    if (ok) {
+        ++counters_.acked;
+    } else {
+        ++counters_.failed;
+    }
+}
+
+} // namespace atem_rtm
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace atem_rtm {
+
+// Publishes handed to the SDK that have not seen onPublishResult yet,
+// keyed by SDK request id. Tolerates the result racing ahead of sent().
+// Map nodes of completed publishes are kept and reused, so steady-state
+// tracking allocates nothing.
+// Not thread-safe; the owning client serialises access.
+class InflightTracker {
+public:
+    struct Counters {
+        uint64_t sent{0};
+        uint64_t acked{0};
+        uint64_t failed{0};
+    };
+
+    void sent(uint64_t request_id, uint64_t now_ms);
+
+    // Records an onPublishResult. Returns false if the id was unknown.
+    bool completed(uint64_t request_id, bool ok);
+
+    size_t size() const { return pending_.size(); }
+    const Counters& counters() const { return counters_; }
+
+private:
+    struct Entry {
+        uint64_t sent_ms;
+    };
+
+    void count(bool ok);
+
+    using Pending = std::unordered_map<uint64_t, Entry>;
+
+    Counters counters_;
+    Pending pending_;
+    std::vector<Pending::node_type> spare_;
+    // Results that arrived before sent() registered their request id.
+    std::unordered_map<uint64_t, bool> early_;
+};
+
+} // namespace atem_rtm
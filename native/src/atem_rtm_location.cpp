@@ -0,0 +1,171 @@
+#include "atem_rtm_location.h"
+
+#include <algorithm>
+#include <unordered_set>
+#include <utility>
+
+namespace atem_rtm {
+
+namespace {
+
+constexpr size_t kMaxEarlyResults = 64;
+// Past this many users, expired entries nobody waits on are dropped.
+constexpr size_t kMaxLocationEntries = 4096;
+
+void add_channel(std::vector<std::string>& channels, const std::string& channel) {
+    if (std::find(channels.begin(), channels.end(), channel) == channels.end()) {
+        channels.push_back(channel);
+    }
+}
+
+void remove_channel(std::vector<std::string>& channels, const std::string& channel) {
+    channels.erase(std::remove(channels.begin(), channels.end(), channel), channels.end());
+}
+
+} // namespace
+
+LocationCache::LocationCache(uint64_t ttl_ms) : ttl_ms_(ttl_ms) {}
+
+bool LocationCache::lookup(
+    const std::string& user,
+    uint64_t now_ms,
+    std::vector<std::string>& channels) {
+    auto it = users_.find(user);
+    if (it != users_.end() && it->second.known && now_ms - it->second.fetched_ms < ttl_ms_) {
+        ++counters_.hits;
+        channels = it->second.channels;
+        return true;
+    }
+    ++counters_.misses;
+    return false;
+}
+
+bool LocationCache::wait(const std::string& user, uint64_t waiter) {
+    Entry& entry = users_[user];
+    entry.waiters.push_back(waiter);
+    if (entry.querying) {
+        ++counters_.collapsed;
+        return false;
+    }
+    entry.querying = true;
+    ++counters_.queries;
+    return true;
+}
+
+void LocationCache::issued(
+    const std::string& user,
+    uint64_t request_id,
+    uint64_t now_ms,
+    std::vector<Answer>& done) {
+    in_flight_[request_id] = user;
+    auto early = early_.find(request_id);
+    if (early != early_.end()) {
+        Early answer = std::move(early->second);
+        early_.erase(early);
+        result(request_id, answer.ok, std::move(answer.channels), now_ms, done);
+    }
+}
+
+void LocationCache::abandon(const std::string& user, std::vector<Answer>& done) {
+    auto it = users_.find(user);
+    if (it == users_.end()) {
+        return;
+    }
+    it->second.querying = false;
+    complete(user, it->second, false, done);
+}
+
+void LocationCache::result(
+    uint64_t request_id,
+    bool ok,
+    std::vector<std::string> channels,
+    uint64_t now_ms,
+    std::vector<Answer>& done) {
+    auto it = in_flight_.find(request_id);
+    if (it == in_flight_.end()) {
+        if (early_.size() >= kMaxEarlyResults) early_.clear();
+        early_[request_id] = Early{ok, std::move(channels)};
+        return;
+    }
+    const std::string user = std::move(it->second);
+    in_flight_.erase(it);
+    Entry& entry = users_[user];
+    entry.querying = false;
+    if (ok) {
+        entry.channels = std::move(channels);
+        entry.fetched_ms = now_ms;
+        entry.known = true;
+    }
+    complete(user, entry, ok, done);
+    trim(now_ms);
+}
+
+void LocationCache::apply(const PresenceDelta& delta) {
+    switch (delta.kind) {
+    case PresenceDelta::Kind::Snapshot: {
+        std::unordered_set<std::string> present(delta.users.begin(), delta.users.end());
+        for (auto& entry : users_) {
+            if (!entry.second.known) continue;
+            if (present.count(entry.first)) {
+                add_channel(entry.second.channels, delta.channel);
+            } else {
+                remove_channel(entry.second.channels, delta.channel);
+            }
+        }
+        break;
+    }
+    case PresenceDelta::Kind::Join:
+    case PresenceDelta::Kind::Leave:
+        for (const auto& user : delta.users) {
+            auto it = users_.find(user);
+            if (it == users_.end() || !it->second.known) continue;
+            if (delta.kind == PresenceDelta::Kind::Join) {
+                add_channel(it->second.channels, delta.channel);
+            } else {
+                remove_channel(it->second.channels, delta.channel);
+            }
+        }
+        break;
+    }
+}
+
+void LocationCache::invalidate() {
+    for (auto& entry : users_) entry.second.known = false;
+}
+
+void LocationCache::close(std::vector<Answer>& done) {
+    for (auto& entry : users_) {
+        entry.second.querying = false;
+        complete(entry.first, entry.second, false, done);
+    }
+    in_flight_.clear();
+}
+
+void LocationCache::complete(
+    const std::string& user,
+    Entry& entry,
+    bool ok,
+    std::vector<Answer>& done) {
+    for (uint64_t waiter : entry.waiters) {
+        done.push_back(Answer{waiter, user, ok, ok ? entry.channels : std::vector<std::string>{}});
+        if (!ok) ++counters_.failed;
+    }
+    entry.waiters.clear();
+}
+
+void LocationCache::trim(uint64_t now_ms) {
+    if (users_.size() <= kMaxLocationEntries) {
+        return;
+    }
+    for (auto it = users_.begin(); it != users_.end();) {
+        const Entry& entry = it->second;
+        if (!entry.querying && entry.waiters.empty() &&
+            (!entry.known || now_ms - entry.fetched_ms >= ttl_ms_)) {
+            it = users_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+} // namespace atem_rtm
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "atem_rtm_presence.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace atem_rtm {
+
+constexpr uint32_t kDefaultLocationTtlMs = 30000;
+
+// Answers "which channels is this user in" locally. Entries come from
+// getUserChannels results and expire after the TTL; until then presence
+// deltas on our subscribed channels keep them current. Concurrent misses
+// for one user share a single remote query.
+// Not thread-safe; the owning client serialises access.
+class LocationCache {
+public:
+    struct Counters {
+        uint64_t hits{0};
+        uint64_t misses{0};
+        uint64_t queries{0};    // getUserChannels requests issued
+        uint64_t collapsed{0};  // misses that joined a query already in flight
+        uint64_t failed{0};     // waiters completed without an answer
+    };
+
+    struct Answer {
+        uint64_t waiter;
+        std::string user;
+        bool ok;
+        std::vector<std::string> channels;
+    };
+
+    explicit LocationCache(uint64_t ttl_ms);
+
+    // Fills `channels` and returns true when a fresh entry exists.
+    bool lookup(const std::string& user, uint64_t now_ms, std::vector<std::string>& channels);
+
+    // Parks `waiter` after a miss. Returns true when the caller has to issue
+    // the query (then report it via issued() or abandon()).
+    bool wait(const std::string& user, uint64_t waiter);
+    void issued(const std::string& user, uint64_t request_id, uint64_t now_ms,
+                std::vector<Answer>& done);
+    // The query could not be issued; fails the user's waiters.
+    void abandon(const std::string& user, std::vector<Answer>& done);
+    void result(uint64_t request_id, bool ok, std::vector<std::string> channels,
+                uint64_t now_ms, std::vector<Answer>& done);
+
+    // Presence on our subscribed channels.
+    void apply(const PresenceDelta& delta);
+    // Link dropped: deltas may have been missed, so nothing is fresh.
+    void invalidate();
+    // Fails every waiter, e.g. on shutdown.
+    void close(std::vector<Answer>& done);
+
+    size_t entries() const { return users_.size(); }
+    const Counters& counters() const { return counters_; }
+
+private:
+    struct Entry {
+        std::vector<std::string> channels;
+        uint64_t fetched_ms{0};
+        bool known{false};
+        bool querying{false};
+        std::vector<uint64_t> waiters;
+    };
+
+    struct Early {
+        bool ok;
+        std::vector<std::string> channels;
+    };
+
+    void complete(const std::string& user, Entry& entry, bool ok, std::vector<Answer>& done);
+    void trim(uint64_t now_ms);
+
+    uint64_t ttl_ms_;
+    Counters counters_;
+    std::unordered_map<std::string, Entry> users_;
+    std::unordered_map<uint64_t, std::string> in_flight_;
+    std::unordered_map<uint64_t, Early> early_;
+};
+
+} // namespace atem_rtm
@@ -0,0 +1,233 @@
+#include "atem_rtm_lock_wait.h"
+
+#include <algorithm>
+
+namespace atem_rtm {
+
+namespace {
+
+constexpr size_t kMaxEarlyResults = 64;
+
+} // namespace
+
+std::string LockWaitList::lock_id(const std::string& channel, const std::string& name) {
+    std::string id;
+    id.reserve(channel.size() + name.size() + 1);
+    id.append(channel).push_back('\x1f');
+    id.append(name);
+    return id;
+}
+
+LockWaitList::Lock& LockWaitList::lock(const std::string& channel, const std::string& name) {
+    Lock& lock = locks_[lock_id(channel, name)];
+    if (lock.key.name.empty()) {
+        lock.key = LockKey{channel, name};
+    }
+    return lock;
+}
+
+void LockWaitList::wait(
+    const std::string& channel,
+    const std::string& name,
+    uint64_t waiter,
+    uint64_t now_ms,
+    Step& step) {
+    Lock& target = lock(channel, name);
+    ++counters_.waits;
+    target.waiters.push_back(waiter);
+    if (target.state == State::Unknown) {
+        target.free_since_ms = now_ms;
+    }
+    if (target.state == State::HeldByOther && target.waiters.size() == 1) {
+        arm_recheck(target, now_ms, step);
+    }
+    maybe_acquire(target, now_ms, step);
+}
+
+void LockWaitList::issued(
+    const std::string& channel,
+    const std::string& name,
+    uint64_t request_id,
+    uint64_t now_ms,
+    Step& step) {
+    in_flight_[request_id] = lock_id(channel, name);
+    auto early = early_.find(request_id);
+    if (early != early_.end()) {
+        Result result = early->second;
+        early_.erase(early);
+        acquire_result(request_id, result, now_ms, step);
+    }
+}
+
+void LockWaitList::acquire_result(uint64_t request_id, Result result, uint64_t now_ms, Step& step) {
+    auto it = in_flight_.find(request_id);
+    if (it == in_flight_.end()) {
+        if (early_.size() >= kMaxEarlyResults) early_.clear();
+        early_[request_id] = result;
+        return;
+    }
+    auto found = locks_.find(it->second);
+    in_flight_.erase(it);
+    if (found == locks_.end()) {
+        return;
+    }
+    Lock& target = found->second;
+    target.acquiring = false;
+
+    if (result.ok) {
+        target.state = State::Ours;
+        ++counters_.acquired;
+        uint64_t handoff = now_ms > target.free_since_ms ? now_ms - target.free_since_ms : 0;
+        counters_.handoff_ms_total += handoff;
+        counters_.handoff_ms_max = std::max(counters_.handoff_ms_max, handoff);
+        if (target.waiters.empty()) {
+            // Everyone gave up meanwhile; do not sit on the lock.
+            target.state = State::Free;
+            step.release.push_back(target.key);
+            return;
+        }
+        step.done.push_back(Completion{target.waiters.front(), target.key,
+                                       LockOutcome::Acquired});
+        target.waiters.pop_front();
+    } else if (result.contended) {
+        ++counters_.contended;
+        if (target.state == State::Free && target.free_since_ms >= target.checked_ms) {
+            // The holder let go while our refused acquire was on the wire.
+            maybe_acquire(target, now_ms, step);
+            return;
+        }
+        target.state = State::HeldByOther;
+        target.checked_ms = now_ms;
+        arm_recheck(target, now_ms, step);
+    } else {
+        target.state = State::Unknown;
+        fail_all(target, LockOutcome::Failed, step);
+    }
+}
+
+void LockWaitList::released(
+    const std::string& channel,
+    const std::string& name,
+    uint64_t now_ms,
+    Step& step) {
+    Lock& target = lock(channel, name);
+    if (target.state != State::Ours) {
+        step.release.push_back(target.key);
+        return;
+    }
+    if (!target.waiters.empty()) {
+        // Handed over in place: no release/acquire round trip, and no
+        // window for another client to take it in between.
+        ++counters_.acquired;
+        step.done.push_back(Completion{target.waiters.front(), target.key,
+                                       LockOutcome::Acquired});
+        target.waiters.pop_front();
+        return;
+    }
+    step.release.push_back(target.key);
+    target.state = State::Free;
+    target.free_since_ms = now_ms;
+}
+
+void LockWaitList::on_free(
+    const std::string& channel,
+    const std::string& name,
+    uint64_t now_ms,
+    Step& step) {
+    Lock& target = lock(channel, name);
+    if (target.state == State::Ours) {
+        return;
+    }
+    target.state = State::Free;
+    target.free_since_ms = now_ms;
+    maybe_acquire(target, now_ms, step);
+}
+
+void LockWaitList::on_expired(
+    const std::string& channel,
+    const std::string& name,
+    uint64_t now_ms,
+    Step& step) {
+    Lock& target = lock(channel, name);
+    target.state = State::Free;
+    target.free_since_ms = now_ms;
+    maybe_acquire(target, now_ms, step);
+}
+
+void LockWaitList::on_held(
+    const std::string& channel,
+    const std::string& name,
+    uint64_t now_ms,
+    Step& step) {
+    Lock& target = lock(channel, name);
+    if (target.state == State::Ours) {
+        return;
+    }
+    target.state = State::HeldByOther;
+    target.checked_ms = now_ms;
+    arm_recheck(target, now_ms, step);
+}
+
+void LockWaitList::recheck(
+    const std::string& channel,
+    const std::string& name,
+    uint64_t now_ms,
+    Step& step) {
+    auto found = locks_.find(lock_id(channel, name));
+    if (found == locks_.end()) {
+        return;
+    }
+    Lock& target = found->second;
+    if (target.state == State::HeldByOther && !target.waiters.empty() &&
+        now_ms - target.checked_ms >= kLockRecheckMs) {
+        target.state = State::Unknown;
+        maybe_acquire(target, now_ms, step);
+    }
+}
+
+void LockWaitList::close(Step& step) {
+    for (auto& entry : locks_) {
+        Lock& target = entry.second;
+        fail_all(target, LockOutcome::Closed, step);
+        if (target.state == State::Ours) {
+            step.release.push_back(target.key);
+            target.state = State::Free;
+        }
+    }
+}
+
+size_t LockWaitList::waiters() const {
+    size_t count = 0;
+    for (const auto& entry : locks_) count += entry.second.waiters.size();
+    return count;
+}
+
+void LockWaitList::maybe_acquire(Lock& lock, uint64_t now_ms, Step& step) {
+    if (lock.waiters.empty() || lock.acquiring || lock.state == State::Ours ||
+        lock.state == State::HeldByOther) {
+        return;
+    }
+    lock.acquiring = true;
+    lock.checked_ms = now_ms;
+    ++counters_.acquires;
+    step.acquire.push_back(lock.key);
+}
+
+void LockWaitList::arm_recheck(const Lock& lock, uint64_t now_ms, Step& step) {
+    if (lock.waiters.empty()) {
+        return;
+    }
+    const uint64_t elapsed = now_ms - lock.checked_ms;
+    step.recheck.push_back(
+        Recheck{lock.key, elapsed < kLockRecheckMs ? kLockRecheckMs - elapsed : 0});
+}
+
+void LockWaitList::fail_all(Lock& lock, LockOutcome outcome, Step& step) {
+    for (uint64_t waiter : lock.waiters) {
+        step.done.push_back(Completion{waiter, lock.key, outcome});
+        ++counters_.failed;
+    }
+    lock.waiters.clear();
+}
+
+} // namespace atem_rtm
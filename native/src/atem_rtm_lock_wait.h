@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace atem_rtm {
+
+// A waiter whose lock was held remotely is re-checked with a single
+// acquire after this long without a LockEvent, in case one was missed.
+constexpr uint64_t kLockRecheckMs = 30000;
+
+struct LockKey {
+    std::string channel;
+    std::string name;
+};
+
+enum class LockOutcome { Acquired, Failed, Closed };
+
+// Local wait lists for RTM locks. Waiters queue here instead of polling
+// acquireLock: at most one acquire per lock is in flight, and a lock held
+// by another Atem is only retried once a LockEvent reports it released or
+// expired, so idle waiters send nothing. Waiters are served FIFO: the
+// first by a successful acquire, the rest by a local release, which hands
+// the lock over without giving it back to the service.
+// Not thread-safe; the owning client serialises access.
+class LockWaitList {
+public:
+    struct Counters {
+        uint64_t waits{0};
+        uint64_t acquires{0};     // acquire requests issued
+        uint64_t acquired{0};
+        uint64_t contended{0};    // acquires refused because someone holds it
+        uint64_t failed{0};       // waiters completed without the lock
+        uint64_t handoff_ms_total{0};  // lock seen free -> acquired
+        uint64_t handoff_ms_max{0};
+    };
+
+    struct Completion {
+        uint64_t waiter;
+        LockKey lock;
+        LockOutcome outcome;
+    };
+
+    // A lock held remotely with waiters: call recheck() for it after
+    // `delay_ms`, replacing any re-check armed for it before.
+    struct Recheck {
+        LockKey lock;
+        uint64_t delay_ms;
+    };
+
+    // What the caller has to do after a call: issue acquireLock for each
+    // `acquire` (then report the request id via issued()), releaseLock for
+    // each `release`, complete each waiter in `done` and arm a timer for
+    // each `recheck`.
+    struct Step {
+        std::vector<LockKey> acquire;
+        std::vector<LockKey> release;
+        std::vector<Completion> done;
+        std::vector<Recheck> recheck;
+
+        bool empty() const {
+            return acquire.empty() && release.empty() && done.empty() && recheck.empty();
+        }
+    };
+
+    struct Result {
+        bool ok{false};
+        bool contended{false};  // held by someone else; wait for an event
+    };
+
+    void wait(const std::string& channel, const std::string& name, uint64_t waiter,
+              uint64_t now_ms, Step& step);
+    void issued(const std::string& channel, const std::string& name, uint64_t request_id,
+                uint64_t now_ms, Step& step);
+    void acquire_result(uint64_t request_id, Result result, uint64_t now_ms, Step& step);
+
+    // The application let go of the lock. With local waiters the next one
+    // is handed it; otherwise it is released to the service. A lock that
+    // is not ours is still released there, which reports the error, but
+    // its local state is left alone.
+    void released(const std::string& channel, const std::string& name, uint64_t now_ms,
+                  Step& step);
+
+    // LockEvents: set/released, and acquired by someone else. A release
+    // is ignored while the lock is ours: it is the echo of our own.
+    void on_free(const std::string& channel, const std::string& name, uint64_t now_ms,
+                 Step& step);
+    // Expired or removed: the lock is gone even if it was ours.
+    void on_expired(const std::string& channel, const std::string& name, uint64_t now_ms,
+                    Step& step);
+    void on_held(const std::string& channel, const std::string& name, uint64_t now_ms,
+                 Step& step);
+
+    // Safety net for missed events, run from the timer a Recheck asked
+    // for; does nothing unless kLockRecheckMs passed without an event.
+    void recheck(const std::string& channel, const std::string& name, uint64_t now_ms,
+                 Step& step);
+
+    // Completes every waiter as Closed and releases the locks we hold.
+    void close(Step& step);
+
+    size_t waiters() const;
+    const Counters& counters() const { return counters_; }
+
+private:
+    enum class State { Unknown, Free, HeldByOther, Ours };
+
+    struct Lock {
+        LockKey key;
+        State state{State::Unknown};
+        bool acquiring{false};
+        uint64_t free_since_ms{0};
+        uint64_t checked_ms{0};
+        std::deque<uint64_t> waiters;
+    };
+
+    static std::string lock_id(const std::string& channel, const std::string& name);
+    Lock& lock(const std::string& channel, const std::string& name);
+    void maybe_acquire(Lock& lock, uint64_t now_ms, Step& step);
+    void arm_recheck(const Lock& lock, uint64_t now_ms, Step& step);
+    void fail_all(Lock& lock, LockOutcome outcome, Step& step);
+
+    Counters counters_;
+    std::unordered_map<std::string, Lock> locks_;
+    std::unordered_map<uint64_t, std::string> in_flight_;
+    std::unordered_map<uint64_t, Result> early_;
+};
+
+} // namespace atem_rtm
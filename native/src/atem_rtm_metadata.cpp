@@ -0,0 +1,236 @@
+#include "atem_rtm_metadata.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace atem_rtm {
+
+MetadataWriteBehind::MetadataWriteBehind(uint64_t window_ms) : window_ms_(window_ms) {}
+
+std::string MetadataWriteBehind::target_key(MetadataScope scope, const std::string& target) {
+    return (scope == MetadataScope::Channel ? "c:" : "u:") + target;
+}
+
+void MetadataWriteBehind::stage(
+    MetadataScope scope,
+    const std::string& target,
+    const std::string& key,
+    const std::string& value,
+    uint64_t now_ms,
+    uint64_t wall_ms) {
+    auto& pending = pending_[target_key(scope, target)];
+    if (pending.items.empty()) {
+        pending.scope = scope;
+        pending.target = target;
+        pending.first_staged_ms = now_ms;
+    }
+    auto& item = pending.items[key];
+    if (!item.key.empty()) {
+        ++counters_.coalesced;
+    }
+    item.key = key;
+    item.value = value;
+    item.local_ts_ms = wall_ms;
+    ++counters_.staged;
+}
+
+std::vector<MetadataWrite> MetadataWriteBehind::take_due(uint64_t now_ms, bool force) {
+    std::vector<MetadataWrite> due;
+    for (auto it = pending_.begin(); it != pending_.end();) {
+        const std::string& tk = it->first;
+        Pending& pending = it->second;
+        auto busy = busy_targets_.find(tk);
+        if ((busy != busy_targets_.end() && busy->second > 0) ||
+            (!force && now_ms - pending.first_staged_ms < window_ms_)) {
+            ++it;
+            continue;
+        }
+
+        MetadataWrite write;
+        write.scope = pending.scope;
+        write.target = pending.target;
+        write.attempt = pending.attempt;
+        auto known = known_.find(tk);
+        for (auto& entry : pending.items) {
+            MetadataWrite::Item item = std::move(entry.second);
+            if (known != known_.end()) {
+                auto rev = known->second.find(item.key);
+                if (rev != known->second.end()) item.revision = rev->second.revision;
+            }
+            write.items.push_back(std::move(item));
+        }
+        due.push_back(std::move(write));
+        it = pending_.erase(it);
+    }
+    return due;
+}
+
+uint64_t MetadataWriteBehind::next_due() const {
+    uint64_t next = UINT64_MAX;
+    for (const auto& entry : pending_) {
+        auto busy = busy_targets_.find(entry.first);
+        if (busy != busy_targets_.end() && busy->second > 0) continue;
+        next = std::min(next, entry.second.first_staged_ms + window_ms_);
+    }
+    return next;
+}
+
+void MetadataWriteBehind::issued(
+    uint64_t request_id,
+    MetadataWrite write,
+    uint64_t now_ms,
+    std::vector<Refresh>& refresh) {
+    ++busy_targets_[target_key(write.scope, write.target)];
+    ++counters_.writes;
+    in_flight_[request_id] = InFlight{std::move(write), observations_};
+
+    auto early = early_.find(request_id);
+    if (early != early_.end()) {
+        Result result = early->second;
+        early_.erase(early);
+        completed(request_id, result, now_ms, refresh);
+    }
+}
+
+void MetadataWriteBehind::completed(
+    uint64_t request_id,
+    Result result,
+    uint64_t now_ms,
+    std::vector<Refresh>& refresh) {
+    auto it = in_flight_.find(request_id);
+    if (it == in_flight_.end()) {
+        // Raced ahead of issued(); a handful at most.
+        if (early_.size() >= 64) early_.clear();
+        early_[request_id] = result;
+        return;
+    }
+    MetadataWrite write = std::move(it->second.write);
+    const uint64_t issued_at = it->second.observations;
+    in_flight_.erase(it);
+    const std::string tk = target_key(write.scope, write.target);
+    const bool attempts_left = write.attempt + 1 < kMaxAttempts;
+
+    if (result.conflict) {
+        ++counters_.conflicts;
+    }
+    if (result.conflict && attempts_left) {
+        // Stays busy until the re-read lands so nothing overtakes the retry.
+        auto& parked = awaiting_refresh_[tk];
+        if (parked.empty()) refresh.push_back(Refresh{write.scope, write.target});
+        parked.push_back(std::move(write));
+        return;
+    }
+
+    if (result.ok) {
+        ++counters_.written;
+        // Our write bumped these revisions. Storage events may have told us
+        // the new ones already; otherwise re-read, and hold the next write
+        // until then so it is not sent unconditionally.
+        auto& known = known_[tk];
+        bool stale = false;
+        for (const auto& item : write.items) {
+            auto rev = known.find(item.key);
+            if (rev != known.end() && rev->second.observation > issued_at) continue;
+            if (rev != known.end()) known.erase(rev);
+            stale = true;
+        }
+        if (stale && rereading_.insert(tk).second) {
+            if (!awaiting_refresh_.count(tk)) refresh.push_back(Refresh{write.scope, write.target});
+            return;
+        }
+        --busy_targets_[tk];
+        return;
+    }
+    --busy_targets_[tk];
+    if (result.retryable && attempts_left) {
+        ++write.attempt;
+        ++counters_.retries;
+        restage(std::move(write), now_ms);
+    } else {
+        counters_.failed += write.items.size();
+    }
+}
+
+void MetadataWriteBehind::observe(
+    MetadataScope scope,
+    const std::string& target,
+    const std::string& key,
+    int64_t revision,
+    uint64_t update_ts_ms) {
+    known_[target_key(scope, target)][key] = Known{revision, update_ts_ms, ++observations_};
+}
+
+void MetadataWriteBehind::forget(
+    MetadataScope scope,
+    const std::string& target,
+    const std::string& key) {
+    auto known = known_.find(target_key(scope, target));
+    if (known != known_.end()) known->second.erase(key);
+}
+
+void MetadataWriteBehind::refreshed(
+    MetadataScope scope,
+    const std::string& target,
+    bool ok,
+    uint64_t now_ms) {
+    const std::string tk = target_key(scope, target);
+    if (rereading_.erase(tk)) --busy_targets_[tk];
+    auto parked = awaiting_refresh_.find(tk);
+    if (parked == awaiting_refresh_.end()) {
+        return;
+    }
+    std::vector<MetadataWrite> writes = std::move(parked->second);
+    awaiting_refresh_.erase(parked);
+    auto known = known_.find(tk);
+
+    for (auto& write : writes) {
+        --busy_targets_[tk];
+        if (!ok) {
+            counters_.failed += write.items.size();
+            continue;
+        }
+        std::vector<MetadataWrite::Item> keep;
+        for (auto& item : write.items) {
+            if (known != known_.end()) {
+                auto rev = known->second.find(item.key);
+                if (rev != known->second.end() && rev->second.update_ts_ms > item.local_ts_ms) {
+                    // Someone wrote this key after we did: they are the last writer.
+                    ++counters_.superseded;
+                    continue;
+                }
+            }
+            keep.push_back(std::move(item));
+        }
+        if (keep.empty()) continue;
+        write.items = std::move(keep);
+        ++write.attempt;
+        ++counters_.retries;
+        restage(std::move(write), now_ms);
+    }
+}
+
+size_t MetadataWriteBehind::pending_items() const {
+    size_t count = 0;
+    for (const auto& entry : pending_) count += entry.second.items.size();
+    return count;
+}
+
+void MetadataWriteBehind::restage(MetadataWrite write, uint64_t now_ms) {
+    auto& pending = pending_[target_key(write.scope, write.target)];
+    if (pending.items.empty()) {
+        pending.scope = write.scope;
+        pending.target = write.target;
+        // Retries skip the coalescing window.
+        pending.first_staged_ms = now_ms > window_ms_ ? now_ms - window_ms_ : 0;
+    }
+    pending.attempt = std::max(pending.attempt, write.attempt);
+    for (auto& item : write.items) {
+        // Anything staged since the failed attempt is newer and wins.
+        if (!pending.items.count(item.key)) {
+            item.revision = -1;
+            pending.items[item.key] = std::move(item);
+        }
+    }
+}
+
+} // namespace atem_rtm
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace atem_rtm {
+
+constexpr uint32_t kDefaultMetadataWindowMs = 200;
+
+enum class MetadataScope { Channel, User };
+
+// One coalesced update ready for IRtmStorage::update{Channel,User}Metadata.
+struct MetadataWrite {
+    struct Item {
+        std::string key;
+        std::string value;
+        int64_t revision{-1};   // -1 writes unconditionally
+        uint64_t local_ts_ms{0}; // wall clock of the newest local update
+    };
+
+    MetadataScope scope{MetadataScope::Channel};
+    std::string target;
+    std::vector<Item> items;
+    int attempt{0};
+};
+
+// Write-behind buffer for metadata. Updates to the same target within the
+// window merge into one item array (last local write per key wins). Each
+// item carries the last revision we observed for the key, so the server
+// rejects the write if someone else changed it meanwhile; on that conflict
+// the target is re-read and the write retried unless the remote value is
+// newer than ours, which keeps last-writer-wins intact. At most one write
+// per target is in flight so local ordering is preserved. A successful
+// write bumps the revisions it touched; unless storage events already
+// reported the new ones, the target is re-read before its next write.
+// Not thread-safe; the owning client serialises access.
+class MetadataWriteBehind {
+public:
+    struct Counters {
+        uint64_t staged{0};
+        uint64_t coalesced{0};   // updates merged into an already pending key
+        uint64_t writes{0};      // SDK update requests issued
+        uint64_t written{0};     // ... and acknowledged successfully
+        uint64_t conflicts{0};
+        uint64_t retries{0};
+        uint64_t superseded{0};  // items dropped because a newer remote value won
+        uint64_t failed{0};
+    };
+
+    struct Refresh {
+        MetadataScope scope;
+        std::string target;
+    };
+
+    static constexpr int kMaxAttempts = 4;
+
+    explicit MetadataWriteBehind(uint64_t window_ms);
+
+    void stage(MetadataScope scope, const std::string& target, const std::string& key,
+               const std::string& value, uint64_t now_ms, uint64_t wall_ms);
+
+    // Batches whose window is up (all of them when `force`), with revisions
+    // filled in. Targets with a write in flight wait for it to finish.
+    std::vector<MetadataWrite> take_due(uint64_t now_ms, bool force);
+    // When take_due() next has a batch; UINT64_MAX when none can go.
+    // Targets with a write in flight wait for its result instead.
+    uint64_t next_due() const;
+
+    struct Result {
+        bool ok{false};
+        bool conflict{false};   // revision check failed
+        bool retryable{false};  // e.g. timeout; retry as is
+    };
+
+    // Registers a write handed to the SDK. A result that raced ahead of
+    // this call is applied here.
+    void issued(uint64_t request_id, MetadataWrite write, uint64_t now_ms,
+                std::vector<Refresh>& refresh);
+
+    // Feeds an update result back. Conflicting writes park until the target
+    // is re-read, and a successful one waits for the re-read that learns
+    // the revisions it produced; the caller issues a get for every entry
+    // appended to `refresh`.
+    void completed(uint64_t request_id, Result result, uint64_t now_ms,
+                   std::vector<Refresh>& refresh);
+
+    // Revisions learned from get results and storage events.
+    void observe(MetadataScope scope, const std::string& target, const std::string& key,
+                 int64_t revision, uint64_t update_ts_ms);
+    void forget(MetadataScope scope, const std::string& target, const std::string& key);
+
+    // Called after a re-read of `target` (successful or not) to retry or
+    // drop the writes parked on it and let the next write go.
+    void refreshed(MetadataScope scope, const std::string& target, bool ok, uint64_t now_ms);
+
+    size_t pending_items() const;
+    size_t in_flight() const { return in_flight_.size(); }
+    const Counters& counters() const { return counters_; }
+
+private:
+    struct Known {
+        int64_t revision{-1};
+        uint64_t update_ts_ms{0};
+        uint64_t observation{0};  // observations_ when it was learned
+    };
+
+    struct InFlight {
+        MetadataWrite write;
+        uint64_t observations{0};  // observations_ when it was issued
+    };
+
+    struct Pending {
+        MetadataScope scope{MetadataScope::Channel};
+        std::string target;
+        std::map<std::string, MetadataWrite::Item> items;
+        uint64_t first_staged_ms{0};
+        int attempt{0};
+    };
+
+    static std::string target_key(MetadataScope scope, const std::string& target);
+    void restage(MetadataWrite write, uint64_t now_ms);
+
+    uint64_t window_ms_;
+    Counters counters_;
+    std::unordered_map<std::string, Pending> pending_;
+    std::unordered_map<uint64_t, InFlight> in_flight_;
+    std::unordered_map<uint64_t, Result> early_;
+    std::unordered_map<std::string, size_t> busy_targets_;
+    std::unordered_map<std::string, std::vector<MetadataWrite>> awaiting_refresh_;
+    std::unordered_set<std::string> rereading_;  // after a successful write
+    uint64_t observations_{0};
+    std::unordered_map<std::string, std::unordered_map<std::string, Known>> known_;
+};
+
+} // namespace atem_rtm
@@ -0,0 +1,114 @@
+#include "atem_rtm_outbound.h"
+
+#include "atem_rtm_history.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace atem_rtm {
+
+namespace {
+
+constexpr uint64_t kCreditPerMessage = 1000;
+
+} // namespace
+
+OutboundScheduler::OutboundScheduler(uint32_t rate_per_s, uint32_t burst, uint32_t aging_ms)
+    : rate_(rate_per_s),
+      burst_(burst ? burst : kDefaultOutboundBurst),
+      aging_ms_(aging_ms ? aging_ms : kDefaultOutboundAgingMs),
+      credit_(burst_ * kCreditPerMessage) {}
+
+void OutboundScheduler::set_class(const std::string& message_class, uint32_t priority) {
+    classes_[message_class] = std::min<uint32_t>(priority, kOutboundBulk);
+}
+
+uint32_t OutboundScheduler::priority_of(const std::string& message_class) const {
+    if (message_class.empty()) return default_priority_;
+    auto it = classes_.find(message_class);
+    if (it != classes_.end()) return it->second;
+    const std::string base = partial_base(message_class);
+    if (!base.empty()) {
+        it = classes_.find(base);
+        if (it != classes_.end()) return it->second;
+    }
+    return default_priority_;
+}
+
+void OutboundScheduler::push(OutboundMessage msg, uint64_t now_ms) {
+    msg.priority = std::min<uint32_t>(msg.priority, kOutboundBulk);
+    msg.queued_ms = now_ms;
+    queues_[msg.priority].push_back(std::move(msg));
+}
+
+void OutboundScheduler::take_due(uint64_t now_ms, std::vector<OutboundMessage>& out) {
+    refill(now_ms);
+    int klass;
+    while (credit_ >= kCreditPerMessage && (klass = next_class()) >= 0) {
+        credit_ -= kCreditPerMessage;
+        pop(static_cast<size_t>(klass), now_ms, out);
+    }
+    // Whatever is left has to wait for credit.
+    for (auto& queue : queues_) {
+        for (auto it = queue.rbegin(); it != queue.rend() && !it->deferred; ++it) {
+            it->deferred = true;
+            ++counters_.deferred;
+        }
+    }
+}
+
+void OutboundScheduler::take_all(uint64_t now_ms, std::vector<OutboundMessage>& out) {
+    int klass;
+    while ((klass = next_class()) >= 0) pop(static_cast<size_t>(klass), now_ms, out);
+}
+
+uint64_t OutboundScheduler::next_due() const {
+    if (next_class() < 0) return UINT64_MAX;
+    if (credit_ >= kCreditPerMessage || rate_ == 0) return refilled_ms_;
+    return refilled_ms_ + (kCreditPerMessage - credit_ + rate_ - 1) / rate_;
+}
+
+size_t OutboundScheduler::depth() const {
+    size_t count = 0;
+    for (const auto& queue : queues_) count += queue.size();
+    return count;
+}
+
+void OutboundScheduler::refill(uint64_t now_ms) {
+    if (refilled_ms_ != 0 && now_ms > refilled_ms_) {
+        credit_ = std::min(credit_ + (now_ms - refilled_ms_) * rate_,
+                           burst_ * kCreditPerMessage);
+    }
+    refilled_ms_ = now_ms;
+}
+
+int OutboundScheduler::next_class() const {
+    int best = -1;
+    uint64_t best_turn = 0;
+    for (size_t klass = 0; klass < kOutboundClasses; ++klass) {
+        if (queues_[klass].empty()) continue;
+        const uint64_t turn = queues_[klass].front().queued_ms + klass * aging_ms_;
+        // Ties go to the more urgent class.
+        if (best < 0 || turn < best_turn) {
+            best = static_cast<int>(klass);
+            best_turn = turn;
+        }
+    }
+    return best;
+}
+
+void OutboundScheduler::pop(size_t klass, uint64_t now_ms, std::vector<OutboundMessage>& out) {
+    OutboundMessage& msg = queues_[klass].front();
+    for (size_t other = 0; other < klass; ++other) {
+        if (!queues_[other].empty()) {
+            ++counters_.aged;
+            break;
+        }
+    }
+    const uint64_t waited = now_ms > msg.queued_ms ? now_ms - msg.queued_ms : 0;
+    counters_.wait_ms_max[klass] = std::max(counters_.wait_ms_max[klass], waited);
+    out.push_back(std::move(msg));
+    queues_[klass].pop_front();
+}
+
+} // namespace atem_rtm
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace atem_rtm {
+
+// Priority classes, numbered as AtemRtmPriority.
+constexpr uint32_t kOutboundControl = 0;
+constexpr uint32_t kOutboundNormal = 1;
+constexpr uint32_t kOutboundBulk = 2;
+constexpr size_t kOutboundClasses = 3;
+
+constexpr uint32_t kDefaultOutboundBurst = 10;
+constexpr uint32_t kDefaultOutboundAgingMs = 250;
+constexpr uint32_t kNoOutboundBuffer = UINT32_MAX;
+
+// A publish (empty target) or peer send waiting for the pacer. Buffer
+// sends keep their registered buffer instead of a payload copy.
+struct OutboundMessage {
+    std::string target;
+    std::string payload;
+    uint32_t buffer_id{kNoOutboundBuffer};
+    size_t length{0};
+    uint32_t priority{kOutboundNormal};
+    uint64_t queued_ms{0};
+    bool deferred{false};  // left waiting by a take_due()
+};
+
+// Paces outbound messages with a token bucket (`rate_per_s` sustained,
+// `burst` at once) and lets them out in priority order. Each class is a
+// FIFO; a message's turn comes at queued_ms + priority * aging_ms, so
+// control messages overtake everything queued, and a bulk message that
+// has waited two aging periods goes ahead of a fresh control message
+// instead of starving. The class of a message comes from its message
+// class (see message_class()), as for HistoryPolicy.
+// Not thread-safe; the owning client serialises access.
+class OutboundScheduler {
+public:
+    struct Counters {
+        uint64_t deferred{0};  // had to wait for a send credit
+        uint64_t aged{0};      // sent ahead of a more urgent class by aging
+        uint64_t wait_ms_max[kOutboundClasses]{};
+    };
+
+    // rate_per_s 0 disables pacing; burst and aging_ms 0 pick the defaults.
+    OutboundScheduler(uint32_t rate_per_s, uint32_t burst, uint32_t aging_ms);
+
+    bool paced() const { return rate_ > 0; }
+
+    void set_class(const std::string& message_class, uint32_t priority);
+    void set_default(uint32_t priority) { default_priority_ = priority; }
+    uint32_t priority_of(const std::string& message_class) const;
+
+    void push(OutboundMessage msg, uint64_t now_ms);
+
+    // Moves the messages the send credit allows into `out`, in turn order.
+    void take_due(uint64_t now_ms, std::vector<OutboundMessage>& out);
+    // Everything, regardless of credit (shutdown).
+    void take_all(uint64_t now_ms, std::vector<OutboundMessage>& out);
+    // When take_due() next lets a message out; UINT64_MAX when empty.
+    uint64_t next_due() const;
+
+    size_t depth() const;
+    const Counters& counters() const { return counters_; }
+
+private:
+    void refill(uint64_t now_ms);
+    // Class whose front message's turn comes first; -1 when all are empty.
+    int next_class() const;
+    void pop(size_t klass, uint64_t now_ms, std::vector<OutboundMessage>& out);
+
+    uint64_t rate_;
+    uint64_t burst_;
+    uint64_t aging_ms_;
+    // Send credit in thousandths of a message.
+    uint64_t credit_;
+    uint64_t refilled_ms_{0};
+    std::deque<OutboundMessage> queues_[kOutboundClasses];
+    uint32_t default_priority_{kOutboundNormal};
+    std::unordered_map<std::string, uint32_t> classes_;
+    Counters counters_;
+};
+
+} // namespace atem_rtm
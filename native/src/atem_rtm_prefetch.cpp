@@ -0,0 +1,89 @@
+#include "atem_rtm_prefetch.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace atem_rtm {
+
+namespace {
+
+bool same_message(const InboundMessage& a, const InboundMessage& b) {
+    return a.server_ts == b.server_ts && a.publisher == b.publisher && a.payload == b.payload;
+}
+
+} // namespace
+
+HistoryPrefetch::HistoryPrefetch(uint64_t hold_ms) : hold_ms_(hold_ms) {}
+
+bool HistoryPrefetch::begin(const std::string& channel, uint64_t now_ms) {
+    if (pending_.count(channel)) return false;
+    pending_[channel].since_ms = now_ms;
+    ++counters_.fetches;
+    return true;
+}
+
+bool HistoryPrefetch::hold(InboundMessage& msg) {
+    auto it = pending_.find(msg.channel);
+    if (it == pending_.end()) return false;
+    it->second.live.push_back(std::move(msg));
+    return true;
+}
+
+void HistoryPrefetch::completed(
+    const std::string& channel,
+    bool ok,
+    std::vector<InboundMessage> history,
+    std::vector<InboundMessage>& out) {
+    auto it = pending_.find(channel);
+    if (it == pending_.end() || !ok) {
+        ++counters_.late;
+        if (it == pending_.end()) return;
+        history.clear();
+    }
+    std::vector<InboundMessage>& live = it->second.live;
+
+    std::stable_sort(history.begin(), history.end(),
+                     [](const InboundMessage& a, const InboundMessage& b) {
+                         return a.server_ts < b.server_ts;
+                     });
+    for (auto& msg : history) {
+        const bool duplicate = std::any_of(
+            live.begin(), live.end(),
+            [&msg](const InboundMessage& held) { return same_message(held, msg); });
+        if (duplicate) {
+            ++counters_.duplicates;
+            continue;
+        }
+        msg.channel = channel;
+        msg.replayed = true;
+        out.push_back(std::move(msg));
+        ++counters_.replayed;
+    }
+    for (auto& msg : live) out.push_back(std::move(msg));
+    pending_.erase(it);
+}
+
+void HistoryPrefetch::expire(uint64_t now_ms, std::vector<InboundMessage>& out) {
+    for (auto it = pending_.begin(); it != pending_.end();) {
+        if (now_ms - it->second.since_ms < hold_ms_) {
+            ++it;
+            continue;
+        }
+        for (auto& msg : it->second.live) out.push_back(std::move(msg));
+        it = pending_.erase(it);
+    }
+}
+
+uint64_t HistoryPrefetch::next_expiry() const {
+    uint64_t next = UINT64_MAX;
+    for (const auto& entry : pending_) next = std::min(next, entry.second.since_ms + hold_ms_);
+    return next;
+}
+
+size_t HistoryPrefetch::held() const {
+    size_t count = 0;
+    for (const auto& entry : pending_) count += entry.second.live.size();
+    return count;
+}
+
+} // namespace atem_rtm
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "atem_rtm_reorder.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace atem_rtm {
+
+// Live messages wait at most this long for the join-time history.
+constexpr uint32_t kDefaultPrefetchHoldMs = 2000;
+// One history page (the SDK's GetHistoryMessagesOptions limit).
+constexpr uint32_t kMaxPrefetchCount = 100;
+
+// Merges the history fetched when a channel is joined with the channel's
+// first live messages. Live messages are held until the history arrives
+// (or the hold runs out), then the history is released first, oldest
+// first and marked replayed, without the messages that were also received
+// live, followed by the held live messages in their delivery order.
+// History that arrives after the hold ran out is dropped, since the live
+// messages have been delivered already.
+// Not thread-safe; the owning client serialises access.
+class HistoryPrefetch {
+public:
+    struct Counters {
+        uint64_t fetches{0};
+        uint64_t replayed{0};    // history messages delivered
+        uint64_t duplicates{0};  // history messages also received live
+        uint64_t late{0};        // fetches that failed or missed the hold
+    };
+
+    explicit HistoryPrefetch(uint64_t hold_ms = kDefaultPrefetchHoldMs);
+
+    // Starts holding `channel`'s live messages. False if a fetch for it is
+    // already pending.
+    bool begin(const std::string& channel, uint64_t now_ms);
+
+    // Takes `msg` if its channel waits for history; it is released by
+    // completed() or expire().
+    bool hold(InboundMessage& msg);
+
+    // The fetch for `channel` finished; `history` is ignored unless `ok`.
+    void completed(const std::string& channel, bool ok, std::vector<InboundMessage> history,
+                   std::vector<InboundMessage>& out);
+
+    // Releases the live messages of fetches that waited out the hold.
+    void expire(uint64_t now_ms, std::vector<InboundMessage>& out);
+    // When the first hold runs out; UINT64_MAX when none is pending.
+    uint64_t next_expiry() const;
+
+    bool idle() const { return pending_.empty(); }
+    size_t held() const;
+    const Counters& counters() const { return counters_; }
+
+private:
+    struct Pending {
+        uint64_t since_ms{0};
+        std::vector<InboundMessage> live;
+    };
+
+    uint64_t hold_ms_;
+    std::map<std::string, Pending> pending_;
+    Counters counters_;
+};
+
+} // namespace atem_rtm
@@ -0,0 +1,60 @@
+#include "atem_rtm_presence.h"
+
+namespace atem_rtm {
+
+void PresenceCache::apply_snapshot(
+    const std::string& channel,
+    const std::vector<std::string>& users) {
+    auto& view = channels_[channel];
+    view.online.clear();
+    view.online.insert(users.begin(), users.end());
+    view.has_snapshot = true;
+}
+
+void PresenceCache::on_join(const std::string& channel, const std::string& user) {
+    channels_[channel].online.insert(user);
+}
+
+void PresenceCache::on_leave(const std::string& channel, const std::string& user) {
+    auto it = channels_.find(channel);
+    if (it != channels_.end()) {
+        it->second.online.erase(user);
+    }
+}
+
+void PresenceCache::apply(const PresenceDelta& delta, std::vector<std::string>& came_online) {
+    switch (delta.kind) {
+    case PresenceDelta::Kind::Snapshot:
+        apply_snapshot(delta.channel, delta.users);
+        came_online.insert(came_online.end(), delta.users.begin(), delta.users.end());
+        break;
+    case PresenceDelta::Kind::Join:
+        for (const auto& user : delta.users) {
+            on_join(delta.channel, user);
+            came_online.push_back(user);
+        }
+        break;
+    case PresenceDelta::Kind::Leave:
+        for (const auto& user : delta.users) {
+            on_leave(delta.channel, user);
+        }
+        break;
+    }
+}
+
+void PresenceCache::invalidate() {
+    channels_.clear();
+}
+
+PeerPresence PresenceCache::lookup(const std::string& user) const {
+    bool any_snapshot = false;
+    for (const auto& entry : channels_) {
+        if (entry.second.online.count(user)) {
+            return PeerPresence::Online;
+        }
+        any_snapshot = any_snapshot || entry.second.has_snapshot;
+    }
+    return any_snapshot ? PeerPresence::Offline : PeerPresence::Unknown;
+}
+
+} // namespace atem_rtm
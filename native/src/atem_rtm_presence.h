@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace atem_rtm {
+
+enum class PeerPresence {
+    Unknown,  // no snapshot covers this peer yet; callers should not block on it
+    Online,
+    Offline,
+};
+
+// One presence change, decoupled from the SDK event so it can be applied
+// immediately or batched (see idle mode).
+struct PresenceDelta {
+    enum class Kind { Snapshot, Join, Leave };
+
+    Kind kind;
+    std::string channel;
+    std::vector<std::string> users;
+};
+
+// Who is online in each subscribed channel, fed by onPresenceEvent.
+// Not thread-safe; the owning client serialises access.
+class PresenceCache {
+public:
+    void apply_snapshot(const std::string& channel, const std::vector<std::string>& users);
+    void on_join(const std::string& channel, const std::string& user);
+    void on_leave(const std::string& channel, const std::string& user);
+
+    // Applies a delta and appends the users it brought online to `came_online`.
+    void apply(const PresenceDelta& delta, std::vector<std::string>& came_online);
+
+    // Forget everything learned so far, e.g. after the link drops. The SDK
+    // sends a fresh snapshot once the subscription is restored.
+    void invalidate();
+
+    PeerPresence lookup(const std::string& user) const;
+
+private:
+    struct ChannelView {
+        std::unordered_set<std::string> online;
+        bool has_snapshot{false};
+    };
+
+    std::unordered_map<std::string, ChannelView> channels_;
+};
+
+} // namespace atem_rtm
@@ -2,15 +2,177 @@
 // This file is compiled only when the `real_rtm` Cargo feature is enabled.
 
 #include "atem_rtm.h"
+#include "atem_rtm_buffer_pool.h"
+#include "atem_rtm_clock.h"
+#include "atem_rtm_cpu.h"
+#include "atem_rtm_credit.h"
+#include "atem_rtm_dispatcher.h"
+#include "atem_rtm_events.h"
+#include "atem_rtm_history.h"
+#include "atem_rtm_hold_queue.h"
+#include "atem_rtm_inflight.h"
+#include "atem_rtm_location.h"
+#include "atem_rtm_lock_wait.h"
+#include "atem_rtm_metadata.h"
+#include "atem_rtm_outbound.h"
+#include "atem_rtm_prefetch.h"
+#include "atem_rtm_presence.h"
+#include "atem_rtm_reorder.h"
+#include "atem_rtm_series.h"
+#include "atem_rtm_single_flight.h"
+#include "atem_rtm_timers.h"
 
 #include "IAgoraRtmClient.h"
+#include "IAgoraRtmHistory.h"
 #include "AgoraRtmBase.h"
+#include "IAgoraRtmLock.h"
+#include "IAgoraRtmPresence.h"
+#include "IAgoraRtmStorage.h"
 
+#include <algorithm>
+#include <array>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <random>
 #include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t kDefaultIdleBatchWindowMs = 250;
+constexpr uint32_t kDefaultIdlePresenceIntervalMs = 5000;
+
+std::vector<atem_rtm::PresenceDelta> to_presence_deltas(
+    const agora::rtm::IRtmEventHandler::PresenceEvent& event) {
+    using Kind = atem_rtm::PresenceDelta::Kind;
+    const std::string channel = event.channelName ? event.channelName : "";
+    std::vector<atem_rtm::PresenceDelta> deltas;
+    auto add = [&](Kind kind, const char* const* users, size_t count) {
+        atem_rtm::PresenceDelta delta{kind, channel, {}};
+        for (size_t i = 0; i < count; ++i) {
+            if (users[i]) delta.users.emplace_back(users[i]);
+        }
+        deltas.push_back(std::move(delta));
+    };
+
+    switch (event.type) {
+    case agora::rtm::RTM_PRESENCE_EVENT_TYPE_SNAPSHOT: {
+        atem_rtm::PresenceDelta delta{Kind::Snapshot, channel, {}};
+        for (size_t i = 0; i < event.snapshot.userCount; ++i) {
+            const char* user = event.snapshot.userStateList[i].userId;
+            if (user) delta.users.emplace_back(user);
+        }
+        deltas.push_back(std::move(delta));
+        break;
+    }
+    case agora::rtm::RTM_PRESENCE_EVENT_TYPE_INTERVAL:
+        add(Kind::Join, event.interval.joinUserList.users, event.interval.joinUserList.userCount);
+        add(Kind::Leave, event.interval.leaveUserList.users, event.interval.leaveUserList.userCount);
+        add(Kind::Leave, event.interval.timeoutUserList.users,
+            event.interval.timeoutUserList.userCount);
+        break;
+    case agora::rtm::RTM_PRESENCE_EVENT_TYPE_REMOTE_JOIN_CHANNEL:
+        add(Kind::Join, &event.publisher, 1);
+        break;
+    case agora::rtm::RTM_PRESENCE_EVENT_TYPE_REMOTE_LEAVE_CHANNEL:
+    case agora::rtm::RTM_PRESENCE_EVENT_TYPE_REMOTE_TIMEOUT:
+        add(Kind::Leave, &event.publisher, 1);
+        break;
+    default:
+        break;
+    }
+    return deltas;
+}
+
+atem_rtm::MetadataWriteBehind::Result to_metadata_result(agora::rtm::RTM_ERROR_CODE code) {
+    atem_rtm::MetadataWriteBehind::Result result;
+    result.ok = code == agora::rtm::RTM_ERROR_OK;
+    result.conflict = code == agora::rtm::RTM_ERROR_STORAGE_OUTDATED_REVISION ||
+                      code == agora::rtm::RTM_ERROR_STORAGE_INVALID_REVISION;
+    result.retryable = code == agora::rtm::RTM_ERROR_STORAGE_OPERATION_TIMEOUT;
+    return result;
+}
+
+int to_lock_result(atem_rtm::LockOutcome outcome) {
+    switch (outcome) {
+    case atem_rtm::LockOutcome::Acquired:
+        return ATEM_RTM_OK;
+    case atem_rtm::LockOutcome::Closed:
+        return ATEM_RTM_ERR_CLOSED;
+    default:
+        return ATEM_RTM_ERROR;
+    }
+}
+
+uint32_t to_presence_subtype(atem_rtm::PresenceDelta::Kind kind) {
+    switch (kind) {
+    case atem_rtm::PresenceDelta::Kind::Snapshot:
+        return ATEM_RTM_PRESENCE_SNAPSHOT;
+    case atem_rtm::PresenceDelta::Kind::Join:
+        return ATEM_RTM_PRESENCE_JOIN;
+    default:
+        return ATEM_RTM_PRESENCE_LEAVE;
+    }
+}
+
+std::string read_prefix(const char* op, const std::string& channel) {
+    return atem_rtm::SingleFlight::key(op, channel) + '\x1f';
+}
+
+// Owned copy of an SDK string argument; empty when the SDK passed NULL.
+std::string copy_str(const char* value) {
+    return value ? value : "";
+}
+
+// Back to the NULL-for-absent form emit_result expects.
+const char* or_null(const std::string& value) {
+    return value.empty() ? nullptr : value.c_str();
+}
+
+// agora::rtm::MetadataItem with owned strings, for processing that
+// outlives the callback.
+struct OwnedMetadataItem {
+    std::string key;
+    std::string value;
+    bool has_value{false};
+    std::string author;
+    int64_t revision{0};
+    uint64_t update_ts{0};
+};
+
+std::vector<OwnedMetadataItem> copy_metadata(const agora::rtm::Metadata& data) {
+    std::vector<OwnedMetadataItem> items;
+    items.reserve(data.itemCount);
+    for (size_t i = 0; i < data.itemCount; ++i) {
+        const auto& item = data.items[i];
+        if (!item.key) continue;
+        OwnedMetadataItem copy;
+        copy.key = item.key;
+        if (item.value) copy.value = item.value;
+        copy.has_value = item.value != nullptr;
+        if (item.authorUserId) copy.author = item.authorUserId;
+        copy.revision = item.revision;
+        copy.update_ts = static_cast<uint64_t>(item.updateTs);
+        items.push_back(std::move(copy));
+    }
+    return items;
+}
+
+bool contains(const std::vector<std::string>& list, const std::string& value) {
+    for (const auto& item : list) {
+        if (item == value) return true;
+    }
+    return false;
+}
+
+} // namespace
 
 // ---------------------------------------------------------------------------
 // Internal state wrapped behind the opaque AtemRtmClient pointer
@@ -33,102 +195,1767 @@ struct AtemRtmClient : public agora::rtm::IRtmEventHandler {
     // Guard for callback invocations from SDK threads
     std::mutex mtx;
 
+    // Unified event stream (atem_rtm_poll_events). events_mtx nests inside
+    // mtx and state_mtx, never the other way round; the notify hook runs
+    // with neither held by emit().
+    std::mutex events_mtx;
+    atem_rtm::EventQueue events{atem_rtm::kDefaultEventQueueCapacity};
+    AtemRtmEventNotify event_notify{nullptr};
+    void* event_notify_data{nullptr};
+
+    // Per-second traffic for atem_rtm_get_stats_series (guarded by
+    // events_mtx), and the queue drops it has counted as errors.
+    atem_rtm::StatsSeries series;
+    uint64_t series_dropped{0};
+
+    // Caller holds events_mtx.
+    void sample_queue(uint64_t now) {
+        const uint64_t dropped = events.counters().dropped + events.fair().counters().shed;
+        series.errors(dropped - series_dropped, now);
+        series_dropped = dropped;
+        series.depth(events.depth(), now);
+    }
+
+    void record_outbound(size_t length) {
+        std::lock_guard<std::mutex> lock(events_mtx);
+        series.outbound(length, atem_rtm::now_ms());
+    }
+
+    void emit(const atem_rtm::EventRecord& record) {
+        std::unique_lock<std::mutex> lock(events_mtx);
+        const bool woke = events.push(record);
+        sample_queue(atem_rtm::now_ms());
+        notify_if(lock, woke);
+    }
+
+    // Wakes the consumer if the push found the queue empty; releases
+    // events_mtx first.
+    void notify_if(std::unique_lock<std::mutex>& lock, bool woke) {
+        AtemRtmEventNotify notify = woke ? event_notify : nullptr;
+        void* notify_data = event_notify_data;
+        lock.unlock();
+        if (notify) notify(notify_data);
+    }
+
+    void emit_result(uint32_t op, uint64_t request_id, int32_t code,
+                     const char* channel_name, const char* name = nullptr) {
+        atem_rtm::EventRecord record;
+        record.kind = ATEM_RTM_EVENT_RESULT;
+        record.subtype = op;
+        record.code = code;
+        record.request_id = request_id;
+        record.timestamp = atem_rtm::wall_ms();
+        if (channel_name) record.channel = channel_name;
+        if (name) record.with_name(name);
+        emit(std::move(record));
+    }
+
+    // Caller holds mtx, so records keep the order the callback sees.
+    // Straight into a queue slot, without an intermediate EventRecord.
+    // With flow control the stamp is remembered until the message is polled.
+    void emit_message(const atem_rtm::InboundMessage& msg) {
+        if (granter.enabled() && !msg.replayed) {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            granter.delivered(msg.publisher, msg.channel, client_id, msg.stamp,
+                              atem_rtm::now_ms());
+        }
+        std::unique_lock<std::mutex> lock(events_mtx);
+        const bool woke = events.push_message(
+            msg.server_ts, msg.replayed ? ATEM_RTM_MESSAGE_REPLAYED : ATEM_RTM_MESSAGE_LIVE,
+            msg.channel, msg.publisher, msg.payload);
+        const uint64_t now = atem_rtm::now_ms();
+        if (!msg.replayed) series.inbound(msg.payload.size(), now);
+        sample_queue(now);
+        notify_if(lock, woke);
+    }
+
+    // Presence-aware peer delivery; both guarded by state_mtx
+    std::mutex state_mtx;
+    atem_rtm::PresenceCache presence;
+    atem_rtm::PeerHoldQueue hold_queue{atem_rtm::kDefaultPeerHoldCapacity,
+                                       atem_rtm::kDefaultPeerHoldTtlMs};
+
+    // Inbound ordering (guarded by state_mtx) and the outbound sequence
+    // stamps that let remote shims order our messages the same way
+    atem_rtm::ReorderBuffer reorder{atem_rtm::kDefaultReorderWindowMs};
+    uint32_t stamp_epoch{0};
+    std::unordered_map<std::string, uint64_t> next_seq;
+    // Scratch reused by every send (guarded by state_mtx), so that the
+    // steady-state publish path does not allocate.
+    std::string destination_scratch;
+    std::string class_scratch;
+    // Read-cache prefix a history-stored publish invalidates; set at create.
+    std::string hist_prefix;
+
+    // Caller holds state_mtx. The next_seq key for `target`, or for the
+    // channel when it is null; valid until the next call.
+    const std::string& destination_key(const char* target) {
+        if (!target) return channel;
+        destination_scratch.assign(target);
+        return destination_scratch;
+    }
+
+    // Outbound publishes awaiting onPublishResult (guarded by state_mtx).
+    // `closing` is set by atem_rtm_shutdown and rejects new sends.
+    atem_rtm::InflightTracker inflight;
+    std::condition_variable inflight_cv;
+    std::atomic<bool> closing{false};
+
+    // Health probe (atem_rtm_health): plain atomics so supervisors can poll
+    // every frame without contending with SDK callbacks. The queue and
+    // in-flight figures are mirrored by sync_health() under state_mtx.
+    std::atomic<int32_t> link_state{agora::rtm::RTM_LINK_STATE_IDLE};
+    std::atomic<uint64_t> last_inbound_ms{0};
+    std::atomic<uint64_t> last_outbound_ms{0};
+    std::atomic<uint64_t> inbound_queued{0};
+    std::atomic<uint64_t> inbound_queued_since_ms{0};
+    std::atomic<uint64_t> requests_in_flight{0};
+    std::atomic<uint64_t> token_renewed_ms{0};
+
+    // Thread CPU time of each SDK callback and of tick, per event kind.
+    atem_rtm::CpuMeter cpu;
+
+    // Optional event thread (config.dispatcher_tick_ms). Without it the
+    // processing runs on the SDK thread that delivered the callback.
+    std::unique_ptr<atem_rtm::Dispatcher> dispatcher;
+
+    // Runs `work` on the dispatcher, charged to `slot` as continued work,
+    // or inline when there is none.
+    void dispatch(atem_rtm::CpuSlot slot, std::function<void()> work) {
+        if (!dispatcher) {
+            work();
+            return;
+        }
+        dispatcher->post([this, slot, work = std::move(work)] {
+            atem_rtm::CpuScope cpu_scope(cpu, slot, 0);
+            work();
+            arm_deadlines();
+        });
+    }
+
+    // The dispatcher has no tick: each component with a deadline gets a
+    // wheel timer armed for it (guarded by state_mtx), re-armed after
+    // every task that may have moved it. atem_rtm_tick does without and
+    // runs everything that is due.
+    enum DeadlineSlot : size_t {
+        kReorderDeadline,
+        kHoldDeadline,
+        kPrefetchDeadline,
+        kIdleBatchDeadline,
+        kIdlePresenceDeadline,
+        kMetadataDeadline,
+        kOutboundDeadline,
+        kCreditDeadline,
+        kGrantsDeadline,
+        kDeadlineSlots
+    };
+    struct Deadline {
+        atem_rtm::TimerId timer{atem_rtm::kNoTimer};
+        uint64_t at{UINT64_MAX};
+        uint64_t generation{0};
+    };
+    std::array<Deadline, kDeadlineSlots> deadlines;
+    uint64_t deadline_generation{0};
+    uint32_t deadline_slack_ms{0};
+
+    // Moves every component's timer to its current deadline.
+    void arm_deadlines() {
+        if (!dispatcher) return;
+        std::lock_guard<std::mutex> lock(state_mtx);
+        if (granter.enabled()) release_discarded();
+        const uint64_t now = atem_rtm::now_ms();
+        arm_deadline(kReorderDeadline, reorder.next_deadline(), now);
+        arm_deadline(kHoldDeadline, hold_queue.next_expiry(), now);
+        arm_deadline(kPrefetchDeadline, prefetch.next_expiry(), now);
+        arm_deadline(kIdleBatchDeadline,
+                     idle && !idle_batch.empty() ? idle_batch_since_ms + idle_batch_window_ms
+                                                 : UINT64_MAX,
+                     now);
+        arm_deadline(kIdlePresenceDeadline,
+                     !idle_presence.empty() ? idle_presence_since_ms + idle_presence_interval_ms
+                                            : UINT64_MAX,
+                     now);
+        arm_deadline(kMetadataDeadline, metadata.next_due(), now);
+        arm_deadline(kOutboundDeadline, outbound.next_due(), now);
+        arm_deadline(kCreditDeadline, credit_gate.next_expiry(), now);
+        arm_deadline(kGrantsDeadline, granter.enabled() ? granter.next_due() : UINT64_MAX, now);
+    }
+
+    // Caller holds state_mtx.
+    void arm_deadline(DeadlineSlot slot, uint64_t at, uint64_t now) {
+        Deadline& deadline = deadlines[slot];
+        if (deadline.at == at) return;
+        if (deadline.timer != atem_rtm::kNoTimer) dispatcher->cancel(deadline.timer);
+        deadline.timer = atem_rtm::kNoTimer;
+        deadline.at = at;
+        deadline.generation = ++deadline_generation;
+        if (at == UINT64_MAX) return;
+        deadline.timer = dispatcher->schedule(
+            at > now ? at - now : 0,
+            [this, slot, generation = deadline.generation] {
+                atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Dispatch);
+                {
+                    std::lock_guard<std::mutex> lock(state_mtx);
+                    // Re-armed meanwhile: the newer timer does the work.
+                    if (deadlines[slot].generation != generation) return;
+                    deadlines[slot] = Deadline{};
+                }
+                run_deadline(slot);
+                arm_deadlines();
+            },
+            deadline_slack_ms);
+    }
+
+    void run_deadline(DeadlineSlot slot) {
+        const uint64_t now = atem_rtm::now_ms();
+        switch (slot) {
+        case kReorderDeadline:
+            release_reordered();
+            break;
+        case kHoldDeadline:
+            expire_held();
+            break;
+        case kPrefetchDeadline:
+            expire_prefetch();
+            break;
+        case kIdleBatchDeadline:
+            flush_idle_batch(now, false);
+            break;
+        case kIdlePresenceDeadline:
+            apply_idle_presence(now, false);
+            break;
+        case kMetadataDeadline:
+            flush_metadata(false);
+            break;
+        case kOutboundDeadline:
+            flush_outbound(false);
+            break;
+        case kCreditDeadline:
+            flush_credit(false);
+            break;
+        case kGrantsDeadline:
+            send_grants();
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Timers of a client without a dispatcher, run by atem_rtm_tick.
+    // timers_mtx is taken after state_mtx.
+    std::mutex timers_mtx;
+    atem_rtm::TimerWheel timers{atem_rtm::now_ms()};
+
+    // Runs `task` after `delay_ms`: on the dispatcher's wheel when there is
+    // one, else from the next atem_rtm_tick past the deadline.
+    atem_rtm::TimerId schedule_timer(uint64_t delay_ms, std::function<void()> task) {
+        if (dispatcher) {
+            return dispatcher->schedule(delay_ms, [this, task = std::move(task)] {
+                atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Dispatch);
+                task();
+            });
+        }
+        std::lock_guard<std::mutex> lock(timers_mtx);
+        return timers.schedule(atem_rtm::now_ms() + delay_ms, std::move(task));
+    }
+
+    void cancel_timer(atem_rtm::TimerId id) {
+        if (id == atem_rtm::kNoTimer) return;
+        if (dispatcher) {
+            dispatcher->cancel(id);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(timers_mtx);
+        timers.cancel(id);
+    }
+
+    // Caller holds state_mtx.
+    void sync_health() {
+        uint64_t queued = reorder.depth() + idle_batch.size() + prefetch.held();
+        if (queued == 0) {
+            inbound_queued_since_ms.store(0, std::memory_order_relaxed);
+        } else if (inbound_queued.load(std::memory_order_relaxed) == 0) {
+            inbound_queued_since_ms.store(atem_rtm::now_ms(), std::memory_order_relaxed);
+        }
+        inbound_queued.store(queued, std::memory_order_relaxed);
+        requests_in_flight.store(inflight.size() + metadata.in_flight(),
+                                 std::memory_order_relaxed);
+    }
+
+    void track_publish(uint64_t request_id) {
+        std::lock_guard<std::mutex> lock(state_mtx);
+        uint64_t now = atem_rtm::now_ms();
+        inflight.sent(request_id, now);
+        last_outbound_ms.store(now, std::memory_order_relaxed);
+        sync_health();
+        if (inflight.size() == 0) inflight_cv.notify_all();
+    }
+
+    // `target` null stamps a channel publish. Returns the sequence number
+    // used.
+    uint64_t next_stamp(const char* target, char* buf) {
+        std::lock_guard<std::mutex> lock(state_mtx);
+        const uint64_t seq = next_seq[destination_key(target)]++;
+        atem_rtm::format_sender_stamp(buf, stamp_epoch, seq);
+        return seq;
+    }
+
+    // The SDK's publish() returns nothing; a request it refuses up front
+    // is left without a request id. That publish is not tracked, its
+    // stamp is given back unless a later one was taken, and the caller
+    // gets ATEM_RTM_ERROR.
+    int publish_issued(const char* target, uint64_t seq, uint64_t request_id, size_t length) {
+        if (request_id == 0) {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            uint64_t& next = next_seq[destination_key(target)];
+            if (next == seq + 1) next = seq;
+            return ATEM_RTM_ERROR;
+        }
+        track_publish(request_id);
+        record_outbound(length);
+        return 0;
+    }
+
+    // Low-power idle mode (guarded by state_mtx): inbound deliveries and
+    // presence changes are batched, extra topic subscriptions are paused.
+    bool idle{false};
+    uint32_t idle_batch_window_ms{kDefaultIdleBatchWindowMs};
+    uint32_t idle_presence_interval_ms{kDefaultIdlePresenceIntervalMs};
+    uint64_t idle_batch_since_ms{0};
+    uint64_t idle_presence_since_ms{0};
+    uint64_t idle_batched_messages{0};
+    std::vector<atem_rtm::InboundMessage> idle_batch;
+    std::vector<atem_rtm::PresenceDelta> idle_presence;
+    std::vector<std::string> joined_channels;
+    std::vector<std::string> topic_channels;
+    std::vector<std::string> paused_topics;
+
+    // Join-time history (guarded by state_mtx): live messages on a channel
+    // whose history is being fetched are held until it is merged in.
+    atem_rtm::HistoryPrefetch prefetch;
+    uint32_t join_history_count{0};
+
+    // `may_hold` is false for what the prefetch itself releases.
+    void deliver(std::vector<atem_rtm::InboundMessage>& ready, bool may_hold = true) {
+        if (ready.empty()) return;
+        {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            if (may_hold && !prefetch.idle()) {
+                ready.erase(std::remove_if(ready.begin(), ready.end(),
+                                           [this](atem_rtm::InboundMessage& msg) {
+                                               return prefetch.hold(msg);
+                                           }),
+                            ready.end());
+                sync_health();
+                if (ready.empty()) return;
+            }
+            if (idle) {
+                if (idle_batch.empty()) idle_batch_since_ms = atem_rtm::now_ms();
+                idle_batched_messages += ready.size();
+                for (auto& msg : ready) idle_batch.push_back(std::move(msg));
+                sync_health();
+                return;
+            }
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        for (const auto& msg : ready) {
+            emit_message(msg);
+            // The legacy callback only ever sees live traffic.
+            if (callback && !msg.replayed) {
+                callback(msg.publisher.c_str(), msg.payload.c_str(), user_data);
+            }
+        }
+    }
+
+    // Delivers the idle batch once its window is up, or unconditionally
+    // when leaving idle mode. Holding `mtx` across the swap keeps anything
+    // delivered after the resume behind the batch.
+    void flush_idle_batch(uint64_t now, bool resume) {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::vector<atem_rtm::InboundMessage> batch;
+        {
+            std::lock_guard<std::mutex> state_lock(state_mtx);
+            if (resume) {
+                idle = false;
+            } else if (!idle || idle_batch.empty() ||
+                       now - idle_batch_since_ms < idle_batch_window_ms) {
+                return;
+            }
+            batch.swap(idle_batch);
+            sync_health();
+        }
+        for (const auto& msg : batch) {
+            emit_message(msg);
+            if (callback && !msg.replayed) {
+                callback(msg.publisher.c_str(), msg.payload.c_str(), user_data);
+            }
+        }
+    }
+
+    // Applies batched presence once the idle interval is up (or always when
+    // `force`), then releases held messages for peers that came back.
+    void apply_idle_presence(uint64_t now, bool force) {
+        std::vector<std::string> came_online;
+        {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            if (idle_presence.empty() ||
+                (!force && now - idle_presence_since_ms < idle_presence_interval_ms)) {
+                return;
+            }
+            for (const auto& delta : idle_presence) presence.apply(delta, came_online);
+            idle_presence.clear();
+        }
+        flush_held(came_online);
+    }
+
+    // Subscribe used by atem_rtm_join_channel and bring-ups. With
+    // join_history_count the history fetch goes out right behind it.
+    uint64_t subscribe_channel(const char* channel_name) {
+        agora::rtm::SubscribeOptions opts;
+        opts.withMessage = true;
+        opts.withPresence = true;
+        opts.withMetadata = false;
+        // Lock events drive the local lock wait lists.
+        opts.withLock = true;
+
+        bool fetch_history = false;
+        {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            if (!contains(joined_channels, channel_name)) {
+                joined_channels.emplace_back(channel_name);
+            }
+            // Before the subscribe, so no live message slips past the merge.
+            fetch_history =
+                join_history_count && prefetch.begin(channel_name, atem_rtm::now_ms());
+        }
+
+        uint64_t request_id = 0;
+        rtm_client->subscribe(channel_name, opts, request_id);
+        if (fetch_history) {
+            arm_deadlines();
+            prefetch_history(channel_name);
+        }
+        return request_id;
+    }
+
+    void prefetch_history(const std::string& channel_name) {
+        agora::rtm::GetHistoryMessagesOptions opts;
+        opts.messageCount = static_cast<uint16_t>(join_history_count);
+        agora::rtm::IRtmClient* rtm = rtm_client;
+        start_read(atem_rtm::SingleFlight::key("hist", channel_name,
+                                               std::to_string(opts.messageCount)),
+                   ReadWaiter{nullptr, nullptr, channel_name}, [&](uint64_t& request_id) {
+                       agora::rtm::IRtmHistory* history = rtm->getHistory();
+                       if (!history) return false;
+                       history->getMessages(channel_name.c_str(),
+                                            agora::rtm::RTM_CHANNEL_TYPE_MESSAGE, opts,
+                                            request_id);
+                       return true;
+                   });
+    }
+
+    void prefetch_done(const std::string& channel_name, const atem_rtm::ReadResult& result) {
+        std::vector<atem_rtm::InboundMessage> history;
+        for (const auto& item : result.items) {
+            atem_rtm::InboundMessage msg;
+            msg.publisher = item.key;
+            msg.payload = item.value;
+            msg.server_ts = item.timestamp;
+            history.push_back(std::move(msg));
+        }
+        std::vector<atem_rtm::InboundMessage> ready;
+        {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            prefetch.completed(channel_name, result.code == agora::rtm::RTM_ERROR_OK,
+                               std::move(history), ready);
+            sync_health();
+        }
+        deliver(ready, false);
+    }
+
+    // Pending atem_rtm_bring_up (guarded by state_mtx). The login result
+    // issues the subscribe, the subscribe result completes it.
+    struct BringUp {
+        std::string channel;
+        AtemRtmReadyCallback callback{nullptr};
+        void* user_data{nullptr};
+        bool subscribing{false};
+    };
+    std::unique_ptr<BringUp> bring_up;
+
+    // Completes the pending bring-up with `result`. With a channel, only a
+    // bring-up waiting for that channel's subscribe result is completed.
+    void finish_bring_up(const char* channel_name, int result) {
+        std::unique_ptr<BringUp> done;
+        {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            if (!bring_up) return;
+            if (channel_name && (!bring_up->subscribing || bring_up->channel != channel_name)) {
+                return;
+            }
+            done = std::move(bring_up);
+        }
+        if (!done->callback) return;
+        std::lock_guard<std::mutex> lock(mtx);
+        done->callback(this, result, done->user_data);
+    }
+
+    void subscribe_topic_channel(const char* channel_name, const char* topic) {
+        // In RTM 2.x message channels, topics are not a first-class concept.
+        // Topic subscription is relevant for stream channels. For message channels,
+        // we subscribe to the channel itself which receives all messages.
+        // We perform a regular channel subscribe here as a reasonable fallback.
+        agora::rtm::SubscribeOptions opts;
+        opts.withMessage = true;
+        opts.withPresence = false;
+
+        uint64_t request_id = 0;
+        rtm_client->subscribe(channel_name, opts, request_id);
+        fprintf(stderr,
+                "[atem_rtm_real] subscribe_topic channel=%s topic=%s requestId=%llu\n",
+                channel_name, topic, (unsigned long long)request_id);
+    }
+
+    // Returns 0 with `request_id` set, or ATEM_RTM_ERROR when the SDK
+    // refused the publish.
+    int publish_peer_now(const char* target_client_id, const char* payload, size_t length,
+                         uint64_t* request_id) {
+        char stamp[atem_rtm::kSenderStampMax];
+        const uint64_t seq = next_stamp(target_client_id, stamp);
+
+        // In RTM 2.x, peer messaging is done by publishing to the user channel type.
+        agora::rtm::PublishOptions opts;
+        opts.channelType = agora::rtm::RTM_CHANNEL_TYPE_USER;
+        opts.messageType = agora::rtm::RTM_MESSAGE_TYPE_STRING;
+        opts.customType = stamp;
+
+        *request_id = 0;
+        rtm_client->publish(target_client_id, payload, length, opts, *request_id);
+        return publish_issued(target_client_id, seq, *request_id, length);
+    }
+
+    // As publish_peer_now, to the channel.
+    int publish_channel_now(const char* payload, size_t length, uint64_t* request_id) {
+        const char* channel_name = channel.c_str();
+        char stamp[atem_rtm::kSenderStampMax];
+        const uint64_t seq = next_stamp(nullptr, stamp);
+
+        agora::rtm::PublishOptions opts;
+        opts.channelType = agora::rtm::RTM_CHANNEL_TYPE_MESSAGE;
+        opts.messageType = agora::rtm::RTM_MESSAGE_TYPE_STRING;
+        opts.customType = stamp;
+
+        {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            atem_rtm::message_class(payload, length, &class_scratch);
+            opts.storeInHistory = history.should_store(class_scratch);
+            if (opts.storeInHistory) reads.invalidate_prefix(hist_prefix);
+        }
+
+        *request_id = 0;
+        rtm_client->publish(channel_name, payload, length, opts, *request_id);
+        return publish_issued(nullptr, seq, *request_id, length);
+    }
+
+    // Publishing to an offline user only earns a failed onPublishResult,
+    // so park the message until presence reports the peer back. Returns
+    // ATEM_RTM_QUEUED in that case; otherwise as publish_peer_now.
+    int send_peer_now(const char* target_client_id, const char* payload, size_t length,
+                      uint64_t* request_id) {
+        bool held = false;
+        {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            if (presence.lookup(target_client_id) == atem_rtm::PeerPresence::Offline) {
+                hold_queue.hold(target_client_id, std::string(payload, length),
+                                atem_rtm::now_ms());
+                held = true;
+            }
+        }
+        if (held) {
+            fprintf(stderr, "[atem_rtm_real] send_peer target=%s offline, holding len=%zu\n",
+                    target_client_id, length);
+            arm_deadlines();
+            return ATEM_RTM_QUEUED;
+        }
+        return publish_peer_now(target_client_id, payload, length, request_id);
+    }
+
+    // Paced sending (guarded by state_mtx). send_mtx keeps paced messages
+    // in turn order between taking them and handing them to the SDK; it
+    // is taken before state_mtx, never after.
+    std::mutex send_mtx;
+    atem_rtm::OutboundScheduler outbound{0, 0, 0};
+
+    // Flow control (guarded by state_mtx): the credit we grant publishers
+    // we receive from, and the sends held for the credit granted to us.
+    atem_rtm::CreditGranter granter{0, 0};
+    atem_rtm::CreditGate credit_gate{0, 0};
+
+    static atem_rtm::OutboundMessage outbound_message(const char* target, const char* payload,
+                                                      size_t length, uint32_t buffer_id) {
+        atem_rtm::OutboundMessage msg;
+        if (target) msg.target = target;
+        if (buffer_id == atem_rtm::kNoOutboundBuffer) {
+            msg.payload.assign(payload, length);
+        } else {
+            msg.buffer_id = buffer_id;
+            msg.length = length;
+        }
+        return msg;
+    }
+
+    // With pacing on, queues the message and sends whatever is due, this
+    // one included if it may go now. Without pacing, holds it if the
+    // credit does not cover it. Returns 0 when the caller should send it
+    // now, 1 when it was queued, and ATEM_RTM_ERR_BUSY when flow control
+    // is full and it would have to wait. A buffer sent now is marked
+    // sending, a queued one queued; a refused one stays the caller's.
+    int pace(const char* target, const char* payload, size_t length, uint32_t buffer_id) {
+        std::lock_guard<std::mutex> send_lock(send_mtx);
+        std::vector<atem_rtm::OutboundMessage> due;
+        {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            const bool buffered = buffer_id != atem_rtm::kNoOutboundBuffer;
+            const std::string& destination = destination_key(target);
+            const uint64_t now = atem_rtm::now_ms();
+            if (!outbound.paced()) {
+                // Unpaced sends still wait behind the credit.
+                if (credit_gate.allows(destination, next_seq[destination], now)) {
+                    if (buffered) buffers.sending(buffer_id);
+                    return 0;
+                }
+                atem_rtm::message_class(payload, length, &class_scratch);
+                if (!credit_gate.hold(destination,
+                                      outbound_message(target, payload, length, buffer_id),
+                                      class_scratch)) {
+                    return ATEM_RTM_ERR_BUSY;
+                }
+            } else {
+                if (credit_gate.refuses(destination, next_seq[destination], now)) {
+                    credit_gate.count_refused();
+                    return ATEM_RTM_ERR_BUSY;
+                }
+                atem_rtm::OutboundMessage msg =
+                    outbound_message(target, payload, length, buffer_id);
+                atem_rtm::message_class(payload, length, &class_scratch);
+                msg.priority = outbound.priority_of(class_scratch);
+                outbound.push(std::move(msg), now);
+                outbound.take_due(now, due);
+            }
+            if (buffered) buffers.queued(buffer_id);
+        }
+        send_paced(due);
+        arm_deadlines();
+        return 1;
+    }
+
+    // Sends what the pacer lets out now, or everything when `all`.
+    void flush_outbound(bool all) {
+        std::lock_guard<std::mutex> send_lock(send_mtx);
+        std::vector<atem_rtm::OutboundMessage> due;
+        {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            if (outbound.depth() == 0) return;
+            if (all) {
+                outbound.take_all(atem_rtm::now_ms(), due);
+            } else {
+                outbound.take_due(atem_rtm::now_ms(), due);
+            }
+        }
+        send_paced(due);
+    }
+
+    // Sends the held messages new credit covers, or all of them when `all`.
+    void flush_credit(bool all) {
+        std::lock_guard<std::mutex> send_lock(send_mtx);
+        std::vector<atem_rtm::OutboundMessage> ready;
+        {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            if (credit_gate.depth() == 0) return;
+            if (all) {
+                credit_gate.take_all(ready);
+            } else {
+                const uint64_t now = atem_rtm::now_ms();
+                for (const auto& destination : credit_gate.waiting()) {
+                    credit_gate.take_ready(destination, next_seq[destination], now, ready);
+                }
+            }
+        }
+        send_out(ready);
+    }
+
+    // Caller holds send_mtx. What the credit does not cover yet is held,
+    // or dropped when flow control is full.
+    void send_paced(std::vector<atem_rtm::OutboundMessage>& due) {
+        std::vector<atem_rtm::OutboundMessage> covered;
+        {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            const uint64_t now = atem_rtm::now_ms();
+            // Stamps the messages already let through will take.
+            std::unordered_map<std::string, uint64_t> planned;
+            for (auto& msg : due) {
+                const std::string& destination = msg.target.empty() ? channel : msg.target;
+                if (credit_gate.allows(destination, next_seq[destination] + planned[destination],
+                                       now)) {
+                    ++planned[destination];
+                    covered.push_back(std::move(msg));
+                    continue;
+                }
+                const uint32_t buffer_id = msg.buffer_id;
+                const bool buffered = buffer_id != atem_rtm::kNoOutboundBuffer;
+                atem_rtm::message_class(buffered ? buffers.data(buffer_id) : msg.payload.data(),
+                                        buffered ? msg.length : msg.payload.size(),
+                                        &class_scratch);
+                if (!credit_gate.hold(destination, std::move(msg), class_scratch) && buffered) {
+                    buffers.discard(buffer_id);
+                }
+            }
+        }
+        send_out(covered);
+    }
+
+    // Caller holds send_mtx.
+    void send_out(std::vector<atem_rtm::OutboundMessage>& due) {
+        for (auto& msg : due) {
+            const bool buffered = msg.buffer_id != atem_rtm::kNoOutboundBuffer;
+            const char* payload = msg.payload.data();
+            size_t length = msg.payload.size();
+            if (buffered) {
+                std::lock_guard<std::mutex> lock(state_mtx);
+                payload = buffers.data(msg.buffer_id);
+                length = msg.length;
+                buffers.sending(msg.buffer_id);
+            }
+            uint64_t request_id = 0;
+            const int rc = msg.target.empty()
+                               ? publish_channel_now(payload, length, &request_id)
+                               : send_peer_now(msg.target.c_str(), payload, length, &request_id);
+            if (buffered) {
+                std::lock_guard<std::mutex> lock(state_mtx);
+                if (rc != 0) {
+                    buffers.discard(msg.buffer_id);
+                } else {
+                    buffers.submitted(msg.buffer_id, request_id);
+                }
+            }
+        }
+    }
+
+    // Caller holds state_mtx. Live messages the event queue dropped or shed
+    // will never be polled; they free their publishers' credit all the same.
+    void release_discarded() {
+        std::vector<atem_rtm::DiscardedMessage> discarded;
+        {
+            std::lock_guard<std::mutex> lock(events_mtx);
+            events.take_discarded(discarded);
+        }
+        for (const auto& msg : discarded) granter.consumed(msg.publisher, msg.channel);
+    }
+
+    // Grants the credit polled messages have freed, and repeats standing
+    // grants. They go out on the publisher's user channel, outside the
+    // sequence stamps, pacing and credit.
+    void send_grants() {
+        std::vector<atem_rtm::CreditGranter::Grant> grants;
+        {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            if (!granter.enabled()) return;
+            release_discarded();
+            granter.take_grants(atem_rtm::now_ms(), grants);
+        }
+        for (const auto& grant : grants) {
+            char custom_type[atem_rtm::kSenderStampMax];
+            atem_rtm::format_credit_grant(custom_type, grant.epoch, grant.limit);
+            agora::rtm::PublishOptions opts;
+            opts.channelType = agora::rtm::RTM_CHANNEL_TYPE_USER;
+            opts.messageType = agora::rtm::RTM_MESSAGE_TYPE_STRING;
+            opts.customType = custom_type;
+            uint64_t request_id = 0;
+            rtm_client->publish(grant.publisher.c_str(), grant.destination.data(),
+                                grant.destination.size(), opts, request_id);
+        }
+    }
+
+    // Registered outbound buffers (guarded by state_mtx).
+    atem_rtm::BufferPool buffers{atem_rtm::kDefaultOutboundBufferCount,
+                                 atem_rtm::kDefaultOutboundBufferSize};
+
+    // storeInHistory per message class (guarded by state_mtx).
+    atem_rtm::HistoryPolicy history;
+
+    // Coalesced metadata writes (guarded by state_mtx).
+    atem_rtm::MetadataWriteBehind metadata{atem_rtm::kDefaultMetadataWindowMs};
+
+    // Issues the metadata batches whose window is up (all of them when
+    // `force`) as one update call per target.
+    void flush_metadata(bool force) {
+        std::vector<atem_rtm::MetadataWrite> due;
+        {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            due = metadata.take_due(atem_rtm::now_ms(), force);
+        }
+        for (auto& write : due) {
+            std::vector<agora::rtm::MetadataItem> items;
+            items.reserve(write.items.size());
+            for (const auto& item : write.items) {
+                items.emplace_back(item.key.c_str(), item.value.c_str(), item.revision);
+            }
+            agora::rtm::Metadata data;
+            data.items = items.data();
+            data.itemCount = items.size();
+            agora::rtm::MetadataOptions opts;
+            // Server timestamps let a conflicting retry tell whose write was last.
+            opts.recordTs = true;
+
+            uint64_t request_id = 0;
+            if (write.scope == atem_rtm::MetadataScope::Channel) {
+                rtm_client->getStorage()->updateChannelMetadata(
+                    write.target.c_str(), agora::rtm::RTM_CHANNEL_TYPE_MESSAGE, data, opts,
+                    nullptr, request_id);
+            } else {
+                rtm_client->getStorage()->updateUserMetadata(
+                    write.target.c_str(), data, opts, request_id);
+            }
+            fprintf(stderr,
+                    "[atem_rtm_real] metadata update target=%s items=%zu attempt=%d requestId=%llu\n",
+                    write.target.c_str(), items.size(), write.attempt,
+                    (unsigned long long)request_id);
+
+            std::vector<atem_rtm::MetadataWriteBehind::Refresh> refresh;
+            {
+                std::lock_guard<std::mutex> lock(state_mtx);
+                metadata.issued(request_id, std::move(write), atem_rtm::now_ms(), refresh);
+                sync_health();
+                if (metadata.in_flight() == 0) inflight_cv.notify_all();
+            }
+            refresh_metadata(refresh);
+        }
+    }
+
+    void refresh_metadata(const std::vector<atem_rtm::MetadataWriteBehind::Refresh>& refresh) {
+        for (const auto& target : refresh) {
+            uint64_t request_id = 0;
+            if (target.scope == atem_rtm::MetadataScope::Channel) {
+                rtm_client->getStorage()->getChannelMetadata(
+                    target.target.c_str(), agora::rtm::RTM_CHANNEL_TYPE_MESSAGE, request_id);
+            } else {
+                rtm_client->getStorage()->getUserMetadata(target.target.c_str(), request_id);
+            }
+            fprintf(stderr, "[atem_rtm_real] metadata re-reading target=%s\n",
+                    target.target.c_str());
+        }
+    }
+
+    void metadata_update_result(uint64_t request_id, agora::rtm::RTM_ERROR_CODE code) {
+        std::vector<atem_rtm::MetadataWriteBehind::Refresh> refresh;
+        {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            metadata.completed(request_id, to_metadata_result(code), atem_rtm::now_ms(), refresh);
+            sync_health();
+            if (metadata.in_flight() == 0) inflight_cv.notify_all();
+        }
+        refresh_metadata(refresh);
+    }
+
+    void metadata_get_result(atem_rtm::MetadataScope scope, const std::string& target,
+                             const std::vector<OwnedMetadataItem>& items, bool ok) {
+        if (target.empty()) return;
+        std::lock_guard<std::mutex> lock(state_mtx);
+        for (size_t i = 0; ok && i < items.size(); ++i) {
+            metadata.observe(scope, target, items[i].key, items[i].revision,
+                             items[i].update_ts);
+        }
+        metadata.refreshed(scope, target, ok, atem_rtm::now_ms());
+    }
+
+    // Local lock wait lists and the callbacks of their waiters (guarded by
+    // state_mtx).
+    struct LockWaiter {
+        AtemRtmLockCallback callback;
+        void* user_data;
+    };
+    atem_rtm::LockWaitList locks;
+    std::unordered_map<uint64_t, LockWaiter> lock_waiters;
+    uint64_t next_lock_waiter{1};
+    // Re-check timer per lock (channel '\x1f' name).
+    std::unordered_map<std::string, atem_rtm::TimerId> lock_rechecks;
+
+    // whereNow answers and the callbacks waiting on remote queries
+    // (guarded by state_mtx).
+    struct LocationWaiter {
+        AtemRtmWhereNowCallback callback;
+        void* user_data;
+    };
+    atem_rtm::LocationCache location{atem_rtm::kDefaultLocationTtlMs};
+    std::unordered_map<uint64_t, LocationWaiter> location_waiters;
+    uint64_t next_location_waiter{1};
+
+    // Collapsed presence/storage/history reads and their callbacks (guarded
+    // by state_mtx). Events that change the data drop cached results.
+    struct ReadWaiter {
+        AtemRtmReadCallback callback;
+        void* user_data;
+        std::string prefetch_channel;  // set for the join-time history fetch
+    };
+    atem_rtm::SingleFlight reads{0, 0};
+    std::unordered_map<uint64_t, ReadWaiter> read_waiters;
+    uint64_t next_read_waiter{1};
+
+    static void answer_read(const atem_rtm::ReadResult& result, AtemRtmReadCallback cb,
+                            void* cb_data) {
+        if (!cb) return;
+        std::vector<AtemRtmItem> items;
+        items.reserve(result.items.size());
+        for (const auto& item : result.items) {
+            items.push_back(AtemRtmItem{item.key.c_str(),
+                                        item.has_value ? item.value.data() : nullptr,
+                                        item.value.size(), item.timestamp});
+        }
+        cb(result.code, items.data(), items.size(), cb_data);
+    }
+
+    void complete_reads(const std::vector<atem_rtm::SingleFlight::Delivery>& done) {
+        if (done.empty()) return;
+        std::vector<std::pair<ReadWaiter, const atem_rtm::ReadResult*>> ready;
+        std::vector<std::pair<std::string, const atem_rtm::ReadResult*>> prefetched;
+        {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            for (const auto& delivery : done) {
+                auto it = read_waiters.find(delivery.waiter);
+                if (it == read_waiters.end()) continue;
+                if (it->second.prefetch_channel.empty()) {
+                    ready.emplace_back(it->second, delivery.result.get());
+                } else {
+                    prefetched.emplace_back(it->second.prefetch_channel, delivery.result.get());
+                }
+                read_waiters.erase(it);
+            }
+        }
+        // deliver() takes mtx itself.
+        for (const auto& entry : prefetched) prefetch_done(entry.first, *entry.second);
+        std::lock_guard<std::mutex> lock(mtx);
+        for (const auto& entry : ready) {
+            answer_read(*entry.second, entry.first.callback, entry.first.user_data);
+        }
+    }
+
+    void read_result(uint64_t request_id, atem_rtm::ReadResult result) {
+        std::vector<atem_rtm::SingleFlight::Delivery> done;
+        {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            reads.completed(request_id, std::move(result), atem_rtm::now_ms(), done);
+        }
+        complete_reads(done);
+    }
+
+    // Joins or starts the read `key`; `issue` sends the SDK request and
+    // returns false if it could not.
+    template <typename Issue>
+    int start_read(const std::string& key, AtemRtmReadCallback cb, void* cb_data, Issue issue) {
+        return start_read(key, ReadWaiter{cb, cb_data, {}}, issue);
+    }
+
+    template <typename Issue>
+    int start_read(const std::string& key, ReadWaiter reader, Issue issue) {
+        if (closing) return ATEM_RTM_ERR_CLOSED;
+        std::shared_ptr<const atem_rtm::ReadResult> cached;
+        atem_rtm::SingleFlight::Start start;
+        uint64_t waiter = 0;
+        {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            waiter = next_read_waiter++;
+            start = reads.begin(key, waiter, atem_rtm::now_ms(), cached);
+            if (start != atem_rtm::SingleFlight::Start::Cached) {
+                read_waiters[waiter] = reader;
+            }
+        }
+        if (start == atem_rtm::SingleFlight::Start::Cached) {
+            if (reader.prefetch_channel.empty()) {
+                answer_read(*cached, reader.callback, reader.user_data);
+            } else {
+                prefetch_done(reader.prefetch_channel, *cached);
+            }
+            return ATEM_RTM_OK;
+        }
+        if (start == atem_rtm::SingleFlight::Start::Issue) {
+            uint64_t request_id = 0;
+            const bool sent = issue(request_id);
+            std::vector<atem_rtm::SingleFlight::Delivery> done;
+            {
+                std::lock_guard<std::mutex> lock(state_mtx);
+                if (sent) {
+                    reads.issued(waiter, request_id, atem_rtm::now_ms(), done);
+                } else {
+                    reads.abandon(waiter, ATEM_RTM_ERROR, done);
+                }
+            }
+            complete_reads(done);
+        }
+        return ATEM_RTM_QUEUED;
+    }
+
+    void answer_location(const std::string& user, int result,
+                         const std::vector<std::string>& channels,
+                         AtemRtmWhereNowCallback cb, void* cb_data) {
+        if (!cb) return;
+        std::vector<const char*> names;
+        names.reserve(channels.size());
+        for (const auto& channel : channels) names.push_back(channel.c_str());
+        cb(user.c_str(), result, names.data(), names.size(), cb_data);
+    }
+
+    void complete_location_waiters(const std::vector<atem_rtm::LocationCache::Answer>& done) {
+        if (done.empty()) return;
+        std::vector<std::pair<LocationWaiter, const atem_rtm::LocationCache::Answer*>> ready;
+        {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            for (const auto& answer : done) {
+                auto it = location_waiters.find(answer.waiter);
+                if (it == location_waiters.end()) continue;
+                ready.emplace_back(it->second, &answer);
+                location_waiters.erase(it);
+            }
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        for (const auto& entry : ready) {
+            answer_location(entry.second->user,
+                            entry.second->ok ? ATEM_RTM_OK
+                                             : (closing ? ATEM_RTM_ERR_CLOSED : ATEM_RTM_ERROR),
+                            entry.second->channels, entry.first.callback, entry.first.user_data);
+        }
+    }
+
+    // Carries out what the wait list asked for. Registering an acquire can
+    // apply a result that raced ahead of it, so loop until nothing is left.
+    void run_lock_step(atem_rtm::LockWaitList::Step step) {
+        while (!step.empty()) {
+            atem_rtm::LockWaitList::Step next;
+            for (const auto& recheck : step.recheck) {
+                arm_lock_recheck(recheck);
+            }
+            for (const auto& key : step.release) {
+                uint64_t request_id = 0;
+                rtm_client->getLock()->releaseLock(key.channel.c_str(),
+                                                   agora::rtm::RTM_CHANNEL_TYPE_MESSAGE,
+                                                   key.name.c_str(), request_id);
+                fprintf(stderr, "[atem_rtm_real] releaseLock channel=%s lock=%s requestId=%llu\n",
+                        key.channel.c_str(), key.name.c_str(), (unsigned long long)request_id);
+            }
+            for (const auto& key : step.acquire) {
+                uint64_t request_id = 0;
+                // No SDK-side retry: the wait list re-acquires on LockEvents.
+                rtm_client->getLock()->acquireLock(key.channel.c_str(),
+                                                   agora::rtm::RTM_CHANNEL_TYPE_MESSAGE,
+                                                   key.name.c_str(), false, request_id);
+                fprintf(stderr, "[atem_rtm_real] acquireLock channel=%s lock=%s requestId=%llu\n",
+                        key.channel.c_str(), key.name.c_str(), (unsigned long long)request_id);
+                std::lock_guard<std::mutex> lock(state_mtx);
+                locks.issued(key.channel, key.name, request_id, atem_rtm::now_ms(), next);
+            }
+            complete_lock_waiters(step.done);
+            step = std::move(next);
+        }
+    }
+
+    // Replaces the lock's pending re-check with one `delay_ms` from now.
+    void arm_lock_recheck(const atem_rtm::LockWaitList::Recheck& recheck) {
+        std::string id = recheck.lock.channel;
+        id.push_back('\x1f');
+        id.append(recheck.lock.name);
+        std::lock_guard<std::mutex> lock(state_mtx);
+        atem_rtm::TimerId& timer = lock_rechecks[id];
+        cancel_timer(timer);
+        timer = schedule_timer(recheck.delay_ms, [this, key = recheck.lock] {
+            atem_rtm::LockWaitList::Step step;
+            {
+                std::lock_guard<std::mutex> lock(state_mtx);
+                locks.recheck(key.channel, key.name, atem_rtm::now_ms(), step);
+            }
+            run_lock_step(std::move(step));
+        });
+    }
+
+    void complete_lock_waiters(const std::vector<atem_rtm::LockWaitList::Completion>& done) {
+        if (done.empty()) return;
+        std::vector<std::pair<LockWaiter, const atem_rtm::LockWaitList::Completion*>> ready;
+        {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            for (const auto& completion : done) {
+                auto it = lock_waiters.find(completion.waiter);
+                if (it == lock_waiters.end()) continue;
+                ready.emplace_back(it->second, &completion);
+                lock_waiters.erase(it);
+            }
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        for (const auto& entry : ready) {
+            if (!entry.first.callback) continue;
+            entry.first.callback(entry.second->lock.channel.c_str(),
+                                 entry.second->lock.name.c_str(),
+                                 to_lock_result(entry.second->outcome), entry.first.user_data);
+        }
+    }
+
+    // Sends whatever was held for peers that just came online, through the
+    // pacer like any other send. Nothing more goes out once shutdown began.
+    void flush_held(const std::vector<std::string>& peers) {
+        for (const auto& peer : peers) {
+            if (closing) return;
+            std::vector<std::string> held;
+            {
+                std::lock_guard<std::mutex> lock(state_mtx);
+                held = hold_queue.release(peer, atem_rtm::now_ms());
+            }
+            if (held.empty()) continue;
+            fprintf(stderr, "[atem_rtm_real] flushing %zu held message(s) to %s\n",
+                    held.size(), peer.c_str());
+            for (const auto& payload : held) {
+                if (closing) return;
+                // Credit is only taken now; a full credit hold refuses it.
+                const int paced = pace(peer.c_str(), payload.data(), payload.size(),
+                                       atem_rtm::kNoOutboundBuffer);
+                if (paced == ATEM_RTM_ERR_BUSY) {
+                    fprintf(stderr,
+                            "[atem_rtm_real] credit hold full, dropping held message to %s\n",
+                            peer.c_str());
+                }
+                if (paced != 0) continue;
+                uint64_t request_id = 0;
+                send_peer_now(peer.c_str(), payload.data(), payload.size(), &request_id);
+            }
+        }
+    }
+
+    void release_reordered() {
+        std::vector<atem_rtm::InboundMessage> ready;
+        {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            reorder.poll(atem_rtm::now_ms(), ready);
+            sync_health();
+        }
+        deliver(ready);
+    }
+
+    void expire_held() {
+        std::lock_guard<std::mutex> lock(state_mtx);
+        hold_queue.expire(atem_rtm::now_ms());
+    }
+
+    void expire_prefetch() {
+        std::vector<atem_rtm::InboundMessage> unheld;
+        {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            prefetch.expire(atem_rtm::now_ms(), unheld);
+            sync_health();
+        }
+        deliver(unheld, false);
+    }
+
+    // Everything with a deadline that is due: reorder, hold expiry, idle
+    // batches, metadata write-behind, pacing and credit, plus the timers
+    // of a client without a dispatcher. Run by atem_rtm_tick; the
+    // dispatcher arms a timer per deadline instead.
+    void tick_work() {
+        release_reordered();
+        expire_held();
+        expire_prefetch();
+
+        uint64_t now = atem_rtm::now_ms();
+        flush_idle_batch(now, false);
+        apply_idle_presence(now, false);
+        flush_metadata(false);
+        flush_outbound(false);
+        flush_credit(false);
+        send_grants();
+
+        std::vector<atem_rtm::TimerWheel::Task> due;
+        {
+            std::lock_guard<std::mutex> lock(timers_mtx);
+            timers.advance(atem_rtm::now_ms(), due);
+        }
+        for (auto& task : due) task();
+    }
+
     // -----------------------------------------------------------------------
     // IRtmEventHandler overrides
+    //
+    // Each override copies what it needs out of the SDK's event (the buffers
+    // die with the callback) and hands the processing to dispatch().
     // -----------------------------------------------------------------------
 
     void onMessageEvent(const MessageEvent& event) override {
-        std::lock_guard<std::mutex> lock(mtx);
-        if (!callback) return;
+        atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Message);
+        atem_rtm::InboundMessage msg;
+        msg.publisher = event.publisher ? event.publisher : "";
+        msg.channel = event.channelName ? event.channelName : "";
+        // Copy by length: binary payloads are not null-terminated.
+        if (event.message) msg.payload.assign(event.message, event.messageLength);
+        msg.server_ts = event.timestamp;
+        msg.stamp = atem_rtm::parse_sender_stamp(event.customType);
+        last_inbound_ms.store(atem_rtm::now_ms(), std::memory_order_relaxed);
 
-        const char* sender = event.publisher ? event.publisher : "";
-        // For string messages the payload is a null-terminated string.
-        // For binary messages we still forward the pointer; the Rust side
-        // interprets it via the length in RtmEvent.
-        const char* payload = event.message ? event.message : "";
+        // Credit granted to us: never delivered, it releases held sends.
+        const atem_rtm::CreditGrant grant = atem_rtm::parse_credit_grant(event.customType);
+        if (grant.valid) {
+            dispatch(atem_rtm::CpuSlot::Message, [this, grant, msg = std::move(msg)] {
+                {
+                    std::lock_guard<std::mutex> lock(state_mtx);
+                    credit_gate.grant(msg.publisher, msg.payload, grant, atem_rtm::now_ms());
+                }
+                flush_credit(false);
+            });
+            return;
+        }
 
-        callback(sender, payload, user_data);
+        dispatch(atem_rtm::CpuSlot::Message, [this, msg = std::move(msg)]() mutable {
+            std::vector<atem_rtm::InboundMessage> ready;
+            {
+                std::lock_guard<std::mutex> lock(state_mtx);
+                reads.invalidate_prefix(read_prefix("hist", msg.channel));
+                reorder.push(std::move(msg), atem_rtm::now_ms(), ready);
+                sync_health();
+            }
+            deliver(ready);
+        });
     }
 
     void onPresenceEvent(const PresenceEvent& event) override {
-        (void)event;
+        atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Presence);
         fprintf(stderr, "[atem_rtm_real] onPresenceEvent type=%d channel=%s\n",
                 event.type, event.channelName ? event.channelName : "(null)");
+        dispatch(atem_rtm::CpuSlot::Presence,
+                 [this, deltas = to_presence_deltas(event), timestamp = event.timestamp,
+                  channel_name = copy_str(event.channelName)]() mutable {
+                     on_presence(std::move(deltas), timestamp, channel_name);
+                 });
+    }
+
+    void on_presence(std::vector<atem_rtm::PresenceDelta> deltas, uint64_t timestamp,
+                     const std::string& channel_name) {
+        for (const auto& delta : deltas) {
+            atem_rtm::EventRecord record;
+            record.kind = ATEM_RTM_EVENT_PRESENCE;
+            record.subtype = to_presence_subtype(delta.kind);
+            record.timestamp = timestamp;
+            record.channel = delta.channel;
+            if (delta.kind == atem_rtm::PresenceDelta::Kind::Snapshot) {
+                record.aux = static_cast<uint32_t>(delta.users.size());
+                // An empty snapshot still reports the (empty) roster.
+                if (delta.users.empty()) emit(record);
+            }
+            for (const auto& user : delta.users) {
+                atem_rtm::EventRecord per_user = record;
+                emit(std::move(per_user.with_user(user)));
+            }
+        }
+        std::vector<std::string> came_online;
+        {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            uint64_t now = atem_rtm::now_ms();
+            // Lookups stay exact even while idle batches the presence cache.
+            for (const auto& delta : deltas) location.apply(delta);
+            if (!channel_name.empty()) {
+                reads.invalidate(atem_rtm::SingleFlight::key("who", channel_name));
+                reads.invalidate_prefix(read_prefix("state", channel_name));
+            }
+            if (idle) {
+                // Interval-style while idle: applied together on the next tick.
+                if (idle_presence.empty()) idle_presence_since_ms = now;
+                for (auto& delta : deltas) idle_presence.push_back(std::move(delta));
+            } else {
+                for (const auto& delta : deltas) presence.apply(delta, came_online);
+            }
+            hold_queue.expire(now);
+        }
+        flush_held(came_online);
     }
 
     void onTopicEvent(const TopicEvent& event) override {
-        (void)event;
+        atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Topic);
         fprintf(stderr, "[atem_rtm_real] onTopicEvent type=%d channel=%s\n",
                 event.type, event.channelName ? event.channelName : "(null)");
+        std::vector<atem_rtm::EventRecord> records;
+        for (size_t i = 0; i < event.topicInfoCount; ++i) {
+            const auto& info = event.topicInfos[i];
+            if (!info.topic) continue;
+            atem_rtm::EventRecord record;
+            record.kind = ATEM_RTM_EVENT_TOPIC;
+            record.subtype = static_cast<uint32_t>(event.type);
+            record.timestamp = event.timestamp;
+            if (event.channelName) record.channel = event.channelName;
+            record.with_name(info.topic);
+            if (info.publisherCount == 0) {
+                if (event.publisher) record.with_user(event.publisher);
+                records.push_back(std::move(record));
+                continue;
+            }
+            for (size_t j = 0; j < info.publisherCount; ++j) {
+                const char* publisher = info.publishers[j].publisherUserId;
+                atem_rtm::EventRecord per_publisher = record;
+                if (publisher) per_publisher.with_user(publisher);
+                records.push_back(std::move(per_publisher));
+            }
+        }
+        dispatch(atem_rtm::CpuSlot::Topic, [this, records = std::move(records)]() mutable {
+            for (auto& record : records) emit(std::move(record));
+        });
     }
 
     void onLockEvent(const LockEvent& event) override {
-        (void)event;
+        atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Lock);
         fprintf(stderr, "[atem_rtm_real] onLockEvent type=%d channel=%s\n",
                 event.eventType, event.channelName ? event.channelName : "(null)");
+        if (!event.channelName) return;
+
+        // The records carry everything on_lock needs: channel, lock name
+        // (record.name) and owner (record.user, empty when free).
+        std::vector<atem_rtm::EventRecord> records;
+        for (size_t i = 0; i < event.count; ++i) {
+            const auto& detail = event.lockDetailList[i];
+            if (!detail.lockName) continue;
+            atem_rtm::EventRecord record;
+            record.kind = ATEM_RTM_EVENT_LOCK;
+            record.subtype = static_cast<uint32_t>(event.eventType);
+            record.aux = detail.ttl;
+            record.timestamp = event.timestamp;
+            record.channel = event.channelName;
+            record.with_name(detail.lockName);
+            if (detail.owner && detail.owner[0] != '\0') record.with_user(detail.owner);
+            records.push_back(std::move(record));
+        }
+        dispatch(atem_rtm::CpuSlot::Lock,
+                 [this, type = event.eventType, records = std::move(records)]() mutable {
+                     on_lock(type, std::move(records));
+                 });
+    }
+
+    void on_lock(agora::rtm::RTM_LOCK_EVENT_TYPE type,
+                 std::vector<atem_rtm::EventRecord> records) {
+        atem_rtm::LockWaitList::Step step;
+        {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            uint64_t now = atem_rtm::now_ms();
+            for (const auto& record : records) {
+                switch (type) {
+                case agora::rtm::RTM_LOCK_EVENT_TYPE_SNAPSHOT:
+                    if (record.user.empty()) {
+                        // Free in the snapshot: any hold of ours is gone.
+                        locks.on_expired(record.channel, record.name, now, step);
+                    } else if (client_id != record.user) {
+                        locks.on_held(record.channel, record.name, now, step);
+                    }
+                    break;
+                case agora::rtm::RTM_LOCK_EVENT_TYPE_LOCK_ACQUIRED:
+                    locks.on_held(record.channel, record.name, now, step);
+                    break;
+                case agora::rtm::RTM_LOCK_EVENT_TYPE_LOCK_SET:
+                case agora::rtm::RTM_LOCK_EVENT_TYPE_LOCK_RELEASED:
+                    locks.on_free(record.channel, record.name, now, step);
+                    break;
+                case agora::rtm::RTM_LOCK_EVENT_TYPE_LOCK_EXPIRED:
+                case agora::rtm::RTM_LOCK_EVENT_TYPE_LOCK_REMOVED:
+                    // Removed locks are "free" too: the acquire then fails
+                    // with LOCK_NOT_EXIST instead of leaving waiters hanging.
+                    locks.on_expired(record.channel, record.name, now, step);
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+        for (auto& record : records) emit(std::move(record));
+        run_lock_step(std::move(step));
+    }
+
+    void onAcquireLockResult(const uint64_t requestId, const char* channelName,
+                             agora::rtm::RTM_CHANNEL_TYPE channelType, const char* lockName,
+                             agora::rtm::RTM_ERROR_CODE errorCode,
+                             const char* errorDetails) override {
+        atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Result);
+        (void)channelType;
+        fprintf(stderr,
+                "[atem_rtm_real] onAcquireLockResult requestId=%llu channel=%s lock=%s errorCode=%d (%s)\n",
+                (unsigned long long)requestId, channelName ? channelName : "(null)",
+                lockName ? lockName : "(null)", errorCode, errorDetails ? errorDetails : "");
+        dispatch(atem_rtm::CpuSlot::Result, [this, requestId, errorCode,
+                                             channel_name = copy_str(channelName),
+                                             lock_name = copy_str(lockName)] {
+            atem_rtm::LockWaitList::Result result;
+            result.ok = errorCode == agora::rtm::RTM_ERROR_OK;
+            result.contended = errorCode == agora::rtm::RTM_ERROR_LOCK_ACQUIRE_FAILED ||
+                               errorCode == agora::rtm::RTM_ERROR_LOCK_NOT_AVAILABLE;
+            atem_rtm::LockWaitList::Step step;
+            {
+                std::lock_guard<std::mutex> lock(state_mtx);
+                locks.acquire_result(requestId, result, atem_rtm::now_ms(), step);
+            }
+            emit_result(ATEM_RTM_OP_ACQUIRE_LOCK, requestId, errorCode, or_null(channel_name),
+                        or_null(lock_name));
+            run_lock_step(std::move(step));
+        });
+    }
+
+    void onReleaseLockResult(const uint64_t requestId, const char* channelName,
+                             agora::rtm::RTM_CHANNEL_TYPE channelType, const char* lockName,
+                             agora::rtm::RTM_ERROR_CODE errorCode) override {
+        atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Result);
+        (void)channelType;
+        dispatch(atem_rtm::CpuSlot::Result, [this, requestId, errorCode,
+                                             channel_name = copy_str(channelName),
+                                             lock_name = copy_str(lockName)] {
+            emit_result(ATEM_RTM_OP_RELEASE_LOCK, requestId, errorCode, or_null(channel_name),
+                        or_null(lock_name));
+        });
     }
 
     void onStorageEvent(const StorageEvent& event) override {
-        (void)event;
+        atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Storage);
         fprintf(stderr, "[atem_rtm_real] onStorageEvent type=%d target=%s\n",
                 event.eventType, event.target ? event.target : "(null)");
+        if (!event.target) return;
+
+        const auto scope = event.storageType == agora::rtm::RTM_STORAGE_TYPE_USER
+                               ? atem_rtm::MetadataScope::User
+                               : atem_rtm::MetadataScope::Channel;
+        dispatch(atem_rtm::CpuSlot::Storage,
+                 [this, scope, type = event.eventType, timestamp = event.timestamp,
+                  target = std::string(event.target), items = copy_metadata(event.data)] {
+                     on_storage(scope, type, timestamp, target, items);
+                 });
+    }
+
+    void on_storage(atem_rtm::MetadataScope scope, agora::rtm::RTM_STORAGE_EVENT_TYPE type,
+                    uint64_t timestamp, const std::string& target,
+                    const std::vector<OwnedMetadataItem>& items) {
+        for (const auto& item : items) {
+            atem_rtm::EventRecord record;
+            record.kind = ATEM_RTM_EVENT_STORAGE;
+            record.subtype = static_cast<uint32_t>(type);
+            record.aux = scope == atem_rtm::MetadataScope::User ? ATEM_RTM_METADATA_USER
+                                                                : ATEM_RTM_METADATA_CHANNEL;
+            record.timestamp = timestamp;
+            record.channel = target;
+            record.with_name(item.key);
+            if (item.has_value) record.with_payload(item.value);
+            if (!item.author.empty()) record.with_user(item.author);
+            emit(std::move(record));
+        }
+        // Keep the revisions our conditional writes are checked against fresh.
+        std::lock_guard<std::mutex> lock(state_mtx);
+        if (scope == atem_rtm::MetadataScope::Channel) {
+            reads.invalidate(atem_rtm::SingleFlight::key("meta", target));
+        }
+        for (const auto& item : items) {
+            if (type == agora::rtm::RTM_STORAGE_EVENT_TYPE_REMOVE) {
+                metadata.forget(scope, target, item.key);
+            } else {
+                metadata.observe(scope, target, item.key, item.revision, item.update_ts);
+            }
+        }
+    }
+
+    void onUpdateChannelMetadataResult(const uint64_t requestId, const char* channelName,
+                                       agora::rtm::RTM_CHANNEL_TYPE channelType,
+                                       agora::rtm::RTM_ERROR_CODE errorCode) override {
+        atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Result);
+        (void)channelType;
+        fprintf(stderr,
+                "[atem_rtm_real] onUpdateChannelMetadataResult requestId=%llu channel=%s errorCode=%d\n",
+                (unsigned long long)requestId, channelName ? channelName : "(null)", errorCode);
+        dispatch(atem_rtm::CpuSlot::Result,
+                 [this, requestId, errorCode, channel_name = copy_str(channelName)] {
+                     emit_result(ATEM_RTM_OP_SET_METADATA, requestId, errorCode,
+                                 or_null(channel_name));
+                     if (!channel_name.empty()) {
+                         std::lock_guard<std::mutex> lock(state_mtx);
+                         reads.invalidate(atem_rtm::SingleFlight::key("meta", channel_name));
+                     }
+                     metadata_update_result(requestId, errorCode);
+                 });
+    }
+
+    void onUpdateUserMetadataResult(const uint64_t requestId, const char* userId,
+                                    agora::rtm::RTM_ERROR_CODE errorCode) override {
+        atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Result);
+        fprintf(stderr,
+                "[atem_rtm_real] onUpdateUserMetadataResult requestId=%llu user=%s errorCode=%d\n",
+                (unsigned long long)requestId, userId ? userId : "(null)", errorCode);
+        dispatch(atem_rtm::CpuSlot::Result,
+                 [this, requestId, errorCode, user = copy_str(userId)] {
+                     emit_result(ATEM_RTM_OP_SET_METADATA, requestId, errorCode, or_null(user));
+                     metadata_update_result(requestId, errorCode);
+                 });
+    }
+
+    void onGetChannelMetadataResult(const uint64_t requestId, const char* channelName,
+                                    agora::rtm::RTM_CHANNEL_TYPE channelType,
+                                    const agora::rtm::Metadata& data,
+                                    agora::rtm::RTM_ERROR_CODE errorCode) override {
+        atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Result);
+        (void)channelType;
+        dispatch(atem_rtm::CpuSlot::Result, [this, requestId, errorCode,
+                                             channel_name = copy_str(channelName),
+                                             items = copy_metadata(data)] {
+            emit_result(ATEM_RTM_OP_GET_METADATA, requestId, errorCode, or_null(channel_name));
+            metadata_get_result(atem_rtm::MetadataScope::Channel, channel_name, items,
+                                errorCode == agora::rtm::RTM_ERROR_OK);
+            atem_rtm::ReadResult result;
+            result.code = errorCode;
+            for (const auto& item : items) {
+                result.items.push_back(
+                    atem_rtm::ReadItem{item.key, item.value, item.has_value, item.update_ts});
+            }
+            read_result(requestId, std::move(result));
+        });
+    }
+
+    void onPresenceGetStateResult(const uint64_t requestId, const agora::rtm::UserState& state,
+                                  agora::rtm::RTM_ERROR_CODE errorCode) override {
+        atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Result);
+        atem_rtm::ReadResult result;
+        result.code = errorCode;
+        for (size_t i = 0; i < state.statesCount; ++i) {
+            const auto& item = state.states[i];
+            if (!item.key) continue;
+            result.items.push_back(
+                atem_rtm::ReadItem{item.key, item.value ? item.value : "", item.value != nullptr, 0});
+        }
+        dispatch_read(ATEM_RTM_OP_GET_STATE, requestId, errorCode, std::move(result));
+    }
+
+    // Only the first page: channels here hold a handful of Atems.
+    void onWhoNowResult(const uint64_t requestId, const agora::rtm::UserState* userStateList,
+                        const size_t count, const char* nextPage,
+                        agora::rtm::RTM_ERROR_CODE errorCode) override {
+        atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Result);
+        (void)nextPage;
+        atem_rtm::ReadResult result;
+        result.code = errorCode;
+        for (size_t i = 0; userStateList && i < count; ++i) {
+            if (!userStateList[i].userId) continue;
+            result.items.push_back(atem_rtm::ReadItem{userStateList[i].userId, "", false, 0});
+        }
+        dispatch_read(ATEM_RTM_OP_WHO_NOW, requestId, errorCode, std::move(result));
+    }
+
+    void onGetHistoryMessagesResult(const uint64_t requestId,
+                                    const agora::rtm::HistoryMessage* messageList,
+                                    const size_t count, const uint64_t newStart,
+                                    agora::rtm::RTM_ERROR_CODE errorCode) override {
+        atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Result);
+        (void)newStart;
+        atem_rtm::ReadResult result;
+        result.code = errorCode;
+        for (size_t i = 0; messageList && i < count; ++i) {
+            const auto& message = messageList[i];
+            atem_rtm::ReadItem item;
+            item.key = message.publisher ? message.publisher : "";
+            if (message.message) item.value.assign(message.message, message.messageLength);
+            item.has_value = message.message != nullptr;
+            item.timestamp = message.timestamp;
+            result.items.push_back(std::move(item));
+        }
+        dispatch_read(ATEM_RTM_OP_GET_HISTORY, requestId, errorCode, std::move(result));
+    }
+
+    void dispatch_read(uint32_t op, uint64_t request_id, agora::rtm::RTM_ERROR_CODE code,
+                       atem_rtm::ReadResult result) {
+        dispatch(atem_rtm::CpuSlot::Result,
+                 [this, op, request_id, code, result = std::move(result)]() mutable {
+                     emit_result(op, request_id, code, nullptr);
+                     read_result(request_id, std::move(result));
+                 });
+    }
+
+    void onGetUserMetadataResult(const uint64_t requestId, const char* userId,
+                                 const agora::rtm::Metadata& data,
+                                 agora::rtm::RTM_ERROR_CODE errorCode) override {
+        atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Result);
+        dispatch(atem_rtm::CpuSlot::Result, [this, requestId, errorCode,
+                                             user = copy_str(userId),
+                                             items = copy_metadata(data)] {
+            emit_result(ATEM_RTM_OP_GET_METADATA, requestId, errorCode, or_null(user));
+            metadata_get_result(atem_rtm::MetadataScope::User, user, items,
+                                errorCode == agora::rtm::RTM_ERROR_OK);
+        });
+    }
+
+    void onGetUserChannelsResult(const uint64_t requestId, const agora::rtm::ChannelInfo* channels,
+                                 const size_t count,
+                                 agora::rtm::RTM_ERROR_CODE errorCode) override {
+        atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Result);
+        fprintf(stderr,
+                "[atem_rtm_real] onGetUserChannelsResult requestId=%llu count=%zu errorCode=%d\n",
+                (unsigned long long)requestId, count, errorCode);
+        std::vector<std::string> names;
+        for (size_t i = 0; channels && i < count; ++i) {
+            if (channels[i].channelName) names.emplace_back(channels[i].channelName);
+        }
+        dispatch(atem_rtm::CpuSlot::Result,
+                 [this, requestId, errorCode, names = std::move(names)]() mutable {
+                     std::vector<atem_rtm::LocationCache::Answer> done;
+                     {
+                         std::lock_guard<std::mutex> lock(state_mtx);
+                         location.result(requestId, errorCode == agora::rtm::RTM_ERROR_OK,
+                                         std::move(names), atem_rtm::now_ms(), done);
+                     }
+                     emit_result(ATEM_RTM_OP_WHERE_NOW, requestId, errorCode, nullptr);
+                     complete_location_waiters(done);
+                 });
     }
 
     void onLinkStateEvent(const LinkStateEvent& event) override {
+        atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::LinkState);
         fprintf(stderr,
                 "[atem_rtm_real] onLinkStateEvent prev=%d cur=%d service=%d reason=%d\n",
                 event.previousState, event.currentState,
                 event.serviceType, event.reasonCode);
+        // Stored here so the health probe never lags the dispatcher queue.
+        link_state.store(event.currentState, std::memory_order_relaxed);
+        atem_rtm::EventRecord record;
+        record.kind = ATEM_RTM_EVENT_LINK_STATE;
+        record.subtype = static_cast<uint32_t>(event.currentState);
+        record.code = event.reasonCode;
+        record.timestamp = event.timestamp;
+        bool connected = event.currentState == agora::rtm::RTM_LINK_STATE_CONNECTED;
+        dispatch(atem_rtm::CpuSlot::LinkState,
+                 [this, connected, record = std::move(record)]() mutable {
+                     emit(std::move(record));
+                     if (!connected) {
+                         // Presence is stale until the restored subscription
+                         // re-snapshots.
+                         std::lock_guard<std::mutex> lock(state_mtx);
+                         presence.invalidate();
+                         location.invalidate();
+                         reads.invalidate_all();
+                     }
+                 });
     }
 
     void onConnectionStateChanged(const char* channelName,
                                   agora::rtm::RTM_CONNECTION_STATE state,
                                   agora::rtm::RTM_CONNECTION_CHANGE_REASON reason) override {
+        atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::LinkState);
         fprintf(stderr,
                 "[atem_rtm_real] onConnectionStateChanged channel=%s state=%d reason=%d\n",
                 channelName ? channelName : "(null)", state, reason);
     }
 
     void onTokenPrivilegeWillExpire(const char* channelName) override {
+        atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::TokenWillExpire);
         fprintf(stderr,
                 "[atem_rtm_real] WARNING: token will expire soon (channel=%s)\n",
                 channelName ? channelName : "(null)");
+        atem_rtm::EventRecord record;
+        record.kind = ATEM_RTM_EVENT_TOKEN_WILL_EXPIRE;
+        record.timestamp = atem_rtm::wall_ms();
+        if (channelName) record.channel = channelName;
+        dispatch(atem_rtm::CpuSlot::TokenWillExpire,
+                 [this, record = std::move(record)]() mutable { emit(std::move(record)); });
     }
 
     void onLoginResult(const uint64_t requestId, agora::rtm::RTM_ERROR_CODE errorCode) override {
+        atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Result);
         fprintf(stderr,
                 "[atem_rtm_real] onLoginResult requestId=%llu errorCode=%d\n",
                 (unsigned long long)requestId, errorCode);
+        if (errorCode == agora::rtm::RTM_ERROR_OK) {
+            token_renewed_ms.store(atem_rtm::now_ms(), std::memory_order_relaxed);
+        }
+        dispatch(atem_rtm::CpuSlot::Result,
+                 [this, requestId, errorCode] { on_login(requestId, errorCode); });
+    }
+
+    void on_login(uint64_t request_id, agora::rtm::RTM_ERROR_CODE code) {
+        emit_result(ATEM_RTM_OP_LOGIN, request_id, code, nullptr);
+
+        std::string bring_up_channel;
+        bool bring_up_failed = false;
+        {
+            std::lock_guard<std::mutex> lock(state_mtx);
+            if (bring_up && !bring_up->subscribing) {
+                if (code == agora::rtm::RTM_ERROR_OK) {
+                    bring_up->subscribing = true;
+                    bring_up_channel = bring_up->channel;
+                } else {
+                    bring_up_failed = true;
+                }
+            }
+        }
+        if (!bring_up_channel.empty()) {
+            uint64_t subscribe_id = subscribe_channel(bring_up_channel.c_str());
+            fprintf(stderr, "[atem_rtm_real] subscribe (bring-up) channel=%s requestId=%llu\n",
+                    bring_up_channel.c_str(), (unsigned long long)subscribe_id);
+        } else if (bring_up_failed) {
+            finish_bring_up(nullptr, code);
+        }
     }
 
     void onLogoutResult(const uint64_t requestId, agora::rtm::RTM_ERROR_CODE errorCode) override {
+        atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Result);
         fprintf(stderr,
                 "[atem_rtm_real] onLogoutResult requestId=%llu errorCode=%d\n",
                 (unsigned long long)requestId, errorCode);
+        dispatch(atem_rtm::CpuSlot::Result, [this, requestId, errorCode] {
+            emit_result(ATEM_RTM_OP_LOGOUT, requestId, errorCode, nullptr);
+        });
     }
 
     void onSubscribeResult(const uint64_t requestId, const char* channelName,
                            agora::rtm::RTM_ERROR_CODE errorCode) override {
+        atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Result);
         fprintf(stderr,
                 "[atem_rtm_real] onSubscribeResult requestId=%llu channel=%s errorCode=%d\n",
                 (unsigned long long)requestId,
                 channelName ? channelName : "(null)", errorCode);
+        dispatch(atem_rtm::CpuSlot::Result,
+                 [this, requestId, errorCode, channel_name = copy_str(channelName)] {
+                     emit_result(ATEM_RTM_OP_SUBSCRIBE, requestId, errorCode,
+                                 or_null(channel_name));
+                     if (!channel_name.empty()) finish_bring_up(channel_name.c_str(), errorCode);
+                 });
     }
 
     void onPublishResult(const uint64_t requestId, agora::rtm::RTM_ERROR_CODE errorCode) override {
-        fprintf(stderr,
-                "[atem_rtm_real] onPublishResult requestId=%llu errorCode=%d\n",
-                (unsigned long long)requestId, errorCode);
+        atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Result);
+        // Per-publish logging would cost more than the publish; only
+        // failures are worth a line.
+        if (errorCode != agora::rtm::RTM_ERROR_OK) {
+            fprintf(stderr,
+                    "[atem_rtm_real] onPublishResult requestId=%llu errorCode=%d\n",
+                    (unsigned long long)requestId, errorCode);
+        }
+        dispatch(atem_rtm::CpuSlot::Result, [this, requestId, errorCode] {
+            emit_result(ATEM_RTM_OP_PUBLISH, requestId, errorCode, nullptr);
+            if (errorCode != agora::rtm::RTM_ERROR_OK) {
+                std::lock_guard<std::mutex> lock(events_mtx);
+                series.errors(1, atem_rtm::now_ms());
+            }
+            std::lock_guard<std::mutex> lock(state_mtx);
+            inflight.completed(requestId, errorCode == agora::rtm::RTM_ERROR_OK);
+            buffers.completed(requestId);
+            sync_health();
+            if (inflight.size() == 0) inflight_cv.notify_all();
+        });
     }
 
     void onRenewTokenResult(const uint64_t requestId,
                             agora::rtm::RTM_SERVICE_TYPE serverType,
                             const char* channelName,
                             agora::rtm::RTM_ERROR_CODE errorCode) override {
+        atem_rtm::CpuScope cpu_scope(cpu, atem_rtm::CpuSlot::Result);
         fprintf(stderr,
                 "[atem_rtm_real] onRenewTokenResult requestId=%llu serviceType=%d channel=%s errorCode=%d\n",
                 (unsigned long long)requestId, serverType,
                 channelName ? channelName : "(null)", errorCode);
+        if (errorCode == agora::rtm::RTM_ERROR_OK) {
+            token_renewed_ms.store(atem_rtm::now_ms(), std::memory_order_relaxed);
+        }
+        dispatch(atem_rtm::CpuSlot::Result,
+                 [this, requestId, errorCode, channel_name = copy_str(channelName)] {
+                     emit_result(ATEM_RTM_OP_RENEW_TOKEN, requestId, errorCode,
+                                 or_null(channel_name));
+                 });
     }
 };
 
@@ -153,7 +1980,52 @@ AtemRtmClient* atem_rtm_create(
     client->app_id = config->app_id;
     client->token = config->token ? config->token : "";
     client->channel = config->channel ? config->channel : "";
+    client->hist_prefix = read_prefix("hist", client->channel);
     client->client_id = config->client_id;
+    client->hold_queue = atem_rtm::PeerHoldQueue(
+        config->peer_hold_capacity ? config->peer_hold_capacity
+                                   : atem_rtm::kDefaultPeerHoldCapacity,
+        config->peer_hold_ttl_ms ? config->peer_hold_ttl_ms
+                                 : atem_rtm::kDefaultPeerHoldTtlMs);
+    client->reorder = atem_rtm::ReorderBuffer(
+        config->reorder_window_ms ? config->reorder_window_ms
+                                  : atem_rtm::kDefaultReorderWindowMs);
+    client->stamp_epoch = std::random_device{}();
+    client->granter = atem_rtm::CreditGranter(config->credit_window, config->credit_refresh_ms);
+    client->credit_gate =
+        atem_rtm::CreditGate(config->credit_refresh_ms, config->credit_hold_max);
+    client->credit_gate.set_epoch(client->stamp_epoch);
+    if (config->idle_batch_window_ms) client->idle_batch_window_ms = config->idle_batch_window_ms;
+    if (config->idle_presence_interval_ms) {
+        client->idle_presence_interval_ms = config->idle_presence_interval_ms;
+    }
+    client->buffers = atem_rtm::BufferPool(
+        config->outbound_buffer_count ? config->outbound_buffer_count
+                                      : atem_rtm::kDefaultOutboundBufferCount,
+        config->outbound_buffer_size ? config->outbound_buffer_size
+                                     : atem_rtm::kDefaultOutboundBufferSize);
+    client->metadata = atem_rtm::MetadataWriteBehind(
+        config->metadata_window_ms ? config->metadata_window_ms
+                                   : atem_rtm::kDefaultMetadataWindowMs);
+    client->events = atem_rtm::EventQueue(
+        config->event_queue_capacity ? config->event_queue_capacity
+                                     : atem_rtm::kDefaultEventQueueCapacity,
+        config->fair_quantum_bytes, config->fair_publisher_max_bytes);
+    client->events.track_discards(config->credit_window > 0);
+    client->location = atem_rtm::LocationCache(
+        config->location_ttl_ms ? config->location_ttl_ms : atem_rtm::kDefaultLocationTtlMs);
+    client->reads = atem_rtm::SingleFlight(config->read_cache_ms, config->read_error_cache_ms);
+    client->join_history_count = std::min(config->join_history_count, atem_rtm::kMaxPrefetchCount);
+    client->outbound = atem_rtm::OutboundScheduler(
+        config->outbound_rate_per_s, config->outbound_burst, config->outbound_aging_ms);
+    if (config->dispatcher_tick_ms) {
+        atem_rtm::Dispatcher::Options options;
+        if (config->dispatcher_name) options.name = config->dispatcher_name;
+        options.cpu_mask = config->dispatcher_cpu_mask;
+        options.priority = config->dispatcher_priority;
+        client->dispatcher = std::make_unique<atem_rtm::Dispatcher>(options);
+        client->deadline_slack_ms = config->dispatcher_tick_ms - 1;
+    }
 
     // Build Agora RtmConfig
     agora::rtm::RtmConfig rtm_cfg;
@@ -179,10 +2051,13 @@ AtemRtmClient* atem_rtm_create(
 void atem_rtm_destroy(AtemRtmClient* client) {
     if (!client) return;
 
+    // Before release: queued events reference the client.
+    if (client->dispatcher) client->dispatcher->stop();
     if (client->rtm_client) {
         client->rtm_client->release();
         client->rtm_client = nullptr;
     }
+    client->finish_bring_up(nullptr, ATEM_RTM_ERR_CLOSED);
     delete client;
     fprintf(stderr, "[atem_rtm_real] RTM client destroyed\n");
 }
@@ -196,6 +2071,16 @@ int atem_rtm_connect(AtemRtmClient* client) {
 
 int atem_rtm_disconnect(AtemRtmClient* client) {
     if (!client || !client->rtm_client) return -1;
+    // atem_rtm_shutdown already logged out.
+    if (client->closing) return 0;
+
+    {
+        std::lock_guard<std::mutex> lock(client->state_mtx);
+        size_t abandoned = client->hold_queue.clear();
+        if (abandoned) {
+            fprintf(stderr, "[atem_rtm_real] dropping %zu held peer message(s)\n", abandoned);
+        }
+    }
 
     uint64_t request_id = 0;
     client->rtm_client->logout(request_id);
@@ -225,37 +2110,43 @@ int atem_rtm_join_channel(
     const char* channel_id) {
     if (!client || !client->rtm_client || !channel_id) return -1;
 
-    agora::rtm::SubscribeOptions opts;
-    opts.withMessage = true;
-    opts.withPresence = true;
-    opts.withMetadata = false;
-    opts.withLock = false;
-
-    uint64_t request_id = 0;
-    client->rtm_client->subscribe(channel_id, opts, request_id);
+    uint64_t request_id = client->subscribe_channel(channel_id);
     fprintf(stderr, "[atem_rtm_real] subscribe (join) channel=%s requestId=%llu\n",
             channel_id, (unsigned long long)request_id);
     return 0;
 }
 
+int atem_rtm_bring_up(
+    AtemRtmClient* client,
+    const char* token,
+    const char* channel_id,
+    AtemRtmReadyCallback callback,
+    void* user_data) {
+    if (!client || !client->rtm_client || !channel_id || !channel_id[0]) return -1;
+    if (client->closing) return ATEM_RTM_ERR_CLOSED;
+
+    {
+        std::lock_guard<std::mutex> lock(client->state_mtx);
+        if (client->bring_up) return -1;
+        client->bring_up.reset(new AtemRtmClient::BringUp());
+        client->bring_up->channel = channel_id;
+        client->bring_up->callback = callback;
+        client->bring_up->user_data = user_data;
+    }
+    return atem_rtm_login(client, token, nullptr);
+}
+
 int atem_rtm_publish_channel(
     AtemRtmClient* client,
     const char* payload) {
     if (!client || !client->rtm_client || !payload) return -1;
+    if (client->closing) return ATEM_RTM_ERR_CLOSED;
 
-    agora::rtm::PublishOptions opts;
-    opts.channelType = agora::rtm::RTM_CHANNEL_TYPE_MESSAGE;
-    opts.messageType = agora::rtm::RTM_MESSAGE_TYPE_STRING;
-
-    const char* channel = client->channel.c_str();
-    size_t length = strlen(payload);
-
+    const size_t length = strlen(payload);
+    const int paced = client->pace(nullptr, payload, length, atem_rtm::kNoOutboundBuffer);
+    if (paced != 0) return paced < 0 ? paced : 0;
     uint64_t request_id = 0;
-    client->rtm_client->publish(channel, payload, length, opts, request_id);
-    fprintf(stderr,
-            "[atem_rtm_real] publish channel=%s len=%zu requestId=%llu\n",
-            channel, length, (unsigned long long)request_id);
-    return 0;
+    return client->publish_channel_now(payload, length, &request_id);
 }
 
 int atem_rtm_send_peer(
@@ -263,19 +2154,204 @@ int atem_rtm_send_peer(
     const char* target_client_id,
     const char* payload) {
     if (!client || !client->rtm_client || !target_client_id || !payload) return -1;
+    if (client->closing) return ATEM_RTM_ERR_CLOSED;
+
+    const size_t length = strlen(payload);
+    const int paced = client->pace(target_client_id, payload, length, atem_rtm::kNoOutboundBuffer);
+    if (paced != 0) return paced < 0 ? paced : 0;
+    uint64_t request_id = 0;
+    return client->send_peer_now(target_client_id, payload, length, &request_id);
+}
+
+int atem_rtm_buffer_acquire(
+    AtemRtmClient* client,
+    AtemRtmBuffer* out) {
+    if (!client || !out) return -1;
+    if (client->closing) return ATEM_RTM_ERR_CLOSED;
+
+    std::lock_guard<std::mutex> lock(client->state_mtx);
+    uint32_t id = 0;
+    if (!client->buffers.acquire(&id)) return ATEM_RTM_ERR_NO_BUFFER;
+    out->id = id;
+    out->data = client->buffers.data(id);
+    out->capacity = client->buffers.size();
+    return 0;
+}
+
+int atem_rtm_buffer_release(
+    AtemRtmClient* client,
+    uint32_t buffer_id) {
+    if (!client) return -1;
+    std::lock_guard<std::mutex> lock(client->state_mtx);
+    return client->buffers.release(buffer_id) ? 0 : -1;
+}
+
+int atem_rtm_publish_buffer(
+    AtemRtmClient* client,
+    uint32_t buffer_id,
+    size_t length) {
+    if (!client || !client->rtm_client) return -1;
+    if (client->closing) return ATEM_RTM_ERR_CLOSED;
+
+    const char* payload = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(client->state_mtx);
+        if (!client->buffers.owned(buffer_id) || length > client->buffers.size()) return -1;
+        payload = client->buffers.data(buffer_id);
+    }
+    // Paced or held for credit, the buffer is queued until its turn comes.
+    const int paced = client->pace(nullptr, payload, length, buffer_id);
+    if (paced != 0) return paced < 0 ? paced : 0;
+    // The SDK reads straight from the registered buffer; it is recycled
+    // once onPublishResult arrives. Refused, it is the caller's again.
+    uint64_t request_id = 0;
+    const int rc = client->publish_channel_now(payload, length, &request_id);
+    std::lock_guard<std::mutex> lock(client->state_mtx);
+    if (rc != 0) {
+        client->buffers.unsent(buffer_id);
+    } else {
+        client->buffers.submitted(buffer_id, request_id);
+    }
+    return rc;
+}
+
+int atem_rtm_send_peer_buffer(
+    AtemRtmClient* client,
+    const char* target_client_id,
+    uint32_t buffer_id,
+    size_t length) {
+    if (!client || !client->rtm_client || !target_client_id) return -1;
+    if (client->closing) return ATEM_RTM_ERR_CLOSED;
+
+    const char* payload = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(client->state_mtx);
+        if (!client->buffers.owned(buffer_id) || length > client->buffers.size()) return -1;
+        payload = client->buffers.data(buffer_id);
+    }
+    const int paced = client->pace(target_client_id, payload, length, buffer_id);
+    if (paced != 0) return paced < 0 ? paced : 0;
+    uint64_t request_id = 0;
+    int rc = client->send_peer_now(target_client_id, payload, length, &request_id);
+    std::lock_guard<std::mutex> lock(client->state_mtx);
+    if (rc == ATEM_RTM_QUEUED) {
+        // The hold queue keeps its own copy.
+        client->buffers.discard(buffer_id);
+    } else if (rc != 0) {
+        client->buffers.unsent(buffer_id);
+    } else {
+        client->buffers.submitted(buffer_id, request_id);
+    }
+    return rc;
+}
 
-    // In RTM 2.x, peer messaging is done by publishing to the user channel type.
-    agora::rtm::PublishOptions opts;
-    opts.channelType = agora::rtm::RTM_CHANNEL_TYPE_USER;
-    opts.messageType = agora::rtm::RTM_MESSAGE_TYPE_STRING;
+int atem_rtm_set_history_policy(
+    AtemRtmClient* client,
+    const char* message_class,
+    AtemRtmHistoryPolicy policy) {
+    if (!client) return -1;
+
+    std::lock_guard<std::mutex> lock(client->state_mtx);
+    const bool store = policy == ATEM_RTM_HISTORY_STORE;
+    if (!message_class || strcmp(message_class, "*") == 0) {
+        client->history.set_default(store);
+    } else {
+        client->history.set(message_class, store);
+    }
+    return 0;
+}
+
+int atem_rtm_set_priority(
+    AtemRtmClient* client,
+    const char* message_class,
+    AtemRtmPriority priority) {
+    if (!client) return -1;
+
+    std::lock_guard<std::mutex> lock(client->state_mtx);
+    if (!message_class || strcmp(message_class, "*") == 0) {
+        client->outbound.set_default(priority);
+    } else {
+        client->outbound.set_class(message_class, priority);
+    }
+    return 0;
+}
+
+int atem_rtm_shutdown(
+    AtemRtmClient* client,
+    uint32_t deadline_ms,
+    AtemRtmShutdownReport* report) {
+    if (!client || !client->rtm_client) return -1;
+    if (client->closing.exchange(true)) return ATEM_RTM_ERR_CLOSED;
+
+    const uint64_t started = atem_rtm::now_ms();
+    AtemRtmShutdownReport result{};
+
+    // Hand anything still batched by idle mode to the application before
+    // the handle goes away.
+    client->flush_idle_batch(started, true);
+    // Staged metadata skips its coalescing window and goes out now, and so
+    // does everything the pacer or missing credit still holds.
+    client->flush_metadata(true);
+    client->flush_outbound(true);
+    client->flush_credit(true);
+    // Lock waiters are told we are closing; held locks are handed back.
+    {
+        atem_rtm::LockWaitList::Step step;
+        {
+            std::lock_guard<std::mutex> lock(client->state_mtx);
+            client->locks.close(step);
+        }
+        client->run_lock_step(std::move(step));
+    }
+    {
+        std::vector<atem_rtm::LocationCache::Answer> done;
+        {
+            std::lock_guard<std::mutex> lock(client->state_mtx);
+            client->location.close(done);
+        }
+        client->complete_location_waiters(done);
+    }
+    {
+        std::vector<atem_rtm::SingleFlight::Delivery> done;
+        {
+            std::lock_guard<std::mutex> lock(client->state_mtx);
+            client->reads.close(ATEM_RTM_ERR_CLOSED, done);
+        }
+        client->complete_reads(done);
+    }
+    client->finish_bring_up(nullptr, ATEM_RTM_ERR_CLOSED);
 
-    size_t length = strlen(payload);
+    {
+        std::unique_lock<std::mutex> lock(client->state_mtx);
+        // Held messages target peers that are still offline; they cannot be
+        // delivered before we log out.
+        result.abandoned += static_cast<uint32_t>(client->hold_queue.clear());
+
+        const uint64_t acked_before =
+            client->inflight.counters().acked + client->metadata.counters().written;
+        const uint64_t failed_before =
+            client->inflight.counters().failed + client->metadata.counters().failed;
+        client->inflight_cv.wait_for(lock, std::chrono::milliseconds(deadline_ms), [client] {
+            return client->inflight.size() == 0 && client->metadata.in_flight() == 0;
+        });
+        result.flushed = static_cast<uint32_t>(client->inflight.counters().acked +
+                                               client->metadata.counters().written - acked_before);
+        result.failed = static_cast<uint32_t>(client->inflight.counters().failed +
+                                              client->metadata.counters().failed - failed_before);
+        // Conflict retries restaged after the flush never went out.
+        result.abandoned += static_cast<uint32_t>(client->inflight.size() +
+                                                  client->metadata.in_flight() +
+                                                  client->metadata.pending_items());
+    }
 
     uint64_t request_id = 0;
-    client->rtm_client->publish(target_client_id, payload, length, opts, request_id);
+    client->rtm_client->logout(request_id);
+    result.elapsed_ms = static_cast<uint32_t>(atem_rtm::now_ms() - started);
     fprintf(stderr,
-            "[atem_rtm_real] send_peer target=%s len=%zu requestId=%llu\n",
-            target_client_id, length, (unsigned long long)request_id);
+            "[atem_rtm_real] shutdown flushed=%u failed=%u abandoned=%u elapsed=%ums requestId=%llu\n",
+            result.flushed, result.failed, result.abandoned, result.elapsed_ms,
+            (unsigned long long)request_id);
+    if (report) *report = result;
     return 0;
 }
 
@@ -297,19 +2373,459 @@ int atem_rtm_subscribe_topic(
     const char* topic) {
     if (!client || !client->rtm_client || !channel || !topic) return -1;
 
-    // In RTM 2.x message channels, topics are not a first-class concept.
-    // Topic subscription is relevant for stream channels. For message channels,
-    // we subscribe to the channel itself which receives all messages.
-    // We perform a regular channel subscribe here as a reasonable fallback.
-    agora::rtm::SubscribeOptions opts;
-    opts.withMessage = true;
-    opts.withPresence = false;
+    {
+        std::lock_guard<std::mutex> lock(client->state_mtx);
+        if (!contains(client->topic_channels, channel)) {
+            client->topic_channels.emplace_back(channel);
+        }
+        if (client->idle && !contains(client->joined_channels, channel)) {
+            // Subscribed on resume along with the other paused topics.
+            if (!contains(client->paused_topics, channel)) {
+                client->paused_topics.emplace_back(channel);
+            }
+            return 0;
+        }
+    }
+    client->subscribe_topic_channel(channel, topic);
+    return 0;
+}
 
-    uint64_t request_id = 0;
-    client->rtm_client->subscribe(channel, opts, request_id);
-    fprintf(stderr,
-            "[atem_rtm_real] subscribe_topic channel=%s topic=%s requestId=%llu\n",
-            channel, topic, (unsigned long long)request_id);
+int atem_rtm_set_idle(AtemRtmClient* client, int idle) {
+    if (!client || !client->rtm_client) return -1;
+
+    if (idle) {
+        std::vector<std::string> to_pause;
+        {
+            std::lock_guard<std::mutex> lock(client->state_mtx);
+            if (client->idle) return 0;
+            client->idle = true;
+            for (const auto& topic_channel : client->topic_channels) {
+                // Channels joined via atem_rtm_join_channel carry the essential
+                // traffic and stay subscribed.
+                if (!contains(client->joined_channels, topic_channel)) {
+                    to_pause.push_back(topic_channel);
+                }
+            }
+            client->paused_topics = to_pause;
+        }
+        for (const auto& topic_channel : to_pause) {
+            uint64_t request_id = 0;
+            client->rtm_client->unsubscribe(topic_channel.c_str(), request_id);
+        }
+        fprintf(stderr, "[atem_rtm_real] idle: paused %zu topic subscription(s)\n",
+                to_pause.size());
+        return 0;
+    }
+
+    std::vector<std::string> to_resume;
+    {
+        std::lock_guard<std::mutex> lock(client->state_mtx);
+        if (!client->idle) return 0;
+        to_resume.swap(client->paused_topics);
+    }
+    // Fast catch-up: deliver what was batched, apply batched presence (which
+    // also releases held peer messages) and restore paused subscriptions.
+    uint64_t now = atem_rtm::now_ms();
+    client->flush_idle_batch(now, true);
+    client->apply_idle_presence(now, true);
+    for (const auto& topic_channel : to_resume) {
+        client->subscribe_topic_channel(topic_channel.c_str(), "(resume)");
+    }
+    fprintf(stderr, "[atem_rtm_real] active: resumed %zu topic subscription(s)\n",
+            to_resume.size());
+    return 0;
+}
+
+int atem_rtm_tick(AtemRtmClient* client) {
+    if (!client) return -1;
+    // The dispatcher runs each deadline on its own.
+    if (client->dispatcher) return 0;
+    atem_rtm::CpuScope cpu_scope(client->cpu, atem_rtm::CpuSlot::Dispatch);
+    client->tick_work();
+    return 0;
+}
+
+int atem_rtm_stage_metadata(
+    AtemRtmClient* client,
+    AtemRtmMetadataScope scope,
+    const char* target,
+    const char* key,
+    const char* value) {
+    if (!client || !client->rtm_client || !target || !key || !value) return -1;
+    if (client->closing) return ATEM_RTM_ERR_CLOSED;
+
+    {
+        std::lock_guard<std::mutex> lock(client->state_mtx);
+        client->metadata.stage(
+            scope == ATEM_RTM_METADATA_USER ? atem_rtm::MetadataScope::User
+                                            : atem_rtm::MetadataScope::Channel,
+            target, key, value, atem_rtm::now_ms(), atem_rtm::wall_ms());
+    }
+    client->arm_deadlines();
+    return 0;
+}
+
+int atem_rtm_flush_metadata(AtemRtmClient* client) {
+    if (!client || !client->rtm_client) return -1;
+    client->flush_metadata(true);
+    return 0;
+}
+
+int atem_rtm_acquire_lock(
+    AtemRtmClient* client,
+    const char* channel,
+    const char* lock_name,
+    AtemRtmLockCallback callback,
+    void* user_data) {
+    if (!client || !client->rtm_client || !channel || !lock_name) return -1;
+    if (client->closing) return ATEM_RTM_ERR_CLOSED;
+
+    atem_rtm::LockWaitList::Step step;
+    {
+        std::lock_guard<std::mutex> lock(client->state_mtx);
+        uint64_t waiter = client->next_lock_waiter++;
+        client->lock_waiters[waiter] = AtemRtmClient::LockWaiter{callback, user_data};
+        client->locks.wait(channel, lock_name, waiter, atem_rtm::now_ms(), step);
+    }
+    client->run_lock_step(std::move(step));
+    return 0;
+}
+
+int atem_rtm_release_lock(
+    AtemRtmClient* client,
+    const char* channel,
+    const char* lock_name) {
+    if (!client || !client->rtm_client || !channel || !lock_name) return -1;
+
+    atem_rtm::LockWaitList::Step step;
+    {
+        std::lock_guard<std::mutex> lock(client->state_mtx);
+        client->locks.released(channel, lock_name, atem_rtm::now_ms(), step);
+    }
+    client->run_lock_step(std::move(step));
+    return 0;
+}
+
+int atem_rtm_health(
+    AtemRtmClient* client,
+    AtemRtmHealth* out) {
+    if (!client || !out) return -1;
+
+    // No locks: every field is a relaxed atomic load.
+    const uint64_t now = atem_rtm::now_ms();
+    auto age = [now](const std::atomic<uint64_t>& since) -> uint64_t {
+        uint64_t at = since.load(std::memory_order_relaxed);
+        if (at == 0) return ATEM_RTM_AGE_NEVER;
+        return now > at ? now - at : 0;
+    };
+    out->link_state = client->link_state.load(std::memory_order_relaxed);
+    out->last_inbound_age_ms = age(client->last_inbound_ms);
+    out->last_outbound_age_ms = age(client->last_outbound_ms);
+    out->inbound_queued = client->inbound_queued.load(std::memory_order_relaxed);
+    out->queue_lag_ms = out->inbound_queued ? age(client->inbound_queued_since_ms) : 0;
+    out->requests_in_flight = client->requests_in_flight.load(std::memory_order_relaxed);
+    out->token_age_ms = age(client->token_renewed_ms);
+    return 0;
+}
+
+int atem_rtm_where_now(
+    AtemRtmClient* client,
+    const char* user_id,
+    AtemRtmWhereNowCallback callback,
+    void* user_data) {
+    if (!client || !client->rtm_client || !user_id) return -1;
+    if (client->closing) return ATEM_RTM_ERR_CLOSED;
+
+    std::vector<std::string> channels;
+    bool hit = false;
+    bool query = false;
+    {
+        std::lock_guard<std::mutex> lock(client->state_mtx);
+        hit = client->location.lookup(user_id, atem_rtm::now_ms(), channels);
+        if (!hit) {
+            uint64_t waiter = client->next_location_waiter++;
+            client->location_waiters[waiter] = AtemRtmClient::LocationWaiter{callback, user_data};
+            query = client->location.wait(user_id, waiter);
+        }
+    }
+    if (hit) {
+        client->answer_location(user_id, ATEM_RTM_OK, channels, callback, user_data);
+        return ATEM_RTM_OK;
+    }
+    if (query) {
+        agora::rtm::IRtmPresence* presence = client->rtm_client->getPresence();
+        uint64_t request_id = 0;
+        if (presence) presence->getUserChannels(user_id, request_id);
+        fprintf(stderr, "[atem_rtm_real] getUserChannels user=%s requestId=%llu\n", user_id,
+                (unsigned long long)request_id);
+        std::vector<atem_rtm::LocationCache::Answer> done;
+        {
+            std::lock_guard<std::mutex> lock(client->state_mtx);
+            if (presence) {
+                client->location.issued(user_id, request_id, atem_rtm::now_ms(), done);
+            } else {
+                client->location.abandon(user_id, done);
+            }
+        }
+        client->complete_location_waiters(done);
+    }
+    return ATEM_RTM_QUEUED;
+}
+
+int atem_rtm_get_state(
+    AtemRtmClient* client,
+    const char* channel,
+    const char* user_id,
+    AtemRtmReadCallback callback,
+    void* user_data) {
+    if (!client || !client->rtm_client || !channel || !user_id) return -1;
+    agora::rtm::IRtmClient* rtm = client->rtm_client;
+    return client->start_read(
+        atem_rtm::SingleFlight::key("state", channel, user_id), callback, user_data,
+        [&](uint64_t& request_id) {
+            agora::rtm::IRtmPresence* presence = rtm->getPresence();
+            if (!presence) return false;
+            presence->getState(channel, agora::rtm::RTM_CHANNEL_TYPE_MESSAGE, user_id, request_id);
+            return true;
+        });
+}
+
+int atem_rtm_get_channel_metadata(
+    AtemRtmClient* client,
+    const char* channel,
+    AtemRtmReadCallback callback,
+    void* user_data) {
+    if (!client || !client->rtm_client || !channel) return -1;
+    agora::rtm::IRtmClient* rtm = client->rtm_client;
+    return client->start_read(
+        atem_rtm::SingleFlight::key("meta", channel), callback, user_data,
+        [&](uint64_t& request_id) {
+            agora::rtm::IRtmStorage* storage = rtm->getStorage();
+            if (!storage) return false;
+            storage->getChannelMetadata(channel, agora::rtm::RTM_CHANNEL_TYPE_MESSAGE, request_id);
+            return true;
+        });
+}
+
+int atem_rtm_who_now(
+    AtemRtmClient* client,
+    const char* channel,
+    AtemRtmReadCallback callback,
+    void* user_data) {
+    if (!client || !client->rtm_client || !channel) return -1;
+    agora::rtm::IRtmClient* rtm = client->rtm_client;
+    return client->start_read(
+        atem_rtm::SingleFlight::key("who", channel), callback, user_data,
+        [&](uint64_t& request_id) {
+            agora::rtm::IRtmPresence* presence = rtm->getPresence();
+            if (!presence) return false;
+            agora::rtm::PresenceOptions opts;
+            presence->whoNow(channel, agora::rtm::RTM_CHANNEL_TYPE_MESSAGE, opts, request_id);
+            return true;
+        });
+}
+
+int atem_rtm_get_history(
+    AtemRtmClient* client,
+    const char* channel,
+    uint32_t count,
+    AtemRtmReadCallback callback,
+    void* user_data) {
+    if (!client || !client->rtm_client || !channel) return -1;
+    agora::rtm::GetHistoryMessagesOptions opts;
+    if (count) opts.messageCount = static_cast<uint16_t>(count > 0xffff ? 0xffff : count);
+    agora::rtm::IRtmClient* rtm = client->rtm_client;
+    return client->start_read(
+        atem_rtm::SingleFlight::key("hist", channel, std::to_string(opts.messageCount)), callback,
+        user_data, [&](uint64_t& request_id) {
+            agora::rtm::IRtmHistory* history = rtm->getHistory();
+            if (!history) return false;
+            history->getMessages(channel, agora::rtm::RTM_CHANNEL_TYPE_MESSAGE, opts, request_id);
+            return true;
+        });
+}
+
+int atem_rtm_poll_events(
+    AtemRtmClient* client,
+    AtemRtmEvent* out,
+    size_t max,
+    size_t* count) {
+    if (!client || !count || (!out && max)) return -1;
+    {
+        std::lock_guard<std::mutex> lock(client->events_mtx);
+        *count = client->events.poll(out, max);
+        const uint64_t now = atem_rtm::now_ms();
+        const uint64_t wall = atem_rtm::wall_ms();
+        for (size_t i = 0; i < *count; ++i) {
+            const AtemRtmEvent& event = out[i];
+            if (event.kind != ATEM_RTM_EVENT_MESSAGE || event.subtype != ATEM_RTM_MESSAGE_LIVE ||
+                event.timestamp == 0) {
+                continue;
+            }
+            client->series.latency(wall > event.timestamp ? wall - event.timestamp : 0, now);
+        }
+    }
+    // Polled messages free their publishers' credit.
+    if (client->granter.enabled()) {
+        std::lock_guard<std::mutex> lock(client->state_mtx);
+        client->release_discarded();
+        for (size_t i = 0; i < *count; ++i) {
+            const AtemRtmEvent& event = out[i];
+            if (event.kind != ATEM_RTM_EVENT_MESSAGE || event.subtype != ATEM_RTM_MESSAGE_LIVE ||
+                !event.user || !event.channel) {
+                continue;
+            }
+            client->granter.consumed(event.user, event.channel);
+        }
+    }
+    // Grants owed for what was polled go out from the dispatcher.
+    if (client->granter.enabled()) client->arm_deadlines();
+    return 0;
+}
+
+int atem_rtm_get_stats_series(
+    AtemRtmClient* client,
+    AtemRtmStatsSample* out,
+    size_t max,
+    size_t* count) {
+    if (!client || !count || (!out && max)) return -1;
+    std::lock_guard<std::mutex> lock(client->events_mtx);
+    *count = client->series.copy(atem_rtm::now_ms(), out, max);
+    return 0;
+}
+
+int atem_rtm_set_event_notify(
+    AtemRtmClient* client,
+    AtemRtmEventNotify notify,
+    void* user_data) {
+    if (!client) return -1;
+    std::lock_guard<std::mutex> lock(client->events_mtx);
+    client->event_notify = notify;
+    client->event_notify_data = user_data;
+    return 0;
+}
+
+int atem_rtm_get_stats(
+    AtemRtmClient* client,
+    AtemRtmStats* out) {
+    if (!client || !out) return -1;
+
+    std::lock_guard<std::mutex> lock(client->state_mtx);
+    client->hold_queue.expire(atem_rtm::now_ms());
+    const auto& held = client->hold_queue.counters();
+    const auto& reorder = client->reorder.counters();
+    *out = AtemRtmStats{};
+    out->peer_messages_held = held.held;
+    out->peer_messages_flushed = held.flushed;
+    out->peer_messages_expired = held.expired;
+    out->peer_messages_dropped = held.dropped;
+    out->peer_hold_depth = client->hold_queue.depth();
+    out->reorder_depth = client->reorder.depth();
+    out->reorder_max_depth = reorder.max_depth;
+    out->reorder_held = reorder.held;
+    out->reorder_hold_ms_total = reorder.hold_ms_total;
+    out->reorder_hold_ms_max = reorder.hold_ms_max;
+    out->reorder_gaps_skipped = reorder.gaps_skipped;
+    out->reorder_duplicates = reorder.duplicates;
+    out->reorder_late = reorder.late;
+    const auto& publishes = client->inflight.counters();
+    out->publishes_sent = publishes.sent;
+    out->publishes_acked = publishes.acked;
+    out->publishes_failed = publishes.failed;
+    out->publishes_in_flight = client->inflight.size();
+    out->idle_mode = client->idle ? 1 : 0;
+    out->idle_batched_messages = client->idle_batched_messages;
+    const auto& meta = client->metadata.counters();
+    out->metadata_staged = meta.staged;
+    out->metadata_coalesced = meta.coalesced;
+    out->metadata_writes = meta.writes;
+    out->metadata_written = meta.written;
+    out->metadata_conflicts = meta.conflicts;
+    out->metadata_retries = meta.retries;
+    out->metadata_superseded = meta.superseded;
+    out->metadata_failed = meta.failed;
+    out->metadata_pending = client->metadata.pending_items();
+    out->metadata_in_flight = client->metadata.in_flight();
+    const auto& locks = client->locks.counters();
+    out->lock_waits = locks.waits;
+    out->lock_acquires = locks.acquires;
+    out->lock_acquired = locks.acquired;
+    out->lock_contended = locks.contended;
+    out->lock_failed = locks.failed;
+    out->lock_waiters = client->locks.waiters();
+    out->lock_handoff_ms_total = locks.handoff_ms_total;
+    out->lock_handoff_ms_max = locks.handoff_ms_max;
+    out->history_stored = client->history.counters().stored;
+    out->history_skipped = client->history.counters().skipped;
+    const auto& buffers = client->buffers.counters();
+    out->buffers_in_use = client->buffers.in_use();
+    out->buffer_publishes = buffers.submitted;
+    out->buffers_exhausted = buffers.exhausted;
+    const auto& location = client->location.counters();
+    out->location_hits = location.hits;
+    out->location_misses = location.misses;
+    out->location_queries = location.queries;
+    out->location_collapsed = location.collapsed;
+    out->location_entries = client->location.entries();
+    const auto& reads = client->reads.counters();
+    out->reads_requested = reads.requests;
+    out->reads_issued = reads.issued;
+    out->reads_collapsed = reads.collapsed;
+    out->reads_cache_hits = reads.cache_hits;
+    const auto callbacks = client->cpu.callbacks();
+    const auto cpu_us = [client](atem_rtm::CpuSlot slot) {
+        return client->cpu.slot(slot).ns_total / 1000;
+    };
+    out->cpu_callbacks = callbacks.calls;
+    out->cpu_callback_us = callbacks.ns_total / 1000;
+    out->cpu_callback_max_us = callbacks.ns_max / 1000;
+    out->cpu_message_us = cpu_us(atem_rtm::CpuSlot::Message);
+    out->cpu_presence_us = cpu_us(atem_rtm::CpuSlot::Presence);
+    out->cpu_topic_us = cpu_us(atem_rtm::CpuSlot::Topic);
+    out->cpu_lock_us = cpu_us(atem_rtm::CpuSlot::Lock);
+    out->cpu_storage_us = cpu_us(atem_rtm::CpuSlot::Storage);
+    out->cpu_link_state_us = cpu_us(atem_rtm::CpuSlot::LinkState);
+    out->cpu_result_us = cpu_us(atem_rtm::CpuSlot::Result);
+    out->cpu_token_us = cpu_us(atem_rtm::CpuSlot::TokenWillExpire);
+    out->cpu_dispatch_us = cpu_us(atem_rtm::CpuSlot::Dispatch);
+    if (client->dispatcher) {
+        const auto dispatched = client->dispatcher->counters();
+        out->dispatcher_tasks = dispatched.tasks;
+        out->dispatcher_max_depth = dispatched.max_depth;
+        out->dispatcher_lag_ms_max = dispatched.lag_ms_max;
+        out->dispatcher_wakeups = dispatched.wakeups;
+        out->timers_pending = dispatched.timers_pending;
+        out->timers_fired = dispatched.timers;
+    } else {
+        std::lock_guard<std::mutex> timers_lock(client->timers_mtx);
+        out->timers_pending = client->timers.size();
+        out->timers_fired = client->timers.counters().fired;
+    }
+    const auto& outbound = client->outbound.counters();
+    out->outbound_queued = client->outbound.depth();
+    out->outbound_deferred = outbound.deferred;
+    out->outbound_aged = outbound.aged;
+    out->outbound_wait_ms_max_control = outbound.wait_ms_max[atem_rtm::kOutboundControl];
+    out->outbound_wait_ms_max_normal = outbound.wait_ms_max[atem_rtm::kOutboundNormal];
+    out->outbound_wait_ms_max_bulk = outbound.wait_ms_max[atem_rtm::kOutboundBulk];
+    const auto& credit = client->credit_gate.counters();
+    out->credit_grants_sent = client->granter.counters().grants;
+    out->credit_grants_received = credit.grants;
+    out->credit_held = credit.held;
+    out->credit_waiting = client->credit_gate.depth();
+    out->credit_coalesced = credit.coalesced;
+    out->credit_refused = credit.refused;
+    std::lock_guard<std::mutex> events_lock(client->events_mtx);
+    out->events_queued = client->events.depth();
+    out->events_dropped = client->events.counters().dropped;
+    out->events_spilled = client->events.counters().spilled;
+    const auto& prefetch = client->prefetch.counters();
+    out->prefetch_fetches = prefetch.fetches;
+    out->prefetch_replayed = prefetch.replayed;
+    out->prefetch_duplicates = prefetch.duplicates;
+    out->prefetch_late = prefetch.late;
+    out->fair_shed = client->events.fair().counters().shed;
+    out->fair_publishers_max = client->events.fair().counters().max_publishers;
     return 0;
 }
 
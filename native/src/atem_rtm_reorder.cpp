@@ -0,0 +1,282 @@
+#include "atem_rtm_reorder.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+namespace atem_rtm {
+
+namespace {
+
+// How many released sequence numbers each stream remembers for duplicate
+// detection (retries and history fill can replay recent messages).
+constexpr size_t kRecentSeqs = 256;
+
+// Earlier epochs each stream remembers, so their stragglers are not taken
+// for a restart.
+constexpr size_t kRetiredEpochs = 4;
+
+// Streams with nothing pending are forgotten after this much silence.
+constexpr uint64_t kStreamIdleMs = 5 * 60 * 1000;
+
+inline std::string stream_key(const InboundMessage& msg) {
+    std::string key;
+    key.reserve(msg.publisher.size() + msg.channel.size() + 1);
+    key.append(msg.publisher).push_back('\x1f');
+    key.append(msg.channel);
+    return key;
+}
+
+} // namespace
+
+void format_sender_stamp(char* buf, uint32_t epoch, uint64_t seq) {
+    snprintf(buf, kSenderStampMax, "seq:%08x:%llx", epoch, (unsigned long long)seq);
+}
+
+SenderStamp parse_sender_stamp(const char* custom_type) {
+    SenderStamp stamp;
+    if (!custom_type || strncmp(custom_type, "seq:", 4) != 0) {
+        return stamp;
+    }
+    char* end = nullptr;
+    unsigned long epoch = strtoul(custom_type + 4, &end, 16);
+    if (!end || *end != ':') {
+        return stamp;
+    }
+    const char* seq_start = end + 1;
+    unsigned long long seq = strtoull(seq_start, &end, 16);
+    if (end == seq_start || *end != '\0') {
+        return stamp;
+    }
+    stamp.valid = true;
+    stamp.epoch = static_cast<uint32_t>(epoch);
+    stamp.seq = seq;
+    return stamp;
+}
+
+ReorderBuffer::ReorderBuffer(uint64_t hold_window_ms) : window_ms_(hold_window_ms) {}
+
+void ReorderBuffer::push(InboundMessage msg, uint64_t now_ms, std::vector<InboundMessage>& out) {
+    msg.arrived_ms = now_ms;
+    const std::string key = stream_key(msg);
+    auto& stream = streams_[key];
+    stream.last_activity_ms = now_ms;
+    if (msg.server_ts) {
+        const int64_t transit = int64_t(now_ms) - int64_t(msg.server_ts);
+        if (!stream.transit_known || transit < stream.transit_min) {
+            stream.transit_min = transit;
+            stream.transit_known = true;
+        }
+    }
+
+    if (msg.stamp.valid) {
+        push_sequenced(stream, std::move(msg), now_ms, out);
+    } else if (stream.last_released_ts && msg.server_ts < stream.last_released_ts) {
+        // Its successors already went out; holding it would not help.
+        ++counters_.late;
+        emit(std::move(msg), now_ms, out);
+    } else {
+        uint64_t ts = msg.server_ts;
+        stream.pending_ts.emplace(ts, std::move(msg));
+        ++depth_;
+    }
+    counters_.max_depth = std::max<uint64_t>(counters_.max_depth, depth_);
+    poll_stream(stream, now_ms, out);
+    refresh(key, stream);
+}
+
+void ReorderBuffer::poll(uint64_t now_ms, std::vector<InboundMessage>& out) {
+    // Only streams whose deadline has come have anything to do.
+    std::vector<std::string> due;
+    for (const auto& entry : deadlines_) {
+        if (entry.first > now_ms) break;
+        due.push_back(entry.second);
+    }
+    for (const auto& key : due) {
+        auto it = streams_.find(key);
+        if (it == streams_.end()) continue;
+        Stream& stream = it->second;
+        poll_stream(stream, now_ms, out);
+        if (stream.pending_seq.empty() && stream.pending_ts.empty() &&
+            now_ms - stream.last_activity_ms >= kStreamIdleMs) {
+            deadlines_.erase({stream.deadline, key});
+            streams_.erase(it);
+        } else {
+            refresh(key, stream);
+        }
+    }
+}
+
+uint64_t ReorderBuffer::next_deadline() const {
+    return deadlines_.empty() ? std::numeric_limits<uint64_t>::max()
+                              : deadlines_.begin()->first;
+}
+
+void ReorderBuffer::refresh(const std::string& key, Stream& stream) {
+    const uint64_t deadline = stream_deadline(stream);
+    if (deadline == stream.deadline) return;
+    deadlines_.erase({stream.deadline, key});
+    stream.deadline = deadline;
+    deadlines_.emplace(deadline, key);
+}
+
+uint64_t ReorderBuffer::stream_deadline(const Stream& stream) const {
+    if (stream.pending_seq.empty() && stream.pending_ts.empty()) {
+        return stream.last_activity_ms + kStreamIdleMs;
+    }
+    uint64_t next = std::numeric_limits<uint64_t>::max();
+    for (const auto& pending : stream.pending_seq) {
+        next = std::min(next, pending.second.arrived_ms + window_ms_);
+    }
+    for (const auto& pending : stream.pending_ts) {
+        next = std::min(next, due_ms(stream, pending.second));
+    }
+    return next;
+}
+
+void ReorderBuffer::push_sequenced(
+    Stream& stream,
+    InboundMessage msg,
+    uint64_t now_ms,
+    std::vector<InboundMessage>& out) {
+    const SenderStamp stamp = msg.stamp;
+    if (stream.seq_started && stream.epoch != stamp.epoch) {
+        // A straggler from before the restart, or from an epoch older than
+        // the current one that was never seen: out of order by definition,
+        // and no reason to start the sequence over.
+        const bool retired = std::find(stream.retired.begin(), stream.retired.end(),
+                                       stamp.epoch) != stream.retired.end();
+        if (retired || (msg.server_ts && msg.server_ts < stream.epoch_ts)) {
+            if (!retired) retire(stream, stamp.epoch);
+            ++counters_.late;
+            emit(std::move(msg), now_ms, out);
+            return;
+        }
+    }
+    if (!stream.seq_started || stream.epoch != stamp.epoch) {
+        // First message from this publisher, or it restarted: whatever is
+        // still pending from the old epoch goes out first, in order.
+        for (auto& entry : stream.pending_seq) {
+            --depth_;
+            emit(std::move(entry.second), now_ms, out);
+        }
+        if (stream.seq_started) retire(stream, stream.epoch);
+        stream.pending_seq.clear();
+        stream.recent.clear();
+        stream.recent_order.clear();
+        stream.seq_started = true;
+        stream.epoch = stamp.epoch;
+        stream.epoch_ts = 0;
+        stream.next_seq = stamp.seq;
+    }
+    stream.epoch_ts = std::max(stream.epoch_ts, msg.server_ts);
+
+    if (stamp.seq < stream.next_seq) {
+        if (stream.recent.count(stamp.seq)) {
+            ++counters_.duplicates;
+            return;
+        }
+        // A gap we already gave up on was filled after all.
+        ++counters_.late;
+        remember(stream, stamp.seq);
+        emit(std::move(msg), now_ms, out);
+        return;
+    }
+
+    if (!stream.pending_seq.emplace(stamp.seq, std::move(msg)).second) {
+        ++counters_.duplicates;
+        return;
+    }
+    ++depth_;
+    release_run(stream, now_ms, out);
+}
+
+void ReorderBuffer::poll_stream(Stream& stream, uint64_t now_ms, std::vector<InboundMessage>& out) {
+    // Stamped: once anything behind a gap has waited out the window, skip
+    // the gap and release the run that follows it.
+    while (!stream.pending_seq.empty()) {
+        uint64_t oldest = std::numeric_limits<uint64_t>::max();
+        for (const auto& entry : stream.pending_seq) {
+            oldest = std::min(oldest, entry.second.arrived_ms);
+        }
+        if (now_ms - oldest < window_ms_) {
+            break;
+        }
+        uint64_t first = stream.pending_seq.begin()->first;
+        counters_.gaps_skipped += first - stream.next_seq;
+        stream.next_seq = first;
+        release_run(stream, now_ms, out);
+    }
+
+    // Unstamped: release everything up to the newest timestamp that has
+    // waited long enough, so earlier timestamps never trail it.
+    bool expired = false;
+    uint64_t cutoff = 0;
+    for (const auto& entry : stream.pending_ts) {
+        if (now_ms >= due_ms(stream, entry.second)) {
+            expired = true;
+            cutoff = entry.first;
+        }
+    }
+    if (!expired) {
+        return;
+    }
+    while (!stream.pending_ts.empty() && stream.pending_ts.begin()->first <= cutoff) {
+        auto node = stream.pending_ts.begin();
+        stream.last_released_ts = node->first;
+        --depth_;
+        emit(std::move(node->second), now_ms, out);
+        stream.pending_ts.erase(node);
+    }
+}
+
+void ReorderBuffer::release_run(Stream& stream, uint64_t now_ms, std::vector<InboundMessage>& out) {
+    while (!stream.pending_seq.empty() && stream.pending_seq.begin()->first == stream.next_seq) {
+        auto node = stream.pending_seq.begin();
+        remember(stream, node->first);
+        --depth_;
+        emit(std::move(node->second), now_ms, out);
+        stream.pending_seq.erase(node);
+        ++stream.next_seq;
+    }
+}
+
+void ReorderBuffer::remember(Stream& stream, uint64_t seq) {
+    if (!stream.recent.insert(seq).second) {
+        return;
+    }
+    stream.recent_order.push_back(seq);
+    if (stream.recent_order.size() > kRecentSeqs) {
+        stream.recent.erase(stream.recent_order.front());
+        stream.recent_order.pop_front();
+    }
+}
+
+void ReorderBuffer::retire(Stream& stream, uint32_t epoch) {
+    stream.retired.push_back(epoch);
+    if (stream.retired.size() > kRetiredEpochs) stream.retired.pop_front();
+}
+
+uint64_t ReorderBuffer::due_ms(const Stream& stream, const InboundMessage& msg) const {
+    const uint64_t latest = msg.arrived_ms + window_ms_;
+    if (!stream.transit_known || !msg.server_ts) return latest;
+    // Anything sent before it arrives within the window of when this one
+    // would have over the fastest transit seen.
+    const int64_t expected = int64_t(msg.server_ts) + stream.transit_min;
+    return std::min(latest, uint64_t(std::max<int64_t>(expected, 0)) + window_ms_);
+}
+
+void ReorderBuffer::emit(InboundMessage msg, uint64_t now_ms, std::vector<InboundMessage>& out) {
+    if (now_ms > msg.arrived_ms) {
+        uint64_t waited = now_ms - msg.arrived_ms;
+        ++counters_.held;
+        counters_.hold_ms_total += waited;
+        counters_.hold_ms_max = std::max(counters_.hold_ms_max, waited);
+    }
+    out.push_back(std::move(msg));
+}
+
+} // namespace atem_rtm
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace atem_rtm {
+
+constexpr uint32_t kDefaultReorderWindowMs = 50;
+
+// Sender stamp carried in PublishOptions::customType by publishing shims:
+// "seq:<epoch hex>:<seq hex>". The epoch changes whenever a client is
+// recreated so a restarted publisher never looks like a stream of replays.
+struct SenderStamp {
+    bool valid{false};
+    uint32_t epoch{0};
+    uint64_t seq{0};
+};
+
+// Formats into `buf` (at least kSenderStampMax bytes, the SDK's customType limit).
+constexpr size_t kSenderStampMax = 32;
+void format_sender_stamp(char* buf, uint32_t epoch, uint64_t seq);
+SenderStamp parse_sender_stamp(const char* custom_type);
+
+struct InboundMessage {
+    std::string publisher;
+    std::string channel;
+    std::string payload;
+    uint64_t server_ts{0};
+    SenderStamp stamp;
+    uint64_t arrived_ms{0};
+    bool replayed{false};  // from history, not live traffic
+};
+
+// Per-publisher (and per-channel) reorder buffer. Stamped messages are
+// released as soon as they are next in sequence and only wait when a gap
+// is open. A new epoch restarts the sequence; stragglers from an earlier
+// one go out at once as late. Unstamped messages are released in server
+// timestamp order once the window has passed since they would have
+// arrived over the fastest transit seen from their publisher, so time
+// already spent in transit counts against the wait. Either way nothing
+// waits longer than the window.
+// Not thread-safe; the owning client serialises access.
+class ReorderBuffer {
+public:
+    struct Counters {
+        uint64_t held{0};           // messages that had to wait at all
+        uint64_t hold_ms_total{0};
+        uint64_t hold_ms_max{0};
+        uint64_t max_depth{0};
+        uint64_t gaps_skipped{0};   // sequence numbers given up on
+        uint64_t duplicates{0};
+        uint64_t late{0};           // delivered behind a newer message
+    };
+
+    explicit ReorderBuffer(uint64_t hold_window_ms);
+
+    void push(InboundMessage msg, uint64_t now_ms, std::vector<InboundMessage>& out);
+
+    // Releases whatever has waited out the window.
+    void poll(uint64_t now_ms, std::vector<InboundMessage>& out);
+    // When poll() next has something to do (release or forget an idle
+    // stream); UINT64_MAX when never. Kept up to date as streams change,
+    // so asking is cheap.
+    uint64_t next_deadline() const;
+
+    size_t depth() const { return depth_; }
+    const Counters& counters() const { return counters_; }
+
+private:
+    struct Stream {
+        // Stamped traffic
+        bool seq_started{false};
+        uint32_t epoch{0};
+        uint64_t epoch_ts{0};  // newest server timestamp seen in `epoch`
+        std::deque<uint32_t> retired;  // earlier epochs, oldest first
+        uint64_t next_seq{0};
+        std::map<uint64_t, InboundMessage> pending_seq;
+        std::unordered_set<uint64_t> recent;
+        std::deque<uint64_t> recent_order;
+
+        // Unstamped traffic, keyed by server timestamp
+        std::multimap<uint64_t, InboundMessage> pending_ts;
+        uint64_t last_released_ts{0};
+        bool transit_known{false};
+        int64_t transit_min{0};  // lowest arrival minus server timestamp
+
+        uint64_t last_activity_ms{0};
+        uint64_t deadline{UINT64_MAX};  // its entry in deadlines_
+    };
+
+    void push_sequenced(Stream& stream, InboundMessage msg, uint64_t now_ms,
+                        std::vector<InboundMessage>& out);
+    void poll_stream(Stream& stream, uint64_t now_ms, std::vector<InboundMessage>& out);
+    // Recomputes a changed stream's deadline and files it in deadlines_.
+    void refresh(const std::string& key, Stream& stream);
+    uint64_t stream_deadline(const Stream& stream) const;
+    void release_run(Stream& stream, uint64_t now_ms, std::vector<InboundMessage>& out);
+    void remember(Stream& stream, uint64_t seq);
+    void retire(Stream& stream, uint32_t epoch);
+    // When an unstamped message has waited long enough.
+    uint64_t due_ms(const Stream& stream, const InboundMessage& msg) const;
+    void emit(InboundMessage msg, uint64_t now_ms, std::vector<InboundMessage>& out);
+
+    uint64_t window_ms_;
+    size_t depth_{0};
+    Counters counters_;
+    std::unordered_map<std::string, Stream> streams_;
+    // Every stream by its deadline, earliest first.
+    std::set<std::pair<uint64_t, std::string>> deadlines_;
+};
+
+} // namespace atem_rtm
@@ -0,0 +1,119 @@
+#include "atem_rtm_series.h"
+
+#include "atem_rtm_clock.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace atem_rtm {
+
+namespace {
+
+constexpr size_t kExactBuckets = 16;
+constexpr size_t kSubBuckets = 4;
+
+uint32_t saturate(uint64_t value) {
+    return static_cast<uint32_t>(
+        std::min<uint64_t>(value, std::numeric_limits<uint32_t>::max()));
+}
+
+} // namespace
+
+StatsSeries::StatsSeries()
+    : second_(now_ms() / 1000), wall_offset_s_(wall_ms() / 1000 - now_ms() / 1000) {
+    current_.unix_second = second_ + wall_offset_s_;
+}
+
+void StatsSeries::inbound(size_t bytes, uint64_t now_ms) {
+    advance(now_ms);
+    ++current_.messages_in;
+    current_.bytes_in += bytes;
+}
+
+void StatsSeries::outbound(size_t bytes, uint64_t now_ms) {
+    advance(now_ms);
+    ++current_.messages_out;
+    current_.bytes_out += bytes;
+}
+
+void StatsSeries::latency(uint64_t latency_ms, uint64_t now_ms) {
+    advance(now_ms);
+    ++latency_[bucket_of(latency_ms)];
+    ++current_.latency_samples;
+}
+
+void StatsSeries::depth(size_t depth, uint64_t now_ms) {
+    advance(now_ms);
+    current_.queue_depth_max = std::max(current_.queue_depth_max, saturate(depth));
+}
+
+void StatsSeries::errors(uint64_t count, uint64_t now_ms) {
+    if (count == 0) return;
+    advance(now_ms);
+    current_.errors = saturate(current_.errors + count);
+}
+
+size_t StatsSeries::copy(uint64_t now_ms, AtemRtmStatsSample* out, size_t max) {
+    advance(now_ms);
+    const size_t n = std::min(max, count_);
+    const size_t skip = count_ - n;
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = ring_[(head_ + skip + i) % kStatsSeriesSeconds];
+    }
+    return n;
+}
+
+size_t StatsSeries::bucket_of(uint64_t latency_ms) {
+    if (latency_ms < kExactBuckets) return static_cast<size_t>(latency_ms);
+    size_t log = 4;
+    while ((latency_ms >> (log + 1)) != 0) ++log;
+    const size_t sub = static_cast<size_t>(latency_ms >> (log - 2)) & (kSubBuckets - 1);
+    return std::min(kExactBuckets + (log - 4) * kSubBuckets + sub, kLatencyBuckets - 1);
+}
+
+uint64_t StatsSeries::bucket_top(size_t bucket) {
+    if (bucket < kExactBuckets) return bucket;
+    const size_t log = (bucket - kExactBuckets) / kSubBuckets + 4;
+    const uint64_t sub = (bucket - kExactBuckets) % kSubBuckets;
+    return ((kSubBuckets + sub + 1) << (log - 2)) - 1;
+}
+
+void StatsSeries::advance(uint64_t now_ms) {
+    const uint64_t second = now_ms / 1000;
+    if (second <= second_) return;
+    close_current();
+    // Idle seconds; a gap longer than the ring only needs the ring's worth.
+    const uint64_t idle = std::min<uint64_t>(second - second_ - 1, kStatsSeriesSeconds);
+    for (uint64_t i = 0; i < idle; ++i) {
+        current_ = AtemRtmStatsSample{};
+        current_.unix_second = second - idle + i + wall_offset_s_;
+        close_current();
+    }
+    second_ = second;
+    current_ = AtemRtmStatsSample{};
+    current_.unix_second = second_ + wall_offset_s_;
+}
+
+void StatsSeries::close_current() {
+    if (current_.latency_samples > 0) {
+        const uint64_t rank = (static_cast<uint64_t>(current_.latency_samples) * 99 + 99) / 100;
+        uint64_t seen = 0;
+        for (size_t bucket = 0; bucket < kLatencyBuckets; ++bucket) {
+            seen += latency_[bucket];
+            if (seen >= rank) {
+                current_.latency_p99_ms = saturate(bucket_top(bucket));
+                break;
+            }
+        }
+        latency_.fill(0);
+    }
+    if (count_ < kStatsSeriesSeconds) {
+        ring_[(head_ + count_) % kStatsSeriesSeconds] = current_;
+        ++count_;
+    } else {
+        ring_[head_] = current_;
+        head_ = (head_ + 1) % kStatsSeriesSeconds;
+    }
+}
+
+} // namespace atem_rtm
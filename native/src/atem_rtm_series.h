@@ -0,0 +1,52 @@
+#pragma once
+
+#include "atem_rtm.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace atem_rtm {
+
+constexpr size_t kStatsSeriesSeconds = ATEM_RTM_STATS_SERIES_SECONDS;
+
+// Per-second traffic samples for the last kStatsSeriesSeconds in a fixed
+// ring, so a dashboard reads the whole window in one copy. The second in
+// progress accumulates on the side and enters the ring when it is over;
+// seconds without any traffic enter as empty samples. Latency goes into
+// log-linear buckets (exact below 16 ms, then four per power of two), so
+// the p99 is the top of its bucket, at most a quarter above the truth.
+// Not thread-safe; the owning client serialises access.
+class StatsSeries {
+public:
+    StatsSeries();
+
+    void inbound(size_t bytes, uint64_t now_ms);
+    void outbound(size_t bytes, uint64_t now_ms);
+    void latency(uint64_t latency_ms, uint64_t now_ms);
+    void depth(size_t depth, uint64_t now_ms);
+    void errors(uint64_t count, uint64_t now_ms);
+
+    // Completed seconds, oldest first: the newest `max` of them.
+    size_t copy(uint64_t now_ms, AtemRtmStatsSample* out, size_t max);
+
+private:
+    static constexpr size_t kLatencyBuckets = 128;
+
+    static size_t bucket_of(uint64_t latency_ms);
+    static uint64_t bucket_top(size_t bucket);
+
+    // Closes the seconds before the one `now_ms` falls in.
+    void advance(uint64_t now_ms);
+    void close_current();
+
+    std::array<AtemRtmStatsSample, kStatsSeriesSeconds> ring_{};
+    size_t head_{0};  // oldest sample
+    size_t count_{0};
+    uint64_t second_;          // monotonic second in progress
+    uint64_t wall_offset_s_;   // unix second = monotonic second + offset
+    AtemRtmStatsSample current_{};
+    std::array<uint32_t, kLatencyBuckets> latency_{};
+};
+
+} // namespace atem_rtm
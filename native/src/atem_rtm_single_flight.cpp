@@ -0,0 +1,161 @@
+#include "atem_rtm_single_flight.h"
+
+#include <utility>
+
+namespace atem_rtm {
+
+namespace {
+
+constexpr size_t kMaxEarlyResults = 64;
+// Expired results are swept once the cache grows past this.
+constexpr size_t kMaxCachedReads = 1024;
+
+} // namespace
+
+SingleFlight::SingleFlight(uint64_t ttl_ms, uint64_t error_ttl_ms)
+    : ttl_ms_(ttl_ms), error_ttl_ms_(error_ttl_ms) {}
+
+std::string SingleFlight::key(const char* op, const std::string& a, const std::string& b) {
+    std::string id(op);
+    id.push_back('\x1f');
+    id.append(a);
+    if (!b.empty()) {
+        id.push_back('\x1f');
+        id.append(b);
+    }
+    return id;
+}
+
+SingleFlight::Start SingleFlight::begin(
+    const std::string& key,
+    uint64_t waiter,
+    uint64_t now_ms,
+    std::shared_ptr<const ReadResult>& cached) {
+    ++counters_.requests;
+    auto hit = cache_.find(key);
+    if (hit != cache_.end()) {
+        if (now_ms < hit->second.expires_ms) {
+            ++counters_.cache_hits;
+            cached = hit->second.result;
+            return Start::Cached;
+        }
+        cache_.erase(hit);
+    }
+    auto joinable = joinable_.find(key);
+    if (joinable != joinable_.end()) {
+        flights_[joinable->second].waiters.push_back(waiter);
+        ++counters_.collapsed;
+        return Start::Joined;
+    }
+    joinable_[key] = waiter;
+    flights_[waiter] = Flight{key, {waiter}, false};
+    ++counters_.issued;
+    return Start::Issue;
+}
+
+void SingleFlight::issued(
+    uint64_t waiter,
+    uint64_t request_id,
+    uint64_t now_ms,
+    std::vector<Delivery>& done) {
+    in_flight_[request_id] = waiter;
+    auto early = early_.find(request_id);
+    if (early != early_.end()) {
+        ReadResult result = std::move(early->second);
+        early_.erase(early);
+        completed(request_id, std::move(result), now_ms, done);
+    }
+}
+
+void SingleFlight::abandon(uint64_t waiter, int32_t code, std::vector<Delivery>& done) {
+    auto result = std::make_shared<ReadResult>();
+    result->code = code;
+    finish(waiter, std::move(result), done);
+}
+
+void SingleFlight::completed(
+    uint64_t request_id,
+    ReadResult result,
+    uint64_t now_ms,
+    std::vector<Delivery>& done) {
+    auto it = in_flight_.find(request_id);
+    if (it == in_flight_.end()) {
+        if (early_.size() >= kMaxEarlyResults) early_.clear();
+        early_[request_id] = std::move(result);
+        return;
+    }
+    const uint64_t id = it->second;
+    in_flight_.erase(it);
+
+    auto shared = std::make_shared<const ReadResult>(std::move(result));
+    const uint64_t ttl = shared->code == 0 ? ttl_ms_ : error_ttl_ms_;
+    auto flight = flights_.find(id);
+    if (ttl > 0 && flight != flights_.end() && !flight->second.stale) {
+        if (cache_.size() >= kMaxCachedReads) {
+            for (auto entry = cache_.begin(); entry != cache_.end();) {
+                entry = now_ms >= entry->second.expires_ms ? cache_.erase(entry) : ++entry;
+            }
+        }
+        cache_[flight->second.key] = Cached{shared, now_ms + ttl};
+    }
+    finish(id, std::move(shared), done);
+}
+
+void SingleFlight::invalidate(const std::string& key) {
+    cache_.erase(key);
+    auto joinable = joinable_.find(key);
+    if (joinable != joinable_.end()) retire(joinable->second);
+}
+
+void SingleFlight::invalidate_prefix(const std::string& prefix) {
+    for (auto it = cache_.begin(); it != cache_.end();) {
+        it = it->first.compare(0, prefix.size(), prefix) == 0 ? cache_.erase(it) : ++it;
+    }
+    std::vector<uint64_t> matched;
+    for (const auto& joinable : joinable_) {
+        if (joinable.first.compare(0, prefix.size(), prefix) == 0) {
+            matched.push_back(joinable.second);
+        }
+    }
+    for (uint64_t flight : matched) retire(flight);
+}
+
+void SingleFlight::invalidate_all() {
+    cache_.clear();
+    for (auto& flight : flights_) flight.second.stale = true;
+    joinable_.clear();
+}
+
+void SingleFlight::close(int32_t code, std::vector<Delivery>& done) {
+    auto result = std::make_shared<ReadResult>();
+    result->code = code;
+    for (auto& entry : flights_) {
+        for (uint64_t waiter : entry.second.waiters) done.push_back(Delivery{waiter, result});
+    }
+    flights_.clear();
+    joinable_.clear();
+    in_flight_.clear();
+    cache_.clear();
+}
+
+void SingleFlight::retire(uint64_t flight) {
+    auto it = flights_.find(flight);
+    if (it == flights_.end()) return;
+    it->second.stale = true;
+    joinable_.erase(it->second.key);
+}
+
+void SingleFlight::finish(
+    uint64_t id,
+    std::shared_ptr<const ReadResult> result,
+    std::vector<Delivery>& done) {
+    auto flight = flights_.find(id);
+    if (flight == flights_.end()) {
+        return;
+    }
+    for (uint64_t waiter : flight->second.waiters) done.push_back(Delivery{waiter, result});
+    if (!flight->second.stale) joinable_.erase(flight->second.key);
+    flights_.erase(flight);
+}
+
+} // namespace atem_rtm
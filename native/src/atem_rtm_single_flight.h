@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace atem_rtm {
+
+// One key/value pair of a read: a state or metadata item, a user (no
+// value) for whoNow, or publisher/message for history.
+struct ReadItem {
+    std::string key;
+    std::string value;
+    bool has_value{false};
+    uint64_t timestamp{0};
+};
+
+struct ReadResult {
+    int32_t code{0};  // SDK error code; 0 on success
+    std::vector<ReadItem> items;
+};
+
+// Collapses identical concurrent reads (getState, getChannelMetadata,
+// whoNow, history) into one SDK request and fans the result out to every
+// waiter. Results can optionally be served again for a short while:
+// successes for `ttl_ms`, errors for `error_ttl_ms` (0 disables either).
+// Callers invalidate keys when events show the data changed.
+// Not thread-safe; the owning client serialises access.
+class SingleFlight {
+public:
+    struct Counters {
+        uint64_t requests{0};
+        uint64_t issued{0};     // SDK requests actually sent
+        uint64_t collapsed{0};  // requests that joined one in flight
+        uint64_t cache_hits{0};
+    };
+
+    struct Delivery {
+        uint64_t waiter;
+        std::shared_ptr<const ReadResult> result;
+    };
+
+    enum class Start {
+        Cached,  // `cached` is set; answer now
+        Joined,  // an identical read is in flight; wait for it
+        Issue,   // send the request, then report it via issued()/abandon()
+                 // with this waiter
+    };
+
+    SingleFlight(uint64_t ttl_ms, uint64_t error_ttl_ms);
+
+    static std::string key(const char* op, const std::string& a, const std::string& b = {});
+
+    Start begin(const std::string& key, uint64_t waiter, uint64_t now_ms,
+                std::shared_ptr<const ReadResult>& cached);
+    // `waiter` is the one begin() told to issue.
+    void issued(uint64_t waiter, uint64_t request_id, uint64_t now_ms,
+                std::vector<Delivery>& done);
+    // The request could not be sent; waiters get `code`.
+    void abandon(uint64_t waiter, int32_t code, std::vector<Delivery>& done);
+    void completed(uint64_t request_id, ReadResult result, uint64_t now_ms,
+                   std::vector<Delivery>& done);
+
+    // Drops cached results. In-flight reads still complete for the waiters
+    // they have, but what they return predates the change: it is not
+    // cached, and later reads of the key issue a request of their own.
+    void invalidate(const std::string& key);
+    void invalidate_prefix(const std::string& prefix);
+    void invalidate_all();
+
+    // Completes every waiter with `code`, e.g. on shutdown.
+    void close(int32_t code, std::vector<Delivery>& done);
+
+    size_t in_flight() const { return in_flight_.size(); }
+    const Counters& counters() const { return counters_; }
+
+private:
+    struct Flight {
+        std::string key;
+        std::vector<uint64_t> waiters;
+        bool stale{false};  // invalidated while in flight; not cached
+    };
+
+    struct Cached {
+        std::shared_ptr<const ReadResult> result;
+        uint64_t expires_ms{0};
+    };
+
+    // Stops later reads of the flight's key from joining it.
+    void retire(uint64_t flight);
+    void finish(uint64_t flight, std::shared_ptr<const ReadResult> result,
+                std::vector<Delivery>& done);
+
+    uint64_t ttl_ms_;
+    uint64_t error_ttl_ms_;
+    Counters counters_;
+    std::unordered_map<uint64_t, Flight> flights_;       // by issuing waiter
+    std::unordered_map<std::string, uint64_t> joinable_;  // key -> flight
+    std::unordered_map<uint64_t, uint64_t> in_flight_;    // request id -> flight
+    std::unordered_map<uint64_t, ReadResult> early_;
+    std::unordered_map<std::string, Cached> cache_;
+};
+
+} // namespace atem_rtm
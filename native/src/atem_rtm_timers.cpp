@@ -0,0 +1,184 @@
+#include "atem_rtm_timers.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace atem_rtm {
+
+namespace {
+
+unsigned lowest_bit(uint64_t bits) {
+    return static_cast<unsigned>(__builtin_ctzll(bits));
+}
+
+} // namespace
+
+TimerWheel::TimerWheel(uint64_t now_ms) : now_(now_ms) {
+    heads_.fill(kNil);
+}
+
+TimerId TimerWheel::schedule(uint64_t deadline_ms, Task task, uint32_t slack_ms) {
+    if (slack_ms) {
+        uint64_t grid = 1;
+        while (grid * 2 <= uint64_t(slack_ms) + 1) grid *= 2;
+        if (deadline_ms <= UINT64_MAX - grid) {
+            deadline_ms = (deadline_ms + grid - 1) & ~(grid - 1);
+        }
+    }
+    uint32_t index;
+    if (!free_.empty()) {
+        index = free_.back();
+        free_.pop_back();
+    } else {
+        index = static_cast<uint32_t>(nodes_.size());
+        nodes_.emplace_back();
+    }
+    Node& node = nodes_[index];
+    node.deadline = deadline_ms;
+    node.task = std::move(task);
+    place(index, now_ + 1);
+    ++size_;
+    ++counters_.scheduled;
+    return (uint64_t(node.generation) << 32) | (uint64_t(index) + 1);
+}
+
+bool TimerWheel::cancel(TimerId id) {
+    const uint64_t low = id & 0xffffffffu;
+    if (low == 0 || low > nodes_.size()) return false;
+    const uint32_t index = static_cast<uint32_t>(low - 1);
+    const Node& node = nodes_[index];
+    if (node.slot == kNil || node.generation != static_cast<uint32_t>(id >> 32)) return false;
+    unlink(index);
+    release(index);
+    --size_;
+    ++counters_.cancelled;
+    return true;
+}
+
+void TimerWheel::advance(uint64_t now_ms, std::vector<Task>& due) {
+    while (now_ < now_ms) {
+        // Ticks in between have nothing filed under them; skip to the next
+        // one that does.
+        const uint64_t tick = next_wakeup();
+        if (tick > now_ms) break;
+        run_tick(tick, due);
+    }
+    now_ = std::max(now_, now_ms);
+}
+
+uint64_t TimerWheel::next_wakeup() const {
+    if (size_ == 0) return UINT64_MAX;
+    const uint64_t from = now_ + 1;
+    uint64_t best = UINT64_MAX;
+    for (size_t level = 0; level < kLevels; ++level) {
+        const uint64_t bits = occupied_[level];
+        if (!bits) continue;
+        // A slot is reached when the clock enters it. Slots behind the
+        // clock are reached in the next turn; only parked timers are there.
+        const unsigned shift = kSlotBits * static_cast<unsigned>(level);
+        const unsigned span = shift + kSlotBits;
+        const uint64_t base = (from >> span) << span;
+        const uint64_t first = (from - base + (uint64_t(1) << shift) - 1) >> shift;
+        const uint64_t ahead = first >= kSlots ? 0 : bits & (~uint64_t(0) << first);
+        const uint64_t at = ahead ? base + (uint64_t(lowest_bit(ahead)) << shift)
+                                  : base + (uint64_t(1) << span) +
+                                        (uint64_t(lowest_bit(bits)) << shift);
+        best = std::min(best, at);
+    }
+    return best;
+}
+
+void TimerWheel::place(uint32_t index, uint64_t ref) {
+    const uint64_t at = std::max(nodes_[index].deadline, ref);
+    for (size_t level = 0; level < kLevels; ++level) {
+        const unsigned shift = kSlotBits * static_cast<unsigned>(level);
+        if (((at ^ ref) >> (shift + kSlotBits)) == 0) {
+            link(index, static_cast<uint32_t>(level * kSlots + ((at >> shift) & (kSlots - 1))));
+            return;
+        }
+    }
+    // Beyond the top level's turn: park in its first slot, which is
+    // reached no later than the deadline, and place it again from there.
+    link(index, static_cast<uint32_t>((kLevels - 1) * kSlots));
+}
+
+void TimerWheel::link(uint32_t index, uint32_t slot) {
+    Node& node = nodes_[index];
+    node.slot = slot;
+    uint32_t& head = heads_[slot];
+    if (head == kNil) {
+        node.prev = index;
+        node.next = index;
+        head = index;
+        occupied_[slot / kSlots] |= uint64_t(1) << (slot % kSlots);
+        return;
+    }
+    const uint32_t tail = nodes_[head].prev;
+    node.prev = tail;
+    node.next = head;
+    nodes_[tail].next = index;
+    nodes_[head].prev = index;
+}
+
+void TimerWheel::unlink(uint32_t index) {
+    Node& node = nodes_[index];
+    const uint32_t slot = node.slot;
+    if (node.next == index) {
+        heads_[slot] = kNil;
+        occupied_[slot / kSlots] &= ~(uint64_t(1) << (slot % kSlots));
+    } else {
+        nodes_[node.prev].next = node.next;
+        nodes_[node.next].prev = node.prev;
+        if (heads_[slot] == index) heads_[slot] = node.next;
+    }
+    node.prev = kNil;
+    node.next = kNil;
+}
+
+void TimerWheel::release(uint32_t index) {
+    Node& node = nodes_[index];
+    node.task = nullptr;
+    node.slot = kNil;
+    ++node.generation;
+    free_.push_back(index);
+}
+
+void TimerWheel::run_tick(uint64_t tick, std::vector<Task>& due) {
+    // Coarse levels first: what they move down may land in a finer slot
+    // reached at this same tick.
+    for (size_t level = kLevels - 1; level > 0; --level) {
+        const unsigned shift = kSlotBits * static_cast<unsigned>(level);
+        if (tick & ((uint64_t(1) << shift) - 1)) continue;
+        const uint32_t slot = static_cast<uint32_t>(level * kSlots + ((tick >> shift) & (kSlots - 1)));
+        const uint32_t head = heads_[slot];
+        if (head == kNil) continue;
+        heads_[slot] = kNil;
+        occupied_[level] &= ~(uint64_t(1) << (slot % kSlots));
+        uint32_t index = head;
+        do {
+            const uint32_t next = nodes_[index].next;
+            place(index, tick);
+            ++counters_.cascaded;
+            index = next;
+        } while (index != head);
+    }
+
+    const uint32_t slot = static_cast<uint32_t>(tick & (kSlots - 1));
+    const uint32_t head = heads_[slot];
+    if (head != kNil) {
+        heads_[slot] = kNil;
+        occupied_[0] &= ~(uint64_t(1) << slot);
+        uint32_t index = head;
+        do {
+            const uint32_t next = nodes_[index].next;
+            due.push_back(std::move(nodes_[index].task));
+            release(index);
+            --size_;
+            ++counters_.fired;
+            index = next;
+        } while (index != head);
+    }
+    now_ = tick;
+}
+
+} // namespace atem_rtm
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace atem_rtm {
+
+// Handle of a scheduled timer; stays invalid once the timer ran or was
+// cancelled, even when its storage is reused.
+using TimerId = uint64_t;
+constexpr TimerId kNoTimer = 0;
+
+// Hierarchical timing wheel with 1 ms resolution: four levels of 64 slots
+// cover about 4.6 hours, later deadlines are parked in the top level and
+// placed again as it turns. Scheduling and cancelling are O(1); a timer is
+// moved down at most once per level before it runs. The wheel has no
+// clock of its own: time is whatever the owner passes to advance(), so the
+// stub drives it with its virtual clock. Slack lets a timer run up to that
+// much late so that timers close together share one wakeup.
+// Not thread-safe; the owner serialises access.
+class TimerWheel {
+public:
+    using Task = std::function<void()>;
+
+    struct Counters {
+        uint64_t scheduled{0};
+        uint64_t cancelled{0};
+        uint64_t fired{0};
+        uint64_t cascaded{0};  // moves to a finer level
+    };
+
+    // `now_ms` is where the wheel's clock starts.
+    explicit TimerWheel(uint64_t now_ms);
+
+    // Runs `task` from the first advance() at or past `deadline_ms`, or up
+    // to `slack_ms` later: the deadline is rounded up to the coarsest
+    // power-of-two grid the slack allows. Deadlines already passed run on
+    // the next advance() that moves the clock.
+    TimerId schedule(uint64_t deadline_ms, Task task, uint32_t slack_ms = 0);
+    // False when the timer already ran or was cancelled.
+    bool cancel(TimerId id);
+
+    // Moves the clock to `now_ms` and appends the tasks that came due,
+    // earliest deadline first. The caller runs them, outside whatever lock
+    // guards the wheel.
+    void advance(uint64_t now_ms, std::vector<Task>& due);
+
+    // When advance() next has work (a deadline, or a coarse slot to move
+    // down); UINT64_MAX when nothing is scheduled. Sleeping until then
+    // wakes once for timers that share a slot.
+    uint64_t next_wakeup() const;
+
+    uint64_t now() const { return now_; }
+    size_t size() const { return size_; }
+    const Counters& counters() const { return counters_; }
+
+private:
+    static constexpr unsigned kSlotBits = 6;
+    static constexpr size_t kSlots = size_t(1) << kSlotBits;
+    static constexpr size_t kLevels = 4;
+    static constexpr uint32_t kNil = UINT32_MAX;
+
+    struct Node {
+        uint64_t deadline{0};
+        Task task;
+        uint32_t generation{0};
+        uint32_t prev{kNil};
+        uint32_t next{kNil};
+        uint32_t slot{kNil};  // level * kSlots + index; kNil = free
+    };
+
+    // Files the node under the slot that is reached at or before its
+    // deadline, seen from `ref` (the last tick run, or the one running).
+    void place(uint32_t index, uint64_t ref);
+    void link(uint32_t index, uint32_t slot);
+    void unlink(uint32_t index);
+    void release(uint32_t index);
+    void run_tick(uint64_t tick, std::vector<Task>& due);
+
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> free_;
+    std::array<uint32_t, kLevels * kSlots> heads_;  // circular lists; kNil = empty
+    std::array<uint64_t, kLevels> occupied_{};      // bit n = slot n non-empty
+    uint64_t now_;                                  // last tick run
+    size_t size_{0};
+    Counters counters_;
+};
+
+} // namespace atem_rtm
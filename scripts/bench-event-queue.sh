@@ -0,0 +1,41 @@
+#!/usr/bin/env bash
+#
+# scripts/bench-event-queue.sh — time the native event queue on its own.
+#
+# USAGE
+#   ./scripts/bench-event-queue.sh            # 300- and 2000-byte payloads
+#   ./scripts/bench-event-queue.sh 512 4096   # explicit payload sizes
+#
+# WHAT IT DOES
+#   Builds native/bench/event_queue_bench.cpp with -O2 against the shim's
+#   event queue. For each size it runs the "record" path (a built
+#   EventRecord, as every event used to be queued) and the "message" path
+#   (push_message). Payloads over the slot's inline space (about 512 bytes)
+#   use the spill pool.
+#
+# WHAT IT DOES NOT DO
+#   - Does NOT measure cache misses (prefix the runs with
+#     `perf stat -e cache-misses` where perf counters are available)
+#   - Does NOT cover the Rust side, reorder or fair scheduling, which still
+#     build a String per event; for end to end use
+#     `cargo test --release event_stream_throughput -- --ignored --nocapture`
+
+set -euo pipefail
+
+cd "$(dirname "$0")/.."
+CXX="${CXX:-g++}"
+OUT="$(mktemp -d)"
+trap 'rm -rf "$OUT"' EXIT
+
+"$CXX" -std=c++17 -O2 -Inative/include -Inative/src \
+    native/bench/event_queue_bench.cpp \
+    native/src/atem_rtm_events.cpp \
+    native/src/atem_rtm_fair.cpp \
+    -o "$OUT/event_queue_bench"
+
+SIZES=("$@")
+[[ ${#SIZES[@]} -eq 0 ]] && SIZES=(300 2000)
+for size in "${SIZES[@]}"; do
+    "$OUT/event_queue_bench" "$size" record
+    "$OUT/event_queue_bench" "$size" message
+done
@@ -27,13 +27,15 @@ use crate::codex_client::{CodexClient, CodexResizeHandle};
 use crate::command::StreamBuffer;
 use crate::dispatch::{TaskDispatcher, WorkItem, WorkKind};
 use crate::config::AtemConfig;
-use crate::rtm_client::{RtmClient, RtmEvent};
+use crate::rtm_client::{RtmClient, RtmEvent, RtmLinkState};
 use crate::websocket_client::{AstationClient, AstationMessage};
 use crate::agent_client::{AgentEvent, AgentInfo, AgentKind, AgentOrigin, AgentProtocol, AgentStatus};
 use crate::agent_registry::AgentRegistry;
 use crate::acp_client::AcpClient;
 
 pub const AGORA_RTM_TOKEN_TTL_SECS: u32 = 3600;
+/// Activity pings are this many times less frequent while the terminal is unfocused.
+const IDLE_ACTIVITY_PING_FACTOR: u32 = 15;
 
 #[derive(Debug, Clone)]
 pub enum AppMode {
@@ -118,7 +120,10 @@ pub struct App {
     pub rtm_client: Option<RtmClient>,
     pub rtm_client_id: String,
     pub last_activity_ping: Option<Instant>,
+    /// Focus state the last activity ping reported.
+    pub last_activity_focused: Option<bool>,
     pub activity_ping_interval: Duration,
+    pub rtm_idle: bool,
     pub pending_transcriptions: VecDeque<String>,
     pub rtm_token_expires_at: Option<Instant>,
     pub show_certificates: bool,
@@ -257,7 +262,9 @@ impl App {
             rtm_client: None,
             rtm_client_id,
             last_activity_ping: None,
+            last_activity_focused: None,
             activity_ping_interval: Duration::from_secs(2),
+            rtm_idle: false,
             pending_transcriptions: VecDeque::new(),
             rtm_token_expires_at: None,
             show_certificates: false,
@@ -839,15 +846,25 @@ impl App {
     }
 
     pub async fn maybe_send_activity_ping(&mut self, focused: bool) {
-        let should_send = match self.last_activity_ping {
-            Some(last) => last.elapsed() >= self.activity_ping_interval,
-            None => true,
+        self.sync_rtm_idle(!focused).await;
+
+        // A focus change goes out at once; only repeats of the same state
+        // are spaced, and background Atems repeat far less often.
+        let interval = if focused {
+            self.activity_ping_interval
+        } else {
+            self.activity_ping_interval * IDLE_ACTIVITY_PING_FACTOR
+        };
+        let should_send = match (self.last_activity_ping, self.last_activity_focused) {
+            (Some(last), Some(reported)) if reported == focused => last.elapsed() >= interval,
+            _ => true,
         };
 
         if should_send {
             match self.send_activity_ping(focused).await {
                 Ok(()) => {
                     self.last_activity_ping = Some(Instant::now());
+                    self.last_activity_focused = Some(focused);
                 }
                 Err(_err) => {
                     // Silently ignore activity ping errors (RTM not configured/no current project)
@@ -857,6 +874,20 @@ impl App {
         }
     }
 
+    /// Puts the RTM shim into low-power idle mode while the terminal is
+    /// unfocused; leaving idle triggers its fast catch-up.
+    async fn sync_rtm_idle(&mut self, idle: bool) {
+        if self.rtm_idle == idle {
+            return;
+        }
+        if let Some(rtm) = &self.rtm_client {
+            if rtm.set_idle(idle).await.is_err() {
+                return;
+            }
+        }
+        self.rtm_idle = idle;
+    }
+
     pub async fn process_rtm_messages(&mut self) -> Result<()> {
         // RTM DISABLED: No RTM events to process
         // Still flush transcriptions if needed
@@ -865,11 +896,31 @@ impl App {
     }
 
     pub fn handle_rtm_event(&mut self, event: RtmEvent) {
-        if event.payload.trim().is_empty() {
+        match event {
+            RtmEvent::Message { payload, .. } => self.handle_rtm_message(&payload),
+            RtmEvent::LinkState { state, reason } => match state {
+                RtmLinkState::Connected => {
+                    self.status_message = Some("RTM connected.".to_string());
+                }
+                RtmLinkState::Disconnected | RtmLinkState::Suspended | RtmLinkState::Failed => {
+                    self.status_message =
+                        Some(format!("RTM link {:?} (reason {})", state, reason));
+                }
+                _ => {}
+            },
+            RtmEvent::TokenWillExpire { .. } => {
+                self.status_message = Some("RTM token will expire soon.".to_string());
+            }
+            _ => {}
+        }
+    }
+
+    fn handle_rtm_message(&mut self, payload: &str) {
+        if payload.trim().is_empty() {
             return;
         }
 
-        match serde_json::from_str::<Value>(&event.payload) {
+        match serde_json::from_str::<Value>(payload) {
             Ok(value) => {
                 if let Some(kind) = value.get("type").and_then(|v| v.as_str()) {
                     match kind {
@@ -913,7 +964,7 @@ impl App {
             Err(err) => {
                 self.status_message = Some(format!(
                     "Failed to parse RTM message '{}' ({})",
-                    event.payload, err
+                    payload, err
                 ));
             }
         }
@@ -2715,6 +2766,28 @@ mod tests {
         assert_eq!(got, "\x1b");
     }
 
+    #[tokio::test]
+    async fn activity_ping_goes_out_at_once_when_focus_changes() {
+        let mut app = App::new();
+        app.activity_ping_interval = Duration::from_secs(60);
+        app.maybe_send_activity_ping(true).await;
+        let first = app.last_activity_ping.expect("first ping is sent");
+
+        // Same state within the interval: nothing new.
+        app.maybe_send_activity_ping(true).await;
+        assert_eq!(app.last_activity_ping, Some(first));
+
+        // Losing focus is reported right away, not after 15 intervals.
+        app.maybe_send_activity_ping(false).await;
+        assert_eq!(app.last_activity_focused, Some(false));
+        let unfocused = app.last_activity_ping.unwrap();
+        app.maybe_send_activity_ping(false).await;
+        assert_eq!(app.last_activity_ping, Some(unfocused));
+
+        app.maybe_send_activity_ping(true).await;
+        assert_eq!(app.last_activity_focused, Some(true));
+    }
+
     #[test]
     fn test_active_cli_default_is_claude() {
         let app = App::new();
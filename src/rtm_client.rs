@@ -1,24 +1,246 @@
 use anyhow::{Result, anyhow};
 use libc::{c_char, c_void};
+use std::collections::VecDeque;
 use std::ffi::{CStr, CString};
+use std::io;
 use std::ptr;
 use std::sync::Arc;
-use tokio::sync::Mutex;
-use tokio::sync::mpsc::{
-    UnboundedReceiver, UnboundedSender, error::TryRecvError, unbounded_channel,
-};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::time::Duration;
+use tokio::sync::{Mutex, Notify, oneshot};
 
 #[repr(C)]
 struct AtemRtmClient {
     _private: [u8; 0],
 }
 
+#[repr(C)]
+struct AtemRtmFleet {
+    _private: [u8; 0],
+}
+
+const ATEM_RTM_QUEUED: i32 = 1;
+const ATEM_RTM_ERR_CLOSED: i32 = -2;
+const ATEM_RTM_ERR_NO_BUFFER: i32 = -3;
+const ATEM_RTM_ERR_BUSY: i32 = -4;
+
+const ATEM_RTM_AGE_NEVER: u64 = u64::MAX;
+const ATEM_RTM_FLEET_NO_JITTER: u32 = u32::MAX;
+
+const ATEM_RTM_EVENT_MESSAGE: u32 = 1;
+const ATEM_RTM_EVENT_PRESENCE: u32 = 2;
+const ATEM_RTM_EVENT_TOPIC: u32 = 3;
+const ATEM_RTM_EVENT_LOCK: u32 = 4;
+const ATEM_RTM_EVENT_STORAGE: u32 = 5;
+const ATEM_RTM_EVENT_LINK_STATE: u32 = 6;
+const ATEM_RTM_EVENT_RESULT: u32 = 7;
+const ATEM_RTM_EVENT_TOKEN_WILL_EXPIRE: u32 = 8;
+
+const ATEM_RTM_MESSAGE_REPLAYED: u32 = 1;
+
+const ATEM_RTM_PRESENCE_SNAPSHOT: u32 = 1;
+const ATEM_RTM_PRESENCE_JOIN: u32 = 2;
+
+/// Events moved out of the native queue per poll.
+const EVENT_POLL_BATCH: usize = 64;
+
+/// How long dropping a client waits for outstanding publishes to be acked.
+const DROP_SHUTDOWN_DEADLINE_MS: u32 = 1000;
+
+/// How often [`bring_up_fleet`] drives the native fleet.
+const FLEET_TICK: Duration = Duration::from_millis(5);
+
 #[repr(C)]
 struct AtemRtmConfig {
     app_id: *const c_char,
     token: *const c_char,
     channel: *const c_char,
     client_id: *const c_char,
+    peer_hold_capacity: usize,
+    peer_hold_ttl_ms: u32,
+    reorder_window_ms: u32,
+    idle_batch_window_ms: u32,
+    idle_presence_interval_ms: u32,
+    metadata_window_ms: u32,
+    outbound_buffer_count: u32,
+    outbound_buffer_size: u32,
+    event_queue_capacity: u32,
+    location_ttl_ms: u32,
+    read_cache_ms: u32,
+    read_error_cache_ms: u32,
+    dispatcher_tick_ms: u32,
+    dispatcher_name: *const c_char,
+    dispatcher_cpu_mask: u64,
+    dispatcher_priority: u32,
+    join_history_count: u32,
+    fair_quantum_bytes: u32,
+    fair_publisher_max_bytes: u32,
+    outbound_rate_per_s: u32,
+    outbound_burst: u32,
+    outbound_aging_ms: u32,
+    credit_window: u32,
+    credit_refresh_ms: u32,
+    credit_hold_max: u32,
+}
+
+#[repr(C)]
+struct AtemRtmBuffer {
+    id: u32,
+    data: *mut c_char,
+    capacity: usize,
+}
+
+#[repr(C)]
+#[derive(Debug, Default, Clone, Copy)]
+struct AtemRtmStats {
+    peer_messages_held: u64,
+    peer_messages_flushed: u64,
+    peer_messages_expired: u64,
+    peer_messages_dropped: u64,
+    peer_hold_depth: u64,
+    reorder_depth: u64,
+    reorder_max_depth: u64,
+    reorder_held: u64,
+    reorder_hold_ms_total: u64,
+    reorder_hold_ms_max: u64,
+    reorder_gaps_skipped: u64,
+    reorder_duplicates: u64,
+    reorder_late: u64,
+    publishes_sent: u64,
+    publishes_acked: u64,
+    publishes_failed: u64,
+    publishes_in_flight: u64,
+    idle_mode: u64,
+    idle_batched_messages: u64,
+    metadata_staged: u64,
+    metadata_coalesced: u64,
+    metadata_writes: u64,
+    metadata_written: u64,
+    metadata_conflicts: u64,
+    metadata_retries: u64,
+    metadata_superseded: u64,
+    metadata_failed: u64,
+    metadata_pending: u64,
+    metadata_in_flight: u64,
+    lock_waits: u64,
+    lock_acquires: u64,
+    lock_acquired: u64,
+    lock_contended: u64,
+    lock_failed: u64,
+    lock_waiters: u64,
+    lock_handoff_ms_total: u64,
+    lock_handoff_ms_max: u64,
+    history_stored: u64,
+    history_skipped: u64,
+    buffers_in_use: u64,
+    buffer_publishes: u64,
+    buffers_exhausted: u64,
+    events_queued: u64,
+    events_dropped: u64,
+    location_hits: u64,
+    location_misses: u64,
+    location_queries: u64,
+    location_collapsed: u64,
+    location_entries: u64,
+    reads_requested: u64,
+    reads_issued: u64,
+    reads_collapsed: u64,
+    reads_cache_hits: u64,
+    cpu_callbacks: u64,
+    cpu_callback_us: u64,
+    cpu_callback_max_us: u64,
+    cpu_message_us: u64,
+    cpu_presence_us: u64,
+    cpu_topic_us: u64,
+    cpu_lock_us: u64,
+    cpu_storage_us: u64,
+    cpu_link_state_us: u64,
+    cpu_result_us: u64,
+    cpu_token_us: u64,
+    cpu_dispatch_us: u64,
+    dispatcher_tasks: u64,
+    dispatcher_max_depth: u64,
+    dispatcher_lag_ms_max: u64,
+    events_spilled: u64,
+    prefetch_fetches: u64,
+    prefetch_replayed: u64,
+    prefetch_duplicates: u64,
+    prefetch_late: u64,
+    fair_shed: u64,
+    fair_publishers_max: u64,
+    outbound_queued: u64,
+    outbound_deferred: u64,
+    outbound_aged: u64,
+    outbound_wait_ms_max_control: u64,
+    outbound_wait_ms_max_normal: u64,
+    outbound_wait_ms_max_bulk: u64,
+    credit_grants_sent: u64,
+    credit_grants_received: u64,
+    credit_held: u64,
+    credit_waiting: u64,
+    credit_coalesced: u64,
+    timers_pending: u64,
+    timers_fired: u64,
+    dispatcher_wakeups: u64,
+    credit_refused: u64,
+}
+
+#[repr(C)]
+#[derive(Debug, Default, Clone, Copy)]
+struct AtemRtmStatsSample {
+    unix_second: u64,
+    bytes_in: u64,
+    bytes_out: u64,
+    messages_in: u32,
+    messages_out: u32,
+    latency_p99_ms: u32,
+    latency_samples: u32,
+    queue_depth_max: u32,
+    errors: u32,
+}
+
+#[repr(C)]
+#[derive(Debug, Default, Clone, Copy)]
+struct AtemRtmHealth {
+    link_state: i32,
+    last_inbound_age_ms: u64,
+    last_outbound_age_ms: u64,
+    inbound_queued: u64,
+    queue_lag_ms: u64,
+    requests_in_flight: u64,
+    token_age_ms: u64,
+}
+
+#[repr(C)]
+#[derive(Debug, Default, Clone, Copy)]
+struct AtemRtmFleetConfig {
+    max_parallel: u32,
+    stagger_ms: u32,
+    jitter_ms: u32,
+    ready_timeout_ms: u32,
+}
+
+#[repr(C)]
+#[derive(Debug, Default, Clone, Copy)]
+struct AtemRtmFleetReport {
+    sessions: u32,
+    ready: u32,
+    failed: u32,
+    pending: u32,
+    ready_ms_p50: u32,
+    ready_ms_p90: u32,
+    ready_ms_p99: u32,
+    ready_ms_max: u32,
+    elapsed_ms: u32,
+}
+
+#[repr(C)]
+#[derive(Debug, Default, Clone, Copy)]
+struct AtemRtmShutdownReport {
+    flushed: u32,
+    failed: u32,
+    abandoned: u32,
+    elapsed_ms: u32,
 }
 
 type AtemRtmMessageCallback = unsafe extern "C" fn(
@@ -27,16 +249,85 @@ type AtemRtmMessageCallback = unsafe extern "C" fn(
     user_data: *mut c_void,
 );
 
+#[repr(C)]
+#[derive(Clone, Copy)]
+struct AtemRtmEvent {
+    kind: u32,
+    subtype: u32,
+    code: i32,
+    aux: u32,
+    request_id: u64,
+    timestamp: u64,
+    channel: *const c_char,
+    user: *const c_char,
+    name: *const c_char,
+    payload: *const c_char,
+    payload_len: usize,
+}
+
+impl AtemRtmEvent {
+    const EMPTY: Self = Self {
+        kind: 0,
+        subtype: 0,
+        code: 0,
+        aux: 0,
+        request_id: 0,
+        timestamp: 0,
+        channel: ptr::null(),
+        user: ptr::null(),
+        name: ptr::null(),
+        payload: ptr::null(),
+        payload_len: 0,
+    };
+}
+
+type AtemRtmEventNotify = unsafe extern "C" fn(user_data: *mut c_void);
+
+#[repr(C)]
+struct AtemRtmItem {
+    key: *const c_char,
+    value: *const c_char,
+    value_len: usize,
+    timestamp: u64,
+}
+
+type AtemRtmReadCallback = unsafe extern "C" fn(
+    result: i32,
+    items: *const AtemRtmItem,
+    count: usize,
+    user_data: *mut c_void,
+);
+
+type AtemRtmWhereNowCallback = unsafe extern "C" fn(
+    user_id: *const c_char,
+    result: i32,
+    channels: *const *const c_char,
+    channel_count: usize,
+    user_data: *mut c_void,
+);
+
+type AtemRtmLockCallback = unsafe extern "C" fn(
+    channel: *const c_char,
+    lock_name: *const c_char,
+    result: i32,
+    user_data: *mut c_void,
+);
+
 #[allow(improper_ctypes)]
 unsafe extern "C" {
     fn atem_rtm_create(
         config: *const AtemRtmConfig,
-        callback: AtemRtmMessageCallback,
+        callback: Option<AtemRtmMessageCallback>,
         user_data: *mut c_void,
     ) -> *mut AtemRtmClient;
     fn atem_rtm_destroy(client: *mut AtemRtmClient);
     fn atem_rtm_connect(client: *mut AtemRtmClient) -> i32;
     fn atem_rtm_disconnect(client: *mut AtemRtmClient) -> i32;
+    fn atem_rtm_shutdown(
+        client: *mut AtemRtmClient,
+        deadline_ms: u32,
+        report: *mut AtemRtmShutdownReport,
+    ) -> i32;
     fn atem_rtm_login(
         client: *mut AtemRtmClient,
         token: *const c_char,
@@ -49,228 +340,1384 @@ unsafe extern "C" {
         target_client_id: *const c_char,
         payload: *const c_char,
     ) -> i32;
+    fn atem_rtm_buffer_acquire(client: *mut AtemRtmClient, out: *mut AtemRtmBuffer) -> i32;
+    fn atem_rtm_buffer_release(client: *mut AtemRtmClient, buffer_id: u32) -> i32;
+    fn atem_rtm_publish_buffer(client: *mut AtemRtmClient, buffer_id: u32, length: usize) -> i32;
+    fn atem_rtm_send_peer_buffer(
+        client: *mut AtemRtmClient,
+        target_client_id: *const c_char,
+        buffer_id: u32,
+        length: usize,
+    ) -> i32;
+    fn atem_rtm_set_history_policy(
+        client: *mut AtemRtmClient,
+        message_class: *const c_char,
+        policy: i32,
+    ) -> i32;
+    fn atem_rtm_set_priority(
+        client: *mut AtemRtmClient,
+        message_class: *const c_char,
+        priority: i32,
+    ) -> i32;
     fn atem_rtm_set_token(client: *mut AtemRtmClient, token: *const c_char) -> i32;
     fn atem_rtm_subscribe_topic(
         client: *mut AtemRtmClient,
         channel: *const c_char,
         topic: *const c_char,
     ) -> i32;
+    fn atem_rtm_set_idle(client: *mut AtemRtmClient, idle: i32) -> i32;
+    fn atem_rtm_tick(client: *mut AtemRtmClient) -> i32;
+    fn atem_rtm_stage_metadata(
+        client: *mut AtemRtmClient,
+        scope: i32,
+        target: *const c_char,
+        key: *const c_char,
+        value: *const c_char,
+    ) -> i32;
+    fn atem_rtm_flush_metadata(client: *mut AtemRtmClient) -> i32;
+    fn atem_rtm_acquire_lock(
+        client: *mut AtemRtmClient,
+        channel: *const c_char,
+        lock_name: *const c_char,
+        callback: AtemRtmLockCallback,
+        user_data: *mut c_void,
+    ) -> i32;
+    fn atem_rtm_release_lock(
+        client: *mut AtemRtmClient,
+        channel: *const c_char,
+        lock_name: *const c_char,
+    ) -> i32;
+    fn atem_rtm_get_stats(client: *mut AtemRtmClient, out: *mut AtemRtmStats) -> i32;
+    fn atem_rtm_get_stats_series(
+        client: *mut AtemRtmClient,
+        out: *mut AtemRtmStatsSample,
+        max: usize,
+        count: *mut usize,
+    ) -> i32;
+    fn atem_rtm_health(client: *mut AtemRtmClient, out: *mut AtemRtmHealth) -> i32;
+    fn atem_rtm_where_now(
+        client: *mut AtemRtmClient,
+        user_id: *const c_char,
+        callback: AtemRtmWhereNowCallback,
+        user_data: *mut c_void,
+    ) -> i32;
+    fn atem_rtm_get_state(
+        client: *mut AtemRtmClient,
+        channel: *const c_char,
+        user_id: *const c_char,
+        callback: AtemRtmReadCallback,
+        user_data: *mut c_void,
+    ) -> i32;
+    fn atem_rtm_get_channel_metadata(
+        client: *mut AtemRtmClient,
+        channel: *const c_char,
+        callback: AtemRtmReadCallback,
+        user_data: *mut c_void,
+    ) -> i32;
+    fn atem_rtm_who_now(
+        client: *mut AtemRtmClient,
+        channel: *const c_char,
+        callback: AtemRtmReadCallback,
+        user_data: *mut c_void,
+    ) -> i32;
+    fn atem_rtm_get_history(
+        client: *mut AtemRtmClient,
+        channel: *const c_char,
+        count: u32,
+        callback: AtemRtmReadCallback,
+        user_data: *mut c_void,
+    ) -> i32;
+    fn atem_rtm_fleet_create(config: *const AtemRtmFleetConfig) -> *mut AtemRtmFleet;
+    fn atem_rtm_fleet_add(
+        fleet: *mut AtemRtmFleet,
+        client: *mut AtemRtmClient,
+        token: *const c_char,
+        channel: *const c_char,
+    ) -> i32;
+    fn atem_rtm_fleet_tick(fleet: *mut AtemRtmFleet, report: *mut AtemRtmFleetReport) -> i32;
+    fn atem_rtm_fleet_destroy(fleet: *mut AtemRtmFleet);
+    fn atem_rtm_poll_events(
+        client: *mut AtemRtmClient,
+        out: *mut AtemRtmEvent,
+        max: usize,
+        count: *mut usize,
+    ) -> i32;
+    fn atem_rtm_set_event_notify(
+        client: *mut AtemRtmClient,
+        notify: Option<AtemRtmEventNotify>,
+        user_data: *mut c_void,
+    ) -> i32;
 }
 
-pub struct RtmEvent {
-    pub from: String,
-    pub payload: String,
+/// Everything the native client reports, in arrival order. SDK events
+/// that carry lists (presence intervals, lock snapshots, metadata) arrive
+/// as one event per user, lock or key.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub enum RtmEvent {
+    /// A channel or peer message, after reordering and idle batching.
+    Message {
+        from: String,
+        channel: String,
+        payload: String,
+        /// Server timestamp in ms (0 if unknown).
+        timestamp: u64,
+        /// From the history fetched on join
+        /// ([`RtmConfig::join_history_count`]), not live traffic.
+        replayed: bool,
+    },
+    Presence {
+        channel: String,
+        /// `None` only for an empty snapshot.
+        user: Option<String>,
+        change: PresenceChange,
+    },
+    Topic {
+        channel: String,
+        topic: String,
+        publisher: Option<String>,
+        /// The SDK's `RTM_TOPIC_EVENT_TYPE`.
+        kind: u32,
+    },
+    Lock {
+        channel: String,
+        lock: String,
+        owner: Option<String>,
+        /// The SDK's `RTM_LOCK_EVENT_TYPE`.
+        kind: u32,
+        ttl_secs: u32,
+    },
+    Storage {
+        scope: MetadataScope,
+        target: String,
+        key: String,
+        value: Option<String>,
+        author: Option<String>,
+        /// The SDK's `RTM_STORAGE_EVENT_TYPE`.
+        kind: u32,
+    },
+    LinkState {
+        state: RtmLinkState,
+        /// The SDK's `RTM_LINK_STATE_CHANGE_REASON`.
+        reason: i32,
+    },
+    /// Completion of an asynchronous SDK request.
+    Result {
+        op: RtmOp,
+        request_id: u64,
+        /// The SDK error code; 0 on success.
+        error_code: i32,
+        channel: String,
+        /// Lock name for lock operations.
+        name: Option<String>,
+    },
+    TokenWillExpire {
+        channel: String,
+    },
 }
 
-struct CallbackState {
-    sender: UnboundedSender<RtmEvent>,
+/// One item of a presence, metadata or history read: key/value for state
+/// and metadata, publisher/message for history.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct RtmItem {
+    pub key: String,
+    pub value: Option<String>,
+    /// Update time (metadata) or server timestamp (history) in ms.
+    pub timestamp: u64,
 }
 
-struct OwnedCString(*mut c_char);
-
-impl OwnedCString {
-    fn new(value: CString) -> Self {
-        Self(value.into_raw())
-    }
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum PresenceChange {
+    /// Part of a full roster of `size` users.
+    Snapshot {
+        size: u32,
+    },
+    Join,
+    Leave,
+}
 
-    fn as_ptr(&self) -> *const c_char {
-        self.0
-    }
+/// The request a [`RtmEvent::Result`] completes.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum RtmOp {
+    Login,
+    Logout,
+    Subscribe,
+    Publish,
+    RenewToken,
+    AcquireLock,
+    ReleaseLock,
+    SetMetadata,
+    GetMetadata,
+    WhereNow,
+    GetState,
+    WhoNow,
+    GetHistory,
+    Unknown(u32),
 }
 
-impl Drop for OwnedCString {
-    fn drop(&mut self) {
-        if !self.0.is_null() {
-            unsafe {
-                let _ = CString::from_raw(self.0);
-            }
-            self.0 = ptr::null_mut();
+impl From<u32> for RtmOp {
+    fn from(raw: u32) -> Self {
+        match raw {
+            1 => Self::Login,
+            2 => Self::Logout,
+            3 => Self::Subscribe,
+            4 => Self::Publish,
+            5 => Self::RenewToken,
+            6 => Self::AcquireLock,
+            7 => Self::ReleaseLock,
+            8 => Self::SetMetadata,
+            9 => Self::GetMetadata,
+            10 => Self::WhereNow,
+            11 => Self::GetState,
+            12 => Self::WhoNow,
+            13 => Self::GetHistory,
+            other => Self::Unknown(other),
         }
     }
 }
 
-unsafe extern "C" fn on_message(
-    from_client_id: *const c_char,
-    payload: *const c_char,
-    user_data: *mut c_void,
-) {
-    if user_data.is_null() {
-        return;
-    }
-
-    let state = unsafe { &*(user_data as *mut CallbackState) };
-    let from = if from_client_id.is_null() {
-        String::new()
-    } else {
-        unsafe { CStr::from_ptr(from_client_id) }
-            .to_string_lossy()
-            .into_owned()
-    };
-    let payload = if payload.is_null() {
-        String::new()
-    } else {
-        unsafe { CStr::from_ptr(payload) }
+/// # Safety
+/// `value` is null or a NUL-terminated string.
+unsafe fn opt_string(value: *const c_char) -> Option<String> {
+    (!value.is_null()).then(|| {
+        unsafe { CStr::from_ptr(value) }
             .to_string_lossy()
             .into_owned()
-    };
+    })
+}
 
-    let _ = state.sender.send(RtmEvent { from, payload });
+impl RtmEvent {
+    /// Copies a polled record; `None` for kinds this build does not know.
+    ///
+    /// # Safety
+    /// The record's pointers must still be valid (before the next poll).
+    unsafe fn from_raw(raw: &AtemRtmEvent) -> Option<Self> {
+        let string = |value| unsafe { opt_string(value) };
+        let channel = string(raw.channel).unwrap_or_default();
+        let payload = (!raw.payload.is_null()).then(|| {
+            let bytes =
+                unsafe { std::slice::from_raw_parts(raw.payload as *const u8, raw.payload_len) };
+            String::from_utf8_lossy(bytes).into_owned()
+        });
+        let event = match raw.kind {
+            ATEM_RTM_EVENT_MESSAGE => Self::Message {
+                from: string(raw.user).unwrap_or_default(),
+                channel,
+                payload: payload.unwrap_or_default(),
+                timestamp: raw.timestamp,
+                replayed: raw.subtype == ATEM_RTM_MESSAGE_REPLAYED,
+            },
+            ATEM_RTM_EVENT_PRESENCE => Self::Presence {
+                channel,
+                user: string(raw.user),
+                change: match raw.subtype {
+                    ATEM_RTM_PRESENCE_SNAPSHOT => PresenceChange::Snapshot { size: raw.aux },
+                    ATEM_RTM_PRESENCE_JOIN => PresenceChange::Join,
+                    _ => PresenceChange::Leave,
+                },
+            },
+            ATEM_RTM_EVENT_TOPIC => Self::Topic {
+                channel,
+                topic: string(raw.name).unwrap_or_default(),
+                publisher: string(raw.user),
+                kind: raw.subtype,
+            },
+            ATEM_RTM_EVENT_LOCK => Self::Lock {
+                channel,
+                lock: string(raw.name).unwrap_or_default(),
+                owner: string(raw.user),
+                kind: raw.subtype,
+                ttl_secs: raw.aux,
+            },
+            ATEM_RTM_EVENT_STORAGE => Self::Storage {
+                scope: if raw.aux == MetadataScope::User as u32 {
+                    MetadataScope::User
+                } else {
+                    MetadataScope::Channel
+                },
+                target: channel,
+                key: string(raw.name).unwrap_or_default(),
+                value: payload,
+                author: string(raw.user),
+                kind: raw.subtype,
+            },
+            ATEM_RTM_EVENT_LINK_STATE => Self::LinkState {
+                state: (raw.subtype as i32).into(),
+                reason: raw.code,
+            },
+            ATEM_RTM_EVENT_RESULT => Self::Result {
+                op: raw.subtype.into(),
+                request_id: raw.request_id,
+                error_code: raw.code,
+                channel,
+                name: string(raw.name),
+            },
+            ATEM_RTM_EVENT_TOKEN_WILL_EXPIRE => Self::TokenWillExpire { channel },
+            _ => return None,
+        };
+        Some(event)
+    }
 }
 
-pub struct RtmClient {
-    inner: Arc<Mutex<RtmInner>>,
-    receiver: Mutex<UnboundedReceiver<RtmEvent>>,
-    _state: *mut CallbackState,
-    owned_strings: Vec<OwnedCString>,
+/// Outcome of [`RtmClient::send_peer`].
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum PeerDelivery {
+    /// Handed to the SDK for publishing.
+    Sent,
+    /// The peer is offline; the shim holds the message until it rejoins.
+    Held,
 }
 
-struct RtmInner {
-    handle: *mut AtemRtmClient,
+/// Where a staged metadata update is stored.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum MetadataScope {
+    Channel = 0,
+    User = 1,
 }
 
-impl Drop for RtmInner {
-    fn drop(&mut self) {
-        unsafe {
-            if !self.handle.is_null() {
-                atem_rtm_disconnect(self.handle);
-                atem_rtm_destroy(self.handle);
-            }
+/// Whether channel publishes of a message class are kept in RTM history.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum HistoryPolicy {
+    Skip = 0,
+    Store = 1,
+}
+
+/// Send order of a message class while outbound pacing holds messages back.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum OutboundPriority {
+    Control = 0,
+    Normal = 1,
+    Bulk = 2,
+}
+
+/// Snapshot of the native shim's counters.
+#[derive(Debug, Default, Clone, Copy, PartialEq, Eq)]
+pub struct RtmStats {
+    pub peer_messages_held: u64,
+    pub peer_messages_flushed: u64,
+    pub peer_messages_expired: u64,
+    pub peer_messages_dropped: u64,
+    pub peer_hold_depth: u64,
+    pub reorder_depth: u64,
+    pub reorder_max_depth: u64,
+    /// Messages that had to wait for an earlier one, and how long they waited.
+    pub reorder_held: u64,
+    pub reorder_hold_ms_total: u64,
+    pub reorder_hold_ms_max: u64,
+    pub reorder_gaps_skipped: u64,
+    pub reorder_duplicates: u64,
+    pub reorder_late: u64,
+    pub publishes_sent: u64,
+    pub publishes_acked: u64,
+    pub publishes_failed: u64,
+    pub publishes_in_flight: u64,
+    pub idle_mode: bool,
+    pub idle_batched_messages: u64,
+    pub metadata_staged: u64,
+    /// Staged updates merged into a key that was already pending.
+    pub metadata_coalesced: u64,
+    /// Storage update requests issued, and how many of them succeeded.
+    pub metadata_writes: u64,
+    pub metadata_written: u64,
+    pub metadata_conflicts: u64,
+    pub metadata_retries: u64,
+    /// Items dropped because a newer remote value won.
+    pub metadata_superseded: u64,
+    pub metadata_failed: u64,
+    pub metadata_pending: u64,
+    pub metadata_in_flight: u64,
+    pub lock_waits: u64,
+    /// Acquire requests actually sent; waiters behind a held lock send none.
+    pub lock_acquires: u64,
+    pub lock_acquired: u64,
+    pub lock_contended: u64,
+    pub lock_failed: u64,
+    pub lock_waiters: u64,
+    /// Time from seeing a lock free to owning it.
+    pub lock_handoff_ms_total: u64,
+    pub lock_handoff_ms_max: u64,
+    /// Channel publishes sent with storeInHistory set, and without.
+    pub history_stored: u64,
+    pub history_skipped: u64,
+    pub buffers_in_use: u64,
+    pub buffer_publishes: u64,
+    /// Times [`RtmClient::acquire_buffer`] found the pool empty.
+    pub buffers_exhausted: u64,
+    /// Native events not yet polled, and events dropped because the queue
+    /// was full.
+    pub events_queued: u64,
+    pub events_dropped: u64,
+    /// [`RtmClient::where_now`] answered from cache, or not; `queries` of
+    /// the misses went remote and `collapsed` joined one already in flight.
+    pub location_hits: u64,
+    pub location_misses: u64,
+    pub location_queries: u64,
+    pub location_collapsed: u64,
+    pub location_entries: u64,
+    /// Presence/metadata/history reads: asked for, sent to the SDK, merged
+    /// into an identical read in flight, and answered from cache.
+    pub reads_requested: u64,
+    pub reads_issued: u64,
+    pub reads_collapsed: u64,
+    pub reads_cache_hits: u64,
+    /// Thread CPU time spent in SDK callbacks (µs): how many ran, their
+    /// total and the longest one, then the total per event kind.
+    pub cpu_callbacks: u64,
+    pub cpu_callback_us: u64,
+    pub cpu_callback_max_us: u64,
+    pub cpu_message_us: u64,
+    pub cpu_presence_us: u64,
+    pub cpu_topic_us: u64,
+    pub cpu_lock_us: u64,
+    pub cpu_storage_us: u64,
+    pub cpu_link_state_us: u64,
+    pub cpu_result_us: u64,
+    pub cpu_token_us: u64,
+    /// Thread CPU time of [`RtmClient::tick`] or of the dispatcher's own
+    /// work (µs).
+    pub cpu_dispatch_us: u64,
+    /// Dispatcher thread: tasks run, most queued at once and the longest a
+    /// task waited (ms); all 0 without one.
+    pub dispatcher_tasks: u64,
+    pub dispatcher_max_depth: u64,
+    pub dispatcher_lag_ms_max: u64,
+    /// Native events too large for a queue slot's inline space (about 512
+    /// bytes of payload plus names).
+    pub events_spilled: u64,
+    /// Join-time history fetches, the messages they replayed, history
+    /// messages dropped as duplicates of live ones, and fetches that failed
+    /// or arrived after live messages were released.
+    pub prefetch_fetches: u64,
+    pub prefetch_replayed: u64,
+    pub prefetch_duplicates: u64,
+    pub prefetch_late: u64,
+    /// Messages dropped to keep one publisher within its share of the
+    /// fair scheduler, and the most publishers with messages waiting at
+    /// once.
+    pub fair_shed: u64,
+    pub fair_publishers_max: u64,
+    /// Outbound pacing: messages waiting now, messages that had to wait,
+    /// messages sent ahead of a more urgent class because of their age,
+    /// and the longest wait per priority class.
+    pub outbound_queued: u64,
+    pub outbound_deferred: u64,
+    pub outbound_aged: u64,
+    pub outbound_wait_ms_max_control: u64,
+    pub outbound_wait_ms_max_normal: u64,
+    pub outbound_wait_ms_max_bulk: u64,
+    /// Flow control: grants sent to publishers and received from
+    /// receivers, messages that had to wait for credit (and wait now), and
+    /// held partials replaced by a newer one.
+    pub credit_grants_sent: u64,
+    pub credit_grants_received: u64,
+    pub credit_held: u64,
+    pub credit_waiting: u64,
+    pub credit_coalesced: u64,
+    /// Timer wheel: timers armed now and run so far (with a dispatcher,
+    /// its ticks count too), and how often the dispatcher thread woke up.
+    pub timers_pending: u64,
+    pub timers_fired: u64,
+    pub dispatcher_wakeups: u64,
+    /// Flow control: sends refused or dropped because too many were held.
+    pub credit_refused: u64,
+}
+
+/// Connection state of the SDK link, as last reported by the SDK.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum RtmLinkState {
+    Idle,
+    Connecting,
+    Connected,
+    Disconnected,
+    Suspended,
+    Failed,
+    Unknown(i32),
+}
+
+impl From<i32> for RtmLinkState {
+    fn from(raw: i32) -> Self {
+        match raw {
+            0 => Self::Idle,
+            1 => Self::Connecting,
+            2 => Self::Connected,
+            3 => Self::Disconnected,
+            4 => Self::Suspended,
+            5 => Self::Failed,
+            other => Self::Unknown(other),
         }
     }
 }
 
-impl Drop for RtmClient {
-    fn drop(&mut self) {
-        unsafe {
-            if !self._state.is_null() {
-                drop(Box::from_raw(self._state));
-                self._state = ptr::null_mut();
-            }
+/// Cheap health snapshot, see [`RtmClient::health`]. Ages are `None` until
+/// the first such event.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct RtmHealth {
+    pub link_state: RtmLinkState,
+    pub last_inbound_age: Option<Duration>,
+    pub last_outbound_age: Option<Duration>,
+    /// Inbound messages not yet delivered, and for how long the queue has
+    /// been non-empty.
+    pub inbound_queued: u64,
+    pub queue_lag: Duration,
+    pub requests_in_flight: u64,
+    /// Since the last successful login or token renewal.
+    pub token_age: Option<Duration>,
+}
+
+impl From<AtemRtmHealth> for RtmHealth {
+    fn from(raw: AtemRtmHealth) -> Self {
+        let age = |ms: u64| (ms != ATEM_RTM_AGE_NEVER).then(|| Duration::from_millis(ms));
+        Self {
+            link_state: raw.link_state.into(),
+            last_inbound_age: age(raw.last_inbound_age_ms),
+            last_outbound_age: age(raw.last_outbound_age_ms),
+            inbound_queued: raw.inbound_queued,
+            queue_lag: Duration::from_millis(raw.queue_lag_ms),
+            requests_in_flight: raw.requests_in_flight,
+            token_age: age(raw.token_age_ms),
         }
-        // OwnedCString drops automatically
     }
 }
 
-pub struct RtmConfig {
-    pub app_id: String,
-    pub token: String,
-    pub channel: String,
-    pub client_id: String,
+/// What [`RtmClient::shutdown`] managed to drain before logging out.
+#[derive(Debug, Default, Clone, Copy, PartialEq, Eq)]
+pub struct ShutdownReport {
+    /// Outstanding publishes acknowledged before the deadline.
+    pub flushed: u32,
+    /// Outstanding publishes acknowledged with an error.
+    pub failed: u32,
+    /// Unacknowledged at the deadline, or held for offline peers.
+    pub abandoned: u32,
+    pub elapsed_ms: u32,
 }
 
-impl RtmClient {
-    pub fn new(config: RtmConfig) -> Result<Self> {
-        let (tx, rx) = unbounded_channel();
-        let state = Box::new(CallbackState { sender: tx });
-        let state_ptr = Box::into_raw(state);
-
-        let mut owned_strings = Vec::new();
-        let app_id = OwnedCString::new(CString::new(config.app_id)?);
-        let token = OwnedCString::new(CString::new(config.token)?);
-        let channel = OwnedCString::new(CString::new(config.channel)?);
-        let client_id = OwnedCString::new(CString::new(config.client_id.clone())?);
+/// Pacing for [`bring_up_fleet`]; zero fields use the native defaults.
+#[derive(Debug, Default, Clone, Copy)]
+pub struct FleetConfig {
+    /// Clients logging in at the same time.
+    pub max_parallel: u32,
+    /// Gap between two starts, plus up to `jitter_ms` at random; `None`
+    /// jitters by up to `stagger_ms`, `Some(0)` spaces starts evenly.
+    pub stagger_ms: u32,
+    pub jitter_ms: Option<u32>,
+    /// A client not ready after this long counts as failed. It keeps its
+    /// parallel slot until its bring-up completes.
+    pub ready_timeout_ms: u32,
+}
 
-        let cfg = AtemRtmConfig {
-            app_id: app_id.as_ptr(),
-            token: token.as_ptr(),
-            channel: channel.as_ptr(),
-            client_id: client_id.as_ptr(),
-        };
+/// Outcome of [`bring_up_fleet`]. Time-to-ready runs from a client's start
+/// to its subscribe result.
+#[derive(Debug, Default, Clone, Copy, PartialEq, Eq)]
+pub struct FleetReport {
+    pub sessions: u32,
+    pub ready: u32,
+    pub failed: u32,
+    pub ready_p50: Duration,
+    pub ready_p90: Duration,
+    pub ready_p99: Duration,
+    pub ready_max: Duration,
+    pub elapsed: Duration,
+}
 
-        owned_strings.push(app_id);
-        owned_strings.push(token);
-        owned_strings.push(channel);
-        owned_strings.push(client_id);
+impl From<AtemRtmFleetReport> for FleetReport {
+    fn from(raw: AtemRtmFleetReport) -> Self {
+        let ms = |ms: u32| Duration::from_millis(ms.into());
+        Self {
+            sessions: raw.sessions,
+            ready: raw.ready,
+            failed: raw.failed,
+            ready_p50: ms(raw.ready_ms_p50),
+            ready_p90: ms(raw.ready_ms_p90),
+            ready_p99: ms(raw.ready_ms_p99),
+            ready_max: ms(raw.ready_ms_max),
+            elapsed: ms(raw.elapsed_ms),
+        }
+    }
+}
 
-        let handle = unsafe { atem_rtm_create(&cfg, on_message, state_ptr as *mut _) };
+struct FleetHandle(*mut AtemRtmFleet);
 
-        if handle.is_null() {
-            unsafe {
-                drop(Box::from_raw(state_ptr));
-            }
-            return Err(anyhow!("failed to create RTM client handle"));
-        }
+impl Drop for FleetHandle {
+    fn drop(&mut self) {
+        unsafe { atem_rtm_fleet_destroy(self.0) };
+    }
+}
 
-        let rc = unsafe { atem_rtm_connect(handle) };
+/// Logs in and joins many clients, `(client, token, channel)` each, at most
+/// `max_parallel` at a time and with jittered gaps between starts so a
+/// host restart does not hit RTM all at once. Returns once every client is
+/// ready or has failed.
+pub async fn bring_up_fleet(
+    sessions: &[(&RtmClient, &str, &str)],
+    config: FleetConfig,
+) -> Result<FleetReport> {
+    let raw_config = AtemRtmFleetConfig {
+        max_parallel: config.max_parallel,
+        stagger_ms: config.stagger_ms,
+        jitter_ms: match config.jitter_ms {
+            None => 0,
+            Some(0) => ATEM_RTM_FLEET_NO_JITTER,
+            Some(ms) => ms,
+        },
+        ready_timeout_ms: config.ready_timeout_ms,
+    };
+    let fleet = FleetHandle(unsafe { atem_rtm_fleet_create(&raw_config) });
+    for (client, token, channel) in sessions {
+        let token_c = CString::new(*token)?;
+        let channel_c = CString::new(*channel)?;
+        // The fleet copies the strings.
+        let rc = unsafe {
+            atem_rtm_fleet_add(fleet.0, client.probe, token_c.as_ptr(), channel_c.as_ptr())
+        };
         if rc != 0 {
-            unsafe {
-                atem_rtm_destroy(handle);
-                drop(Box::from_raw(state_ptr));
-            }
-            return Err(anyhow!("failed to connect RTM client (code {rc})"));
+            return Err(anyhow!("failed to add {channel} to the fleet (code {rc})"));
         }
+    }
 
-        let inner = RtmInner { handle };
-        Ok(Self {
-            inner: Arc::new(Mutex::new(inner)),
-            receiver: Mutex::new(rx),
-            _state: state_ptr,
-            owned_strings,
-        })
+    let mut raw = AtemRtmFleetReport::default();
+    loop {
+        match unsafe { atem_rtm_fleet_tick(fleet.0, &mut raw) } {
+            0 => return Ok(raw.into()),
+            ATEM_RTM_QUEUED => tokio::time::sleep(FLEET_TICK).await,
+            rc => return Err(anyhow!("fleet bring-up failed (code {rc})")),
+        }
     }
+}
 
-    pub async fn publish_channel(&self, payload: &str) -> Result<()> {
-        let payload_c = CString::new(payload)?;
-        let guard = self.inner.lock().await;
-        let rc = unsafe { atem_rtm_publish_channel(guard.handle, payload_c.as_ptr()) };
-        if rc != 0 {
-            return Err(anyhow!("failed to publish channel message (code {rc})"));
+impl From<AtemRtmStats> for RtmStats {
+    fn from(raw: AtemRtmStats) -> Self {
+        Self {
+            peer_messages_held: raw.peer_messages_held,
+            peer_messages_flushed: raw.peer_messages_flushed,
+            peer_messages_expired: raw.peer_messages_expired,
+            peer_messages_dropped: raw.peer_messages_dropped,
+            peer_hold_depth: raw.peer_hold_depth,
+            reorder_depth: raw.reorder_depth,
+            reorder_max_depth: raw.reorder_max_depth,
+            reorder_held: raw.reorder_held,
+            reorder_hold_ms_total: raw.reorder_hold_ms_total,
+            reorder_hold_ms_max: raw.reorder_hold_ms_max,
+            reorder_gaps_skipped: raw.reorder_gaps_skipped,
+            reorder_duplicates: raw.reorder_duplicates,
+            reorder_late: raw.reorder_late,
+            publishes_sent: raw.publishes_sent,
+            publishes_acked: raw.publishes_acked,
+            publishes_failed: raw.publishes_failed,
+            publishes_in_flight: raw.publishes_in_flight,
+            idle_mode: raw.idle_mode != 0,
+            idle_batched_messages: raw.idle_batched_messages,
+            metadata_staged: raw.metadata_staged,
+            metadata_coalesced: raw.metadata_coalesced,
+            metadata_writes: raw.metadata_writes,
+            metadata_written: raw.metadata_written,
+            metadata_conflicts: raw.metadata_conflicts,
+            metadata_retries: raw.metadata_retries,
+            metadata_superseded: raw.metadata_superseded,
+            metadata_failed: raw.metadata_failed,
+            metadata_pending: raw.metadata_pending,
+            metadata_in_flight: raw.metadata_in_flight,
+            lock_waits: raw.lock_waits,
+            lock_acquires: raw.lock_acquires,
+            lock_acquired: raw.lock_acquired,
+            lock_contended: raw.lock_contended,
+            lock_failed: raw.lock_failed,
+            lock_waiters: raw.lock_waiters,
+            lock_handoff_ms_total: raw.lock_handoff_ms_total,
+            lock_handoff_ms_max: raw.lock_handoff_ms_max,
+            history_stored: raw.history_stored,
+            history_skipped: raw.history_skipped,
+            buffers_in_use: raw.buffers_in_use,
+            buffer_publishes: raw.buffer_publishes,
+            buffers_exhausted: raw.buffers_exhausted,
+            events_queued: raw.events_queued,
+            events_dropped: raw.events_dropped,
+            location_hits: raw.location_hits,
+            location_misses: raw.location_misses,
+            location_queries: raw.location_queries,
+            location_collapsed: raw.location_collapsed,
+            location_entries: raw.location_entries,
+            reads_requested: raw.reads_requested,
+            reads_issued: raw.reads_issued,
+            reads_collapsed: raw.reads_collapsed,
+            reads_cache_hits: raw.reads_cache_hits,
+            cpu_callbacks: raw.cpu_callbacks,
+            cpu_callback_us: raw.cpu_callback_us,
+            cpu_callback_max_us: raw.cpu_callback_max_us,
+            cpu_message_us: raw.cpu_message_us,
+            cpu_presence_us: raw.cpu_presence_us,
+            cpu_topic_us: raw.cpu_topic_us,
+            cpu_lock_us: raw.cpu_lock_us,
+            cpu_storage_us: raw.cpu_storage_us,
+            cpu_link_state_us: raw.cpu_link_state_us,
+            cpu_result_us: raw.cpu_result_us,
+            cpu_token_us: raw.cpu_token_us,
+            cpu_dispatch_us: raw.cpu_dispatch_us,
+            dispatcher_tasks: raw.dispatcher_tasks,
+            dispatcher_max_depth: raw.dispatcher_max_depth,
+            dispatcher_lag_ms_max: raw.dispatcher_lag_ms_max,
+            events_spilled: raw.events_spilled,
+            prefetch_fetches: raw.prefetch_fetches,
+            prefetch_replayed: raw.prefetch_replayed,
+            prefetch_duplicates: raw.prefetch_duplicates,
+            prefetch_late: raw.prefetch_late,
+            fair_shed: raw.fair_shed,
+            fair_publishers_max: raw.fair_publishers_max,
+            outbound_queued: raw.outbound_queued,
+            outbound_deferred: raw.outbound_deferred,
+            outbound_aged: raw.outbound_aged,
+            outbound_wait_ms_max_control: raw.outbound_wait_ms_max_control,
+            outbound_wait_ms_max_normal: raw.outbound_wait_ms_max_normal,
+            outbound_wait_ms_max_bulk: raw.outbound_wait_ms_max_bulk,
+            credit_grants_sent: raw.credit_grants_sent,
+            credit_grants_received: raw.credit_grants_received,
+            credit_held: raw.credit_held,
+            credit_waiting: raw.credit_waiting,
+            credit_coalesced: raw.credit_coalesced,
+            timers_pending: raw.timers_pending,
+            timers_fired: raw.timers_fired,
+            dispatcher_wakeups: raw.dispatcher_wakeups,
+            credit_refused: raw.credit_refused,
         }
-        Ok(())
     }
+}
 
-    pub async fn login_and_join(&self, token: &str, account: &str, channel: &str) -> Result<()> {
-        let token_c = CString::new(token)?;
-        let account_c = CString::new(account)?;
-        let channel_c = CString::new(channel)?;
+/// Seconds of traffic kept by [`RtmClient::stats_series`].
+pub const STATS_SERIES_SECONDS: usize = 600;
 
-        let handle = {
-            let guard = self.inner.lock().await;
-            guard.handle
-        };
+/// One second of traffic from the native stats series.
+#[derive(Debug, Default, Clone, Copy, PartialEq, Eq)]
+pub struct StatsSample {
+    pub unix_second: u64,
+    /// Live messages queued for [`RtmClient::drain_events`], and publishes
+    /// and peer sends handed to the service.
+    pub messages_in: u32,
+    pub messages_out: u32,
+    pub bytes_in: u64,
+    pub bytes_out: u64,
+    /// Server timestamp to drain, over the messages drained in the second
+    /// (0 when none were).
+    pub latency_p99_ms: u32,
+    pub latency_samples: u32,
+    pub queue_depth_max: u32,
+    /// Failed publishes and events the queue dropped or shed.
+    pub errors: u32,
+}
 
-        let rc = unsafe { atem_rtm_login(handle, token_c.as_ptr(), account_c.as_ptr()) };
-        if rc != 0 {
-            return Err(anyhow!("failed to login to signaling (code {rc})"));
+impl From<AtemRtmStatsSample> for StatsSample {
+    fn from(raw: AtemRtmStatsSample) -> Self {
+        Self {
+            unix_second: raw.unix_second,
+            messages_in: raw.messages_in,
+            messages_out: raw.messages_out,
+            bytes_in: raw.bytes_in,
+            bytes_out: raw.bytes_out,
+            latency_p99_ms: raw.latency_p99_ms,
+            latency_samples: raw.latency_samples,
+            queue_depth_max: raw.queue_depth_max,
+            errors: raw.errors,
         }
+    }
+}
 
-        let rc_join = unsafe { atem_rtm_join_channel(handle, channel_c.as_ptr()) };
-        if rc_join != 0 {
-            return Err(anyhow!(
-                "failed to join signaling channel {} (code {rc_join})",
-                channel
-            ));
-        }
-        Ok(())
+/// A registered native outbound buffer. Serialize into it (it implements
+/// [`io::Write`]) and submit it with [`RtmClient::publish_buffer`] or
+/// [`RtmClient::send_peer_buffer`]; dropping it unsent returns it to the pool.
+pub struct OutboundBuffer<'a> {
+    client: &'a RtmClient,
+    id: u32,
+    data: *mut u8,
+    capacity: usize,
+    len: usize,
+}
+
+impl OutboundBuffer<'_> {
+    pub fn len(&self) -> usize {
+        self.len
     }
 
-    pub async fn send_peer(&self, target: &str, payload: &str) -> Result<()> {
-        let target_c = CString::new(target)?;
+    pub fn is_empty(&self) -> bool {
+        self.len == 0
+    }
+
+    pub fn capacity(&self) -> usize {
+        self.capacity
+    }
+
+    pub fn clear(&mut self) {
+        self.len = 0;
+    }
+
+    pub fn as_bytes(&self) -> &[u8] {
+        unsafe { std::slice::from_raw_parts(self.data, self.len) }
+    }
+
+    // Submitted: the native side owns the buffer until the publish result.
+    fn into_submitted(self) -> (u32, usize) {
+        let parts = (self.id, self.len);
+        std::mem::forget(self);
+        parts
+    }
+}
+
+impl io::Write for OutboundBuffer<'_> {
+    fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+        let n = buf.len().min(self.capacity - self.len);
+        unsafe {
+            ptr::copy_nonoverlapping(buf.as_ptr(), self.data.add(self.len), n);
+        }
+        self.len += n;
+        Ok(n)
+    }
+
+    fn flush(&mut self) -> io::Result<()> {
+        Ok(())
+    }
+}
+
+impl Drop for OutboundBuffer<'_> {
+    fn drop(&mut self) {
+        unsafe {
+            atem_rtm_buffer_release(self.client.probe, self.id);
+        }
+    }
+}
+
+struct CallbackState {
+    // Wakes next_event when the native queue becomes non-empty (or the
+    // client shuts down); a stored permit covers a wake before the wait.
+    notify: Notify,
+    closed: AtomicBool,
+}
+
+unsafe extern "C" fn on_event_notify(user_data: *mut c_void) {
+    if user_data.is_null() {
+        return;
+    }
+    let state = unsafe { &*(user_data as *const CallbackState) };
+    state.notify.notify_one();
+}
+
+unsafe extern "C" fn on_lock(
+    _channel: *const c_char,
+    _lock_name: *const c_char,
+    result: i32,
+    user_data: *mut c_void,
+) {
+    if user_data.is_null() {
+        return;
+    }
+    // Each acquire's sender is boxed for exactly one completion.
+    let sender = unsafe { Box::from_raw(user_data as *mut oneshot::Sender<i32>) };
+    let _ = sender.send(result);
+}
+
+unsafe extern "C" fn on_where_now(
+    _user_id: *const c_char,
+    result: i32,
+    channels: *const *const c_char,
+    channel_count: usize,
+    user_data: *mut c_void,
+) {
+    if user_data.is_null() {
+        return;
+    }
+    // Boxed for exactly one completion, like on_lock.
+    let sender =
+        unsafe { Box::from_raw(user_data as *mut oneshot::Sender<Result<Vec<String>, i32>>) };
+    if result != 0 {
+        let _ = sender.send(Err(result));
+        return;
+    }
+    let names = if channels.is_null() {
+        Vec::new()
+    } else {
+        unsafe { std::slice::from_raw_parts(channels, channel_count) }
+            .iter()
+            .filter_map(|&name| unsafe { opt_string(name) })
+            .collect()
+    };
+    let _ = sender.send(Ok(names));
+}
+
+type ReadSender = oneshot::Sender<Result<Vec<RtmItem>, i32>>;
+
+unsafe extern "C" fn on_read(
+    result: i32,
+    items: *const AtemRtmItem,
+    count: usize,
+    user_data: *mut c_void,
+) {
+    if user_data.is_null() {
+        return;
+    }
+    let sender = unsafe { Box::from_raw(user_data as *mut ReadSender) };
+    if result != 0 {
+        let _ = sender.send(Err(result));
+        return;
+    }
+    let items = if items.is_null() {
+        Vec::new()
+    } else {
+        unsafe { std::slice::from_raw_parts(items, count) }
+            .iter()
+            .map(|item| RtmItem {
+                key: unsafe { opt_string(item.key) }.unwrap_or_default(),
+                value: (!item.value.is_null()).then(|| {
+                    let bytes = unsafe {
+                        std::slice::from_raw_parts(item.value as *const u8, item.value_len)
+                    };
+                    String::from_utf8_lossy(bytes).into_owned()
+                }),
+                timestamp: item.timestamp,
+            })
+            .collect()
+    };
+    let _ = sender.send(Ok(items));
+}
+
+struct OwnedCString(*mut c_char);
+
+impl OwnedCString {
+    fn new(value: CString) -> Self {
+        Self(value.into_raw())
+    }
+
+    fn as_ptr(&self) -> *const c_char {
+        self.0
+    }
+}
+
+impl Drop for OwnedCString {
+    fn drop(&mut self) {
+        if !self.0.is_null() {
+            unsafe {
+                let _ = CString::from_raw(self.0);
+            }
+            self.0 = ptr::null_mut();
+        }
+    }
+}
+
+pub struct RtmClient {
+    inner: Arc<Mutex<RtmInner>>,
+    // Copy of the native handle for health(), which must not wait on
+    // `inner`; valid for as long as `inner` owns the handle.
+    probe: *mut AtemRtmClient,
+    // Polled events not yet handed out; the lock also serialises polls,
+    // whose records are only valid until the next one.
+    pending: Mutex<VecDeque<RtmEvent>>,
+    _state: *mut CallbackState,
+    owned_strings: Vec<OwnedCString>,
+}
+
+struct RtmInner {
+    handle: *mut AtemRtmClient,
+    shut_down: bool,
+}
+
+impl Drop for RtmInner {
+    fn drop(&mut self) {
+        unsafe {
+            if !self.handle.is_null() {
+                // Give queued publishes (final transcripts, status updates) a
+                // chance to land before the handle goes away.
+                if !self.shut_down {
+                    atem_rtm_shutdown(self.handle, DROP_SHUTDOWN_DEADLINE_MS, ptr::null_mut());
+                }
+                atem_rtm_destroy(self.handle);
+            }
+        }
+    }
+}
+
+impl Drop for RtmClient {
+    fn drop(&mut self) {
+        unsafe {
+            if !self._state.is_null() {
+                // The handle outlives us (shutdown still runs in RtmInner's
+                // drop); make sure it no longer points at the state.
+                atem_rtm_set_event_notify(self.probe, None, ptr::null_mut());
+                drop(Box::from_raw(self._state));
+                self._state = ptr::null_mut();
+            }
+        }
+        // OwnedCString drops automatically
+    }
+}
+
+#[derive(Default)]
+pub struct RtmConfig {
+    pub app_id: String,
+    pub token: String,
+    pub channel: String,
+    pub client_id: String,
+    /// Messages held per offline peer; 0 uses the native default.
+    pub peer_hold_capacity: usize,
+    /// Lifetime of a held peer message in ms; 0 uses the native default.
+    pub peer_hold_ttl_ms: u32,
+    /// Reorder hold window in ms; 0 uses the native default.
+    pub reorder_window_ms: u32,
+    /// Idle-mode delivery batching window in ms; 0 uses the native default.
+    pub idle_batch_window_ms: u32,
+    /// Idle-mode presence apply interval in ms; 0 uses the native default.
+    pub idle_presence_interval_ms: u32,
+    /// Metadata coalescing window in ms; 0 uses the native default.
+    pub metadata_window_ms: u32,
+    /// Number and size of registered outbound buffers; 0 uses the native
+    /// defaults.
+    pub outbound_buffer_count: u32,
+    pub outbound_buffer_size: u32,
+    /// Unpolled events kept before the oldest is dropped; 0 uses the native
+    /// default.
+    pub event_queue_capacity: u32,
+    /// How long a remote [`RtmClient::where_now`] answer is trusted in ms;
+    /// 0 uses the native default.
+    pub location_ttl_ms: u32,
+    /// How long read results (successful / failed) are reused; 0 only
+    /// shares reads that are in flight at the same time.
+    pub read_cache_ms: u32,
+    pub read_error_cache_ms: u32,
+    /// Turns on the native event thread; 0 processes SDK callbacks on the
+    /// SDK's threads. The thread sleeps until the next event or deadline;
+    /// deadlines less than this many ms apart may share one wakeup (1 =
+    /// exact). With a dispatcher, [`RtmClient::tick`] is a no-op. The stub
+    /// ignores these settings.
+    pub dispatcher_tick_ms: u32,
+    /// Thread name; `None` uses "atem-rtm-disp".
+    pub dispatcher_name: Option<String>,
+    /// CPUs to pin the thread to (bit n = CPU n); 0 leaves it unpinned.
+    pub dispatcher_cpu_mask: u64,
+    /// SCHED_FIFO priority 1-99; 0 keeps the normal policy.
+    pub dispatcher_priority: u32,
+    /// Channel history fetched alongside the subscribe of a join (0 = none,
+    /// at most 100), delivered ahead of live messages as replayed
+    /// [`RtmEvent::Message`]s.
+    pub join_history_count: u32,
+    /// Byte credit per publisher and round when delivering messages by
+    /// deficit round-robin (0 = arrival order), so a publisher flooding a
+    /// channel cannot starve the others. Each publisher keeps its order.
+    pub fair_quantum_bytes: u32,
+    /// Waiting messages one publisher may have before its oldest are
+    /// dropped (0 = 262144 bytes).
+    pub fair_publisher_max_bytes: u32,
+    /// Publishes and peer sends per second before messages wait in a
+    /// priority queue (0 = no pacing); see
+    /// [`RtmClient::set_outbound_priority`].
+    pub outbound_rate_per_s: u32,
+    /// Messages sent back to back before pacing starts (0 = 10).
+    pub outbound_burst: u32,
+    /// A waiting message gains one priority class per this many ms
+    /// (0 = 250), so bulk traffic is never starved.
+    pub outbound_aging_ms: u32,
+    /// Messages each publisher may have that we have not drained yet
+    /// (0 = no limit). Credit is granted back as events are drained and
+    /// repeated every `credit_refresh_ms` (0 = 1000); sending always
+    /// honours the credit other clients grant us, holding what it does not
+    /// cover and keeping only the latest of consecutive held partials.
+    pub credit_window: u32,
+    pub credit_refresh_ms: u32,
+    /// Most sends held for credit at once (0 = 1024); beyond it sending
+    /// fails instead of queueing.
+    pub credit_hold_max: u32,
+}
+
+impl RtmClient {
+    pub fn new(config: RtmConfig) -> Result<Self> {
+        let state = Box::new(CallbackState {
+            notify: Notify::new(),
+            closed: AtomicBool::new(false),
+        });
+        let state_ptr = Box::into_raw(state);
+
+        let mut owned_strings = Vec::new();
+        let app_id = OwnedCString::new(CString::new(config.app_id)?);
+        let token = OwnedCString::new(CString::new(config.token)?);
+        let channel = OwnedCString::new(CString::new(config.channel)?);
+        let client_id = OwnedCString::new(CString::new(config.client_id.clone())?);
+        let dispatcher_name = match config.dispatcher_name {
+            Some(name) => Some(OwnedCString::new(CString::new(name)?)),
+            None => None,
+        };
+
+        let cfg = AtemRtmConfig {
+            app_id: app_id.as_ptr(),
+            token: token.as_ptr(),
+            channel: channel.as_ptr(),
+            client_id: client_id.as_ptr(),
+            peer_hold_capacity: config.peer_hold_capacity,
+            peer_hold_ttl_ms: config.peer_hold_ttl_ms,
+            reorder_window_ms: config.reorder_window_ms,
+            idle_batch_window_ms: config.idle_batch_window_ms,
+            idle_presence_interval_ms: config.idle_presence_interval_ms,
+            metadata_window_ms: config.metadata_window_ms,
+            outbound_buffer_count: config.outbound_buffer_count,
+            outbound_buffer_size: config.outbound_buffer_size,
+            event_queue_capacity: config.event_queue_capacity,
+            location_ttl_ms: config.location_ttl_ms,
+            read_cache_ms: config.read_cache_ms,
+            read_error_cache_ms: config.read_error_cache_ms,
+            dispatcher_tick_ms: config.dispatcher_tick_ms,
+            dispatcher_name: dispatcher_name
+                .as_ref()
+                .map_or(ptr::null(), |name| name.as_ptr()),
+            dispatcher_cpu_mask: config.dispatcher_cpu_mask,
+            dispatcher_priority: config.dispatcher_priority,
+            join_history_count: config.join_history_count,
+            fair_quantum_bytes: config.fair_quantum_bytes,
+            fair_publisher_max_bytes: config.fair_publisher_max_bytes,
+            outbound_rate_per_s: config.outbound_rate_per_s,
+            outbound_burst: config.outbound_burst,
+            outbound_aging_ms: config.outbound_aging_ms,
+            credit_window: config.credit_window,
+            credit_refresh_ms: config.credit_refresh_ms,
+            credit_hold_max: config.credit_hold_max,
+        };
+
+        owned_strings.push(app_id);
+        owned_strings.push(token);
+        owned_strings.push(channel);
+        owned_strings.push(client_id);
+        owned_strings.extend(dispatcher_name);
+
+        // Messages come through the event stream; no message callback.
+        let handle = unsafe { atem_rtm_create(&cfg, None, ptr::null_mut()) };
+
+        if handle.is_null() {
+            unsafe {
+                drop(Box::from_raw(state_ptr));
+            }
+            return Err(anyhow!("failed to create RTM client handle"));
+        }
+
+        unsafe {
+            atem_rtm_set_event_notify(handle, Some(on_event_notify), state_ptr as *mut _);
+        }
+
+        let rc = unsafe { atem_rtm_connect(handle) };
+        if rc != 0 {
+            unsafe {
+                atem_rtm_destroy(handle);
+                drop(Box::from_raw(state_ptr));
+            }
+            return Err(anyhow!("failed to connect RTM client (code {rc})"));
+        }
+
+        let inner = RtmInner {
+            handle,
+            shut_down: false,
+        };
+        Ok(Self {
+            inner: Arc::new(Mutex::new(inner)),
+            probe: handle,
+            pending: Mutex::new(VecDeque::new()),
+            _state: state_ptr,
+            owned_strings,
+        })
+    }
+
+    pub async fn publish_channel(&self, payload: &str) -> Result<()> {
+        let payload_c = CString::new(payload)?;
+        let guard = self.inner.lock().await;
+        let rc = unsafe { atem_rtm_publish_channel(guard.handle, payload_c.as_ptr()) };
+        match rc {
+            0 => Ok(()),
+            ATEM_RTM_ERR_CLOSED => Err(anyhow!("RTM client is shutting down")),
+            ATEM_RTM_ERR_BUSY => Err(anyhow!("too many messages are waiting for credit")),
+            _ => Err(anyhow!("failed to publish channel message (code {rc})")),
+        }
+    }
+
+    pub async fn login_and_join(&self, token: &str, account: &str, channel: &str) -> Result<()> {
+        let token_c = CString::new(token)?;
+        let account_c = CString::new(account)?;
+        let channel_c = CString::new(channel)?;
+
+        let handle = {
+            let guard = self.inner.lock().await;
+            guard.handle
+        };
+
+        let rc = unsafe { atem_rtm_login(handle, token_c.as_ptr(), account_c.as_ptr()) };
+        if rc != 0 {
+            return Err(anyhow!("failed to login to signaling (code {rc})"));
+        }
+
+        let rc_join = unsafe { atem_rtm_join_channel(handle, channel_c.as_ptr()) };
+        if rc_join != 0 {
+            return Err(anyhow!(
+                "failed to join signaling channel {} (code {rc_join})",
+                channel
+            ));
+        }
+        Ok(())
+    }
+
+    pub async fn send_peer(&self, target: &str, payload: &str) -> Result<PeerDelivery> {
+        let target_c = CString::new(target)?;
         let payload_c = CString::new(payload)?;
         let guard = self.inner.lock().await;
         let rc = unsafe { atem_rtm_send_peer(guard.handle, target_c.as_ptr(), payload_c.as_ptr()) };
+        match rc {
+            0 => Ok(PeerDelivery::Sent),
+            ATEM_RTM_QUEUED => Ok(PeerDelivery::Held),
+            ATEM_RTM_ERR_CLOSED => Err(anyhow!("RTM client is shutting down")),
+            ATEM_RTM_ERR_BUSY => Err(anyhow!("too many messages are waiting for credit")),
+            _ => Err(anyhow!("failed to send peer message (code {rc})")),
+        }
+    }
+
+    /// Takes a registered outbound buffer from the native pool. Buffer
+    /// bookkeeping is locked natively, so this does not wait on the client.
+    pub fn acquire_buffer(&self) -> Result<OutboundBuffer<'_>> {
+        let mut raw = AtemRtmBuffer {
+            id: 0,
+            data: ptr::null_mut(),
+            capacity: 0,
+        };
+        let rc = unsafe { atem_rtm_buffer_acquire(self.probe, &mut raw) };
+        match rc {
+            0 => Ok(OutboundBuffer {
+                client: self,
+                id: raw.id,
+                data: raw.data as *mut u8,
+                capacity: raw.capacity,
+                len: 0,
+            }),
+            ATEM_RTM_ERR_NO_BUFFER => Err(anyhow!("all outbound RTM buffers are in use")),
+            ATEM_RTM_ERR_CLOSED => Err(anyhow!("RTM client is shutting down")),
+            _ => Err(anyhow!("failed to acquire outbound buffer (code {rc})")),
+        }
+    }
+
+    /// Publishes the buffer's contents to the channel without copying them.
+    pub async fn publish_buffer(&self, buffer: OutboundBuffer<'_>) -> Result<()> {
+        let guard = self.inner.lock().await;
+        let (id, len) = buffer.into_submitted();
+        let rc = unsafe { atem_rtm_publish_buffer(guard.handle, id, len) };
         if rc != 0 {
-            return Err(anyhow!("failed to send peer message (code {rc})"));
+            // Rejected before reaching the SDK, so it is still ours to return.
+            unsafe {
+                atem_rtm_buffer_release(guard.handle, id);
+            }
+            return match rc {
+                ATEM_RTM_ERR_CLOSED => Err(anyhow!("RTM client is shutting down")),
+                ATEM_RTM_ERR_BUSY => Err(anyhow!("too many messages are waiting for credit")),
+                _ => Err(anyhow!("failed to publish channel message (code {rc})")),
+            };
         }
         Ok(())
     }
 
-    pub async fn next_event(&self) -> Option<RtmEvent> {
-        let mut rx = self.receiver.lock().await;
-        rx.recv().await
+    pub async fn send_peer_buffer(
+        &self,
+        target: &str,
+        buffer: OutboundBuffer<'_>,
+    ) -> Result<PeerDelivery> {
+        let target_c = CString::new(target)?;
+        let guard = self.inner.lock().await;
+        let (id, len) = buffer.into_submitted();
+        let rc = unsafe { atem_rtm_send_peer_buffer(guard.handle, target_c.as_ptr(), id, len) };
+        if rc != 0 && rc != ATEM_RTM_QUEUED {
+            unsafe {
+                atem_rtm_buffer_release(guard.handle, id);
+            }
+        }
+        match rc {
+            0 => Ok(PeerDelivery::Sent),
+            ATEM_RTM_QUEUED => Ok(PeerDelivery::Held),
+            ATEM_RTM_ERR_CLOSED => Err(anyhow!("RTM client is shutting down")),
+            ATEM_RTM_ERR_BUSY => Err(anyhow!("too many messages are waiting for credit")),
+            _ => Err(anyhow!("failed to send peer message (code {rc})")),
+        }
     }
 
-    pub async fn drain_events(&self) -> Vec<RtmEvent> {
-        let mut rx = self.receiver.lock().await;
-        let mut events = Vec::new();
+    fn callback_state(&self) -> &CallbackState {
+        unsafe { &*self._state }
+    }
+
+    /// Moves one batch out of the native queue; returns how many arrived.
+    async fn poll_native(&self, pending: &mut VecDeque<RtmEvent>) -> usize {
+        let mut raw = [AtemRtmEvent::EMPTY; EVENT_POLL_BATCH];
+        let mut count = 0usize;
+        // The real shim locks its event queue and credit state, so polling
+        // need not wait on `inner`. The stub has no locks of its own and a
+        // poll also updates its credit and latency bookkeeping.
+        #[cfg(not(feature = "real_rtm"))]
+        let _guard = self.inner.lock().await;
+        let rc =
+            unsafe { atem_rtm_poll_events(self.probe, raw.as_mut_ptr(), raw.len(), &mut count) };
+        if rc != 0 {
+            return 0;
+        }
+        for record in &raw[..count] {
+            if let Some(event) = unsafe { RtmEvent::from_raw(record) } {
+                pending.push_back(event);
+            }
+        }
+        count
+    }
+
+    /// Waits for the next event. Returns `None` once the client has been
+    /// shut down and everything queued before that was handed out.
+    pub async fn next_event(&self) -> Option<RtmEvent> {
+        let state = self.callback_state();
         loop {
-            match rx.try_recv() {
-                Ok(event) => events.push(event),
-                Err(TryRecvError::Empty) => break,
-                Err(TryRecvError::Disconnected) => break,
+            {
+                let mut pending = self.pending.lock().await;
+                if pending.is_empty() {
+                    self.poll_native(&mut pending).await;
+                }
+                if let Some(event) = pending.pop_front() {
+                    return Some(event);
+                }
+                if state.closed.load(Ordering::Acquire) {
+                    return None;
+                }
             }
+            state.notify.notified().await;
+        }
+    }
+
+    pub async fn drain_events(&self) -> Vec<RtmEvent> {
+        let mut pending = self.pending.lock().await;
+        while self.poll_native(&mut pending).await == EVENT_POLL_BATCH {}
+        pending.drain(..).collect()
+    }
+
+    /// Sets the history policy for a message class: the payload's JSON
+    /// `type`, or `"<type>.partial"` for payloads with `"is_final": false`.
+    /// `None` sets the default for unlisted classes (initially `Skip`).
+    pub async fn set_history_policy(
+        &self,
+        message_class: Option<&str>,
+        policy: HistoryPolicy,
+    ) -> Result<()> {
+        let class_c = message_class.map(CString::new).transpose()?;
+        let class_ptr = class_c.as_ref().map_or(ptr::null(), |c| c.as_ptr());
+        let guard = self.inner.lock().await;
+        let rc = unsafe { atem_rtm_set_history_policy(guard.handle, class_ptr, policy as i32) };
+        if rc != 0 {
+            return Err(anyhow!("failed to set history policy (code {rc})"));
+        }
+        Ok(())
+    }
+
+    /// Sets the outbound priority of a message class (classes as for
+    /// [`RtmClient::set_history_policy`]). `None` sets the default for
+    /// unlisted classes (initially `Normal`). Only matters with
+    /// [`RtmConfig::outbound_rate_per_s`] set.
+    pub async fn set_outbound_priority(
+        &self,
+        message_class: Option<&str>,
+        priority: OutboundPriority,
+    ) -> Result<()> {
+        let class_c = message_class.map(CString::new).transpose()?;
+        let class_ptr = class_c.as_ref().map_or(ptr::null(), |c| c.as_ptr());
+        let guard = self.inner.lock().await;
+        let rc = unsafe { atem_rtm_set_priority(guard.handle, class_ptr, priority as i32) };
+        if rc != 0 {
+            return Err(anyhow!("failed to set outbound priority (code {rc})"));
         }
-        events
+        Ok(())
     }
 
     pub async fn set_token(&self, token: &str) -> Result<()> {
@@ -299,10 +1746,1949 @@ impl RtmClient {
         Ok(())
     }
 
-    pub async fn disconnect(&self) {
+    /// Switches the native shim in or out of its low-power idle mode.
+    pub async fn set_idle(&self, idle: bool) -> Result<()> {
         let guard = self.inner.lock().await;
-        unsafe {
-            atem_rtm_disconnect(guard.handle);
+        let rc = unsafe { atem_rtm_set_idle(guard.handle, idle as i32) };
+        if rc != 0 {
+            return Err(anyhow!("failed to set RTM idle mode (code {rc})"));
+        }
+        Ok(())
+    }
+
+    /// Runs the native shim's time-based work (reorder window, hold expiry).
+    /// Released messages arrive through the usual event channel.
+    pub async fn tick(&self) -> Result<()> {
+        let guard = self.inner.lock().await;
+        let rc = unsafe { atem_rtm_tick(guard.handle) };
+        if rc != 0 {
+            return Err(anyhow!("failed to tick RTM client (code {rc})"));
+        }
+        Ok(())
+    }
+
+    /// Stages a metadata update. Updates to the same target are coalesced
+    /// and written together once the metadata window is up (see [`tick`]).
+    ///
+    /// [`tick`]: RtmClient::tick
+    pub async fn stage_metadata(
+        &self,
+        scope: MetadataScope,
+        target: &str,
+        key: &str,
+        value: &str,
+    ) -> Result<()> {
+        let target_c = CString::new(target)?;
+        let key_c = CString::new(key)?;
+        let value_c = CString::new(value)?;
+        let guard = self.inner.lock().await;
+        let rc = unsafe {
+            atem_rtm_stage_metadata(
+                guard.handle,
+                scope as i32,
+                target_c.as_ptr(),
+                key_c.as_ptr(),
+                value_c.as_ptr(),
+            )
+        };
+        match rc {
+            0 => Ok(()),
+            ATEM_RTM_ERR_CLOSED => Err(anyhow!("RTM client is shutting down")),
+            _ => Err(anyhow!(
+                "failed to stage metadata {key} for {target} (code {rc})"
+            )),
+        }
+    }
+
+    /// Writes all staged metadata now instead of waiting for the window.
+    pub async fn flush_metadata(&self) -> Result<()> {
+        let guard = self.inner.lock().await;
+        let rc = unsafe { atem_rtm_flush_metadata(guard.handle) };
+        if rc != 0 {
+            return Err(anyhow!("failed to flush metadata (code {rc})"));
+        }
+        Ok(())
+    }
+
+    /// Waits until the RTM lock `name` in `channel` is ours. Waiting is
+    /// event-driven in the native shim, so a lock held elsewhere costs no
+    /// requests until it is released or expires.
+    pub async fn acquire_lock(&self, channel: &str, name: &str) -> Result<()> {
+        let channel_c = CString::new(channel)?;
+        let name_c = CString::new(name)?;
+        let (tx, rx) = oneshot::channel();
+        let tx_ptr = Box::into_raw(Box::new(tx));
+        let rc = {
+            let guard = self.inner.lock().await;
+            unsafe {
+                atem_rtm_acquire_lock(
+                    guard.handle,
+                    channel_c.as_ptr(),
+                    name_c.as_ptr(),
+                    on_lock,
+                    tx_ptr as *mut c_void,
+                )
+            }
+        };
+        if rc != 0 {
+            // Not queued, so the callback will never reclaim the sender.
+            unsafe {
+                drop(Box::from_raw(tx_ptr));
+            }
+            return match rc {
+                ATEM_RTM_ERR_CLOSED => Err(anyhow!("RTM client is shutting down")),
+                _ => Err(anyhow!("failed to wait for lock {name} (code {rc})")),
+            };
+        }
+        match rx.await {
+            Ok(0) => Ok(()),
+            Ok(ATEM_RTM_ERR_CLOSED) => Err(anyhow!(
+                "RTM client shut down while waiting for lock {name}"
+            )),
+            Ok(code) => Err(anyhow!("failed to acquire lock {name} (code {code})")),
+            Err(_) => Err(anyhow!("lock wait for {name} was dropped")),
+        }
+    }
+
+    /// Channels `user` is currently in. Answered from the native cache when
+    /// it is fresh; otherwise one remote query is shared by all concurrent
+    /// lookups for the user.
+    pub async fn where_now(&self, user: &str) -> Result<Vec<String>> {
+        let user_c = CString::new(user)?;
+        let (tx, rx) = oneshot::channel::<Result<Vec<String>, i32>>();
+        let tx_ptr = Box::into_raw(Box::new(tx));
+        let rc = {
+            let guard = self.inner.lock().await;
+            unsafe {
+                atem_rtm_where_now(
+                    guard.handle,
+                    user_c.as_ptr(),
+                    on_where_now,
+                    tx_ptr as *mut c_void,
+                )
+            }
+        };
+        if rc != 0 && rc != ATEM_RTM_QUEUED {
+            unsafe {
+                drop(Box::from_raw(tx_ptr));
+            }
+            return match rc {
+                ATEM_RTM_ERR_CLOSED => Err(anyhow!("RTM client is shutting down")),
+                _ => Err(anyhow!("failed to look up {user} (code {rc})")),
+            };
+        }
+        match rx.await {
+            Ok(Ok(channels)) => Ok(channels),
+            Ok(Err(ATEM_RTM_ERR_CLOSED)) => {
+                Err(anyhow!("RTM client shut down while looking up {user}"))
+            }
+            Ok(Err(code)) => Err(anyhow!("failed to look up {user} (code {code})")),
+            Err(_) => Err(anyhow!("lookup of {user} was dropped")),
+        }
+    }
+
+    /// Runs a collapsed native read; `start` receives the handle and the
+    /// boxed sender to pass as user data.
+    async fn read(
+        &self,
+        what: &str,
+        start: impl FnOnce(*mut AtemRtmClient, *mut c_void) -> i32,
+    ) -> Result<Vec<RtmItem>> {
+        let (tx, rx) = oneshot::channel();
+        let tx_ptr = Box::into_raw(Box::new(tx)) as *mut ReadSender;
+        let rc = {
+            let guard = self.inner.lock().await;
+            start(guard.handle, tx_ptr as *mut c_void)
+        };
+        if rc != 0 && rc != ATEM_RTM_QUEUED {
+            unsafe {
+                drop(Box::from_raw(tx_ptr));
+            }
+            return match rc {
+                ATEM_RTM_ERR_CLOSED => Err(anyhow!("RTM client is shutting down")),
+                _ => Err(anyhow!("failed to read {what} (code {rc})")),
+            };
+        }
+        match rx.await {
+            Ok(Ok(items)) => Ok(items),
+            Ok(Err(ATEM_RTM_ERR_CLOSED)) => {
+                Err(anyhow!("RTM client shut down while reading {what}"))
+            }
+            Ok(Err(code)) => Err(anyhow!("failed to read {what} (code {code})")),
+            Err(_) => Err(anyhow!("read of {what} was dropped")),
+        }
+    }
+
+    /// Presence state of `user` in `channel`.
+    pub async fn get_state(&self, channel: &str, user: &str) -> Result<Vec<RtmItem>> {
+        let channel_c = CString::new(channel)?;
+        let user_c = CString::new(user)?;
+        self.read(&format!("state of {user}"), |handle, tx| unsafe {
+            atem_rtm_get_state(handle, channel_c.as_ptr(), user_c.as_ptr(), on_read, tx)
+        })
+        .await
+    }
+
+    pub async fn get_channel_metadata(&self, channel: &str) -> Result<Vec<RtmItem>> {
+        let channel_c = CString::new(channel)?;
+        self.read(&format!("metadata of {channel}"), |handle, tx| unsafe {
+            atem_rtm_get_channel_metadata(handle, channel_c.as_ptr(), on_read, tx)
+        })
+        .await
+    }
+
+    /// Users currently in `channel`.
+    pub async fn who_now(&self, channel: &str) -> Result<Vec<String>> {
+        let channel_c = CString::new(channel)?;
+        let items = self
+            .read(&format!("users of {channel}"), |handle, tx| unsafe {
+                atem_rtm_who_now(handle, channel_c.as_ptr(), on_read, tx)
+            })
+            .await?;
+        Ok(items.into_iter().map(|item| item.key).collect())
+    }
+
+    /// The newest `count` stored messages of `channel` (0 for the SDK
+    /// default of 100).
+    pub async fn get_history(&self, channel: &str, count: u32) -> Result<Vec<RtmItem>> {
+        let channel_c = CString::new(channel)?;
+        self.read(&format!("history of {channel}"), |handle, tx| unsafe {
+            atem_rtm_get_history(handle, channel_c.as_ptr(), count, on_read, tx)
+        })
+        .await
+    }
+
+    /// Lets go of a lock from [`RtmClient::acquire_lock`]. A local waiter
+    /// is handed it in place; otherwise it is released to the service.
+    pub async fn release_lock(&self, channel: &str, name: &str) -> Result<()> {
+        let channel_c = CString::new(channel)?;
+        let name_c = CString::new(name)?;
+        let guard = self.inner.lock().await;
+        let rc =
+            unsafe { atem_rtm_release_lock(guard.handle, channel_c.as_ptr(), name_c.as_ptr()) };
+        if rc != 0 {
+            return Err(anyhow!("failed to release lock {name} (code {rc})"));
+        }
+        Ok(())
+    }
+
+    /// Lock-free health snapshot; cheap enough to call every frame.
+    pub fn health(&self) -> Result<RtmHealth> {
+        let mut raw = AtemRtmHealth::default();
+        let rc = unsafe { atem_rtm_health(self.probe, &mut raw) };
+        if rc != 0 {
+            return Err(anyhow!("failed to read RTM health (code {rc})"));
+        }
+        Ok(raw.into())
+    }
+
+    pub async fn stats(&self) -> Result<RtmStats> {
+        let guard = self.inner.lock().await;
+        let mut raw = AtemRtmStats::default();
+        let rc = unsafe { atem_rtm_get_stats(guard.handle, &mut raw) };
+        if rc != 0 {
+            return Err(anyhow!("failed to read RTM stats (code {rc})"));
+        }
+        Ok(raw.into())
+    }
+
+    /// Per-second samples of the last [`STATS_SERIES_SECONDS`] completed
+    /// seconds, oldest first and one per second, idle seconds included.
+    pub async fn stats_series(&self) -> Result<Vec<StatsSample>> {
+        let guard = self.inner.lock().await;
+        let mut raw = vec![AtemRtmStatsSample::default(); STATS_SERIES_SECONDS];
+        let mut count = 0usize;
+        let rc = unsafe {
+            atem_rtm_get_stats_series(guard.handle, raw.as_mut_ptr(), raw.len(), &mut count)
+        };
+        if rc != 0 {
+            return Err(anyhow!("failed to read RTM stats series (code {rc})"));
+        }
+        raw.truncate(count);
+        Ok(raw.into_iter().map(StatsSample::from).collect())
+    }
+
+    /// Stops accepting sends, waits up to `deadline` for outstanding
+    /// publishes to be acknowledged, then logs out.
+    pub async fn shutdown(&self, deadline: Duration) -> Result<ShutdownReport> {
+        let mut guard = self.inner.lock().await;
+        let deadline_ms = deadline.as_millis().min(u32::MAX as u128) as u32;
+        let mut raw = AtemRtmShutdownReport::default();
+        // Blocks for at most `deadline` while native acknowledgements drain.
+        let rc = unsafe { atem_rtm_shutdown(guard.handle, deadline_ms, &mut raw) };
+        match rc {
+            0 => {
+                guard.shut_down = true;
+                let state = self.callback_state();
+                state.closed.store(true, Ordering::Release);
+                state.notify.notify_one();
+                Ok(ShutdownReport {
+                    flushed: raw.flushed,
+                    failed: raw.failed,
+                    abandoned: raw.abandoned,
+                    elapsed_ms: raw.elapsed_ms,
+                })
+            }
+            ATEM_RTM_ERR_CLOSED => Err(anyhow!("RTM client already shut down")),
+            _ => Err(anyhow!("failed to shut down RTM client (code {rc})")),
+        }
+    }
+
+    pub async fn disconnect(&self) {
+        let guard = self.inner.lock().await;
+        unsafe {
+            atem_rtm_disconnect(guard.handle);
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::atomic::AtomicUsize;
+
+    #[cfg(not(feature = "real_rtm"))]
+    unsafe extern "C" {
+        fn atem_rtm_stub_set_latency(app_id: *const c_char, min_ms: u32, max_ms: u32) -> i32;
+        fn atem_rtm_stub_advance_clock(app_id: *const c_char, ms: u32) -> i32;
+        fn atem_rtm_stub_inject_message(
+            app_id: *const c_char,
+            channel: *const c_char,
+            publisher: *const c_char,
+            payload: *const c_char,
+            custom_type: *const c_char,
+            timestamp: u64,
+        ) -> i32;
+    }
+
+    /// Stub clients with one app id share an emulated project; each test
+    /// gets its own so they do not see each other.
+    fn test_app() -> String {
+        static NEXT: AtomicUsize = AtomicUsize::new(0);
+        format!("test-app-{}", NEXT.fetch_add(1, Ordering::Relaxed))
+    }
+
+    fn stub_client_in(app_id: &str, client_id: &str) -> RtmClient {
+        RtmClient::new(RtmConfig {
+            app_id: app_id.into(),
+            channel: "atem_channel".into(),
+            client_id: client_id.into(),
+            ..Default::default()
+        })
+        .expect("stub client")
+    }
+
+    fn stub_client(client_id: &str) -> RtmClient {
+        stub_client_in(&test_app(), client_id)
+    }
+
+    #[tokio::test]
+    async fn send_peer_reports_sent_when_presence_unknown() {
+        // Not joined yet: no snapshot says who is online.
+        let client = stub_client("atem01");
+        let delivery = client
+            .send_peer("astation", "{\"type\":\"ping\"}")
+            .await
+            .unwrap();
+        assert_eq!(delivery, PeerDelivery::Sent);
+        let echoed: Vec<String> = client
+            .drain_events()
+            .await
+            .into_iter()
+            .filter_map(|event| match event {
+                RtmEvent::Message { from, .. } => Some(from),
+                _ => None,
+            })
+            .collect();
+        assert_eq!(echoed, vec!["astation".to_string()]);
+    }
+
+    async fn hold_client(app: &str, capacity: usize, ttl_ms: u32) -> RtmClient {
+        let client = RtmClient::new(RtmConfig {
+            app_id: app.into(),
+            channel: "atem_channel".into(),
+            client_id: "atem01".into(),
+            peer_hold_capacity: capacity,
+            peer_hold_ttl_ms: ttl_ms,
+            ..Default::default()
+        })
+        .expect("stub client");
+        client
+            .login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        client
+    }
+
+    /// Peer payloads `client` has received from atem01 so far.
+    async fn received(client: &RtmClient) -> Vec<String> {
+        client.tick().await.unwrap();
+        client
+            .drain_events()
+            .await
+            .into_iter()
+            .filter_map(|event| match event {
+                RtmEvent::Message { from, payload, .. } if from == "atem01" => Some(payload),
+                _ => None,
+            })
+            .collect()
+    }
+
+    #[tokio::test]
+    async fn peer_messages_are_held_until_the_peer_joins() {
+        let app = test_app();
+        let sender = hold_client(&app, 0, 0).await;
+        // The channel snapshot shows atem02 offline.
+        let delivery = sender.send_peer("atem02", "m1").await.unwrap();
+        assert_eq!(delivery, PeerDelivery::Held);
+        let stats = sender.stats().await.unwrap();
+        assert_eq!(stats.peer_messages_held, 1);
+        assert_eq!(stats.peer_hold_depth, 1);
+
+        let peer = stub_client_in(&app, "atem02");
+        peer.login_and_join("", "atem02", "atem_channel")
+            .await
+            .unwrap();
+        assert!(received(&peer).await.is_empty());
+        // The join announcement releases it.
+        sender.tick().await.unwrap();
+        assert_eq!(received(&peer).await, vec!["m1"]);
+        let stats = sender.stats().await.unwrap();
+        assert_eq!(stats.peer_messages_flushed, 1);
+        assert_eq!(stats.peer_hold_depth, 0);
+        assert_eq!(
+            sender.send_peer("atem02", "m2").await.unwrap(),
+            PeerDelivery::Sent
+        );
+    }
+
+    #[tokio::test]
+    async fn held_peer_messages_go_out_with_the_next_snapshot() {
+        let app = test_app();
+        let sender = hold_client(&app, 0, 0).await;
+        sender.send_peer("atem02", "m1").await.unwrap();
+
+        // atem02 joins while we are away, so only the snapshot on
+        // rejoining shows it.
+        sender.disconnect().await;
+        let peer = stub_client_in(&app, "atem02");
+        peer.login_and_join("", "atem02", "atem_channel")
+            .await
+            .unwrap();
+        unsafe { atem_rtm_connect(sender.inner.lock().await.handle) };
+        sender
+            .login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        assert_eq!(received(&peer).await, vec!["m1"]);
+        assert_eq!(sender.stats().await.unwrap().peer_messages_flushed, 1);
+    }
+
+    #[tokio::test]
+    async fn held_peer_messages_expire_after_the_ttl() {
+        let app = test_app();
+        let app_c = CString::new(app.clone()).unwrap();
+        let sender = hold_client(&app, 0, 1_000).await;
+        sender.send_peer("atem02", "m1").await.unwrap();
+
+        unsafe { atem_rtm_stub_advance_clock(app_c.as_ptr(), 2_000) };
+        let stats = sender.stats().await.unwrap();
+        assert_eq!(stats.peer_messages_expired, 1);
+        assert_eq!(stats.peer_hold_depth, 0);
+
+        let peer = stub_client_in(&app, "atem02");
+        peer.login_and_join("", "atem02", "atem_channel")
+            .await
+            .unwrap();
+        sender.tick().await.unwrap();
+        assert!(received(&peer).await.is_empty());
+        assert_eq!(sender.stats().await.unwrap().peer_messages_flushed, 0);
+    }
+
+    #[tokio::test]
+    async fn a_full_hold_drops_the_oldest_peer_message() {
+        let app = test_app();
+        let sender = hold_client(&app, 2, 0).await;
+        for payload in ["m1", "m2", "m3"] {
+            let delivery = sender.send_peer("atem02", payload).await.unwrap();
+            assert_eq!(delivery, PeerDelivery::Held);
+        }
+        let stats = sender.stats().await.unwrap();
+        assert_eq!(stats.peer_messages_dropped, 1);
+        assert_eq!(stats.peer_hold_depth, 2);
+
+        let peer = stub_client_in(&app, "atem02");
+        peer.login_and_join("", "atem02", "atem_channel")
+            .await
+            .unwrap();
+        sender.tick().await.unwrap();
+        assert_eq!(received(&peer).await, vec!["m2", "m3"]);
+    }
+
+    #[tokio::test]
+    async fn paced_peer_messages_are_held_and_flushed_at_the_paced_rate() {
+        let app = test_app();
+        let app_c = CString::new(app.clone()).unwrap();
+        let sender = RtmClient::new(RtmConfig {
+            app_id: app.clone(),
+            channel: "atem_channel".into(),
+            client_id: "atem01".into(),
+            outbound_rate_per_s: 10,
+            outbound_burst: 1,
+            ..Default::default()
+        })
+        .unwrap();
+        sender
+            .login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        sender.drain_events().await;
+        for payload in ["m1", "m2", "m3"] {
+            sender.send_peer("atem02", payload).await.unwrap();
+        }
+        // Paced out one per 100 ms, each to be held rather than echoed.
+        for _ in 0..3 {
+            unsafe { atem_rtm_stub_advance_clock(app_c.as_ptr(), 100) };
+            sender.tick().await.unwrap();
+        }
+        let stats = sender.stats().await.unwrap();
+        assert_eq!(stats.outbound_queued, 0);
+        assert_eq!(stats.peer_messages_held, 3);
+        let echoed = sender
+            .drain_events()
+            .await
+            .into_iter()
+            .any(|event| matches!(event, RtmEvent::Message { .. }));
+        assert!(!echoed);
+
+        let peer = stub_client_in(&app, "atem02");
+        peer.login_and_join("", "atem02", "atem_channel")
+            .await
+            .unwrap();
+        sender.tick().await.unwrap();
+        assert_eq!(received(&peer).await, vec!["m1"]);
+        assert_eq!(sender.stats().await.unwrap().outbound_queued, 2);
+        for expected in ["m2", "m3"] {
+            unsafe { atem_rtm_stub_advance_clock(app_c.as_ptr(), 100) };
+            sender.tick().await.unwrap();
+            assert_eq!(received(&peer).await, vec![expected]);
+        }
+    }
+
+    #[tokio::test]
+    async fn event_stream_reports_link_state_results_and_messages() {
+        let client = stub_client("atem01");
+        client
+            .login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        assert_eq!(
+            client.next_event().await,
+            Some(RtmEvent::LinkState {
+                state: RtmLinkState::Connected,
+                reason: 0,
+            })
+        );
+        client
+            .publish_channel("{\"type\":\"status\"}")
+            .await
+            .unwrap();
+
+        let events = client.drain_events().await;
+        let ops: Vec<RtmOp> = events
+            .iter()
+            .filter_map(|event| match event {
+                RtmEvent::Result {
+                    op, error_code: 0, ..
+                } => Some(*op),
+                _ => None,
+            })
+            .collect();
+        assert_eq!(ops, vec![RtmOp::Login, RtmOp::Subscribe, RtmOp::Publish]);
+        assert!(events.iter().any(|event| matches!(
+            event,
+            RtmEvent::Message { from, channel, payload, .. }
+                if from == "atem01" && channel == "atem_channel" && payload == "{\"type\":\"status\"}"
+        )));
+
+        client.shutdown(Duration::from_millis(10)).await.unwrap();
+        assert_eq!(client.next_event().await, None);
+    }
+
+    #[tokio::test]
+    async fn full_event_queue_drops_oldest() {
+        let client = RtmClient::new(RtmConfig {
+            app_id: test_app().into(),
+            channel: "atem_channel".into(),
+            client_id: "atem01".into(),
+            event_queue_capacity: 2,
+            ..Default::default()
+        })
+        .unwrap();
+        client
+            .login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        let stats = client.stats().await.unwrap();
+        assert_eq!(stats.events_queued, 2);
+        assert_eq!(stats.events_dropped, 2);
+        assert!(matches!(
+            client.drain_events().await[..],
+            [
+                RtmEvent::Result {
+                    op: RtmOp::Subscribe,
+                    ..
+                },
+                RtmEvent::Presence {
+                    change: PresenceChange::Snapshot { size: 1 },
+                    ..
+                }
+            ]
+        ));
+    }
+
+    #[tokio::test]
+    async fn large_events_spill_out_of_their_slot() {
+        let app = test_app();
+        let a = stub_client_in(&app, "atem01");
+        let b = stub_client_in(&app, "atem02");
+        a.login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        b.login_and_join("", "atem02", "atem_channel")
+            .await
+            .unwrap();
+        let large = format!("{{\"blob\":\"{}\"}}", "x".repeat(2000));
+        a.publish_channel("{\"type\":\"status\"}").await.unwrap();
+        a.publish_channel(&large).await.unwrap();
+        b.tick().await.unwrap();
+
+        let received: Vec<String> = b
+            .drain_events()
+            .await
+            .into_iter()
+            .filter_map(|event| match event {
+                RtmEvent::Message { payload, .. } => Some(payload),
+                _ => None,
+            })
+            .collect();
+        assert_eq!(received, vec!["{\"type\":\"status\"}".to_string(), large]);
+        assert_eq!(b.stats().await.unwrap().events_spilled, 1);
+    }
+
+    // Benchmark of the inbound path from delivery to RtmEvent:
+    // cargo test --release event_stream_throughput -- --ignored --nocapture
+    // Cache misses have not been measured; run it under
+    // `perf stat -e cache-misses` where counters exist. The native queue
+    // alone is timed by scripts/bench-event-queue.sh. Its gain barely
+    // shows here, because reorder, fair scheduling and the Rust side still
+    // build a String per event.
+    #[tokio::test]
+    #[ignore]
+    async fn event_stream_throughput() {
+        const BATCH: usize = 256;
+        const EVENTS: usize = BATCH * 800;
+        let app = test_app();
+        let a = stub_client_in(&app, "atem01");
+        let b = stub_client_in(&app, "atem02");
+        a.login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        b.login_and_join("", "atem02", "atem_channel")
+            .await
+            .unwrap();
+        b.drain_events().await;
+        let payload = format!("{{\"type\":\"status\",\"pad\":\"{}\"}}", "x".repeat(280));
+
+        let started = std::time::Instant::now();
+        let mut received = 0;
+        for _ in 0..EVENTS / BATCH {
+            for _ in 0..BATCH {
+                a.publish_channel(&payload).await.unwrap();
+            }
+            b.tick().await.unwrap();
+            received += b.drain_events().await.len();
+        }
+        let elapsed = started.elapsed();
+        assert_eq!(received, EVENTS);
+        println!(
+            "{} events of {} bytes: {:.0} ns/event",
+            EVENTS,
+            payload.len(),
+            elapsed.as_nanos() as f64 / EVENTS as f64
+        );
+    }
+
+    #[tokio::test]
+    async fn stats_start_empty() {
+        let client = stub_client("atem01");
+        client.tick().await.unwrap();
+        assert_eq!(client.stats().await.unwrap(), RtmStats::default());
+    }
+
+    #[tokio::test]
+    async fn shutdown_rejects_later_sends() {
+        let client = RtmClient::new(RtmConfig {
+            app_id: test_app(),
+            channel: "atem_channel".into(),
+            client_id: "atem01".into(),
+            outbound_rate_per_s: 1,
+            outbound_burst: 1,
+            ..Default::default()
+        })
+        .unwrap();
+        client
+            .login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        // One goes out at once; the paced backlog is flushed by shutdown.
+        for _ in 0..4 {
+            client
+                .publish_channel("{\"type\":\"status\"}")
+                .await
+                .unwrap();
+        }
+        assert_eq!(client.stats().await.unwrap().outbound_queued, 3);
+        let report = client.shutdown(Duration::from_millis(100)).await.unwrap();
+        assert_eq!(report.flushed, 3);
+        assert_eq!(report.failed, 0);
+        assert_eq!(report.abandoned, 0);
+        assert!(client.publish_channel("late").await.is_err());
+        assert!(client.send_peer("astation", "late").await.is_err());
+        assert!(client.shutdown(Duration::from_millis(100)).await.is_err());
+    }
+
+    #[tokio::test]
+    async fn staged_metadata_is_coalesced_per_target() {
+        let client = stub_client("atem01");
+        client
+            .login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        client
+            .stage_metadata(MetadataScope::User, "atem01", "status", "busy")
+            .await
+            .unwrap();
+        client
+            .stage_metadata(MetadataScope::User, "atem01", "status", "idle")
+            .await
+            .unwrap();
+        client
+            .stage_metadata(MetadataScope::User, "atem01", "branch", "main")
+            .await
+            .unwrap();
+        let stats = client.stats().await.unwrap();
+        assert_eq!(stats.metadata_pending, 2);
+        assert_eq!(stats.metadata_coalesced, 1);
+
+        client.flush_metadata().await.unwrap();
+        let stats = client.stats().await.unwrap();
+        assert_eq!(stats.metadata_pending, 0);
+        assert_eq!(stats.metadata_writes, 1);
+        assert_eq!(stats.metadata_written, 1);
+    }
+
+    #[tokio::test]
+    async fn metadata_writes_stay_conditional_after_a_successful_write() {
+        let app = test_app();
+        let atem = stub_client_in(&app, "atem01");
+        let other = stub_client_in(&app, "atem02");
+        for (client, id) in [(&atem, "atem01"), (&other, "atem02")] {
+            client.login_and_join("", id, "atem_channel").await.unwrap();
+        }
+        atem.stage_metadata(MetadataScope::Channel, "atem_channel", "status", "busy")
+            .await
+            .unwrap();
+        atem.flush_metadata().await.unwrap();
+        other
+            .stage_metadata(MetadataScope::Channel, "atem_channel", "status", "away")
+            .await
+            .unwrap();
+        other.flush_metadata().await.unwrap();
+
+        // The second write still carries the revision the first produced,
+        // so the other writer's change in between is caught.
+        atem.stage_metadata(MetadataScope::Channel, "atem_channel", "status", "idle")
+            .await
+            .unwrap();
+        atem.flush_metadata().await.unwrap();
+        let stats = atem.stats().await.unwrap();
+        assert_eq!(stats.metadata_conflicts, 1);
+        assert_eq!(stats.metadata_in_flight, 0);
+    }
+
+    #[tokio::test]
+    async fn staged_metadata_waits_for_the_virtual_clock() {
+        let app = test_app();
+        let app_c = CString::new(app.clone()).unwrap();
+        let client = RtmClient::new(RtmConfig {
+            app_id: app.clone(),
+            channel: "atem_channel".into(),
+            client_id: "atem01".into(),
+            metadata_window_ms: 500,
+            ..Default::default()
+        })
+        .expect("stub client");
+        client
+            .login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        client
+            .stage_metadata(MetadataScope::Channel, "atem_channel", "status", "busy")
+            .await
+            .unwrap();
+
+        // The window runs on the broker's clock, so advancing it flushes
+        // the write without waiting.
+        client.tick().await.unwrap();
+        assert_eq!(client.stats().await.unwrap().metadata_writes, 0);
+        unsafe { atem_rtm_stub_advance_clock(app_c.as_ptr(), 500) };
+        client.tick().await.unwrap();
+        let stats = client.stats().await.unwrap();
+        assert_eq!(stats.metadata_writes, 1);
+        assert_eq!(stats.metadata_pending, 0);
+    }
+
+    #[tokio::test]
+    async fn lock_waiters_are_handed_the_lock_on_release() {
+        let client = stub_client("atem01");
+        client
+            .login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        client.acquire_lock("atem_channel", "active").await.unwrap();
+
+        let (waited, queued) = tokio::join!(client.acquire_lock("atem_channel", "active"), async {
+            let stats = client.stats().await.unwrap();
+            client.release_lock("atem_channel", "active").await.unwrap();
+            stats
+        });
+        waited.unwrap();
+        // The second waiter queued locally instead of sending an acquire.
+        assert_eq!(queued.lock_waiters, 1);
+        assert_eq!(queued.lock_acquires, 1);
+
+        // Handed over in place: no second acquire went out.
+        let stats = client.stats().await.unwrap();
+        assert_eq!(stats.lock_acquires, 1);
+        assert_eq!(stats.lock_acquired, 2);
+        assert_eq!(stats.lock_waiters, 0);
+    }
+
+    #[tokio::test]
+    async fn a_lock_lost_to_its_ttl_is_acquired_again() {
+        let app = test_app();
+        let app_c = CString::new(app.clone()).unwrap();
+        let client = stub_client_in(&app, "atem01");
+        client
+            .login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        client.acquire_lock("atem_channel", "active").await.unwrap();
+
+        // Offline past the TTL: the service lets the lock go, and the
+        // snapshot on rejoining shows it free.
+        client.disconnect().await;
+        unsafe { atem_rtm_stub_advance_clock(app_c.as_ptr(), 10_000) };
+        unsafe { atem_rtm_connect(client.inner.lock().await.handle) };
+        client
+            .login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        tokio::time::timeout(
+            Duration::from_secs(1),
+            client.acquire_lock("atem_channel", "active"),
+        )
+        .await
+        .expect("the lapsed hold is not taken for ours")
+        .unwrap();
+        let stats = client.stats().await.unwrap();
+        assert_eq!(stats.lock_acquires, 2);
+        assert_eq!(stats.lock_acquired, 2);
+    }
+
+    /// Sends `payload` to atem_channel as from "ext", stamped with
+    /// (epoch, seq) if given and with server timestamp `timestamp`.
+    fn inject(app: &str, payload: &str, stamp: Option<(u32, u64)>, timestamp: u64) {
+        let app_c = CString::new(app).unwrap();
+        let channel_c = CString::new("atem_channel").unwrap();
+        let publisher_c = CString::new("ext").unwrap();
+        let payload_c = CString::new(payload).unwrap();
+        let custom_c =
+            stamp.map(|(epoch, seq)| CString::new(format!("seq:{epoch:08x}:{seq:x}")).unwrap());
+        let rc = unsafe {
+            atem_rtm_stub_inject_message(
+                app_c.as_ptr(),
+                channel_c.as_ptr(),
+                publisher_c.as_ptr(),
+                payload_c.as_ptr(),
+                custom_c.as_ref().map_or(ptr::null(), |c| c.as_ptr()),
+                timestamp,
+            )
+        };
+        assert_eq!(rc, 0);
+    }
+
+    /// Payloads delivered from "ext" so far.
+    async fn delivered(client: &RtmClient) -> Vec<String> {
+        client.tick().await.unwrap();
+        client
+            .drain_events()
+            .await
+            .into_iter()
+            .filter_map(|event| match event {
+                RtmEvent::Message { from, payload, .. } if from == "ext" => Some(payload),
+                _ => None,
+            })
+            .collect()
+    }
+
+    async fn reorder_client(app: &str) -> RtmClient {
+        let client = stub_client_in(app, "atem01");
+        client
+            .login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        client.drain_events().await;
+        client
+    }
+
+    #[tokio::test]
+    async fn reorder_skips_a_gap_after_the_window() {
+        let app = test_app();
+        let app_c = CString::new(app.clone()).unwrap();
+        let client = reorder_client(&app).await;
+        inject(&app, "m0", Some((7, 0)), 1_000);
+        inject(&app, "m2", Some((7, 2)), 1_002);
+        assert_eq!(delivered(&client).await, vec!["m0"]);
+        assert_eq!(client.stats().await.unwrap().reorder_depth, 1);
+
+        unsafe { atem_rtm_stub_advance_clock(app_c.as_ptr(), 50) };
+        assert_eq!(delivered(&client).await, vec!["m2"]);
+        // The message given up on still arrives, behind its successor.
+        inject(&app, "m1", Some((7, 1)), 1_001);
+        assert_eq!(delivered(&client).await, vec!["m1"]);
+        let stats = client.stats().await.unwrap();
+        assert_eq!(stats.reorder_gaps_skipped, 1);
+        assert_eq!(stats.reorder_late, 1);
+        assert_eq!(stats.reorder_depth, 0);
+    }
+
+    #[tokio::test]
+    async fn reorder_drops_duplicates() {
+        let app = test_app();
+        let client = reorder_client(&app).await;
+        inject(&app, "m0", Some((7, 0)), 1_000);
+        inject(&app, "m1", Some((7, 1)), 1_001);
+        inject(&app, "m1", Some((7, 1)), 1_001);
+        inject(&app, "m0", Some((7, 0)), 1_000);
+        assert_eq!(delivered(&client).await, vec!["m0", "m1"]);
+        assert_eq!(client.stats().await.unwrap().reorder_duplicates, 2);
+    }
+
+    #[tokio::test]
+    async fn reorder_lets_stragglers_of_an_old_epoch_through_late() {
+        let app = test_app();
+        let client = reorder_client(&app).await;
+        inject(&app, "a5", Some((0xa, 5)), 1_000);
+        inject(&app, "a6", Some((0xa, 6)), 1_001);
+        // The publisher restarted; its new epoch starts a new sequence.
+        inject(&app, "b0", Some((0xb, 0)), 2_000);
+        // Stragglers from the old epoch, and from one older still that was
+        // never seen, go out as they come without restarting the sequence.
+        inject(&app, "a7", Some((0xa, 7)), 1_002);
+        inject(&app, "c9", Some((0xc, 9)), 500);
+        // So the new epoch is still being ordered.
+        inject(&app, "b2", Some((0xb, 2)), 2_002);
+        inject(&app, "b1", Some((0xb, 1)), 2_001);
+        assert_eq!(
+            delivered(&client).await,
+            vec!["a5", "a6", "b0", "a7", "c9", "b1", "b2"]
+        );
+        let stats = client.stats().await.unwrap();
+        assert_eq!(stats.reorder_late, 2);
+        assert_eq!(stats.reorder_gaps_skipped, 0);
+    }
+
+    #[tokio::test]
+    async fn reorder_orders_unstamped_messages_by_server_time() {
+        let app = test_app();
+        let app_c = CString::new(app.clone()).unwrap();
+        let client = reorder_client(&app).await;
+        inject(&app, "t0", None, 1_000_000);
+        inject(&app, "t-10", None, 999_990);
+        assert!(delivered(&client).await.is_empty());
+        assert_eq!(client.stats().await.unwrap().reorder_depth, 2);
+        unsafe { atem_rtm_stub_advance_clock(app_c.as_ptr(), 50) };
+        assert_eq!(delivered(&client).await, vec!["t-10", "t0"]);
+
+        // Sent 10 ms after t0 but 40 ms later in transit: it has used up
+        // most of its wait on the way and only waits out the rest.
+        inject(&app, "t10", None, 1_000_010);
+        assert!(delivered(&client).await.is_empty());
+        unsafe { atem_rtm_stub_advance_clock(app_c.as_ptr(), 15) };
+        assert_eq!(delivered(&client).await, vec!["t10"]);
+    }
+
+    #[tokio::test]
+    async fn history_policy_applies_per_message_class() {
+        let client = stub_client("atem01");
+        client
+            .login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        client
+            .set_history_policy(Some("transcription"), HistoryPolicy::Store)
+            .await
+            .unwrap();
+        client
+            .set_history_policy(Some("transcription.partial"), HistoryPolicy::Skip)
+            .await
+            .unwrap();
+        client
+            .publish_channel(r#"{"type":"transcription","text":"hi","is_final":true}"#)
+            .await
+            .unwrap();
+        client
+            .publish_channel(r#"{"type":"transcription","text":"h","is_final":false}"#)
+            .await
+            .unwrap();
+        client.publish_channel(r#"{"type":"ping"}"#).await.unwrap();
+        let stats = client.stats().await.unwrap();
+        assert_eq!(stats.history_stored, 1);
+        assert_eq!(stats.history_skipped, 2);
+    }
+
+    #[tokio::test]
+    async fn health_tracks_link_and_traffic() {
+        let client = stub_client("atem01");
+        let health = client.health().unwrap();
+        assert_eq!(health.link_state, RtmLinkState::Idle);
+        assert_eq!(health.last_outbound_age, None);
+        assert_eq!(health.token_age, None);
+
+        client
+            .login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        client.publish_channel("{\"type\":\"ping\"}").await.unwrap();
+        let health = client.health().unwrap();
+        assert_eq!(health.link_state, RtmLinkState::Connected);
+        assert!(health.last_outbound_age.is_some());
+        assert!(health.last_inbound_age.is_some());
+        assert!(health.token_age.is_some());
+        assert_eq!(health.requests_in_flight, 0);
+    }
+
+    #[tokio::test]
+    async fn outbound_buffers_are_recycled_after_publish() {
+        use std::io::Write;
+
+        let client = RtmClient::new(RtmConfig {
+            app_id: test_app().into(),
+            channel: "atem_channel".into(),
+            client_id: "atem01".into(),
+            outbound_buffer_count: 1,
+            outbound_buffer_size: 64,
+            ..Default::default()
+        })
+        .unwrap();
+        client
+            .login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+
+        let mut buffer = client.acquire_buffer().unwrap();
+        write!(buffer, "{{\"type\":\"status\"}}").unwrap();
+        assert!(client.acquire_buffer().is_err());
+        client.publish_buffer(buffer).await.unwrap();
+
+        let published = client
+            .drain_events()
+            .await
+            .into_iter()
+            .find_map(|event| match event {
+                RtmEvent::Message { payload, .. } => Some(payload),
+                _ => None,
+            });
+        assert_eq!(published.as_deref(), Some("{\"type\":\"status\"}"));
+        let stats = client.stats().await.unwrap();
+        assert_eq!(stats.buffers_in_use, 0);
+        assert_eq!(stats.buffer_publishes, 1);
+        assert_eq!(stats.buffers_exhausted, 1);
+
+        let mut buffer = client.acquire_buffer().unwrap();
+        assert!(buffer.write_all(&[b'x'; 65]).is_err());
+        drop(buffer);
+        assert_eq!(client.stats().await.unwrap().buffers_in_use, 0);
+    }
+
+    #[tokio::test]
+    async fn where_now_is_cached_after_first_lookup() {
+        let client = stub_client("atem01");
+        client
+            .login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        assert_eq!(
+            client.where_now("atem01").await.unwrap(),
+            vec!["atem_channel"]
+        );
+        assert_eq!(
+            client.where_now("atem01").await.unwrap(),
+            vec!["atem_channel"]
+        );
+        assert!(client.where_now("astation").await.unwrap().is_empty());
+
+        let stats = client.stats().await.unwrap();
+        assert_eq!(stats.location_queries, 2);
+        assert_eq!(stats.location_hits, 1);
+        assert_eq!(stats.location_misses, 2);
+        assert_eq!(stats.location_entries, 2);
+    }
+
+    #[tokio::test]
+    async fn cached_reads_are_dropped_when_the_data_changes() {
+        let client = RtmClient::new(RtmConfig {
+            app_id: test_app().into(),
+            channel: "atem_channel".into(),
+            client_id: "atem01".into(),
+            read_cache_ms: 60_000,
+            ..Default::default()
+        })
+        .unwrap();
+        client
+            .login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        assert_eq!(
+            client.who_now("atem_channel").await.unwrap(),
+            vec!["atem01"]
+        );
+        assert_eq!(
+            client.who_now("atem_channel").await.unwrap(),
+            vec!["atem01"]
+        );
+
+        assert!(
+            client
+                .get_channel_metadata("atem_channel")
+                .await
+                .unwrap()
+                .is_empty()
+        );
+        client
+            .stage_metadata(MetadataScope::Channel, "atem_channel", "active", "atem01")
+            .await
+            .unwrap();
+        client.flush_metadata().await.unwrap();
+        let items = client.get_channel_metadata("atem_channel").await.unwrap();
+        assert_eq!(items.len(), 1);
+        assert_eq!(items[0].key, "active");
+        assert_eq!(items[0].value.as_deref(), Some("atem01"));
+
+        let stats = client.stats().await.unwrap();
+        assert_eq!(stats.reads_requested, 4);
+        assert_eq!(stats.reads_issued, 3);
+        assert_eq!(stats.reads_cache_hits, 1);
+    }
+
+    #[tokio::test]
+    async fn reads_in_flight_across_a_change_are_not_cached() {
+        let app = test_app();
+        let app_c = CString::new(app.clone()).unwrap();
+        let client = RtmClient::new(RtmConfig {
+            app_id: app.clone(),
+            channel: "atem_channel".into(),
+            client_id: "atem01".into(),
+            read_cache_ms: 60_000,
+            ..Default::default()
+        })
+        .unwrap();
+        client
+            .login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        client
+            .set_history_policy(None, HistoryPolicy::Store)
+            .await
+            .unwrap();
+        unsafe { atem_rtm_stub_set_latency(app_c.as_ptr(), 20, 20) };
+
+        // The stored publish lands while the first read is on the wire, so
+        // its answer is already stale when it arrives.
+        let done = std::cell::Cell::new(false);
+        let (first, _) = tokio::join!(
+            async {
+                let items = client.get_history("atem_channel", 10).await.unwrap();
+                done.set(true);
+                items
+            },
+            async {
+                client.publish_channel(r#"{"type":"ping"}"#).await.unwrap();
+                for _ in 0..100 {
+                    if done.get() {
+                        break;
+                    }
+                    unsafe { atem_rtm_stub_advance_clock(app_c.as_ptr(), 10) };
+                    client.tick().await.unwrap();
+                    tokio::task::yield_now().await;
+                }
+            }
+        );
+        assert!(first.is_empty());
+
+        unsafe { atem_rtm_stub_set_latency(app_c.as_ptr(), 0, 0) };
+        let second = client.get_history("atem_channel", 10).await.unwrap();
+        assert_eq!(second.len(), 1);
+        let stats = client.stats().await.unwrap();
+        assert_eq!(stats.reads_issued, 2);
+        assert_eq!(stats.reads_cache_hits, 0);
+    }
+
+    #[tokio::test]
+    async fn reads_started_after_a_change_do_not_join_the_stale_one() {
+        let app = test_app();
+        let app_c = CString::new(app.clone()).unwrap();
+        let client = stub_client_in(&app, "atem01");
+        client
+            .login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        client
+            .set_history_policy(None, HistoryPolicy::Store)
+            .await
+            .unwrap();
+        unsafe { atem_rtm_stub_set_latency(app_c.as_ptr(), 20, 20) };
+
+        // The second read starts after the stored publish, while the first
+        // is still on the wire; it must not be handed the first's answer.
+        let (first, (second, _)) = tokio::join!(client.get_history("atem_channel", 10), async {
+            client.publish_channel(r#"{"type":"ping"}"#).await.unwrap();
+            tokio::join!(client.get_history("atem_channel", 10), async {
+                for _ in 0..10 {
+                    unsafe { atem_rtm_stub_advance_clock(app_c.as_ptr(), 10) };
+                    client.tick().await.unwrap();
+                    tokio::task::yield_now().await;
+                }
+            })
+        });
+        assert!(first.unwrap().is_empty());
+        assert_eq!(second.unwrap().len(), 1);
+        let stats = client.stats().await.unwrap();
+        assert_eq!(stats.reads_issued, 2);
+        assert_eq!(stats.reads_collapsed, 0);
+    }
+
+    #[tokio::test]
+    async fn idle_mode_is_reported_in_stats() {
+        let client = stub_client("atem01");
+        client.set_idle(true).await.unwrap();
+        assert!(client.stats().await.unwrap().idle_mode);
+        client.set_idle(false).await.unwrap();
+        assert!(!client.stats().await.unwrap().idle_mode);
+    }
+
+    #[tokio::test]
+    async fn stub_clients_in_one_app_see_each_other() {
+        let app = test_app();
+        let a = stub_client_in(&app, "atem01");
+        let b = stub_client_in(&app, "atem02");
+        a.login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        b.login_and_join("", "atem02", "atem_channel")
+            .await
+            .unwrap();
+        a.set_history_policy(None, HistoryPolicy::Store)
+            .await
+            .unwrap();
+        a.publish_channel("{\"type\":\"status\"}").await.unwrap();
+        a.tick().await.unwrap();
+        b.tick().await.unwrap();
+
+        assert!(a.drain_events().await.iter().any(|event| matches!(
+            event,
+            RtmEvent::Presence { user: Some(user), change: PresenceChange::Join, .. }
+                if user == "atem02"
+        )));
+        let received: Vec<String> = b
+            .drain_events()
+            .await
+            .into_iter()
+            .filter_map(|event| match event {
+                RtmEvent::Message { from, payload, .. } if from == "atem01" => Some(payload),
+                _ => None,
+            })
+            .collect();
+        assert_eq!(received, vec!["{\"type\":\"status\"}".to_string()]);
+
+        assert_eq!(
+            b.who_now("atem_channel").await.unwrap(),
+            vec!["atem01", "atem02"]
+        );
+        assert_eq!(b.where_now("atem01").await.unwrap(), vec!["atem_channel"]);
+        let history = b.get_history("atem_channel", 10).await.unwrap();
+        assert_eq!(history.len(), 1);
+        assert_eq!(history[0].key, "atem01");
+        assert_eq!(history[0].value.as_deref(), Some("{\"type\":\"status\"}"));
+    }
+
+    #[tokio::test]
+    async fn fair_scheduling_keeps_a_flooding_publisher_from_starving_others() {
+        let app = test_app();
+        let flood = stub_client_in(&app, "atem01");
+        let quiet = stub_client_in(&app, "atem02");
+        let receiver = RtmClient::new(RtmConfig {
+            app_id: app.clone(),
+            channel: "atem_channel".into(),
+            client_id: "atem03".into(),
+            fair_quantum_bytes: 128,
+            // Ten of the flood's messages (payload plus 64 bytes each).
+            fair_publisher_max_bytes: 10 * (64 + 11),
+            ..Default::default()
+        })
+        .unwrap();
+        for (client, user) in [
+            (&flood, "atem01"),
+            (&quiet, "atem02"),
+            (&receiver, "atem03"),
+        ] {
+            client
+                .login_and_join("", user, "atem_channel")
+                .await
+                .unwrap();
+        }
+        receiver.drain_events().await;
+
+        for n in 0..40 {
+            flood
+                .publish_channel(&format!("{{\"n\":{n:03}}}  "))
+                .await
+                .unwrap();
+        }
+        quiet.publish_channel("{\"q\":1}").await.unwrap();
+        quiet.publish_channel("{\"q\":2}").await.unwrap();
+        receiver.tick().await.unwrap();
+
+        let received: Vec<(String, String)> = receiver
+            .drain_events()
+            .await
+            .into_iter()
+            .filter_map(|event| match event {
+                RtmEvent::Message { from, payload, .. } => Some((from, payload)),
+                _ => None,
+            })
+            .collect();
+        let from = |user: &str| -> Vec<String> {
+            received
+                .iter()
+                .filter(|(publisher, _)| publisher == user)
+                .map(|(_, payload)| payload.clone())
+                .collect()
+        };
+        // The quiet publisher is served within the first rounds, not
+        // behind the whole flood.
+        let last_quiet = received
+            .iter()
+            .rposition(|(publisher, _)| publisher == "atem02")
+            .unwrap();
+        assert!(last_quiet < 5, "quiet publisher served at {last_quiet}");
+        assert_eq!(from("atem02"), vec!["{\"q\":1}", "{\"q\":2}"]);
+        // The flood keeps its newest ten, in order.
+        let flooded = from("atem01");
+        let expected: Vec<String> = (30..40).map(|n| format!("{{\"n\":{n:03}}}  ")).collect();
+        assert_eq!(flooded, expected);
+
+        let stats = receiver.stats().await.unwrap();
+        assert_eq!(stats.fair_shed, 30);
+        assert_eq!(stats.fair_publishers_max, 2);
+    }
+
+    #[tokio::test]
+    async fn paced_control_messages_overtake_queued_bulk() {
+        let app = test_app();
+        let app_c = CString::new(app.clone()).unwrap();
+        let sender = RtmClient::new(RtmConfig {
+            app_id: app.clone(),
+            channel: "atem_channel".into(),
+            client_id: "atem01".into(),
+            outbound_rate_per_s: 200,
+            outbound_burst: 1,
+            ..Default::default()
+        })
+        .unwrap();
+        let receiver = stub_client_in(&app, "atem02");
+        sender
+            .login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        receiver
+            .login_and_join("", "atem02", "atem_channel")
+            .await
+            .unwrap();
+        sender
+            .set_outbound_priority(Some("transcript"), OutboundPriority::Bulk)
+            .await
+            .unwrap();
+        sender
+            .set_outbound_priority(Some("active_update"), OutboundPriority::Control)
+            .await
+            .unwrap();
+        receiver.drain_events().await;
+
+        for n in 0..5 {
+            sender
+                .publish_channel(&format!("{{\"type\":\"transcript\",\"n\":{n}}}"))
+                .await
+                .unwrap();
+        }
+        sender
+            .publish_channel("{\"type\":\"active_update\"}")
+            .await
+            .unwrap();
+        assert_eq!(sender.stats().await.unwrap().outbound_queued, 5);
+        // 200 per second: one message every 5 ms of the stub's clock.
+        for _ in 0..5 {
+            unsafe { atem_rtm_stub_advance_clock(app_c.as_ptr(), 5) };
+            sender.tick().await.unwrap();
+        }
+        assert_eq!(sender.stats().await.unwrap().outbound_queued, 0);
+        receiver.tick().await.unwrap();
+
+        let received: Vec<String> = receiver
+            .drain_events()
+            .await
+            .into_iter()
+            .filter_map(|event| match event {
+                RtmEvent::Message { payload, .. } => Some(payload),
+                _ => None,
+            })
+            .collect();
+        let transcript = |n: u32| format!("{{\"type\":\"transcript\",\"n\":{n}}}");
+        assert_eq!(
+            received,
+            vec![
+                transcript(0),
+                "{\"type\":\"active_update\"}".to_string(),
+                transcript(1),
+                transcript(2),
+                transcript(3),
+                transcript(4),
+            ]
+        );
+        let stats = sender.stats().await.unwrap();
+        assert_eq!(stats.outbound_deferred, 5);
+        assert_eq!(stats.outbound_aged, 0);
+        assert!(stats.outbound_wait_ms_max_bulk >= stats.outbound_wait_ms_max_control);
+    }
+
+    fn credit_client(app: &str, client_id: &str, credit_window: u32) -> RtmClient {
+        RtmClient::new(RtmConfig {
+            app_id: app.into(),
+            channel: "atem_channel".into(),
+            client_id: client_id.into(),
+            credit_window,
+            ..Default::default()
+        })
+        .unwrap()
+    }
+
+    async fn payloads_from(client: &RtmClient, publisher: &str) -> Vec<String> {
+        client
+            .drain_events()
+            .await
+            .into_iter()
+            .filter_map(|event| match event {
+                RtmEvent::Message { from, payload, .. } if from == publisher => Some(payload),
+                _ => None,
+            })
+            .collect()
+    }
+
+    #[tokio::test]
+    async fn credit_window_bounds_what_a_slow_receiver_has_queued() {
+        let app = test_app();
+        let astation = stub_client_in(&app, "astation");
+        let atem = credit_client(&app, "atem01", 4);
+        astation
+            .login_and_join("", "astation", "atem_channel")
+            .await
+            .unwrap();
+        atem.login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        atem.drain_events().await;
+
+        let transcript = |n: u32| format!("{{\"type\":\"transcript\",\"n\":{n}}}");
+        // The first message introduces the publisher; its grant follows.
+        astation.publish_channel(&transcript(0)).await.unwrap();
+        atem.tick().await.unwrap();
+        astation.tick().await.unwrap();
+        for n in 1..20 {
+            astation.publish_channel(&transcript(n)).await.unwrap();
+        }
+        let stats = astation.stats().await.unwrap();
+        assert_eq!(stats.credit_grants_received, 1);
+        assert_eq!(stats.credit_waiting, 16);
+
+        atem.tick().await.unwrap();
+        let mut received = payloads_from(&atem, "astation").await;
+        assert_eq!(received.len(), 4);
+        // Each drain frees credit for at most one more window.
+        let deadline = std::time::Instant::now() + Duration::from_secs(5);
+        while received.len() < 20 {
+            assert!(
+                std::time::Instant::now() < deadline,
+                "credit never caught up"
+            );
+            atem.tick().await.unwrap();
+            astation.tick().await.unwrap();
+            atem.tick().await.unwrap();
+            let batch = payloads_from(&atem, "astation").await;
+            assert!(
+                batch.len() <= 4,
+                "{} messages beyond the window",
+                batch.len()
+            );
+            received.extend(batch);
+        }
+        assert_eq!(received, (0..20).map(transcript).collect::<Vec<_>>());
+        assert_eq!(astation.stats().await.unwrap().credit_held, 16);
+        assert!(atem.stats().await.unwrap().credit_grants_sent >= 5);
+    }
+
+    #[tokio::test]
+    async fn held_partials_coalesce_to_the_latest() {
+        let app = test_app();
+        let astation = stub_client_in(&app, "astation");
+        let atem = credit_client(&app, "atem01", 1);
+        astation
+            .login_and_join("", "astation", "atem_channel")
+            .await
+            .unwrap();
+        atem.login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        atem.drain_events().await;
+
+        let partial = |text: &str| {
+            format!("{{\"type\":\"voiceCommand\",\"text\":\"{text}\",\"is_final\":false}}")
+        };
+        astation.publish_channel(&partial("open")).await.unwrap();
+        atem.tick().await.unwrap();
+        astation.tick().await.unwrap();
+        for text in ["open the", "open the par", "open the parser"] {
+            astation.publish_channel(&partial(text)).await.unwrap();
+        }
+        let stats = astation.stats().await.unwrap();
+        assert_eq!(stats.credit_waiting, 1);
+        assert_eq!(stats.credit_coalesced, 2);
+
+        assert_eq!(
+            payloads_from(&atem, "astation").await,
+            vec![partial("open")]
+        );
+        atem.tick().await.unwrap();
+        astation.tick().await.unwrap();
+        atem.tick().await.unwrap();
+        assert_eq!(
+            payloads_from(&atem, "astation").await,
+            vec![partial("open the parser")]
+        );
+    }
+
+    #[tokio::test]
+    async fn dropped_events_still_return_credit() {
+        let app = test_app();
+        let astation = stub_client_in(&app, "astation");
+        let atem = RtmClient::new(RtmConfig {
+            app_id: app.clone(),
+            channel: "atem_channel".into(),
+            client_id: "atem01".into(),
+            credit_window: 4,
+            event_queue_capacity: 2,
+            ..Default::default()
+        })
+        .unwrap();
+        astation
+            .login_and_join("", "astation", "atem_channel")
+            .await
+            .unwrap();
+        atem.login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        atem.drain_events().await;
+
+        let transcript = |n: u32| format!("{{\"type\":\"transcript\",\"n\":{n}}}");
+        astation.publish_channel(&transcript(0)).await.unwrap();
+        atem.tick().await.unwrap();
+        astation.tick().await.unwrap();
+        for n in 1..20 {
+            astation.publish_channel(&transcript(n)).await.unwrap();
+        }
+        // Half of each window overflows the receiver's queue unpolled;
+        // those messages must free credit as the polled ones do.
+        let deadline = std::time::Instant::now() + Duration::from_secs(5);
+        while astation.stats().await.unwrap().credit_waiting > 0 {
+            assert!(
+                std::time::Instant::now() < deadline,
+                "credit stalled behind dropped events"
+            );
+            atem.drain_events().await;
+            atem.tick().await.unwrap();
+            astation.tick().await.unwrap();
+        }
+        assert!(atem.stats().await.unwrap().events_dropped > 0);
+    }
+
+    #[tokio::test]
+    async fn credit_hold_max_pushes_back_on_the_sender() {
+        let app = test_app();
+        let astation = RtmClient::new(RtmConfig {
+            app_id: app.clone(),
+            channel: "atem_channel".into(),
+            client_id: "astation".into(),
+            credit_hold_max: 3,
+            ..Default::default()
+        })
+        .unwrap();
+        let atem = credit_client(&app, "atem01", 1);
+        astation
+            .login_and_join("", "astation", "atem_channel")
+            .await
+            .unwrap();
+        atem.login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        atem.drain_events().await;
+
+        let transcript = |n: u32| format!("{{\"type\":\"transcript\",\"n\":{n}}}");
+        astation.publish_channel(&transcript(0)).await.unwrap();
+        atem.tick().await.unwrap();
+        astation.tick().await.unwrap();
+        for n in 1..4 {
+            astation.publish_channel(&transcript(n)).await.unwrap();
+        }
+        assert!(astation.publish_channel(&transcript(4)).await.is_err());
+        let stats = astation.stats().await.unwrap();
+        assert_eq!(stats.credit_waiting, 3);
+        assert_eq!(stats.credit_refused, 1);
+    }
+
+    #[tokio::test]
+    async fn peer_messages_held_offline_still_wait_for_credit() {
+        let app = test_app();
+        let astation = stub_client_in(&app, "astation");
+        let atem = credit_client(&app, "atem01", 2);
+        astation
+            .login_and_join("", "astation", "atem_channel")
+            .await
+            .unwrap();
+        atem.login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        astation.tick().await.unwrap();
+        // The first message introduces the sender; its grant follows.
+        astation.send_peer("atem01", "m0").await.unwrap();
+        atem.tick().await.unwrap();
+        astation.tick().await.unwrap();
+        assert_eq!(astation.stats().await.unwrap().credit_grants_received, 1);
+
+        atem.disconnect().await;
+        astation.tick().await.unwrap();
+        for n in 1..=6 {
+            let delivery = astation
+                .send_peer("atem01", &format!("m{n}"))
+                .await
+                .unwrap();
+            assert_eq!(delivery, PeerDelivery::Held);
+        }
+
+        // Back online: the held messages are let out no faster than the
+        // grant allows.
+        unsafe { atem_rtm_connect(atem.inner.lock().await.handle) };
+        atem.login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        atem.drain_events().await;
+        astation.tick().await.unwrap();
+        let stats = astation.stats().await.unwrap();
+        assert_eq!(stats.peer_messages_flushed, 6);
+        assert!(stats.credit_waiting > 0);
+        atem.tick().await.unwrap();
+        let first = payloads_from(&atem, "astation").await;
+        assert!(
+            first.len() <= 2,
+            "{} messages beyond the window",
+            first.len()
+        );
+    }
+
+    #[tokio::test]
+    async fn stats_series_records_each_second_of_traffic() {
+        let app = test_app();
+        let app_c = CString::new(app.clone()).unwrap();
+        let sender = stub_client_in(&app, "atem01");
+        let receiver = stub_client_in(&app, "atem02");
+        sender
+            .login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        receiver
+            .login_and_join("", "atem02", "atem_channel")
+            .await
+            .unwrap();
+        receiver.drain_events().await;
+
+        let payload = "{\"type\":\"transcript\"}";
+        for _ in 0..5 {
+            sender.publish_channel(payload).await.unwrap();
+        }
+        receiver.tick().await.unwrap();
+        receiver.drain_events().await;
+        // Samples enter the series once their second is over.
+        unsafe { atem_rtm_stub_advance_clock(app_c.as_ptr(), 1_000) };
+
+        let series = receiver.stats_series().await.unwrap();
+        assert!(!series.is_empty() && series.len() <= STATS_SERIES_SECONDS);
+        assert!(
+            series
+                .windows(2)
+                .all(|pair| pair[1].unix_second == pair[0].unix_second + 1)
+        );
+        let total = |field: fn(&StatsSample) -> u64| series.iter().map(field).sum::<u64>();
+        assert_eq!(total(|s| s.messages_in as u64), 5);
+        assert_eq!(total(|s| s.bytes_in), 5 * payload.len() as u64);
+        assert_eq!(total(|s| s.latency_samples as u64), 5);
+        assert!(series.iter().any(|s| s.queue_depth_max > 0));
+        assert_eq!(total(|s| s.errors as u64), 0);
+
+        let sent = sender.stats_series().await.unwrap();
+        assert_eq!(sent.iter().map(|s| s.messages_out).sum::<u32>(), 5);
+    }
+
+    #[tokio::test]
+    async fn join_replays_history_before_live_messages() {
+        let app = test_app();
+        let a = stub_client_in(&app, "atem01");
+        a.login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        a.set_history_policy(None, HistoryPolicy::Store)
+            .await
+            .unwrap();
+        a.publish_channel("{\"n\":1}").await.unwrap();
+        a.publish_channel("{\"n\":2}").await.unwrap();
+
+        let b = RtmClient::new(RtmConfig {
+            app_id: app.clone(),
+            channel: "atem_channel".into(),
+            client_id: "atem02".into(),
+            join_history_count: 10,
+            ..Default::default()
+        })
+        .unwrap();
+        b.login_and_join("", "atem02", "atem_channel")
+            .await
+            .unwrap();
+        a.publish_channel("{\"n\":3}").await.unwrap();
+        b.tick().await.unwrap();
+
+        let received: Vec<(String, bool)> = b
+            .drain_events()
+            .await
+            .into_iter()
+            .filter_map(|event| match event {
+                RtmEvent::Message {
+                    payload, replayed, ..
+                } => Some((payload, replayed)),
+                _ => None,
+            })
+            .collect();
+        assert_eq!(
+            received,
+            vec![
+                ("{\"n\":1}".to_string(), true),
+                ("{\"n\":2}".to_string(), true),
+                ("{\"n\":3}".to_string(), false),
+            ]
+        );
+        let stats = b.stats().await.unwrap();
+        assert_eq!(stats.prefetch_fetches, 1);
+        assert_eq!(stats.prefetch_replayed, 2);
+        assert_eq!(stats.prefetch_late, 0);
+    }
+
+    #[cfg(not(feature = "real_rtm"))]
+    #[tokio::test]
+    async fn stub_arbitrates_locks_with_latency() {
+        let app = test_app();
+        let app_c = CString::new(app.clone()).unwrap();
+        let a = stub_client_in(&app, "atem01");
+        let b = stub_client_in(&app, "atem02");
+        a.login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        b.login_and_join("", "atem02", "atem_channel")
+            .await
+            .unwrap();
+        assert_eq!(
+            unsafe { atem_rtm_stub_set_latency(app_c.as_ptr(), 20, 20) },
+            0
+        );
+
+        let order = std::cell::RefCell::new(Vec::new());
+        let done = std::cell::Cell::new(0);
+        tokio::join!(
+            async {
+                a.acquire_lock("atem_channel", "active").await.unwrap();
+                order.borrow_mut().push("atem01");
+                a.release_lock("atem_channel", "active").await.unwrap();
+                done.set(done.get() + 1);
+            },
+            async {
+                b.acquire_lock("atem_channel", "active").await.unwrap();
+                order.borrow_mut().push("atem02");
+                done.set(done.get() + 1);
+            },
+            async {
+                for _ in 0..100 {
+                    if done.get() == 2 {
+                        break;
+                    }
+                    unsafe { atem_rtm_stub_advance_clock(app_c.as_ptr(), 10) };
+                    a.tick().await.unwrap();
+                    b.tick().await.unwrap();
+                    tokio::task::yield_now().await;
+                }
+            }
+        );
+        assert_eq!(*order.borrow(), vec!["atem01", "atem02"]);
+        let stats = b.stats().await.unwrap();
+        assert_eq!(stats.lock_contended, 1);
+        assert_eq!(stats.lock_acquired, 1);
+    }
+
+    #[cfg(not(feature = "real_rtm"))]
+    #[tokio::test]
+    async fn stub_lock_expires_after_owner_leaves() {
+        let app = test_app();
+        let app_c = CString::new(app.clone()).unwrap();
+        let a = stub_client_in(&app, "atem01");
+        let b = stub_client_in(&app, "atem02");
+        a.login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        b.login_and_join("", "atem02", "atem_channel")
+            .await
+            .unwrap();
+        a.acquire_lock("atem_channel", "active").await.unwrap();
+        a.disconnect().await;
+
+        let advanced = std::cell::Cell::new(0u32);
+        let (acquired, _) = tokio::join!(b.acquire_lock("atem_channel", "active"), async {
+            for _ in 0..20 {
+                tokio::task::yield_now().await;
+                if b.stats().await.unwrap().lock_acquired == 1 {
+                    break;
+                }
+                unsafe { atem_rtm_stub_advance_clock(app_c.as_ptr(), 1_000) };
+                advanced.set(advanced.get() + 1_000);
+                b.tick().await.unwrap();
+            }
+        });
+        acquired.unwrap();
+        // Held for the service's default TTL after the owner went away.
+        assert!(advanced.get() >= 10_000);
+    }
+
+    #[cfg(not(feature = "real_rtm"))]
+    #[tokio::test]
+    async fn stub_lock_waiter_rechecks_on_the_virtual_clock() {
+        let app = test_app();
+        let app_c = CString::new(app.clone()).unwrap();
+        let a = stub_client_in(&app, "atem01");
+        let b = stub_client_in(&app, "atem02");
+        a.login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        b.login_and_join("", "atem02", "atem_channel")
+            .await
+            .unwrap();
+        a.acquire_lock("atem_channel", "active").await.unwrap();
+
+        let waiter = b.acquire_lock("atem_channel", "active");
+        tokio::pin!(waiter);
+        tokio::select! {
+            _ = &mut waiter => panic!("the lock is held"),
+            _ = tokio::task::yield_now() => {}
+        }
+        b.tick().await.unwrap();
+        let before = b.stats().await.unwrap();
+        assert_eq!(before.timers_pending, 1);
+
+        // No event was missed, but after 30 s the waiter asks once more.
+        unsafe { atem_rtm_stub_advance_clock(app_c.as_ptr(), 29_000) };
+        b.tick().await.unwrap();
+        assert_eq!(b.stats().await.unwrap().lock_acquires, before.lock_acquires);
+        unsafe { atem_rtm_stub_advance_clock(app_c.as_ptr(), 1_000) };
+        b.tick().await.unwrap();
+        let after = b.stats().await.unwrap();
+        assert_eq!(after.lock_acquires, before.lock_acquires + 1);
+        assert_eq!(after.lock_contended, before.lock_contended + 1);
+        assert_eq!(after.timers_fired, 1);
+        // Refused again, so the next re-check is armed.
+        assert_eq!(after.timers_pending, 1);
+    }
+
+    #[tokio::test]
+    async fn callback_cpu_is_attributed_per_event_kind() {
+        let app = test_app();
+        let a = stub_client_in(&app, "atem01");
+        let b = stub_client_in(&app, "atem02");
+        a.login_and_join("", "atem01", "atem_channel")
+            .await
+            .unwrap();
+        b.login_and_join("", "atem02", "atem_channel")
+            .await
+            .unwrap();
+        a.publish_channel("{\"type\":\"status\"}").await.unwrap();
+        b.tick().await.unwrap();
+
+        // b saw its own snapshot and the message; a also saw b join.
+        let stats = b.stats().await.unwrap();
+        assert_eq!(stats.cpu_callbacks, 2);
+        assert!(stats.cpu_callback_max_us <= stats.cpu_callback_us);
+        // Totals are rounded down per slot.
+        assert!(stats.cpu_callback_us >= stats.cpu_message_us + stats.cpu_presence_us);
+        assert_eq!(a.stats().await.unwrap().cpu_callbacks, 2);
+    }
+
+    #[tokio::test]
+    async fn fleet_brings_up_every_client() {
+        let clients: Vec<RtmClient> = (0..5)
+            .map(|i| stub_client(&format!("atem{i:02}")))
+            .collect();
+        let sessions: Vec<(&RtmClient, &str, &str)> =
+            clients.iter().map(|c| (c, "", "atem_channel")).collect();
+        let report = bring_up_fleet(
+            &sessions,
+            FleetConfig {
+                max_parallel: 2,
+                stagger_ms: 1,
+                jitter_ms: Some(1),
+                ..Default::default()
+            },
+        )
+        .await
+        .expect("fleet");
+        assert_eq!(report.sessions, 5);
+        assert_eq!(report.ready, 5);
+        assert_eq!(report.failed, 0);
+        assert!(report.ready_p50 <= report.ready_p99);
+        for client in &clients {
+            client.publish_channel("hello").await.expect("joined");
         }
     }
 }
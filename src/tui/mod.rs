@@ -4,7 +4,7 @@ pub mod voice_fx;
 use anyhow::Result;
 use crossterm::{
     event::{
-        self, Event, KeyCode, KeyEventKind, KeyModifiers,
+        self, DisableFocusChange, EnableFocusChange, Event, KeyCode, KeyEventKind, KeyModifiers,
     },
     execute,
     terminal::{
@@ -27,7 +27,7 @@ pub async fn run_tui() -> Result<()> {
     // Interactive TUI mode
     enable_raw_mode()?;
     let mut stdout = io::stdout();
-    execute!(stdout, EnterAlternateScreen)?;
+    execute!(stdout, EnterAlternateScreen, EnableFocusChange)?;
     let backend = CrosstermBackend::new(stdout);
     let mut terminal = Terminal::new(backend)?;
 
@@ -38,6 +38,7 @@ pub async fn run_tui() -> Result<()> {
     disable_raw_mode()?;
     execute!(
         terminal.backend_mut(),
+        DisableFocusChange,
         LeaveAlternateScreen
     )?;
     terminal.show_cursor()?;
@@ -93,7 +94,11 @@ async fn run_tui_loop(terminal: &mut Terminal<CrosstermBackend<Stdout>>, app: &m
         terminal.draw(|f| draw_ui(f, app))?;
 
         if event::poll(Duration::from_millis(100))? {
-            if let Event::Key(key) = event::read()? {
+            let input_event = event::read()?;
+            if let Event::FocusGained | Event::FocusLost = input_event {
+                app.register_local_activity(matches!(input_event, Event::FocusGained)).await;
+            }
+            if let Event::Key(key) = input_event {
                 if key.kind == KeyEventKind::Press {
                     app.register_local_activity(true).await;
                     let ctrl = key.modifiers.contains(KeyModifiers::CONTROL);